@@ -78,6 +78,19 @@ retouch_copy_buffer_to_buffer(global float4 *in, global dt_iop_roi_t *roi_in, gl
   out[mad24(y, roi_out->width, x)] = in[mad24(y + yoffs, roi_in->width, x + xoffs)];
 }
 
+kernel void
+retouch_paste_buffer_to_buffer(global float4 *in, global dt_iop_roi_t *roi_in, global float4 *out,
+                               global dt_iop_roi_t *roi_out, const int xoffs, const int yoffs)
+{
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= roi_in->width || y >= roi_in->height) return;
+  if(x + xoffs >= roi_out->width || y + yoffs >= roi_out->height) return;
+
+  out[mad24(y + yoffs, roi_out->width, x + xoffs)] = in[mad24(y, roi_in->width, x)];
+}
+
 kernel void
 retouch_copy_mask_to_alpha(global float4 *in, global dt_iop_roi_t *roi_in, global float *mask_scaled,
                                        global dt_iop_roi_t *roi_mask_scaled, const float opacity)
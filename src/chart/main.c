@@ -636,14 +636,14 @@ static void print_xml_plugin(FILE *fd, int num, int op_version, const char *oper
   fprintf(fd, "  </plugin>\n");
 }
 
-static void export_style(dt_lut_t *self, const char *filename, const char *name, const char *description,
-                         gboolean include_basecurve, gboolean include_colorchecker, gboolean include_colorin,
-                         gboolean include_tonecurve)
+static gboolean export_style(dt_lut_t *self, const char *filename, const char *name, const char *description,
+                             gboolean include_basecurve, gboolean include_colorchecker, gboolean include_colorin,
+                             gboolean include_tonecurve)
 {
   int num = 0;
 
   FILE *fd = g_fopen(filename, "w");
-  if(!fd) return;
+  if(!fd) return FALSE;
 
   fprintf(fd, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
   fprintf(fd, "<darktable_style version=\"1.0\">\n");
@@ -682,6 +682,7 @@ static void export_style(dt_lut_t *self, const char *filename, const char *name,
   fprintf(fd, "</darktable_style>\n");
 
   fclose(fd);
+  return TRUE;
 }
 
 static void export_raw(dt_lut_t *self, char *filename, char *name, char *description)
@@ -1089,25 +1090,17 @@ static void process_data(dt_lut_t *self, double *target_L, double *target_a, dou
   tonecurve_delete(&tonecurve);
 }
 
-static void process_button_clicked_callback(GtkButton *button, gpointer user_data)
+// source and reference Lab of all the patches of the chart plus the hdr ones, returns their number
+static int get_patches_data(dt_lut_t *self, double **target_L, double **target_a, double **target_b,
+                            double **colorchecker_Lab)
 {
-  dt_lut_t *self = (dt_lut_t *)user_data;
-
-  gtk_widget_set_sensitive(self->export_button, FALSE);
-  free(self->tonecurve_encoded);
-  free(self->colorchecker_encoded);
-  self->tonecurve_encoded = NULL;
-  self->colorchecker_encoded = NULL;
-
-  if(!self->chart) return;
-
   int i = 0;
   int N = g_hash_table_size(self->chart->box_table);
 
-  double *target_L = (double *)calloc(sizeof(double), (N + 4));
-  double *target_a = (double *)calloc(sizeof(double), (N + 4));
-  double *target_b = (double *)calloc(sizeof(double), (N + 4));
-  double *colorchecker_Lab = (double *)calloc(sizeof(double) * 3, N);
+  *target_L = (double *)calloc(sizeof(double), (N + 4));
+  *target_a = (double *)calloc(sizeof(double), (N + 4));
+  *target_b = (double *)calloc(sizeof(double), (N + 4));
+  *colorchecker_Lab = (double *)calloc(sizeof(double) * 3, N);
 
   GHashTableIter table_iter;
   gpointer set_key, value;
@@ -1116,10 +1109,28 @@ static void process_button_clicked_callback(GtkButton *button, gpointer user_dat
   while(g_hash_table_iter_next(&table_iter, &set_key, &value))
   {
     GList *patch_names = (GList *)value;
-    add_patches_to_array(self, patch_names, &N, &i, target_L, target_a, target_b, colorchecker_Lab);
+    add_patches_to_array(self, patch_names, &N, &i, *target_L, *target_a, *target_b, *colorchecker_Lab);
   }
 
-  add_hdr_patches(&N, &target_L, &target_a, &target_b, &colorchecker_Lab);
+  add_hdr_patches(&N, target_L, target_a, target_b, colorchecker_Lab);
+
+  return N;
+}
+
+static void process_button_clicked_callback(GtkButton *button, gpointer user_data)
+{
+  dt_lut_t *self = (dt_lut_t *)user_data;
+
+  gtk_widget_set_sensitive(self->export_button, FALSE);
+  free(self->tonecurve_encoded);
+  free(self->colorchecker_encoded);
+  self->tonecurve_encoded = NULL;
+  self->colorchecker_encoded = NULL;
+
+  if(!self->chart) return;
+
+  double *target_L, *target_a, *target_b, *colorchecker_Lab;
+  const int N = get_patches_data(self, &target_L, &target_a, &target_b, &colorchecker_Lab);
 
   int sparsity = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(self->number_patches)) + 4;
 
@@ -1885,11 +1896,125 @@ static int main_csv(dt_lut_t *self, int argc, char *argv[])
   return 0;
 }
 
+// corners of the chart in the source image relative to its size, "x,y,x,y,x,y,x,y" clockwise from the top left
+static gboolean parse_corners(const char *corners, point_t *bb)
+{
+  gchar **values = g_strsplit(corners, ",", -1);
+  gboolean res = g_strv_length(values) == 8;
+  for(int i = 0; res && i < 8; i++)
+  {
+    char *end = NULL;
+    const double value = g_ascii_strtod(values[i], &end);
+    res = end != values[i] && *end == '\0';
+    if(i % 2 == 0)
+      bb[i / 2].x = value;
+    else
+      bb[i / 2].y = value;
+  }
+  g_strfreev(values);
+  return res;
+}
+
+static int main_headless(dt_lut_t *self, int argc, char *argv[])
+{
+  const char *source_filename = argv[2];
+  const char *cht_filename = argv[3];
+  const char *reference_filename = argv[4];
+  const int num_patches = atoi(argv[5]);
+  const char *filename_style = argv[6];
+
+  const int sparsity = num_patches + 4;
+
+  if(num_patches < 0)
+  {
+    fprintf(stderr, "invalid number of patches `%s', giving up\n", argv[5]);
+    return 1;
+  }
+
+  self->source.chart = &self->chart;
+  self->reference.chart = &self->chart;
+  // the default frame of the gui when no corners are given
+  reset_bb(&self->source);
+  reset_bb(&self->reference);
+
+  if(!open_image(&self->source, source_filename)) return 1;
+  if(argc == 8 && !parse_corners(argv[7], self->source.bb))
+  {
+    fprintf(stderr, "error parsing the chart corners `%s', giving up\n", argv[7]);
+    return 1;
+  }
+
+  self->chart = parse_cht(cht_filename);
+  if(!self->chart)
+  {
+    fprintf(stderr, "error parsing `%s', giving up\n", cht_filename);
+    return 1;
+  }
+  // as the gui does, sample with the default shrink of the boxes
+  self->source.shrink = 1.0f;
+  self->reference.shrink = 1.0f;
+
+  char *upper_string = g_ascii_strup(reference_filename, -1);
+  const gboolean reference_image = g_str_has_suffix(upper_string, ".PFM");
+  g_free(upper_string);
+  if(reference_image)
+  {
+    if(!open_image(&self->reference, reference_filename)) return 1;
+    // the chart is framed the same in both images, as when matching raw to jpeg
+    memcpy(self->reference.bb, self->source.bb, sizeof(self->reference.bb));
+    collect_reference_patches(self);
+  }
+  else if(!parse_it8(reference_filename, self->chart))
+  {
+    fprintf(stderr, "error parsing `%s', giving up\n", reference_filename);
+    return 1;
+  }
+  collect_source_patches(self);
+  self->reference_filename = get_filename_base(reference_filename);
+
+  double *target_L, *target_a, *target_b, *colorchecker_Lab;
+  const int N = get_patches_data(self, &target_L, &target_a, &target_b, &colorchecker_Lab);
+
+  // the fit picks num_patches of them, on top of the 4 of the linear part
+  const int needed = MAX(num_patches, 4);
+  if(N < needed)
+  {
+    fprintf(stderr, "only %d usable patches, %d are needed, giving up\n", N, needed);
+    free(target_L);
+    free(target_a);
+    free(target_b);
+    free(colorchecker_Lab);
+    return 1;
+  }
+
+  process_data(self, target_L, target_a, target_b, colorchecker_Lab, N, sparsity);
+
+  // same defaults as the export dialog
+  char *name = g_strdup(self->reference_filename);
+  char *name_dot = g_strrstr(name, ".");
+  if(name_dot) *name_dot = '\0';
+  char *description = g_strdup_printf("fitted LUT style from %s", self->reference_filename);
+
+  const gboolean res = export_style(self, filename_style, name, description, TRUE, TRUE, TRUE, TRUE);
+  if(!res) fprintf(stderr, "error writing `%s'\n", filename_style);
+
+  free(target_L);
+  free(target_a);
+  free(target_b);
+  free(colorchecker_Lab);
+  g_free(name);
+  g_free(description);
+
+  return res ? 0 : 1;
+}
+
 static void show_usage(const char *exe)
 {
   fprintf(stderr, "Usage: %s [<input Lab pfm file>] [<cht file>] [<reference cgats/it8 or Lab pfm file>]\n"
-                  "       %s --csv <csv file> <number patches> <output dtstyle file>\n",
-          exe, exe);
+                  "       %s --csv <csv file> <number patches> <output dtstyle file>\n"
+                  "       %s --headless <input Lab pfm file> <cht file> <reference cgats/it8 or Lab pfm file>"
+                  " <number patches> <output dtstyle file> [<chart corners x,y,x,y,x,y,x,y>]\n",
+          exe, exe, exe);
 }
 
 int main(int argc, char *argv[])
@@ -1918,6 +2043,13 @@ int main(int argc, char *argv[])
     else
       res = main_csv(self, argc, argv);
   }
+  else if(argc >= 2 && !g_strcmp0(argv[1], "--headless"))
+  {
+    if(argc != 7 && argc != 8)
+      show_usage(argv[0]);
+    else
+      res = main_headless(self, argc, argv);
+  }
   else if(argc <= 4)
     res = main_gui(self, argc, argv);
   else
@@ -180,12 +180,13 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
   for(int j = N; j < wd; j++)
     for(int i = N; i < wd; i++) A[j * wd + i] = 0.0f;
 
+  // A is symmetric: column t can be read as the contiguous row t below.
   // precompute normalisation factors for columns of A
   double *norm = malloc(sizeof(double) * wd);
   for(int i = 0; i < wd; i++)
   {
     norm[i] = 0.0;
-    for(int j = 0; j < wd; j++) norm[i] += A[j * wd + i] * A[j * wd + i];
+    for(int j = 0; j < wd; j++) norm[i] += A[i * wd + j] * A[i * wd + j];
     norm[i] = 1.0 / sqrt(norm[i]);
   }
 
@@ -200,6 +201,15 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
   double *v = malloc(sizeof(double) * S * S);
   double *As = calloc((size_t)wd * S, sizeof(double));
 
+  // thin QR factorisation of the chosen columns, A_perm = Q R, grown by one column per rank:
+  // Q[i * wd + j] is the i-th orthonormal column, R is S x S upper triangular and qtb[ch * S + i] = q_i^t b[ch]
+  double *Q = calloc((size_t)wd * S, sizeof(double));
+  double *R = calloc((size_t)S * S, sizeof(double));
+  double *qtb = calloc((size_t)dim * S, sizeof(double));
+  double *dots = malloc(sizeof(double) * wd);
+
+  int res = -1;
+
   // for rank from 0 to sparsity level
   int s = 0, patches = 0;
   double olderr = FLT_MAX;
@@ -210,14 +220,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
 #ifndef REPLACEMENT
     if(patches >= S - 4)
     {
-      free(r);
-      free(b);
-      free(w);
-      free(v);
-      free(As);
-      free(norm);
-      free(A);
-      return sparsity;
+      res = sparsity;
+      goto end;
     }
     assert(sparsity < S + 4);
 #endif
@@ -225,12 +229,12 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
     // by searching over all three residuals
     double maxdot = 0.0;
     int maxcol = 0;
+#ifdef EXACT // use full solve
     for(int t = 0; t < wd; t++)
     {
       double dot = 0.0;
       if(norm[t] > 0.0)
       {
-#ifdef EXACT // use full solve
         permutation[sparsity] = t;
         for(int ch = 0; ch < dim; ch++)
         {
@@ -241,14 +245,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
 
           if(solve(As, w, v, b[ch], coeff[ch], wd, sparsity, S))
           {
-            free(r);
-            free(b);
-            free(w);
-            free(v);
-            free(As);
-            free(norm);
-            free(A);
-            return sparsity;
+            res = sparsity;
+            goto end;
           }
 
           // compute tentative residual:
@@ -263,23 +261,46 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
         // compute error:
         const double err = compute_error(curve, target, r[0], r[1], r[2], wd, 0);
         dot = 1. / err; // searching for smallest error or largest dot
-#else                   // use dot product
+      }
+      // fprintf(stderr, "dot %d = %g\n", i, dot);
+      if(dot > maxdot)
+      {
+        maxcol = t;
+        maxdot = dot;
+      }
+    }
+#else // use dot product
+    // the candidates are independent, score them in parallel and keep the first best one
+    const double *const res_v = &r[0][0];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(A, norm, res_v, dots, wd, dim) \
+    schedule(static)
+#endif
+    for(int t = 0; t < wd; t++)
+    {
+      double dot = 0.0;
+      if(norm[t] > 0.0)
+      {
         for(int ch = 0; ch < dim; ch++)
         {
           double chdot = 0.0;
-          for(int j = 0; j < wd; j++) chdot += A[j * wd + t] * r[ch][j];
+          for(int j = 0; j < wd; j++) chdot += A[(size_t)t * wd + j] * res_v[(size_t)ch * wd + j];
           dot += fabs(chdot);
         }
         dot *= norm[t];
-#endif
       }
-      // fprintf(stderr, "dot %d = %g\n", i, dot);
-      if(dot > maxdot)
+      dots[t] = dot;
+    }
+    for(int t = 0; t < wd; t++)
+    {
+      if(dots[t] > maxdot)
       {
         maxcol = t;
-        maxdot = dot;
+        maxdot = dots[t];
       }
     }
+#endif
 
     if(patches < S - 4)
     {
@@ -308,14 +329,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
 
           if(solve(As, w, v, b[ch], coeff[ch], wd, sparsity-1, S))
           {
-            free(r);
-            free(b);
-            free(w);
-            free(v);
-            free(As);
-            free(norm);
-            free(A);
-            return s;
+            res = s;
+            goto end;
           }
 
           // compute tentative residual:
@@ -371,7 +386,7 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
 
 #ifdef EXACT
     double err = 1. / maxdot;
-#else
+#elif defined(REPLACEMENT)
     const int sp = MIN(sparsity, S-1); // need to fix up for replacement
     // solve linear least squares for sparse c for every output channel:
     for(int ch = 0; ch < dim; ch++)
@@ -384,14 +399,8 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
       // on error, return last valid configuration
       if(solve(As, w, v, b[ch], coeff[ch], wd, sp, S))
       {
-        free(r);
-        free(b);
-        free(w);
-        free(v);
-        free(As);
-        free(norm);
-        free(A);
-        return sparsity;
+        res = sparsity;
+        goto end;
       }
 
       // compute new residual:
@@ -403,6 +412,54 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
       }
     }
 
+    double merr = 0.0;
+    const double err = compute_error(curve, target, r[0], r[1], r[2], wd, &merr);
+#else
+    // the columns are only ever appended, so instead of solving the whole least squares problem again the new
+    // column is orthogonalised against Q (modified gram-schmidt, twice to keep Q orthogonal) and the residuals
+    // lose their component along it.
+    const int sp = sparsity;
+    double *q = Q + (size_t)sp * wd;
+    for(int j = 0; j < wd; j++) q[j] = A[(size_t)maxcol * wd + j];
+    for(int pass = 0; pass < 2; pass++)
+      for(int i = 0; i < sp; i++)
+      {
+        const double *qi = Q + (size_t)i * wd;
+        double d = 0.0;
+        for(int j = 0; j < wd; j++) d += qi[j] * q[j];
+        for(int j = 0; j < wd; j++) q[j] -= d * qi[j];
+        R[i * S + sp] += d;
+      }
+    double rho = 0.0;
+    for(int j = 0; j < wd; j++) rho += q[j] * q[j];
+    rho = sqrt(rho);
+
+    // the new column is about in the span of the previous ones, return last valid configuration
+    if(rho < 1e-3)
+    {
+      res = sparsity;
+      goto end;
+    }
+    R[sp * S + sp] = rho;
+    for(int j = 0; j < wd; j++) q[j] /= rho;
+
+    for(int ch = 0; ch < dim; ch++)
+    {
+      // r is orthogonal to the previous columns already, so q^t r = q^t b
+      double d = 0.0;
+      for(int j = 0; j < wd; j++) d += q[j] * r[ch][j];
+      qtb[ch * S + sp] = d;
+      for(int j = 0; j < wd; j++) r[ch][j] -= d * q[j];
+
+      // coefficients by back substitution of R c = Q^t b
+      for(int i = sp; i >= 0; i--)
+      {
+        double c = qtb[ch * S + i];
+        for(int k = i + 1; k <= sp; k++) c -= R[i * S + k] * coeff[ch][k];
+        coeff[ch][i] = c / R[i * S + i];
+      }
+    }
+
     double merr = 0.0;
     const double err = compute_error(curve, target, r[0], r[1], r[2], wd, &merr);
 #endif
@@ -420,6 +477,12 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
     // if(err < 2.0) return sparsity+1;
     olderr = err;
   }
+
+end:
+  free(dots);
+  free(qtb);
+  free(R);
+  free(Q);
   free(r);
   free(b);
   free(w);
@@ -427,7 +490,7 @@ int thinplate_match(const tonecurve_t *curve, // tonecurve to apply after this (
   free(As);
   free(norm);
   free(A);
-  return -1;
+  return res;
 }
 
 #pragma GCC diagnostic pop
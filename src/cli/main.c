@@ -25,6 +25,7 @@
  *  - profit
  */
 
+#include "cli/server.h"
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
@@ -83,6 +84,9 @@ static void usage(const char *progname)
   fprintf(stderr, "   --icc-file <file> specify icc filename, default to NONE\n");
   fprintf(stderr, "   --icc-intent <intent> specify icc intent, default to LAST\n");
   fprintf(stderr, "                     use --help icc-intent for list of supported intents\n");
+  fprintf(stderr, "   --server <port or unix socket> serve render requests instead of exporting,\n");
+  fprintf(stderr, "                     no input file nor output destination is given then\n");
+  fprintf(stderr, "   --server-threads <n> number of requests rendered at once, default: 2\n");
   fprintf(stderr, "   --verbose\n");
   fprintf(stderr, "   --help,-h [option]\n");
   fprintf(stderr, "   --version\n");
@@ -207,6 +211,9 @@ int main(int argc, char *arg[])
   gchar *icc_filename = NULL;
   dt_iop_color_intent_t icc_intent = DT_INTENT_LAST;
 
+  char *server_address = NULL;
+  int server_threads = 2;
+
   int k;
   for(k = 1; k < argc; k++)
   {
@@ -381,6 +388,16 @@ int main(int argc, char *arg[])
           exit(1);
         }
       }
+      else if(!strcmp(arg[k], "--server") && argc > k + 1)
+      {
+        k++;
+        server_address = arg[k];
+      }
+      else if(!strcmp(arg[k], "--server-threads") && argc > k + 1)
+      {
+        k++;
+        server_threads = MAX(atoi(arg[k]), 1);
+      }
       else if(!strcmp(arg[k], "-v") || !strcmp(arg[k], "--verbose"))
       {
         verbose = TRUE;
@@ -420,6 +437,34 @@ int main(int argc, char *arg[])
   for(; k < argc; k++) m_arg[m_argc++] = arg[k];
   m_arg[m_argc] = NULL;
 
+  if(server_address)
+  {
+    // the images and the output come with the requests
+    if(inputs || file_counter > 0)
+      fprintf(stderr, "%s\n", _("notice: input and output files are ignored by the render server"));
+    g_free(output_filename);
+    g_free(output_ext);
+    g_list_free_full(inputs, g_free);
+
+    if(dt_init(m_argc, m_arg, FALSE, custom_presets, NULL))
+    {
+      free(m_arg);
+      exit(1);
+    }
+
+    const dt_cli_server_params_t params = { .high_quality = high_quality,
+                                            .upscale = upscale,
+                                            .icc_type = icc_type,
+                                            .icc_filename = icc_filename,
+                                            .icc_intent = icc_intent };
+    const int res = dt_cli_server_run(server_address, server_threads, &params);
+
+    g_free(icc_filename);
+    dt_cleanup();
+    free(m_arg);
+    exit(res);
+  }
+
   if( (inputs && file_counter < 1) || (!inputs && file_counter < 2) || file_counter > 3)
   {
     usage(arg[0]);
@@ -742,10 +787,21 @@ int main(int argc, char *arg[])
 
   // TODO: add a callback to set the bpp without going through the config
 
+  // the files of the next images are read while the current one is exported
+  const int prefetch = dt_conf_get_int("plugins/imageio/prefetch");
+  GList *ahead = prefetch > 0 ? id_list : NULL;
+  for(int k = 0; k < prefetch && ahead; k++, ahead = g_list_next(ahead))
+    dt_imageio_prefetch(GPOINTER_TO_INT(ahead->data));
+
   int num = 1, res = 0;
   for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
   {
     const int id = GPOINTER_TO_INT(iter->data);
+    if(ahead)
+    {
+      dt_imageio_prefetch(GPOINTER_TO_INT(ahead->data));
+      ahead = g_list_next(ahead);
+    }
     // TODO: have a parameter in command line to get the export presets
     dt_export_metadata_t metadata;
     metadata.flags = dt_lib_export_metadata_default_flags();
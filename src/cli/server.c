@@ -0,0 +1,305 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cli/server.h"
+#include "common/darktable.h"
+
+#ifdef HAVE_HTTP_SERVER
+
+#include "common/exif.h"
+#include "common/film.h"
+#include "common/history.h"
+#include "common/http_server.h"
+#include "common/image.h"
+#include "common/image_cache.h"
+#include "common/imageio.h"
+#include "common/imageio_module.h"
+#include "common/metadata_export.h"
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <glib-unix.h>
+#endif
+
+typedef struct _server_t
+{
+  const dt_cli_server_params_t *params;
+
+  GMutex lock;
+  GCond released;
+  GHashTable *paths;   // path -> imgid of the images imported by the requests
+  GHashTable *applied; // imgid -> where its history comes from: "xmp:<path>", "sidecar" or "default"
+  GHashTable *busy;    // imgids being rendered
+} _server_t;
+
+static guint _error(GBytes **reply, gchar **content_type, const guint status, const char *message)
+{
+  *reply = g_bytes_new(message, strlen(message));
+  *content_type = g_strdup("text/plain");
+  return status;
+}
+
+static gboolean _query_bool(GHashTable *query, const char *key, const gboolean def)
+{
+  const char *value = query ? g_hash_table_lookup(query, key) : NULL;
+  if(!value) return def;
+  return !g_ascii_strcasecmp(value, "1") || !g_ascii_strcasecmp(value, "true");
+}
+
+// find or import the image, takes it for the rendering and sets its history. called with the lock held.
+static int32_t _take_image(_server_t *server, const char *path, const int32_t id, const char *xmp,
+                           const gboolean reset)
+{
+  int32_t imgid = id;
+
+  if(path)
+  {
+    imgid = GPOINTER_TO_INT(g_hash_table_lookup(server->paths, path));
+    if(imgid <= 0)
+    {
+      dt_film_t film;
+      gchar *directory = g_path_get_dirname(path);
+      dt_film_new(&film, directory);
+      g_free(directory);
+      imgid = dt_image_import(film.id, path, TRUE, FALSE);
+      if(imgid <= 0) return -1;
+      g_hash_table_insert(server->paths, g_strdup(path), GINT_TO_POINTER(imgid));
+      // the import has read the sidecar of the image, if any
+      g_hash_table_insert(server->applied, GINT_TO_POINTER(imgid), g_strdup("sidecar"));
+    }
+  }
+
+  // one rendering at a time per image, its history may have to change
+  while(g_hash_table_contains(server->busy, GINT_TO_POINTER(imgid)))
+    g_cond_wait(&server->released, &server->lock);
+  g_hash_table_add(server->busy, GINT_TO_POINTER(imgid));
+
+  // the images of the library keep their own history
+  if(!path) return imgid;
+
+  // without an xmp the image gets back the history of its own sidecar, the default one only when asked
+  gchar *wanted = xmp ? g_strconcat("xmp:", xmp, NULL) : g_strdup(reset ? "default" : "sidecar");
+  if(g_strcmp0(g_hash_table_lookup(server->applied, GINT_TO_POINTER(imgid)), wanted))
+  {
+    char sidecar[PATH_MAX] = { 0 };
+    if(!xmp && !reset)
+    {
+      g_strlcpy(sidecar, path, sizeof(sidecar));
+      dt_image_path_append_version(imgid, sidecar, sizeof(sidecar));
+      g_strlcat(sidecar, ".xmp", sizeof(sidecar));
+    }
+    const char *source = xmp ? xmp : (sidecar[0] && g_file_test(sidecar, G_FILE_TEST_IS_REGULAR) ? sidecar : NULL);
+
+    if(source)
+    {
+      dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'w');
+      const int failed = dt_exif_xmp_read(image, source, 1);
+      // don't write new xmp:
+      dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+      if(failed)
+      {
+        // the history is in an unknown state now
+        g_hash_table_remove(server->applied, GINT_TO_POINTER(imgid));
+        g_hash_table_remove(server->busy, GINT_TO_POINTER(imgid));
+        g_cond_broadcast(&server->released);
+        g_free(wanted);
+        return 0;
+      }
+    }
+    else
+      dt_history_delete_on_image(imgid);
+    g_hash_table_insert(server->applied, GINT_TO_POINTER(imgid), wanted);
+  }
+  else
+    g_free(wanted);
+
+  return imgid;
+}
+
+static void _release_image(_server_t *server, const int32_t imgid)
+{
+  g_mutex_lock(&server->lock);
+  g_hash_table_remove(server->busy, GINT_TO_POINTER(imgid));
+  g_cond_broadcast(&server->released);
+  g_mutex_unlock(&server->lock);
+}
+
+// called from the workers of the http server
+static guint _render(GHashTable *query, GBytes **reply, gchar **content_type, gpointer user_data)
+{
+  _server_t *server = (_server_t *)user_data;
+
+  const char *path = query ? g_hash_table_lookup(query, "path") : NULL;
+  const char *id = query ? g_hash_table_lookup(query, "imgid") : NULL;
+  const char *xmp = query ? g_hash_table_lookup(query, "xmp") : NULL;
+  const char *style = query ? g_hash_table_lookup(query, "style") : NULL;
+  const char *width = query ? g_hash_table_lookup(query, "width") : NULL;
+  const char *height = query ? g_hash_table_lookup(query, "height") : NULL;
+  const char *ext = query ? g_hash_table_lookup(query, "format") : NULL;
+  const gboolean high_quality = _query_bool(query, "hq", server->params->high_quality);
+  const gboolean upscale = _query_bool(query, "upscale", server->params->upscale);
+  const gboolean reset = _query_bool(query, "reset", FALSE);
+
+  if(!path == !id)
+    return _error(reply, content_type, SOUP_STATUS_BAD_REQUEST, "either path or imgid is needed\n");
+  if(id && atoi(id) <= 0)
+    return _error(reply, content_type, SOUP_STATUS_BAD_REQUEST, "invalid imgid\n");
+  if(xmp && !path)
+    return _error(reply, content_type, SOUP_STATUS_BAD_REQUEST, "xmp can only be given with path\n");
+  if(reset && !path)
+    return _error(reply, content_type, SOUP_STATUS_BAD_REQUEST, "reset can only be given with path\n");
+  if(path && !g_file_test(path, G_FILE_TEST_IS_REGULAR))
+    return _error(reply, content_type, SOUP_STATUS_NOT_FOUND, "no such image\n");
+  if(xmp && !g_file_test(xmp, G_FILE_TEST_IS_REGULAR))
+    return _error(reply, content_type, SOUP_STATUS_NOT_FOUND, "no such xmp file\n");
+
+  if(!ext || !g_ascii_strcasecmp(ext, "jpg"))
+    ext = "jpeg";
+  else if(!g_ascii_strcasecmp(ext, "tif"))
+    ext = "tiff";
+  dt_imageio_module_format_t *format = dt_imageio_get_format_by_name(ext);
+  if(!format) return _error(reply, content_type, SOUP_STATUS_BAD_REQUEST, "unknown format\n");
+
+  g_mutex_lock(&server->lock);
+  const int32_t imgid = _take_image(server, path, id ? atoi(id) : 0, xmp, reset);
+  g_mutex_unlock(&server->lock);
+  if(imgid < 0) return _error(reply, content_type, SOUP_STATUS_NOT_FOUND, "can't import the image\n");
+  if(imgid == 0) return _error(reply, content_type, SOUP_STATUS_BAD_REQUEST, "can't read the xmp file\n");
+
+  dt_imageio_module_data_t *fdata = format->get_params(format);
+  if(!fdata)
+  {
+    _release_image(server, imgid);
+    return _error(reply, content_type, SOUP_STATUS_INTERNAL_SERVER_ERROR, "can't get the format parameters\n");
+  }
+  fdata->max_width = width ? MAX(atoi(width), 0) : 0;
+  fdata->max_height = height ? MAX(atoi(height), 0) : 0;
+  fdata->style[0] = '\0';
+  fdata->style_append = 1;
+  if(style) g_strlcpy(fdata->style, style, sizeof(fdata->style));
+
+  // the formats only know how to write files
+  gchar *filename = NULL;
+  const int fd = g_file_open_tmp("darktable-render-XXXXXX", &filename, NULL);
+  if(fd < 0)
+  {
+    format->free_params(format, fdata);
+    _release_image(server, imgid);
+    return _error(reply, content_type, SOUP_STATUS_INTERNAL_SERVER_ERROR, "can't create a temporary file\n");
+  }
+  close(fd);
+
+  dt_export_metadata_t metadata;
+  metadata.flags = dt_lib_export_metadata_default_flags();
+  metadata.list = NULL;
+  const int failed = dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, FALSE,
+                                       server->params->icc_type, server->params->icc_filename,
+                                       server->params->icc_intent, NULL, NULL, 1, 1, &metadata);
+  _release_image(server, imgid);
+
+  *content_type = g_strdup(format->mime(fdata));
+  format->free_params(format, fdata);
+
+  gchar *data = NULL;
+  gsize length = 0;
+  guint status = SOUP_STATUS_OK;
+  if(!failed && g_file_get_contents(filename, &data, &length, NULL))
+    *reply = g_bytes_new_take(data, length);
+  else
+  {
+    g_free(*content_type);
+    status = _error(reply, content_type, SOUP_STATUS_INTERNAL_SERVER_ERROR, "export failed\n");
+  }
+
+  g_unlink(filename);
+  g_free(filename);
+
+  dt_print(DT_DEBUG_CONTROL, "[render server] image %d: %u\n", imgid, status);
+  return status;
+}
+
+#ifndef _WIN32
+static gboolean _quit(gpointer user_data)
+{
+  g_main_loop_quit((GMainLoop *)user_data);
+  return G_SOURCE_CONTINUE;
+}
+#endif
+
+int dt_cli_server_run(const char *address, const int threads, const dt_cli_server_params_t *params)
+{
+  _server_t server;
+  server.params = params;
+  g_mutex_init(&server.lock);
+  g_cond_init(&server.released);
+  server.paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  server.applied = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+  server.busy = g_hash_table_new(NULL, NULL);
+
+  // a port number or the path of a unix socket
+  gchar *end = NULL;
+  const long port = strtol(address, &end, 10);
+  const gboolean is_port = end != address && *end == '\0';
+
+  dt_http_server_t *http = dt_http_server_create_service(is_port ? port : 0, is_port ? NULL : address, "render",
+                                                         threads, _render, &server);
+  int res = 1;
+  if(http)
+  {
+    printf("serving renderings on %s\n", http->url);
+    fflush(stdout);
+
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+#ifndef _WIN32
+    g_unix_signal_add(SIGINT, _quit, loop);
+    g_unix_signal_add(SIGTERM, _quit, loop);
+#endif
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+
+    // waits for the renderings in progress
+    dt_http_server_kill(http);
+    if(!is_port) g_unlink(address);
+    res = 0;
+  }
+
+  g_hash_table_destroy(server.busy);
+  g_hash_table_destroy(server.applied);
+  g_hash_table_destroy(server.paths);
+  g_cond_clear(&server.released);
+  g_mutex_clear(&server.lock);
+  return res;
+}
+
+#else // HAVE_HTTP_SERVER
+
+int dt_cli_server_run(const char *address, const int threads, const dt_cli_server_params_t *params)
+{
+  fprintf(stderr, "%s\n", _("error: darktable-cli was built without libsoup, the render server is not available"));
+  return 1;
+}
+
+#endif // HAVE_HTTP_SERVER
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
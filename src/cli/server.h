@@ -0,0 +1,53 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/colorspaces.h"
+
+#include <glib.h>
+
+/*
+  Render service of darktable-cli.
+
+  darktable is initialized once and the renderings are requested over http, on the loopback interface or on a
+  unix socket, so that the caches, the loaded modules and the color profiles are kept between requests:
+
+    GET /render?path=<image>[&xmp=<sidecar>][&reset=1]&format=jpg&width=1024&height=1024[&style=<name>][&hq=1][&upscale=0]
+    GET /render?imgid=<id of an image of the library>&...
+
+  the reply is the encoded image. the requests are handled concurrently by threads workers, the requests on the
+  same image one after the other.
+*/
+
+typedef struct dt_cli_server_params_t
+{
+  gboolean high_quality;
+  gboolean upscale;
+  dt_colorspaces_color_profile_type_t icc_type;
+  const gchar *icc_filename;
+  dt_iop_color_intent_t icc_intent;
+} dt_cli_server_params_t;
+
+/** serve the render requests on address, a port number or the path of a unix socket, until interrupted.
+    params are the defaults of the requests. returns the exit code. */
+int dt_cli_server_run(const char *address, const int threads, const dt_cli_server_params_t *params);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
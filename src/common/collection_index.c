@@ -0,0 +1,1185 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/collection_index.h"
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/datetime.h"
+#include "common/debug.h"
+#include "control/conf.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// distinct values of a column and the rows holding each of them
+typedef struct _dict_t
+{
+  GPtrArray *values;   // value index -> text
+  GPtrArray *rows;     // value index -> GArray of guint32 rows, in increasing order
+  GHashTable *lookup;  // text -> value index + 1
+} _dict_t;
+
+// the timestamps listed by the date properties
+typedef enum _index_time_t
+{
+  _TIME_TAKEN = 0,
+  _TIME_IMPORT,
+  _TIME_CHANGE,
+  _TIME_EXPORT,
+  _TIME_PRINT,
+  _TIME_LAST
+} _index_time_t;
+
+// sql NULLs in the columns
+typedef enum _index_null_t
+{
+  _NULL_CAMERA = 0,
+  _NULL_LENS,
+  _NULL_ISO,
+  _NULL_APERTURE,
+  _NULL_FOCAL_LENGTH,
+  _NULL_LAST
+} _index_null_t;
+
+typedef struct _index_t
+{
+  int rows;             // rows in use, the ones of removed images stay as holes
+  int capacity;
+  int words;
+  int removed;
+  int32_t *ids;
+  GHashTable *row_of;   // image id -> row + 1
+  uint64_t *alive;      // rows of existing images, capacity bits
+
+  _dict_t film;         // by folder
+  GArray *film_ids;     // film value index -> film roll id
+  _dict_t camera;       // "maker\x1fmodel"
+  GPtrArray *makermodel;// camera value index -> name as shown
+  _dict_t lens;
+  _dict_t tag;
+  GHashTable *dt_tags;  // names of the darktable internal tags
+
+  // value index of each row in the dictionaries, -1 for none
+  int32_t *film_v, *camera_v, *lens_v;
+
+  double *iso, *aperture, *focal_length;
+  uint8_t *flags;       // rating (0x7) and rejected (0x8)
+  uint8_t *colors;      // one bit per color label
+  uint8_t *nulls;       // one bit per _index_null_t
+  GTimeSpan *times[_TIME_LAST];
+
+  // sql NULLs don't behave like values in the where clauses, rules on these columns are left to sqlite
+  int null_count[_NULL_LAST];
+} _index_t;
+
+static GMutex _index_lock;
+static _index_t *_index = NULL;
+
+// the index is refreshed from the images recorded as changed by these triggers
+static const char *_triggers[] = {
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_image_insert AFTER INSERT ON main.images"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (new.id);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_image_delete AFTER DELETE ON main.images"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (old.id);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_image_update"
+  " AFTER UPDATE OF film_id, maker, model, lens, iso, aperture, focal_length, flags, datetime_taken,"
+  "   import_timestamp, change_timestamp, export_timestamp, print_timestamp ON main.images"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (new.id);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_tag_attach AFTER INSERT ON main.tagged_images"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (new.imgid);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_tag_detach AFTER DELETE ON main.tagged_images"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (old.imgid);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_tag_move AFTER UPDATE ON main.tagged_images"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (old.imgid);"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (new.imgid);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_tag_rename AFTER UPDATE OF name ON data.tags"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid)"
+  "     SELECT imgid FROM tagged_images WHERE tagid = new.id;"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_color_add AFTER INSERT ON main.color_labels"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (new.imgid);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_color_remove AFTER DELETE ON main.color_labels"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (old.imgid);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_color_change AFTER UPDATE ON main.color_labels"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (old.imgid);"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid) VALUES (new.imgid);"
+  " END",
+  "CREATE TEMPORARY TRIGGER IF NOT EXISTS collection_index_folder_rename AFTER UPDATE OF folder ON main.film_rolls"
+  " BEGIN"
+  "   INSERT OR REPLACE INTO collection_index_dirty (imgid)"
+  "     SELECT id FROM images WHERE film_id = new.id;"
+  " END",
+};
+
+static void _triggers_create()
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  for(size_t k = 0; k < G_N_ELEMENTS(_triggers); k++) sqlite3_exec(db, _triggers[k], NULL, NULL, NULL);
+}
+
+static void _triggers_drop()
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  const char *names[] = { "image_insert", "image_delete", "image_update", "tag_attach", "tag_detach",
+                          "tag_move", "tag_rename", "color_add", "color_remove", "color_change",
+                          "folder_rename" };
+  for(size_t k = 0; k < G_N_ELEMENTS(names); k++)
+  {
+    gchar *query = g_strdup_printf("DROP TRIGGER IF EXISTS temp.collection_index_%s", names[k]);
+    sqlite3_exec(db, query, NULL, NULL, NULL);
+    g_free(query);
+  }
+  sqlite3_exec(db, "DELETE FROM memory.collection_index_dirty", NULL, NULL, NULL);
+}
+
+static void _dict_init(_dict_t *d)
+{
+  d->values = g_ptr_array_new_with_free_func(g_free);
+  d->rows = g_ptr_array_new_with_free_func((GDestroyNotify)g_array_unref);
+  d->lookup = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+static void _dict_cleanup(_dict_t *d)
+{
+  if(d->lookup) g_hash_table_destroy(d->lookup);
+  if(d->rows) g_ptr_array_free(d->rows, TRUE);
+  if(d->values) g_ptr_array_free(d->values, TRUE);
+}
+
+// position of the first row not lower than row
+static guint _rows_search(const GArray *rows, const guint32 row)
+{
+  guint lo = 0, hi = rows->len;
+  while(lo < hi)
+  {
+    const guint mid = (lo + hi) / 2;
+    if(g_array_index(rows, guint32, mid) < row)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// add the row to the value text, returns the value index
+static int _dict_add(_dict_t *d, const char *text, const uint32_t row)
+{
+  int v = GPOINTER_TO_INT(g_hash_table_lookup(d->lookup, text)) - 1;
+  if(v < 0)
+  {
+    gchar *key = g_strdup(text);
+    g_ptr_array_add(d->values, key);
+    g_ptr_array_add(d->rows, g_array_new(FALSE, FALSE, sizeof(guint32)));
+    g_hash_table_insert(d->lookup, key, GINT_TO_POINTER(d->values->len));
+    v = d->values->len - 1;
+  }
+
+  GArray *rows = g_ptr_array_index(d->rows, v);
+  // rows are mostly added in increasing order, on build and for new images
+  if(!rows->len || g_array_index(rows, guint32, rows->len - 1) < row)
+    g_array_append_val(rows, row);
+  else
+  {
+    const guint pos = _rows_search(rows, row);
+    if(pos == rows->len || g_array_index(rows, guint32, pos) != row) g_array_insert_val(rows, pos, row);
+  }
+  return v;
+}
+
+static void _dict_remove(_dict_t *d, const int v, const uint32_t row)
+{
+  if(v < 0) return;
+  GArray *rows = g_ptr_array_index(d->rows, v);
+  const guint pos = _rows_search(rows, row);
+  if(pos < rows->len && g_array_index(rows, guint32, pos) == row) g_array_remove_index(rows, pos);
+}
+
+static void _index_free(_index_t *ix)
+{
+  if(!ix) return;
+  _dict_cleanup(&ix->film);
+  _dict_cleanup(&ix->camera);
+  _dict_cleanup(&ix->lens);
+  _dict_cleanup(&ix->tag);
+  if(ix->film_ids) g_array_unref(ix->film_ids);
+  if(ix->makermodel) g_ptr_array_free(ix->makermodel, TRUE);
+  if(ix->dt_tags) g_hash_table_destroy(ix->dt_tags);
+  if(ix->row_of) g_hash_table_destroy(ix->row_of);
+  free(ix->ids);
+  free(ix->alive);
+  free(ix->film_v);
+  free(ix->camera_v);
+  free(ix->lens_v);
+  free(ix->iso);
+  free(ix->aperture);
+  free(ix->focal_length);
+  free(ix->flags);
+  free(ix->colors);
+  free(ix->nulls);
+  for(int t = 0; t < _TIME_LAST; t++) free(ix->times[t]);
+  free(ix);
+}
+
+static int _find_row(const _index_t *ix, const int32_t id)
+{
+  return GPOINTER_TO_INT(g_hash_table_lookup(ix->row_of, GINT_TO_POINTER(id))) - 1;
+}
+
+#define _GROW(array, n) array = realloc(array, sizeof(*(array)) * (n))
+
+// a new row for image id
+static int _row_append(_index_t *ix, const int32_t id)
+{
+  if(ix->rows == ix->capacity)
+  {
+    const int capacity = MAX(1024, 2 * ix->capacity);
+    _GROW(ix->ids, capacity);
+    _GROW(ix->film_v, capacity);
+    _GROW(ix->camera_v, capacity);
+    _GROW(ix->lens_v, capacity);
+    _GROW(ix->iso, capacity);
+    _GROW(ix->aperture, capacity);
+    _GROW(ix->focal_length, capacity);
+    _GROW(ix->flags, capacity);
+    _GROW(ix->colors, capacity);
+    _GROW(ix->nulls, capacity);
+    for(int t = 0; t < _TIME_LAST; t++) _GROW(ix->times[t], capacity);
+    _GROW(ix->alive, (capacity + 63) / 64);
+    memset(ix->alive + (ix->capacity + 63) / 64, 0, sizeof(uint64_t) * ((capacity - ix->capacity) / 64));
+    ix->capacity = capacity;
+  }
+
+  const int row = ix->rows++;
+  ix->words = (ix->rows + 63) / 64;
+  ix->ids[row] = id;
+  ix->film_v[row] = ix->camera_v[row] = ix->lens_v[row] = -1;
+  ix->nulls[row] = 0;
+  ix->colors[row] = 0;
+  ix->alive[row >> 6] |= (uint64_t)1 << (row & 63);
+  g_hash_table_insert(ix->row_of, GINT_TO_POINTER(id), GINT_TO_POINTER(row + 1));
+  return row;
+}
+
+#undef _GROW
+
+// remove the row from the dictionaries and the counters, before setting it again or dropping it
+static void _row_clear(_index_t *ix, const int row)
+{
+  _dict_remove(&ix->film, ix->film_v[row], row);
+  _dict_remove(&ix->camera, ix->camera_v[row], row);
+  _dict_remove(&ix->lens, ix->lens_v[row], row);
+  for(guint v = 0; v < ix->tag.values->len; v++) _dict_remove(&ix->tag, v, row);
+  ix->film_v[row] = ix->camera_v[row] = ix->lens_v[row] = -1;
+  for(int n = 0; n < _NULL_LAST; n++) ix->null_count[n] -= (ix->nulls[row] >> n) & 1;
+  ix->nulls[row] = 0;
+  ix->colors[row] = 0;
+}
+
+static void _row_drop(_index_t *ix, const int row)
+{
+  _row_clear(ix, row);
+  ix->alive[row >> 6] &= ~((uint64_t)1 << (row & 63));
+  g_hash_table_remove(ix->row_of, GINT_TO_POINTER(ix->ids[row]));
+  ix->removed++;
+}
+
+static void _row_set_null(_index_t *ix, const int row, const _index_null_t n)
+{
+  ix->nulls[row] |= 1 << n;
+  ix->null_count[n]++;
+}
+
+// the columns of the images query: id, exists, folder, film id, maker, model, lens, iso, aperture,
+// focal length, flags and the timestamps
+#define _IMAGES_COLUMNS                                                                                        \
+  " i.id IS NOT NULL, f.folder, i.film_id, i.maker, i.model, i.lens, i.iso, i.aperture, i.focal_length,"     \
+  " i.flags, i.datetime_taken, i.import_timestamp, i.change_timestamp, i.export_timestamp, i.print_timestamp"
+
+static void _row_set(_index_t *ix, const int row, sqlite3_stmt *stmt)
+{
+  const char *folder = (const char *)sqlite3_column_text(stmt, 2);
+  if(folder)
+  {
+    const guint before = ix->film.values->len;
+    ix->film_v[row] = _dict_add(&ix->film, folder, row);
+    if(ix->film.values->len != before)
+    {
+      const int film_id = sqlite3_column_int(stmt, 3);
+      g_array_append_val(ix->film_ids, film_id);
+    }
+  }
+
+  const char *maker = (const char *)sqlite3_column_text(stmt, 4);
+  const char *model = (const char *)sqlite3_column_text(stmt, 5);
+  if(maker && model)
+  {
+    gchar *key = g_strdup_printf("%s\x1f%s", maker, model);
+    const guint before = ix->camera.values->len;
+    ix->camera_v[row] = _dict_add(&ix->camera, key, row);
+    if(ix->camera.values->len != before)
+      g_ptr_array_add(ix->makermodel, dt_collection_get_makermodel(maker, model));
+    g_free(key);
+  }
+  else
+    _row_set_null(ix, row, _NULL_CAMERA);
+
+  const char *lens = (const char *)sqlite3_column_text(stmt, 6);
+  if(lens)
+    ix->lens_v[row] = _dict_add(&ix->lens, lens, row);
+  else
+    _row_set_null(ix, row, _NULL_LENS);
+
+  if(sqlite3_column_type(stmt, 7) == SQLITE_NULL) _row_set_null(ix, row, _NULL_ISO);
+  if(sqlite3_column_type(stmt, 8) == SQLITE_NULL) _row_set_null(ix, row, _NULL_APERTURE);
+  if(sqlite3_column_type(stmt, 9) == SQLITE_NULL) _row_set_null(ix, row, _NULL_FOCAL_LENGTH);
+  ix->iso[row] = sqlite3_column_double(stmt, 7);
+  ix->aperture[row] = sqlite3_column_double(stmt, 8);
+  ix->focal_length[row] = sqlite3_column_double(stmt, 9);
+  ix->flags[row] = sqlite3_column_int(stmt, 10) & 0xf;
+  // NULL reads as 0, which the date lists skip as well
+  for(int t = 0; t < _TIME_LAST; t++) ix->times[t][row] = sqlite3_column_int64(stmt, 11 + t);
+}
+
+// read the images, color labels and tags, all of them or the ones recorded as changed up to rowid max of
+// memory.collection_index_dirty
+static void _rows_load(_index_t *ix, const gboolean dirty, const int max)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  if(dirty)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "SELECT d.imgid," _IMAGES_COLUMNS
+                                " FROM memory.collection_index_dirty AS d"
+                                " LEFT JOIN main.images AS i ON i.id = d.imgid"
+                                " LEFT JOIN main.film_rolls AS f ON f.id = i.film_id"
+                                " WHERE d.rowid <= ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, max);
+  }
+  else
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "SELECT i.id," _IMAGES_COLUMNS
+                                " FROM main.images AS i"
+                                " LEFT JOIN main.film_rolls AS f ON f.id = i.film_id"
+                                " ORDER BY i.id",
+                                -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int32_t id = sqlite3_column_int(stmt, 0);
+    int row = _find_row(ix, id);
+    if(!sqlite3_column_int(stmt, 1))
+    {
+      // the image has been removed
+      if(row >= 0) _row_drop(ix, row);
+      continue;
+    }
+    if(row >= 0)
+      _row_clear(ix, row);
+    else
+      row = _row_append(ix, id);
+    _row_set(ix, row, stmt);
+  }
+  sqlite3_finalize(stmt);
+
+  // color labels
+  if(dirty)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "SELECT imgid, color FROM main.color_labels"
+                                " WHERE imgid IN (SELECT imgid FROM memory.collection_index_dirty"
+                                "                 WHERE rowid <= ?1)",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, max);
+  }
+  else
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT imgid, color FROM main.color_labels", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int r = _find_row(ix, sqlite3_column_int(stmt, 0));
+    const int color = sqlite3_column_int(stmt, 1);
+    if(r >= 0 && color >= 0 && color < 8) ix->colors[r] |= 1 << color;
+  }
+  sqlite3_finalize(stmt);
+
+  // tags, a dictionary by name
+  if(dirty)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "SELECT ti.imgid, t.name"
+                                " FROM main.tagged_images AS ti"
+                                " JOIN data.tags AS t ON t.id = ti.tagid"
+                                " WHERE ti.imgid IN (SELECT imgid FROM memory.collection_index_dirty"
+                                "                    WHERE rowid <= ?1)",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, max);
+  }
+  else
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "SELECT ti.imgid, t.name"
+                                " FROM main.tagged_images AS ti"
+                                " JOIN data.tags AS t ON t.id = ti.tagid"
+                                " ORDER BY ti.imgid",
+                                -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int r = _find_row(ix, sqlite3_column_int(stmt, 0));
+    const char *name = (const char *)sqlite3_column_text(stmt, 1);
+    if(r >= 0 && name) _dict_add(&ix->tag, name, r);
+  }
+  sqlite3_finalize(stmt);
+}
+
+// number of images recorded as changed and the highest rowid of the records
+static int _dirty_count(int *max)
+{
+  sqlite3_stmt *stmt;
+  int count = 0;
+  *max = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT COUNT(*), COALESCE(MAX(rowid), 0) FROM memory.collection_index_dirty", -1,
+                              &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    count = sqlite3_column_int(stmt, 0);
+    *max = sqlite3_column_int(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+  return count;
+}
+
+static void _dirty_clear(const int max)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "DELETE FROM memory.collection_index_dirty WHERE rowid <= ?1", -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, max);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+static _index_t *_index_build()
+{
+  const double start = dt_get_wtime();
+  sqlite3 *db = dt_database_get(darktable.db);
+  sqlite3_stmt *stmt;
+
+  // the changes made while we read the images are applied on next use
+  _triggers_create();
+  int max = 0;
+  _dirty_count(&max);
+
+  _index_t *ix = calloc(1, sizeof(_index_t));
+  _dict_init(&ix->film);
+  _dict_init(&ix->camera);
+  _dict_init(&ix->lens);
+  _dict_init(&ix->tag);
+  ix->film_ids = g_array_new(FALSE, FALSE, sizeof(int));
+  ix->makermodel = g_ptr_array_new_with_free_func(g_free);
+  ix->dt_tags = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  ix->row_of = g_hash_table_new(NULL, NULL);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT name FROM data.tags WHERE id IN (SELECT tagid FROM memory.darktable_tags)",
+                              -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const char *name = (const char *)sqlite3_column_text(stmt, 0);
+    if(name) g_hash_table_add(ix->dt_tags, g_strdup(name));
+  }
+  sqlite3_finalize(stmt);
+
+  _rows_load(ix, FALSE, 0);
+  _dirty_clear(max);
+
+  dt_print(DT_DEBUG_PERF, "[collection_index] %d images indexed in %.3f secs\n", ix->rows,
+           dt_get_wtime() - start);
+  return ix;
+}
+
+// apply the changes recorded since the last use. returns FALSE if the index has to be built again.
+static gboolean _index_refresh(_index_t *ix)
+{
+  int max = 0;
+  const int count = _dirty_count(&max);
+  if(!count) return TRUE;
+
+  // many changes (a new film roll, a large selection retagged...) or many holes, a build is cheaper
+  if(4 * (count + ix->removed) > ix->rows) return FALSE;
+
+  const double start = dt_get_wtime();
+  _rows_load(ix, TRUE, max);
+  _dirty_clear(max);
+  dt_print(DT_DEBUG_PERF, "[collection_index] %d images updated in %.3f secs\n", count,
+           dt_get_wtime() - start);
+  return TRUE;
+}
+
+// bitmaps over the rows
+
+static uint64_t *_bitmap_new(const _index_t *ix, const gboolean set)
+{
+  uint64_t *b = calloc(MAX(ix->words, 1), sizeof(uint64_t));
+  // all the rows of existing images
+  if(set && ix->words) memcpy(b, ix->alive, sizeof(uint64_t) * ix->words);
+  return b;
+}
+
+static inline void _bitmap_set(uint64_t *b, const int row)
+{
+  b[row >> 6] |= (uint64_t)1 << (row & 63);
+}
+
+static inline gboolean _bitmap_get(const uint64_t *b, const int row)
+{
+  return (b[row >> 6] >> (row & 63)) & 1;
+}
+
+static void _bitmap_set_rows(uint64_t *b, const GArray *rows)
+{
+  for(guint k = 0; k < rows->len; k++) _bitmap_set(b, g_array_index(rows, guint32, k));
+}
+
+// sqlite LIKE: % and _ wildcards, case insensitive for ascii only
+static gboolean _like(const char *pattern, const char *text)
+{
+  while(*pattern)
+  {
+    if(*pattern == '%')
+    {
+      while(*pattern == '%') pattern++;
+      if(!*pattern) return TRUE;
+      for(; *text; text = g_utf8_next_char(text))
+        if(_like(pattern, text)) return TRUE;
+      return FALSE;
+    }
+    if(!*text) return FALSE;
+    if(*pattern == '_')
+    {
+      pattern = g_utf8_next_char(pattern);
+      text = g_utf8_next_char(text);
+      continue;
+    }
+    if(g_ascii_tolower(*pattern) != g_ascii_tolower(*text)) return FALSE;
+    pattern++;
+    text++;
+  }
+  return *text == '\0';
+}
+
+static gboolean _compare(const double a, const char *op, const double b)
+{
+  if(!strcmp(op, "<")) return a < b;
+  if(!strcmp(op, "<=")) return a <= b;
+  if(!strcmp(op, ">")) return a > b;
+  if(!strcmp(op, ">=")) return a >= b;
+  if(!strcmp(op, "<>")) return a != b;
+  return a == b;
+}
+
+static double _round1(const double v)
+{
+  return round(v * 10.0) / 10.0;
+}
+
+// the tag rules of get_query_string()
+static gboolean _tag_match(const char *name, const char *text, const gboolean insensitive)
+{
+  const size_t len = strlen(text);
+  const gboolean hierarchy = len > 0 && text[len - 1] == '*';
+  if(insensitive)
+  {
+    if(!hierarchy) return _like(text, name);
+    gchar *base = g_strndup(text, len - 1);
+    gchar *children = g_strdup_printf("%s|%%", base);
+    const gboolean match = _like(base, name) || _like(children, name);
+    g_free(children);
+    g_free(base);
+    return match;
+  }
+  if(hierarchy)
+    return (strlen(name) == len - 1 && !strncmp(name, text, len - 1))
+           || (strlen(name) >= len && !strncmp(name, text, len - 1) && name[len - 1] == '|');
+  if(len > 0 && text[len - 1] == '%')
+    return !strncmp(name, text, len - 1);
+  return !strcmp(name, text);
+}
+
+// the rows matching one rule, as get_query_string() would select them. NULL if not supported.
+static uint64_t *_rule_bitmap(const _index_t *ix, const dt_collection_properties_t property, const gchar *text)
+{
+  uint64_t *b = NULL;
+
+  switch(property)
+  {
+    case DT_COLLECTION_PROP_FILMROLL:
+    {
+      b = _bitmap_new(ix, FALSE);
+      for(guint v = 0; v < ix->film.values->len; v++)
+        if(_like(text, g_ptr_array_index(ix->film.values, v)))
+          _bitmap_set_rows(b, g_ptr_array_index(ix->film.rows, v));
+      break;
+    }
+
+    case DT_COLLECTION_PROP_CAMERA:
+    {
+      if(ix->null_count[_NULL_CAMERA]) break;
+      gchar *needle = g_utf8_strdown(text, -1);
+      const size_t len = strlen(needle);
+      const gboolean wildcard = len > 0 && needle[len - 1] == '%';
+      if(wildcard) needle[len - 1] = '\0';
+      b = _bitmap_new(ix, FALSE);
+      for(guint v = 0; v < ix->camera.values->len; v++)
+      {
+        gchar *haystack = g_utf8_strdown(g_ptr_array_index(ix->makermodel, v), -1);
+        if((wildcard && g_strrstr(haystack, needle)) || (!wildcard && !g_strcmp0(haystack, needle)))
+          _bitmap_set_rows(b, g_ptr_array_index(ix->camera.rows, v));
+        g_free(haystack);
+      }
+      g_free(needle);
+      break;
+    }
+
+    case DT_COLLECTION_PROP_LENS:
+    {
+      if(ix->null_count[_NULL_LENS]) break;
+      gchar *pattern = g_strdup_printf("%%%s%%", text);
+      b = _bitmap_new(ix, FALSE);
+      for(guint v = 0; v < ix->lens.values->len; v++)
+        if(_like(pattern, g_ptr_array_index(ix->lens.values, v)))
+          _bitmap_set_rows(b, g_ptr_array_index(ix->lens.rows, v));
+      g_free(pattern);
+      break;
+    }
+
+    case DT_COLLECTION_PROP_TAG:
+    {
+      const gboolean insensitive = dt_conf_is_equal("plugins/lighttable/tagging/case_sensitivity", "insensitive");
+      const gboolean not_tagged = !strcmp(text, _("not tagged"));
+      b = _bitmap_new(ix, FALSE);
+      for(guint v = 0; v < ix->tag.values->len; v++)
+      {
+        const char *name = g_ptr_array_index(ix->tag.values, v);
+        if(not_tagged ? !g_hash_table_contains(ix->dt_tags, name) : _tag_match(name, text, insensitive))
+          _bitmap_set_rows(b, g_ptr_array_index(ix->tag.rows, v));
+      }
+      if(not_tagged)
+      {
+        uint64_t *all = _bitmap_new(ix, TRUE);
+        for(int w = 0; w < ix->words; w++) b[w] = all[w] & ~b[w];
+        free(all);
+      }
+      break;
+    }
+
+    case DT_COLLECTION_PROP_COLORLABEL:
+    {
+      uint8_t mask = 0xff;
+      if(*text && strcmp(text, "%"))
+      {
+        int color = 0;
+        if(!strcmp(text, _("yellow")))
+          color = 1;
+        else if(!strcmp(text, _("green")))
+          color = 2;
+        else if(!strcmp(text, _("blue")))
+          color = 3;
+        else if(!strcmp(text, _("purple")))
+          color = 4;
+        mask = 1 << color;
+      }
+      b = _bitmap_new(ix, FALSE);
+      for(int r = 0; r < ix->rows; r++)
+        if(ix->colors[r] & mask) _bitmap_set(b, r);
+      break;
+    }
+
+    case DT_COLLECTION_PROP_ISO:
+    case DT_COLLECTION_PROP_APERTURE:
+    case DT_COLLECTION_PROP_FOCAL_LENGTH:
+    {
+      const double *column = property == DT_COLLECTION_PROP_ISO ? ix->iso
+                             : property == DT_COLLECTION_PROP_APERTURE ? ix->aperture
+                             : ix->focal_length;
+      const gboolean has_null = ix->null_count[property == DT_COLLECTION_PROP_ISO ? _NULL_ISO
+                                               : property == DT_COLLECTION_PROP_APERTURE ? _NULL_APERTURE
+                                               : _NULL_FOCAL_LENGTH] > 0;
+      gchar *operator, *number1, *number2;
+      dt_collection_split_operator_number(text, &number1, &number2, &operator);
+
+      // the LIKE fallback of the text search is left to sqlite
+      if(number1 && !has_null)
+      {
+        const double n1 = g_ascii_strtod(number1, NULL);
+        const double n2 = number2 ? g_ascii_strtod(number2, NULL) : 0.0;
+        const gboolean range = operator && !strcmp(operator, "[]");
+        b = _bitmap_new(ix, FALSE);
+        for(int r = 0; r < ix->rows; r++)
+        {
+          const double v = property == DT_COLLECTION_PROP_APERTURE ? _round1(column[r]) : column[r];
+          gboolean match;
+          if(range)
+            match = v >= n1 && v <= n2;
+          else if(operator)
+            match = _compare(v, operator, n1);
+          else if(property == DT_COLLECTION_PROP_FOCAL_LENGTH)
+            match = (int64_t)v == (int64_t)n1;
+          else
+            match = v == n1;
+          if(match) _bitmap_set(b, r);
+        }
+      }
+
+      g_free(operator);
+      g_free(number1);
+      g_free(number2);
+      break;
+    }
+
+    case DT_COLLECTION_PROP_RATING:
+    {
+      gchar *operator, *number1, *number2;
+      dt_collection_split_operator_number(text, &number1, &number2, &operator);
+      const double n1 = number1 ? g_ascii_strtod(number1, NULL) : 0.0;
+      const double n2 = number2 ? g_ascii_strtod(number2, NULL) : 0.0;
+      const int i1 = number1 ? atoi(number1) : 0;
+
+      b = _bitmap_new(ix, FALSE);
+      for(int r = 0; r < ix->rows; r++)
+      {
+        const int stars = ix->flags[r] & 0x7;
+        const gboolean rejected = (ix->flags[r] & 0x8) != 0;
+        gboolean match = TRUE; // no filter, as the "(1=1)" placeholder
+        if(operator && !strcmp(operator, "[]"))
+        {
+          if(number1 && number2)
+            match = (i1 == -1 || !rejected) && stars >= n1 && stars <= n2;
+        }
+        else if(operator && number1)
+        {
+          if(!strcmp(operator, "<=") || !strcmp(operator, "<"))
+            match = rejected || _compare(stars, operator, n1);
+          else if(!strcmp(operator, ">=") || !strcmp(operator, ">"))
+            match = i1 >= 0 ? !rejected && _compare(stars, operator, n1) : TRUE;
+          else
+            match = i1 == -1 ? !rejected : rejected || _compare(stars, operator, n1);
+        }
+        else if(number1)
+          match = i1 == -1 ? rejected : !rejected && stars == n1;
+        if(match) _bitmap_set(b, r);
+      }
+
+      g_free(operator);
+      g_free(number1);
+      g_free(number2);
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  return b;
+}
+
+// the rows matching the collect rules but exclude. the rules are combined with the precedence of the sql
+// where clause "(1=1 AND a OR b AND NOT c)", that is an OR of groups of ANDed rules.
+static uint64_t *_rules_bitmap(const _index_t *ix, const int exclude)
+{
+  char confname[200];
+  const int _n_r = dt_conf_get_int("plugins/lighttable/collect/num_rules");
+  const int num_rules = CLAMP(_n_r, 1, 10);
+
+  if(exclude >= 0)
+  {
+    snprintf(confname, sizeof(confname), "plugins/lighttable/collect/mode%1d", exclude);
+    if(dt_conf_get_int(confname) == 1) // don't limit the collection for OR
+      return _bitmap_new(ix, TRUE);
+  }
+
+  uint64_t *result = _bitmap_new(ix, FALSE);
+  uint64_t *group = _bitmap_new(ix, TRUE);
+
+  for(int i = 0; i < num_rules; i++)
+  {
+    if(i == exclude) continue;
+
+    snprintf(confname, sizeof(confname), "plugins/lighttable/collect/item%1d", i);
+    const int property = dt_conf_get_int(confname);
+    snprintf(confname, sizeof(confname), "plugins/lighttable/collect/string%1d", i);
+    const char *text = dt_conf_get_string_const(confname);
+    snprintf(confname, sizeof(confname), "plugins/lighttable/collect/mode%1d", i);
+    const int mode = dt_conf_get_int(confname);
+
+    uint64_t *rule = NULL;
+    if(!text || text[0] == '\0')
+    {
+      if(mode != 1) continue;
+      rule = _bitmap_new(ix, TRUE); // for OR show all
+    }
+    else if(!(rule = _rule_bitmap(ix, property, text)))
+    {
+      free(group);
+      free(result);
+      return NULL;
+    }
+
+    if(mode == 1)
+    {
+      for(int w = 0; w < ix->words; w++) result[w] |= group[w];
+      free(group);
+      group = rule;
+      continue;
+    }
+    for(int w = 0; w < ix->words; w++) group[w] &= mode == 2 ? ~rule[w] : rule[w];
+    free(rule);
+  }
+
+  // the rows of the removed images are set by the NOT and the numerical rules
+  for(int w = 0; w < ix->words; w++) result[w] = (result[w] | group[w]) & ix->alive[w];
+  free(group);
+  return result;
+}
+
+static gint _sort_values_by_text(gconstpointer a, gconstpointer b)
+{
+  return strcmp(((const dt_collection_index_value_t *)a)->text, ((const dt_collection_index_value_t *)b)->text);
+}
+
+static GList *_append_value(GList *values, gchar *text, const int id, const int count)
+{
+  dt_collection_index_value_t *value = g_malloc(sizeof(dt_collection_index_value_t));
+  value->text = text;
+  value->id = id;
+  value->count = count;
+  return g_list_prepend(values, value);
+}
+
+// per value counts of a dictionary column, in the order of the values. labels, if any, replace the values
+// in the list, ids, if any, give the ids of the values.
+static GList *_dict_counts(const _dict_t *d, const GPtrArray *labels, const GArray *ids, const uint64_t *match)
+{
+  GList *values = NULL;
+  for(guint v = 0; v < d->values->len; v++)
+  {
+    const GArray *rows = g_ptr_array_index(d->rows, v);
+    int count = 0;
+    for(guint k = 0; k < rows->len; k++) count += _bitmap_get(match, g_array_index(rows, guint32, k));
+    if(count) values = _append_value(values, g_strdup(g_ptr_array_index(d->values, v)), v, count);
+  }
+  values = g_list_sort(values, _sort_values_by_text);
+  for(GList *l = values; l; l = g_list_next(l))
+  {
+    dt_collection_index_value_t *value = l->data;
+    if(labels)
+    {
+      g_free(value->text);
+      value->text = g_strdup(g_ptr_array_index(labels, value->id));
+    }
+    value->id = ids ? g_array_index(ids, int, value->id) : 1;
+  }
+  return values;
+}
+
+// per tag counts as the tag query of the collect module: by name or by lower case name, and the number of
+// images of the library without any user tag
+static GList *_tag_counts(const _index_t *ix, const uint64_t *match)
+{
+  const gboolean insensitive = dt_conf_is_equal("plugins/lighttable/tagging/case_sensitivity", "insensitive");
+  GHashTable *counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  uint64_t *tagged = _bitmap_new(ix, FALSE);
+
+  for(guint v = 0; v < ix->tag.values->len; v++)
+  {
+    const char *name = g_ptr_array_index(ix->tag.values, v);
+    const GArray *rows = g_ptr_array_index(ix->tag.rows, v);
+    if(!g_hash_table_contains(ix->dt_tags, name)) _bitmap_set_rows(tagged, rows);
+
+    int count = 0;
+    for(guint k = 0; k < rows->len; k++) count += _bitmap_get(match, g_array_index(rows, guint32, k));
+    if(!count) continue;
+
+    gchar *key = insensitive ? g_ascii_strdown(name, -1) : g_strdup(name);
+    count += GPOINTER_TO_INT(g_hash_table_lookup(counts, key));
+    g_hash_table_replace(counts, key, GINT_TO_POINTER(count));
+  }
+
+  GList *values = NULL;
+  GHashTableIter it;
+  gpointer key, count;
+  g_hash_table_iter_init(&it, counts);
+  while(g_hash_table_iter_next(&it, &key, &count))
+    values = _append_value(values, g_strdup(key), 1, GPOINTER_TO_INT(count));
+  g_hash_table_destroy(counts);
+
+  int not_tagged = 0;
+  for(int r = 0; r < ix->rows; r++) not_tagged += _bitmap_get(ix->alive, r) && !_bitmap_get(tagged, r);
+  free(tagged);
+  return _append_value(values, g_strdup(_("not tagged")), 0, not_tagged);
+}
+
+static gint _sort_times(gconstpointer a, gconstpointer b)
+{
+  const GTimeSpan ta = *(const GTimeSpan *)a, tb = *(const GTimeSpan *)b;
+  return (ta > tb) - (ta < tb);
+}
+
+// per date counts of a timestamp column, without the unset dates
+static GList *_time_counts(const _index_t *ix, const GTimeSpan *column, const uint64_t *match)
+{
+  GArray *times = g_array_new(FALSE, FALSE, sizeof(GTimeSpan));
+  for(int r = 0; r < ix->rows; r++)
+    if(_bitmap_get(match, r) && column[r] != 0) g_array_append_val(times, column[r]);
+  g_array_sort(times, _sort_times);
+
+  GList *values = NULL;
+  for(guint k = 0; k < times->len;)
+  {
+    const GTimeSpan t = g_array_index(times, GTimeSpan, k);
+    guint next = k + 1;
+    while(next < times->len && g_array_index(times, GTimeSpan, next) == t) next++;
+
+    char sdt[DT_DATETIME_EXIF_LENGTH] = { 0 };
+    dt_datetime_gtimespan_to_exif(sdt, sizeof(sdt), t);
+    values = _append_value(values, g_strdup(sdt), 1, next - k);
+    k = next;
+  }
+  g_array_free(times, TRUE);
+  return values;
+}
+
+static gint _sort_keys(gconstpointer a, gconstpointer b)
+{
+  const int ka = GPOINTER_TO_INT(a), kb = GPOINTER_TO_INT(b);
+  return (ka > kb) - (ka < kb);
+}
+
+gboolean dt_collection_index_enabled()
+{
+  return dt_conf_get_bool("plugins/collect/memory_index");
+}
+
+void dt_collection_index_invalidate()
+{
+  g_mutex_lock(&_index_lock);
+  if(_index) _triggers_drop();
+  _index_free(_index);
+  _index = NULL;
+  g_mutex_unlock(&_index_lock);
+}
+
+gboolean dt_collection_index_get_counts(const dt_collection_properties_t property, const int exclude,
+                                        GList **values)
+{
+  *values = NULL;
+  if(!dt_collection_index_enabled())
+  {
+    // the index may have been turned off in the preferences, don't keep the memory
+    dt_collection_index_invalidate();
+    return FALSE;
+  }
+
+  switch(property)
+  {
+    case DT_COLLECTION_PROP_CAMERA:
+    case DT_COLLECTION_PROP_LENS:
+    case DT_COLLECTION_PROP_ISO:
+    case DT_COLLECTION_PROP_APERTURE:
+    case DT_COLLECTION_PROP_FOCAL_LENGTH:
+    case DT_COLLECTION_PROP_RATING:
+    case DT_COLLECTION_PROP_COLORLABEL:
+    case DT_COLLECTION_PROP_FOLDERS:
+    case DT_COLLECTION_PROP_TAG:
+    case DT_COLLECTION_PROP_DAY:
+    case DT_COLLECTION_PROP_TIME:
+    case DT_COLLECTION_PROP_IMPORT_TIMESTAMP:
+    case DT_COLLECTION_PROP_CHANGE_TIMESTAMP:
+    case DT_COLLECTION_PROP_EXPORT_TIMESTAMP:
+    case DT_COLLECTION_PROP_PRINT_TIMESTAMP:
+      break;
+    default:
+      return FALSE;
+  }
+
+  g_mutex_lock(&_index_lock);
+  if(_index && !_index_refresh(_index))
+  {
+    _index_free(_index);
+    _index = NULL;
+  }
+  if(!_index) _index = _index_build();
+  const _index_t *ix = _index;
+
+  // NULL makers or models make a camera of their own in the sql list
+  uint64_t *match = property == DT_COLLECTION_PROP_CAMERA && ix->null_count[_NULL_CAMERA]
+                        ? NULL
+                        : _rules_bitmap(ix, exclude);
+  if(!match)
+  {
+    g_mutex_unlock(&_index_lock);
+    return FALSE;
+  }
+
+  GList *list = NULL;
+  switch(property)
+  {
+    case DT_COLLECTION_PROP_CAMERA:
+      // "maker\x1fmodel" sorts as GROUP BY maker, model
+      list = _dict_counts(&ix->camera, ix->makermodel, NULL, match);
+      break;
+
+    case DT_COLLECTION_PROP_LENS:
+      list = _dict_counts(&ix->lens, NULL, NULL, match);
+      break;
+
+    case DT_COLLECTION_PROP_FOLDERS:
+      list = _dict_counts(&ix->film, NULL, ix->film_ids, match);
+      break;
+
+    case DT_COLLECTION_PROP_TAG:
+      list = _tag_counts(ix, match);
+      break;
+
+    case DT_COLLECTION_PROP_DAY:
+    case DT_COLLECTION_PROP_TIME:
+      list = _time_counts(ix, ix->times[_TIME_TAKEN], match);
+      break;
+
+    case DT_COLLECTION_PROP_IMPORT_TIMESTAMP:
+      list = _time_counts(ix, ix->times[_TIME_IMPORT], match);
+      break;
+
+    case DT_COLLECTION_PROP_CHANGE_TIMESTAMP:
+      list = _time_counts(ix, ix->times[_TIME_CHANGE], match);
+      break;
+
+    case DT_COLLECTION_PROP_EXPORT_TIMESTAMP:
+      list = _time_counts(ix, ix->times[_TIME_EXPORT], match);
+      break;
+
+    case DT_COLLECTION_PROP_PRINT_TIMESTAMP:
+      list = _time_counts(ix, ix->times[_TIME_PRINT], match);
+      break;
+
+    case DT_COLLECTION_PROP_COLORLABEL:
+    {
+      const char *names[] = { _("red"), _("yellow"), _("green"), _("blue"), _("purple") };
+      int counts[5] = { 0 };
+      for(int r = 0; r < ix->rows; r++)
+        if(_bitmap_get(match, r))
+          for(int c = 0; c < 5; c++) counts[c] += (ix->colors[r] >> c) & 1;
+      // the list of the query is in descending color order
+      for(int c = 0; c < 5; c++)
+        if(counts[c]) list = _append_value(list, g_strdup(names[c]), c, counts[c]);
+      break;
+    }
+
+    default:
+    {
+      // the integer keys of the GROUP BY: iso, focal length, aperture in tenths, rating with -1 for rejected
+      const gboolean has_null = property == DT_COLLECTION_PROP_ISO ? ix->null_count[_NULL_ISO] > 0
+                                : property == DT_COLLECTION_PROP_APERTURE ? ix->null_count[_NULL_APERTURE] > 0
+                                : property == DT_COLLECTION_PROP_FOCAL_LENGTH
+                                  ? ix->null_count[_NULL_FOCAL_LENGTH] > 0
+                                  : FALSE;
+      // NULLs are a group of their own which isn't listed, leave it to sqlite
+      if(has_null)
+      {
+        free(match);
+        g_mutex_unlock(&_index_lock);
+        return FALSE;
+      }
+
+      GHashTable *counts = g_hash_table_new(NULL, NULL);
+      for(int r = 0; r < ix->rows; r++)
+      {
+        if(!_bitmap_get(match, r)) continue;
+        int key;
+        if(property == DT_COLLECTION_PROP_ISO)
+          key = (int)ix->iso[r];
+        else if(property == DT_COLLECTION_PROP_FOCAL_LENGTH)
+          key = (int)ix->focal_length[r];
+        else if(property == DT_COLLECTION_PROP_APERTURE)
+          key = lround(ix->aperture[r] * 10.0);
+        else
+          key = (ix->flags[r] & 0x8) ? -1 : ix->flags[r] & 0x7;
+        gpointer k = GINT_TO_POINTER(key);
+        g_hash_table_insert(counts, k, GINT_TO_POINTER(GPOINTER_TO_INT(g_hash_table_lookup(counts, k)) + 1));
+      }
+
+      GList *keys = g_list_sort(g_hash_table_get_keys(counts), _sort_keys);
+      for(GList *k = g_list_last(keys); k; k = g_list_previous(k))
+      {
+        const int key = GPOINTER_TO_INT(k->data);
+        const int count = GPOINTER_TO_INT(g_hash_table_lookup(counts, k->data));
+        gchar *text = property == DT_COLLECTION_PROP_APERTURE ? g_strdup_printf("%.1f", key / 10.0)
+                                                              : g_strdup_printf("%d", key);
+        list = _append_value(list, text, 1, count);
+      }
+      g_list_free(keys);
+      g_hash_table_destroy(counts);
+      break;
+    }
+  }
+
+  free(match);
+  g_mutex_unlock(&_index_lock);
+
+  *values = list;
+  return TRUE;
+}
+
+void dt_collection_index_free_counts(GList *values)
+{
+  for(GList *l = values; l; l = g_list_next(l))
+  {
+    dt_collection_index_value_t *value = l->data;
+    g_free(value->text);
+    g_free(value);
+  }
+  g_list_free(values);
+}
+
+void dt_collection_index_cleanup()
+{
+  dt_collection_index_invalidate();
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,66 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/collection.h"
+
+#include <glib.h>
+
+/*
+  In-memory columnar index of the image properties used by the collect module.
+
+  Each indexed property is kept as a column over all the images of the library (one row per image, in id
+  order), either as plain values (iso, aperture, focal length, rating, color labels) or as a dictionary of
+  distinct values with the sorted list of rows holding each of them (film roll, camera, lens, tag), and the
+  timestamps of the date lists. A
+  collection rule is evaluated into a bitmap over the rows, the rules are combined like the sql where clause
+  built by dt_collection_update_query() and the per value counts are read from the lists.
+
+  The index is optional (plugins/collect/memory_index) and built on first use. While it exists, temporary
+  triggers record the images whose indexed data change in memory.collection_index_dirty and only their rows
+  are read again on next use, unless so many changed that a new build is cheaper. Whenever a rule or a
+  property is not supported the functions return FALSE and the caller falls back to the database.
+*/
+
+typedef struct dt_collection_index_value_t
+{
+  gchar *text; // value as shown in the list and used in the rule
+  int id;      // film id, color... as given by the sql queries, 1 otherwise
+  int count;
+} dt_collection_index_value_t;
+
+/** whether the index is enabled in the preferences */
+gboolean dt_collection_index_enabled();
+
+/** drop the index and its triggers, it will be rebuilt on next use */
+void dt_collection_index_invalidate();
+
+/** per value image counts of property for the images matching all the collect rules but exclude (-1 for
+    none), in the order of the collect module lists (unsorted for the tree properties: folders, tags and
+    dates). id is the film roll id for the folders. returns FALSE if the index can't answer. */
+gboolean dt_collection_index_get_counts(const dt_collection_properties_t property, const int exclude,
+                                        GList **values);
+
+void dt_collection_index_free_counts(GList *values);
+
+void dt_collection_index_cleanup();
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -29,6 +29,7 @@
 #endif
 
 #include "common/collection.h"
+#include "common/collection_index.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
 #include "common/datetime.h"
@@ -63,7 +64,10 @@
 #include "control/jobs/film_jobs.h"
 #include "control/signal.h"
 #include "develop/blend.h"
+#include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/masks.h"
+#include "develop/tiling.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
 #include "gui/guides.h"
@@ -469,7 +473,6 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_pthread_mutex_init(&(darktable.dev_threadsafe), NULL);
   dt_pthread_mutex_init(&(darktable.capabilities_threadsafe), NULL);
   dt_pthread_mutex_init(&(darktable.exiv2_threadsafe), NULL);
-  dt_pthread_mutex_init(&(darktable.readFile_mutex), NULL);
   darktable.control = (dt_control_t *)calloc(1, sizeof(dt_control_t));
 
   // database
@@ -1389,7 +1392,11 @@ void dt_cleanup()
     dt_dbus_destroy(darktable.dbus);
 
     dt_control_shutdown(darktable.control);
-
+  }
+  // the jobs are done, the develop contexts kept for them can go
+  dt_dev_pool_cleanup();
+  if(init_gui)
+  {
     dt_lib_cleanup(darktable.lib);
     free(darktable.lib);
   }
@@ -1420,6 +1427,9 @@ void dt_cleanup()
   free(darktable.conf);
   dt_points_cleanup(darktable.points);
   free(darktable.points);
+  dt_masks_raster_cache_cleanup();
+  dt_tiling_cleanup();
+  dt_collection_index_cleanup();
   dt_iop_unload_modules_so();
   g_list_free_full(darktable.iop_order_list, free);
   darktable.iop_order_list = NULL;
@@ -1491,7 +1501,6 @@ void dt_cleanup()
   dt_pthread_mutex_destroy(&(darktable.dev_threadsafe));
   dt_pthread_mutex_destroy(&(darktable.capabilities_threadsafe));
   dt_pthread_mutex_destroy(&(darktable.exiv2_threadsafe));
-  dt_pthread_mutex_destroy(&(darktable.readFile_mutex));
 
   dt_exif_cleanup();
 }
@@ -330,7 +330,6 @@ typedef struct darktable_t
   dt_pthread_mutex_t plugin_threadsafe;
   dt_pthread_mutex_t capabilities_threadsafe;
   dt_pthread_mutex_t exiv2_threadsafe;
-  dt_pthread_mutex_t readFile_mutex;
   char *progname;
   char *datadir;
   char *sharedir;
@@ -410,7 +409,8 @@ static inline void dt_unlock_image(int32_t imgid) RELEASE(darktable.db_image[img
 
 static inline void dt_lock_image_pair(int32_t imgid1, int32_t imgid2) ACQUIRE(darktable.db_image[imgid1 & (DT_IMAGE_DBLOCKS-1)], darktable.db_image[imgid2 & (DT_IMAGE_DBLOCKS-1)])
 {
-  if(imgid1 < imgid2)
+  // always the lowest lock first
+  if((imgid1 & (DT_IMAGE_DBLOCKS-1)) < (imgid2 & (DT_IMAGE_DBLOCKS-1)))
   {
     dt_pthread_mutex_lock(&(darktable.db_image[imgid1 & (DT_IMAGE_DBLOCKS-1)]));
     dt_pthread_mutex_lock(&(darktable.db_image[imgid2 & (DT_IMAGE_DBLOCKS-1)]));
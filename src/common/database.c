@@ -49,7 +49,7 @@
 
 // whenever _create_*_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 35
+#define CURRENT_DATABASE_VERSION_LIBRARY 36
 #define CURRENT_DATABASE_VERSION_DATA     9
 
 // #define USE_NESTED_TRANSACTIONS
@@ -432,6 +432,32 @@ end:
 // redefine this where needed
 #define FINALIZE
 
+// the recipe of an image (see develop/recipe.h) is dropped as soon as anything it's made from changes
+static const char *_history_recipe_triggers[] =
+{
+  "CREATE TRIGGER main.history_recipe_history_insert AFTER INSERT ON history"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = new.imgid; END",
+  "CREATE TRIGGER main.history_recipe_history_update AFTER UPDATE ON history"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = old.imgid OR imgid = new.imgid; END",
+  "CREATE TRIGGER main.history_recipe_history_delete AFTER DELETE ON history"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = old.imgid; END",
+  "CREATE TRIGGER main.history_recipe_masks_insert AFTER INSERT ON masks_history"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = new.imgid; END",
+  "CREATE TRIGGER main.history_recipe_masks_update AFTER UPDATE ON masks_history"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = old.imgid OR imgid = new.imgid; END",
+  "CREATE TRIGGER main.history_recipe_masks_delete AFTER DELETE ON masks_history"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = old.imgid; END",
+  "CREATE TRIGGER main.history_recipe_order_insert AFTER INSERT ON module_order"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = new.imgid; END",
+  "CREATE TRIGGER main.history_recipe_order_update AFTER UPDATE ON module_order"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = old.imgid OR imgid = new.imgid; END",
+  "CREATE TRIGGER main.history_recipe_order_delete AFTER DELETE ON module_order"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = old.imgid; END",
+  "CREATE TRIGGER main.history_recipe_history_end AFTER UPDATE OF history_end ON images"
+  " BEGIN DELETE FROM history_recipe WHERE imgid = new.id; END",
+  NULL
+};
+
 /* do the real migration steps, returns the version the db was converted to */
 static int _upgrade_library_schema_step(dt_database_t *db, int version)
 {
@@ -2074,6 +2100,19 @@ static int _upgrade_library_schema_step(dt_database_t *db, int version)
     sqlite3_exec(db->handle, "PRAGMA foreign_keys = ON", NULL, NULL, NULL);
     new_version = 35;
   }
+  else if(version == 35)
+  {
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+    TRY_EXEC("CREATE TABLE main.history_recipe (imgid INTEGER PRIMARY KEY, version INTEGER, hash BLOB, recipe BLOB, "
+             "FOREIGN KEY(imgid) REFERENCES images(id) ON UPDATE CASCADE ON DELETE CASCADE)",
+             "[init] can't create table history_recipe\n");
+    for(int i = 0; _history_recipe_triggers[i]; i++)
+      TRY_EXEC(_history_recipe_triggers[i], "[init] can't create history_recipe trigger\n");
+
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 36;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -2426,6 +2465,13 @@ static void _create_library_schema(dt_database_t *db)
                NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index_key ON meta_data (key)", NULL, NULL, NULL);
 
+  // v36
+  sqlite3_exec(db->handle, "CREATE TABLE main.history_recipe (imgid INTEGER PRIMARY KEY, "
+               "version INTEGER, hash BLOB, recipe BLOB, "
+               "FOREIGN KEY(imgid) REFERENCES images(id) ON UPDATE CASCADE ON DELETE CASCADE)",
+               NULL, NULL, NULL);
+  for(int i = 0; _history_recipe_triggers[i]; i++)
+    sqlite3_exec(db->handle, _history_recipe_triggers[i], NULL, NULL, NULL);
 }
 
 /* create the current database schema and set the version in db_info accordingly */
@@ -2521,6 +2567,74 @@ static void _create_memory_schema(dt_database_t *db)
   sqlite3_exec(db->handle,
       "CREATE TABLE memory.film_folder (id INTEGER PRIMARY KEY, status INTEGER)",
       NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TABLE memory.tag_usage (tagid INTEGER PRIMARY KEY, count INTEGER DEFAULT 0, selected INTEGER DEFAULT 0)",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TABLE memory.collection_index_dirty (imgid INTEGER UNIQUE)",
+      NULL, NULL, NULL);
+}
+
+// per tag number of images and of selected images, kept up to date by temporary triggers
+// so that the tag views don't have to count all the tagged images on each refresh.
+// the tables are not qualified in the triggers: temporary triggers resolve them in the
+// search order and tag_usage only exists in memory.
+static void _create_tag_usage(dt_database_t *db)
+{
+  sqlite3_exec(db->handle,
+      "INSERT INTO memory.tag_usage (tagid, count, selected)"
+      "  SELECT ti.tagid, COUNT(*), COUNT(s.imgid)"
+      "  FROM main.tagged_images AS ti"
+      "  LEFT JOIN main.selected_images AS s ON s.imgid = ti.imgid"
+      "  GROUP BY ti.tagid",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TEMPORARY TRIGGER tag_usage_attach AFTER INSERT ON main.tagged_images"
+      " BEGIN"
+      "   INSERT OR IGNORE INTO tag_usage (tagid) VALUES (new.tagid);"
+      "   UPDATE tag_usage"
+      "     SET count = count + 1,"
+      "         selected = selected + EXISTS (SELECT 1 FROM selected_images WHERE imgid = new.imgid)"
+      "     WHERE tagid = new.tagid;"
+      " END",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TEMPORARY TRIGGER tag_usage_detach AFTER DELETE ON main.tagged_images"
+      " BEGIN"
+      "   UPDATE tag_usage"
+      "     SET count = count - 1,"
+      "         selected = selected - EXISTS (SELECT 1 FROM selected_images WHERE imgid = old.imgid)"
+      "     WHERE tagid = old.tagid;"
+      " END",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TEMPORARY TRIGGER tag_usage_move AFTER UPDATE OF imgid, tagid ON main.tagged_images"
+      " BEGIN"
+      "   UPDATE tag_usage"
+      "     SET count = count - 1,"
+      "         selected = selected - EXISTS (SELECT 1 FROM selected_images WHERE imgid = old.imgid)"
+      "     WHERE tagid = old.tagid;"
+      "   INSERT OR IGNORE INTO tag_usage (tagid) VALUES (new.tagid);"
+      "   UPDATE tag_usage"
+      "     SET count = count + 1,"
+      "         selected = selected + EXISTS (SELECT 1 FROM selected_images WHERE imgid = new.imgid)"
+      "     WHERE tagid = new.tagid;"
+      " END",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TEMPORARY TRIGGER tag_usage_select AFTER INSERT ON main.selected_images"
+      " BEGIN"
+      "   UPDATE tag_usage SET selected = selected + 1"
+      "     WHERE tagid IN (SELECT tagid FROM tagged_images WHERE imgid = new.imgid);"
+      " END",
+      NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+      "CREATE TEMPORARY TRIGGER tag_usage_unselect AFTER DELETE ON main.selected_images"
+      " BEGIN"
+      "   UPDATE tag_usage SET selected = selected - 1"
+      "     WHERE tagid IN (SELECT tagid FROM tagged_images WHERE imgid = old.imgid);"
+      " END",
+      NULL, NULL, NULL);
 }
 
 static void _sanitize_db(dt_database_t *db)
@@ -3485,6 +3599,7 @@ start:
 
   // create the in-memory tables
   _create_memory_schema(db);
+  _create_tag_usage(db);
 
   // create a table legacy_presets with all the presets from pre-auto-apply-cleanup darktable.
   dt_legacy_presets_create(db);
@@ -1554,10 +1554,10 @@ int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char
   }
 }
 
-/** read the metadata of an image.
+/** read the metadata of an image, from the file content when data is given.
  * XMP data trumps IPTC data trumps EXIF data
  */
-int dt_exif_read(dt_image_t *img, const char *path)
+static int _exif_read(dt_image_t *img, const char *path, const uint8_t *data, const size_t size)
 {
   // at least set datetime taken to something useful in case there is no exif data in this file (pfm, png,
   // ...)
@@ -1570,7 +1570,8 @@ int dt_exif_read(dt_image_t *img, const char *path)
 
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+    std::unique_ptr<Exiv2::Image> image(data ? Exiv2::ImageFactory::open(data, size)
+                                             : Exiv2::ImageFactory::open(WIDEN(path)));
     assert(image.get() != 0);
     read_metadata_threadsafe(image);
     bool res = true;
@@ -1623,6 +1624,16 @@ int dt_exif_read(dt_image_t *img, const char *path)
   }
 }
 
+int dt_exif_read(dt_image_t *img, const char *path)
+{
+  return _exif_read(img, path, NULL, 0);
+}
+
+int dt_exif_read_from_data(dt_image_t *img, const char *path, const uint8_t *data, const size_t size)
+{
+  return _exif_read(img, path, data, size);
+}
+
 int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int compressed)
 {
   try
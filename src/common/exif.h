@@ -64,6 +64,9 @@ const GList* dt_exif_get_exiv2_taglist();
  * struct. returns 0 on success. */
 int dt_exif_read(dt_image_t *img, const char *path);
 
+/** same as dt_exif_read() on the content of the file at path, already in memory. data is not copied. */
+int dt_exif_read_from_data(dt_image_t *img, const char *path, const uint8_t *data, const size_t size);
+
 /** read exif data to image struct from given data blob, wherever you got it from. */
 int dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size);
 
@@ -35,8 +35,10 @@
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
  * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ *
+ * Large masks are solved by multigrid V-cycles over the bounding box of the
+ * mask instead, as the relaxation needs thousands of sweeps to propagate the
+ * borders to the center of the mask.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -372,19 +374,10 @@ cleanup:
 }
 
 
-/* Original Algorithm Design:
- *
- * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
- * http://www.tgeorgiev.net/Photoshop_Healing.pdf
- */
-void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
-             const int height, const int ch)
+// heal with the red/black relaxation over the whole stamp
+static void _heal_relaxation(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer,
+                             const int width, const int height)
 {
-  if(ch != 4)
-  {
-    fprintf(stderr,"dt_heal: full-color image required\n");
-    return;
-  }
   const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
   float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
   float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
@@ -407,6 +400,460 @@ cleanup:
   if(black_buffer) dt_free_align(black_buffer);
 }
 
+/* Multigrid solver
+ *
+ * The same equation is solved on a plain grid covering the bounding box of
+ * the mask plus one pixel, so that the fixed pixels around the mask are
+ * included. As with the relaxation, the pixels outside of the stamp are not
+ * neighbors.
+ *
+ * Pixel (i, j) of a level is pixel (2i, 2j) of the finer one, and is solved
+ * if that one is. Each coarser level solves for the correction of the
+ * residual of the finer one, the correction being interpolated bilinearly.
+ * The coarse equations are the Galerkin ones, the restriction being the
+ * transpose of the interpolation: unlike equations discretized again on
+ * the coarse grid, they keep the borders of any mask shape where they are,
+ * and the V-cycles converge in a handful of iterations. The error is
+ * smoothed on each level by red/black Gauss-Seidel sweeps.
+ */
+
+#define HEAL_MG_MIN_SIZE 96     // narrower boxes converge as fast with the relaxation
+#define HEAL_MG_MAX_LEVELS 16
+#define HEAL_MG_COARSEST 4      // size of the coarsest level, solved by sweeps only
+#define HEAL_MG_SWEEPS 1        // pre and post smoothing sweeps
+#define HEAL_MG_COARSE_SWEEPS 32
+#define HEAL_MG_MAX_CYCLES 50
+
+// state of a pixel of a level
+#define HEAL_MG_FIXED 0
+#define HEAL_MG_SOLVED 1
+
+typedef struct _heal_level_t
+{
+  size_t width, height;
+  float *u;        // solution on the finest level, correction on the others
+  float *f;        // right hand side
+  float *a;        // 3x3 stencil of the equation of each pixel, NULL on the finest level
+  uint8_t *state;  // HEAL_MG_FIXED or HEAL_MG_SOLVED
+} _heal_level_t;
+
+// coefficient of pixel (x + dx, y + dy) in the equation of pixel (x, y)
+static inline float _heal_mg_coeff(const _heal_level_t *const l, const size_t x, const size_t y,
+                                   const int dx, const int dy)
+{
+  if(l->a) return l->a[9 * (y * l->width + x) + 3 * (dy + 1) + dx + 1];
+
+  // the laplacian of the finest level, as in the relaxation: the sides of the box which aren't fixed pixels are
+  // the borders of the stamp
+  if(dx && dy) return 0.0f;
+  if(dx || dy) return x + dx < l->width && y + dy < l->height ? -1.0f : 0.0f; // also skips -1, wrapped around
+  return (x > 0) + (x + 1 < l->width) + (y > 0) + (y + 1 < l->height);
+}
+
+// left hand side of the equation of pixel (x, y) without its own term, and the coefficient of that term
+static inline float _heal_mg_neighbors(const _heal_level_t *const l, const size_t x, const size_t y,
+                                       dt_aligned_pixel_t sum)
+{
+  const size_t k = y * l->width + x;
+  const size_t stride = 4 * l->width;
+  const float *const u = l->u + 4 * k;
+
+  if(!l->a)
+  {
+    int n = 0;
+    for_each_channel(c) sum[c] = 0.0f;
+    if(x > 0)
+    {
+      for_each_channel(c) sum[c] -= u[c - 4];
+      n++;
+    }
+    if(x + 1 < l->width)
+    {
+      for_each_channel(c) sum[c] -= u[c + 4];
+      n++;
+    }
+    if(y > 0)
+    {
+      for_each_channel(c) sum[c] -= u[c - stride];
+      n++;
+    }
+    if(y + 1 < l->height)
+    {
+      for_each_channel(c) sum[c] -= u[c + stride];
+      n++;
+    }
+    return n;
+  }
+
+  const float *const a = l->a + 9 * k;
+  if(x > 0 && y > 0 && x + 1 < l->width && y + 1 < l->height)
+  {
+    const float *const up = u - stride;
+    const float *const down = u + stride;
+    for_each_channel(c)
+      sum[c] = a[0] * up[c - 4] + a[1] * up[c] + a[2] * up[c + 4]
+               + a[3] * u[c - 4] + a[5] * u[c + 4]
+               + a[6] * down[c - 4] + a[7] * down[c] + a[8] * down[c + 4];
+    return a[4];
+  }
+
+  for_each_channel(c) sum[c] = 0.0f;
+  for(int dy = -1; dy <= 1; dy++)
+    for(int dx = -1; dx <= 1; dx++)
+    {
+      if(!(dx || dy) || x + dx >= l->width || y + dy >= l->height) continue;
+      const float *const v = l->u + 4 * ((y + dy) * l->width + x + dx);
+      for_each_channel(c) sum[c] += a[3 * (dy + 1) + dx + 1] * v[c];
+    }
+  return a[4];
+}
+
+// one Gauss-Seidel sweep over the pixels of one color. the 5 point laplacian of the finest level needs two
+// colors, the 9 point stencils of the coarse levels four, so that the pixels of a color don't depend on each
+// other and the result doesn't depend on the threads.
+static void _heal_mg_smooth(_heal_level_t *const l, const int color)
+{
+  const gboolean four = l->a != NULL;
+  const size_t first_row = four ? color >> 1 : 0;
+  const size_t row_step = four ? 2 : 1;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(l, color, four, first_row, row_step) \
+  schedule(static)
+#endif
+  for(size_t y = first_row; y < l->height; y += row_step)
+  {
+    for(size_t x = four ? color & 1 : (y + color) & 1; x < l->width; x += 2)
+    {
+      const size_t k = y * l->width + x;
+      if(l->state[k] != HEAL_MG_SOLVED) continue;
+      dt_aligned_pixel_t sum;
+      const float a = _heal_mg_neighbors(l, x, y, sum);
+      if(a <= 0.0f) continue;
+      for_each_channel(c) l->u[4 * k + c] = (l->f[4 * k + c] - sum[c]) / a;
+    }
+  }
+}
+
+static void _heal_mg_sweeps(_heal_level_t *const l, const int sweeps)
+{
+  const int colors = l->a ? 4 : 2;
+  for(int s = 0; s < sweeps; s++)
+    for(int color = 0; color < colors; color++) _heal_mg_smooth(l, color);
+}
+
+// weight of the coarse pixels x/2 and (x+1)/2 in the interpolation of pixel x
+static inline float _heal_mg_weight(const size_t x)
+{
+  return x & 1 ? 0.5f : 1.0f;
+}
+
+// galerkin equations of the coarse level: the fine equations of the interpolated correction, summed as in the
+// restriction
+static void _heal_mg_coarsen(const _heal_level_t *const fine, _heal_level_t *const coarse)
+{
+  for(size_t j = 0; j < coarse->height; j++)
+    for(size_t i = 0; i < coarse->width; i++)
+      coarse->state[j * coarse->width + i] = 2 * i < fine->width && 2 * j < fine->height
+                                             ? fine->state[2 * j * fine->width + 2 * i] : HEAL_MG_FIXED;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fine, coarse) \
+  schedule(static)
+#endif
+  for(size_t j = 0; j < coarse->height; j++)
+  {
+    for(size_t i = 0; i < coarse->width; i++)
+    {
+      const size_t k = j * coarse->width + i;
+      float *const a = coarse->a + 9 * k;
+      memset(a, 0, sizeof(float) * 9);
+      if(coarse->state[k] != HEAL_MG_SOLVED) continue;
+
+      for(size_t y = MAX(2 * j, 1) - 1; y <= MIN(2 * j + 1, fine->height - 1); y++)
+        for(size_t x = MAX(2 * i, 1) - 1; x <= MIN(2 * i + 1, fine->width - 1); x++)
+        {
+          if(fine->state[y * fine->width + x] != HEAL_MG_SOLVED) continue;
+          const float w = _heal_mg_weight(x) * _heal_mg_weight(y);
+          for(int dy = -1; dy <= 1; dy++)
+            for(int dx = -1; dx <= 1; dx++)
+            {
+              if(!fine->a && dx && dy) continue; // no diagonal terms on the finest level
+              const size_t nx = x + dx;
+              const size_t ny = y + dy;
+              if(nx >= fine->width || ny >= fine->height
+                 || fine->state[ny * fine->width + nx] != HEAL_MG_SOLVED)
+                continue;
+              const float c = w * _heal_mg_coeff(fine, x, y, dx, dy) * _heal_mg_weight(nx) * _heal_mg_weight(ny);
+              if(c == 0.0f) continue;
+              // the coarse pixels interpolated at (nx, ny), all within one pixel of (i, j)
+              for(size_t cj = ny / 2; cj <= (ny + 1) / 2; cj++)
+                for(size_t ci = nx / 2; ci <= (nx + 1) / 2; ci++)
+                  if(coarse->state[cj * coarse->width + ci] == HEAL_MG_SOLVED)
+                    a[3 * (cj + 1 - j) + ci + 1 - i] += c;
+            }
+        }
+    }
+  }
+}
+
+// residual of the equations of the solved pixels of a level
+static void _heal_mg_residual(const _heal_level_t *const l, float *const restrict r)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(l, r) \
+  schedule(static)
+#endif
+  for(size_t y = 0; y < l->height; y++)
+  {
+    for(size_t x = 0; x < l->width; x++)
+    {
+      const size_t k = y * l->width + x;
+      if(l->state[k] != HEAL_MG_SOLVED) continue;
+      dt_aligned_pixel_t sum;
+      const float a = _heal_mg_neighbors(l, x, y, sum);
+      for_each_channel(c) r[4 * k + c] = l->f[4 * k + c] - sum[c] - a * l->u[4 * k + c];
+    }
+  }
+}
+
+// restrict the residual r of the fine level into the right hand side of the coarse one, and clear its correction
+static void _heal_mg_restrict(const _heal_level_t *const fine, const float *const restrict r,
+                              _heal_level_t *const coarse)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fine, r, coarse) \
+  schedule(static)
+#endif
+  for(size_t j = 0; j < coarse->height; j++)
+  {
+    for(size_t i = 0; i < coarse->width; i++)
+    {
+      const size_t k = j * coarse->width + i;
+      dt_aligned_pixel_t sum = { 0.0f };
+      for(size_t y = MAX(2 * j, 1) - 1; y <= MIN(2 * j + 1, fine->height - 1); y++)
+        for(size_t x = MAX(2 * i, 1) - 1; x <= MIN(2 * i + 1, fine->width - 1); x++)
+        {
+          const size_t kf = y * fine->width + x;
+          if(coarse->state[k] != HEAL_MG_SOLVED || fine->state[kf] != HEAL_MG_SOLVED) continue;
+          const float w = _heal_mg_weight(x) * _heal_mg_weight(y);
+          for_each_channel(c) sum[c] += w * r[4 * kf + c];
+        }
+      for_each_channel(c)
+      {
+        coarse->f[4 * k + c] = sum[c];
+        coarse->u[4 * k + c] = 0.0f;
+      }
+    }
+  }
+}
+
+// add the interpolated correction of the coarse level to the solved pixels of the fine one
+static void _heal_mg_prolongate(const _heal_level_t *const coarse, _heal_level_t *const fine)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fine, coarse) \
+  schedule(static)
+#endif
+  for(size_t y = 0; y < fine->height; y++)
+  {
+    for(size_t x = 0; x < fine->width; x++)
+    {
+      const size_t k = y * fine->width + x;
+      if(fine->state[k] != HEAL_MG_SOLVED) continue;
+      // the correction of the pixels which aren't solved stays null
+      const float w = _heal_mg_weight(x) * _heal_mg_weight(y);
+      for(size_t j = y / 2; j <= (y + 1) / 2; j++)
+        for(size_t i = x / 2; i <= (x + 1) / 2; i++)
+        {
+          const float *const e = coarse->u + 4 * (j * coarse->width + i);
+          for_each_channel(c) fine->u[4 * k + c] += w * e[c];
+        }
+    }
+  }
+}
+
+// r is a scratch buffer as large as the finest level
+static void _heal_mg_vcycle(_heal_level_t *const levels, const int level, const int num_levels, float *const r)
+{
+  _heal_level_t *const l = levels + level;
+  if(level == num_levels - 1)
+  {
+    _heal_mg_sweeps(l, HEAL_MG_COARSE_SWEEPS);
+    return;
+  }
+  _heal_mg_sweeps(l, HEAL_MG_SWEEPS);
+  _heal_mg_residual(l, r);
+  _heal_mg_restrict(l, r, l + 1);
+  _heal_mg_vcycle(levels, level + 1, num_levels, r);
+  _heal_mg_prolongate(l + 1, l);
+  _heal_mg_sweeps(l, HEAL_MG_SWEEPS);
+}
+
+static void _heal_mg_free(_heal_level_t *const levels, const int num_levels)
+{
+  for(int k = 0; k < num_levels; k++)
+  {
+    if(levels[k].u) dt_free_align(levels[k].u);
+    if(levels[k].f) dt_free_align(levels[k].f);
+    if(levels[k].a) dt_free_align(levels[k].a);
+    if(levels[k].state) dt_free_align(levels[k].state);
+  }
+}
+
+// allocate the levels for a box of width x height, returns their number or 0 on failure
+static int _heal_mg_alloc(_heal_level_t *const levels, const size_t width, const size_t height)
+{
+  size_t wd = width;
+  size_t ht = height;
+  int num_levels = 0;
+  while(num_levels < HEAL_MG_MAX_LEVELS)
+  {
+    _heal_level_t *const l = levels + num_levels;
+    l->width = wd;
+    l->height = ht;
+    l->u = dt_alloc_align_float(4 * wd * ht);
+    l->f = dt_calloc_align_float(4 * wd * ht);
+    l->a = num_levels ? dt_alloc_align_float(9 * wd * ht) : NULL;
+    l->state = dt_alloc_align(64, wd * ht);
+    num_levels++;
+    if(!l->u || !l->f || (num_levels > 1 && !l->a) || !l->state)
+    {
+      _heal_mg_free(levels, num_levels);
+      return 0;
+    }
+    if(MIN(wd, ht) <= HEAL_MG_COARSEST) break;
+    // the last pixel of each level is interpolated from the coarser one
+    wd = wd / 2 + 1;
+    ht = ht / 2 + 1;
+  }
+  return num_levels;
+}
+
+// heal the box of the stamp at (x0, y0) by multigrid, returns FALSE if it can't be done
+static gboolean _heal_multigrid(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer,
+                                const int width, const int x0, const int y0,
+                                const int box_width, const int box_height)
+{
+  _heal_level_t levels[HEAL_MG_MAX_LEVELS] = { { 0 } };
+  const int num_levels = _heal_mg_alloc(levels, box_width, box_height);
+  if(num_levels == 0) return FALSE;
+
+  _heal_level_t *const l = levels;
+  const size_t wd = l->width;
+  const size_t ht = l->height;
+  float *const restrict prev = dt_alloc_align_float(4 * wd * ht);
+  float *const restrict r = dt_alloc_align_float(4 * wd * ht);
+  if(!prev || !r)
+  {
+    if(prev) dt_free_align(prev);
+    if(r) dt_free_align(r);
+    _heal_mg_free(levels, num_levels);
+    return FALSE;
+  }
+
+  // the difference to the pattern, as for the relaxation
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(src_buffer, dest_buffer, mask_buffer, width, x0, y0, wd, ht, l) \
+  schedule(static)
+#endif
+  for(size_t y = 0; y < ht; y++)
+    for(size_t x = 0; x < wd; x++)
+    {
+      const size_t k = y * wd + x;
+      const size_t idx = (y + y0) * width + x + x0;
+      l->state[k] = mask_buffer[idx] != 0.0f ? HEAL_MG_SOLVED : HEAL_MG_FIXED;
+      for_each_channel(c) l->u[4 * k + c] = dest_buffer[4 * idx + c] - src_buffer[4 * idx + c];
+    }
+
+  for(int level = 1; level < num_levels; level++) _heal_mg_coarsen(levels + level - 1, levels + level);
+
+  // stop when a cycle doesn't change any pixel by more than 0.1/255
+  const float epsilon = (0.1 / 255);
+  for(int cycle = 0; cycle < HEAL_MG_MAX_CYCLES; cycle++)
+  {
+    memcpy(prev, l->u, sizeof(float) * 4 * wd * ht);
+    _heal_mg_vcycle(levels, 0, num_levels, r);
+
+    float change = 0.0f;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(prev, l, wd, ht) \
+  schedule(static) \
+  reduction(max : change)
+#endif
+    for(size_t k = 0; k < wd * ht; k++)
+      for_each_channel(c) change = fmaxf(change, fabsf(l->u[4 * k + c] - prev[4 * k + c]));
+
+    if(change < epsilon) break;
+  }
+
+  // add the solution to the pattern, on the healed pixels only
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(src_buffer, dest_buffer, width, x0, y0, wd, ht, l) \
+  schedule(static)
+#endif
+  for(size_t y = 0; y < ht; y++)
+    for(size_t x = 0; x < wd; x++)
+    {
+      const size_t k = y * wd + x;
+      if(l->state[k] != HEAL_MG_SOLVED) continue;
+      const size_t idx = (y + y0) * width + x + x0;
+      for_each_channel(c) dest_buffer[4 * idx + c] = l->u[4 * k + c] + src_buffer[4 * idx + c];
+    }
+
+  dt_free_align(prev);
+  dt_free_align(r);
+  _heal_mg_free(levels, num_levels);
+  return TRUE;
+}
+
+/* Original Algorithm Design:
+ *
+ * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
+ * http://www.tgeorgiev.net/Photoshop_Healing.pdf
+ */
+void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
+             const int height, const int ch)
+{
+  if(ch != 4)
+  {
+    fprintf(stderr,"dt_heal: full-color image required\n");
+    return;
+  }
+
+  // bounding box of the mask, grown by one pixel for the fixed pixels around it
+  int x0 = width, y0 = height, x1 = -1, y1 = -1;
+  for(int y = 0; y < height; y++)
+  {
+    const float *const row = mask_buffer + (size_t)y * width;
+    for(int x = 0; x < width; x++)
+      if(row[x] != 0.0f)
+      {
+        x0 = MIN(x0, x);
+        x1 = MAX(x1, x);
+        y0 = MIN(y0, y);
+        y1 = MAX(y1, y);
+      }
+  }
+  if(x1 < 0) return; // nothing to heal
+
+  x0 = MAX(x0 - 1, 0);
+  y0 = MAX(y0 - 1, 0);
+  x1 = MIN(x1 + 2, width);
+  y1 = MIN(y1 + 2, height);
+
+  if(MIN(x1 - x0, y1 - y0) < HEAL_MG_MIN_SIZE
+     || !_heal_multigrid(src_buffer, dest_buffer, mask_buffer, width, x0, y0, x1 - x0, y1 - y0))
+    _heal_relaxation(src_buffer, dest_buffer, mask_buffer, width, height);
+}
+
 #ifdef HAVE_OPENCL
 
 dt_heal_cl_global_t *dt_heal_init_cl_global()
@@ -19,6 +19,7 @@
 #include "common/history.h"
 #include "common/collection.h"
 #include "common/darktable.h"
+#include "common/datetime.h"
 #include "common/debug.h"
 #include "common/exif.h"
 #include "common/history_snapshot.h"
@@ -29,6 +30,7 @@
 #include "common/undo.h"
 #include "common/utility.h"
 #include "control/control.h"
+#include "control/jobs.h"
 #include "develop/blend.h"
 #include "develop/develop.h"
 #include "develop/masks.h"
@@ -474,38 +476,22 @@ int dt_history_merge_module_into_history(dt_develop_t *dev_dest, dt_develop_t *d
   return module_added;
 }
 
-static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_imgid, GList *ops, const gboolean copy_full)
+// read the history of the source image and select the modules to paste, once for all the destination images
+static void _history_paste_source_init(dt_develop_t *dev_src, GList **mod_list, const int32_t imgid, GList *ops,
+                                       const gboolean copy_full)
 {
-  GList *modules_used = NULL;
-
-  dt_develop_t _dev_src = { 0 };
-  dt_develop_t _dev_dest = { 0 };
-
-  dt_develop_t *dev_src = &_dev_src;
-  dt_develop_t *dev_dest = &_dev_dest;
-
-  // we will do the copy/paste on memory so we can deal with masks
   dt_dev_init(dev_src, FALSE);
-  dt_dev_init(dev_dest, FALSE);
-
   dev_src->iop = dt_iop_load_modules_ext(dev_src, TRUE);
-  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
 
   dt_dev_read_history_ext(dev_src, imgid, TRUE);
 
-  // This prepends the default modules and converts just in case it's an empty history
-  dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
-
-  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge ");
-  dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_copy_and_paste_on_image_merge ");
+  dt_ioppr_check_iop_order(dev_src, imgid, "_history_paste_source_init ");
 
   dt_dev_pop_history_items_ext(dev_src, dev_src->history_end);
-  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
 
-  dt_ioppr_check_iop_order(dev_src, imgid, "_history_copy_and_paste_on_image_merge 1");
-  dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_copy_and_paste_on_image_merge 1");
+  dt_ioppr_check_iop_order(dev_src, imgid, "_history_paste_source_init 1");
 
-  GList *mod_list = NULL;
+  *mod_list = NULL;
 
   if(ops)
   {
@@ -524,7 +510,7 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
           if (DT_IOP_ORDER_INFO)
             fprintf(stderr,"\n  module %20s, multiprio %i",  hist->module->op, hist->module->multi_priority);
 
-          mod_list = g_list_prepend(mod_list, hist->module);
+          *mod_list = g_list_prepend(*mod_list, hist->module);
         }
       }
     }
@@ -545,13 +531,29 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
          && (copy_full || !dt_history_module_skip_copy(mod_src->flags()))
         )
       {
-        mod_list = g_list_prepend(mod_list, mod_src);
+        *mod_list = g_list_prepend(*mod_list, mod_src);
       }
     }
   }
   if (DT_IOP_ORDER_INFO) fprintf(stderr,"\nvvvvv\n");
 
-  mod_list = g_list_reverse(mod_list);   // list was built in reverse order, so un-reverse it
+  *mod_list = g_list_reverse(*mod_list);   // list was built in reverse order, so un-reverse it
+}
+
+// merge the modules of mod_list into the history of dest_imgid, dev_src is only read
+static void _history_paste_merge(dt_develop_t *dev_dest, const int32_t dest_imgid, dt_develop_t *dev_src,
+                                 GList *mod_list)
+{
+  GList *modules_used = NULL;
+
+  // This prepends the default modules and converts just in case it's an empty history
+  dt_dev_read_history_ext(dev_dest, dest_imgid, TRUE);
+
+  dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_paste_merge ");
+
+  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
+
+  dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_paste_merge 1");
 
   // update iop-order list to have entries for the new modules
   dt_ioppr_update_for_modules(dev_dest, mod_list, FALSE);
@@ -565,7 +567,27 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
   // update iop-order list to have entries for the new modules
   dt_ioppr_update_for_modules(dev_dest, mod_list, FALSE);
 
-  dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_copy_and_paste_on_image_merge 2");
+  dt_ioppr_check_iop_order(dev_dest, dest_imgid, "_history_paste_merge 2");
+
+  g_list_free(modules_used);
+}
+
+static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_imgid, GList *ops, const gboolean copy_full)
+{
+  dt_develop_t _dev_src = { 0 };
+  dt_develop_t _dev_dest = { 0 };
+
+  dt_develop_t *dev_src = &_dev_src;
+  dt_develop_t *dev_dest = &_dev_dest;
+
+  // we will do the copy/paste on memory so we can deal with masks
+  GList *mod_list = NULL;
+  _history_paste_source_init(dev_src, &mod_list, imgid, ops, copy_full);
+
+  dt_dev_init(dev_dest, FALSE);
+  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
+
+  _history_paste_merge(dev_dest, dest_imgid, dev_src, mod_list);
 
   // write history and forms to db
   dt_dev_write_history_ext(dev_dest, dest_imgid);
@@ -573,17 +595,16 @@ static int _history_copy_and_paste_on_image_merge(int32_t imgid, int32_t dest_im
   dt_dev_cleanup(dev_src);
   dt_dev_cleanup(dev_dest);
 
-  g_list_free(modules_used);
+  g_list_free(mod_list);
 
   return 0;
 }
 
-static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const int32_t dest_imgid, GList *ops, const gboolean copy_full)
+// replace history stack and shapes
+static void _history_clear_on_image(const int32_t dest_imgid)
 {
-  int ret_val = 0;
   sqlite3_stmt *stmt;
 
-  // replace history stack
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "DELETE FROM main.history WHERE imgid = ?1",
                               -1, &stmt, NULL);
@@ -605,124 +626,136 @@ static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
+}
 
-  // the user wants an exact duplicate of the history, so just copy the db
-  if(!ops)
-  {
-    // let's build the list of IOP to not copy
-    gchar *skip_modules = NULL;
+// the user wants an exact duplicate of the history, so just copy the db
+static void _history_copy_rows(const int32_t imgid, const int32_t dest_imgid, const gboolean copy_full)
+{
+  sqlite3_stmt *stmt;
+
+  // let's build the list of IOP to not copy
+  gchar *skip_modules = NULL;
 
-    if(!copy_full)
+  if(!copy_full)
+  {
+    for(GList *modules = darktable.iop; modules; modules = g_list_next(modules))
     {
-      for(GList *modules = darktable.iop; modules; modules = g_list_next(modules))
-      {
-        dt_iop_module_so_t *module = (dt_iop_module_so_t *)modules->data;
+      dt_iop_module_so_t *module = (dt_iop_module_so_t *)modules->data;
 
-        if(dt_history_module_skip_copy(module->flags()))
-        {
-          if(skip_modules)
-            skip_modules = dt_util_dstrcat(skip_modules, ",");
+      if(dt_history_module_skip_copy(module->flags()))
+      {
+        if(skip_modules)
+          skip_modules = dt_util_dstrcat(skip_modules, ",");
 
-          skip_modules = dt_util_dstrcat(skip_modules, "'%s'", module->op);
-        }
+        skip_modules = dt_util_dstrcat(skip_modules, "'%s'", module->op);
       }
     }
+  }
 
-    if(!skip_modules)
-      skip_modules = g_strdup("'@'");
-
-    gchar *query = g_strdup_printf
-      ("INSERT INTO main.history "
-       "            (imgid,num,module,operation,op_params,enabled,blendop_params, "
-       "             blendop_version,multi_priority,multi_name)"
-       " SELECT ?1,num,module,operation,op_params,enabled,blendop_params, "
-       "        blendop_version,multi_priority,multi_name "
-       " FROM main.history"
-       " WHERE imgid=?2"
-       "       AND operation NOT IN (%s)"
-       " ORDER BY num", skip_modules);
-
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+  if(!skip_modules)
+    skip_modules = g_strdup("'@'");
+
+  gchar *query = g_strdup_printf
+    ("INSERT INTO main.history "
+     "            (imgid,num,module,operation,op_params,enabled,blendop_params, "
+     "             blendop_version,multi_priority,multi_name)"
+     " SELECT ?1,num,module,operation,op_params,enabled,blendop_params, "
+     "        blendop_version,multi_priority,multi_name "
+     " FROM main.history"
+     " WHERE imgid=?2"
+     "       AND operation NOT IN (%s)"
+     " ORDER BY num", skip_modules);
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
 
-    g_free(query);
+  g_free(query);
 
-    query = g_strdup_printf
-      ("INSERT INTO main.masks_history "
-       "           (imgid, num, formid, form, name, version, points, points_count, source)"
-       " SELECT ?1, num, formid, form, name, version, points, points_count, source "
-       "  FROM main.masks_history"
-       "  WHERE imgid = ?2"
-       "    AND num NOT IN (SELECT num FROM history WHERE imgid=?2 AND OPERATION IN (%s))", skip_modules);
+  query = g_strdup_printf
+    ("INSERT INTO main.masks_history "
+     "           (imgid, num, formid, form, name, version, points, points_count, source)"
+     " SELECT ?1, num, formid, form, name, version, points, points_count, source "
+     "  FROM main.masks_history"
+     "  WHERE imgid = ?2"
+     "    AND num NOT IN (SELECT num FROM history WHERE imgid=?2 AND OPERATION IN (%s))", skip_modules);
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
 
-    g_free(skip_modules);
+  g_free(skip_modules);
 
-    int history_end = 0;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT history_end FROM main.images WHERE id = ?1",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      if(sqlite3_column_type(stmt, 0) != SQLITE_NULL)
-        history_end = sqlite3_column_int(stmt, 0);
-    }
-    sqlite3_finalize(stmt);
+  int history_end = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT history_end FROM main.images WHERE id = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    if(sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+      history_end = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "UPDATE main.images SET history_end = ?2"
-                                " WHERE id = ?1",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, history_end);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.images SET history_end = ?2"
+                              " WHERE id = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, history_end);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
 
-    // copy the module order
+  // copy the module order
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "INSERT OR REPLACE INTO main.module_order (imgid, iop_list, version)"
-                                " SELECT ?2, iop_list, version"
-                                "   FROM main.module_order"
-                                "   WHERE imgid = ?1",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, dest_imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO main.module_order (imgid, iop_list, version)"
+                              " SELECT ?2, iop_list, version"
+                              "   FROM main.module_order"
+                              "   WHERE imgid = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, dest_imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
 
-    // it is possible the source image has no hash yet. make sure this is copied too
+  // it is possible the source image has no hash yet. make sure this is copied too
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "DELETE FROM main.history_hash WHERE imgid = ?1",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "DELETE FROM main.history_hash WHERE imgid = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
 
-    // and finally copy the history hash, except mipmap hash
+  // and finally copy the history hash, except mipmap hash
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "INSERT INTO main.history_hash"
-                                "    (imgid, basic_hash, auto_hash, current_hash)"
-                                " SELECT ?2, basic_hash, auto_hash, current_hash"
-                                "   FROM main.history_hash "
-                                "   WHERE imgid = ?1",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, dest_imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-  }
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT INTO main.history_hash"
+                              "    (imgid, basic_hash, auto_hash, current_hash)"
+                              " SELECT ?2, basic_hash, auto_hash, current_hash"
+                              "   FROM main.history_hash "
+                              "   WHERE imgid = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, dest_imgid);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+}
+
+static int _history_copy_and_paste_on_image_overwrite(const int32_t imgid, const int32_t dest_imgid, GList *ops, const gboolean copy_full)
+{
+  int ret_val = 0;
+
+  _history_clear_on_image(dest_imgid);
+
+  if(!ops)
+    _history_copy_rows(imgid, dest_imgid, copy_full);
   else
   {
     // since the history and masks where deleted we can do a merge
@@ -807,6 +840,351 @@ int dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t dest_i
   return ret_val;
 }
 
+// the images are changed by chunks: the new histories are built first, reading a history may use its own
+// transaction, then they are all written in one transaction.
+#define DT_HISTORY_BATCH_CHUNK 64
+
+typedef struct _history_batch_t
+{
+  GList *imgs;
+  dt_history_batch_ops_t ops;
+  gpointer user_data;
+  gboolean undo;
+} _history_batch_t;
+
+typedef struct _history_batch_item_t
+{
+  int32_t imgid;
+  dt_develop_t dev;
+  dt_undo_lt_history_t *hist;
+} _history_batch_item_t;
+
+static void _history_batch_free(void *p)
+{
+  _history_batch_t *b = (_history_batch_t *)p;
+  if(b->ops.free) b->ops.free(b->user_data);
+  g_list_free(b->imgs);
+  free(b);
+}
+
+// change time stamp, aspect ratio and final size in one write of the image, the sidecar is written once the
+// whole batch is done
+static void _history_batch_touch_image(const int32_t imgid)
+{
+  dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'w');
+  if(!image) return;
+  image->change_timestamp = dt_datetime_now_to_gtimespan();
+  image->aspect_ratio = 0.f;
+  image->final_width = image->final_height = 0;
+  dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+}
+
+// lock the images of a chunk and the source while their histories change. the locks are taken in the order of
+// dt_lock_image_pair(), the lowest first, so that another thread locking two of them can't wait on us.
+static uint64_t _history_batch_lock(const _history_batch_item_t *items, const int count, const int32_t source)
+  NO_THREAD_SAFETY_ANALYSIS
+{
+  // one bit per lock, DT_IMAGE_DBLOCKS is 64
+  uint64_t locks = 0;
+  for(int k = 0; k < count; k++) locks |= (uint64_t)1 << (items[k].imgid & (DT_IMAGE_DBLOCKS - 1));
+  if(source > 0) locks |= (uint64_t)1 << (source & (DT_IMAGE_DBLOCKS - 1));
+
+  for(int k = 0; k < DT_IMAGE_DBLOCKS; k++)
+    if(locks & ((uint64_t)1 << k)) dt_pthread_mutex_lock(&darktable.db_image[k]);
+  return locks;
+}
+
+static void _history_batch_unlock(const uint64_t locks) NO_THREAD_SAFETY_ANALYSIS
+{
+  for(int k = 0; k < DT_IMAGE_DBLOCKS; k++)
+    if(locks & ((uint64_t)1 << k)) dt_pthread_mutex_unlock(&darktable.db_image[k]);
+}
+
+// the darkroom is only touched from the gui thread
+static gboolean _history_batch_reload_current(gpointer user_data)
+{
+  dt_dev_reload_history_items(darktable.develop);
+  dt_dev_modulegroups_set(darktable.develop, dt_dev_modulegroups_get(darktable.develop));
+  dt_dev_modules_update_multishow(darktable.develop);
+  return FALSE;
+}
+
+// returns the list of the changed images
+static GList *_history_batch_run(_history_batch_t *b, dt_job_t *job)
+{
+  _history_batch_item_t *items = calloc(DT_HISTORY_BATCH_CHUNK, sizeof(_history_batch_item_t));
+  if(!items) return NULL;
+
+  const guint total = g_list_length(b->imgs);
+  guint done = 0;
+  GList *changed = NULL;
+  gboolean current = FALSE;
+
+  guint tagid = 0;
+  dt_tag_new("darktable|changed", &tagid);
+
+  if(b->undo) dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
+
+  const GList *l = b->imgs;
+  while(l && !(job && dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED))
+  {
+    int count = 0;
+    for(; l && count < DT_HISTORY_BATCH_CHUNK; l = g_list_next(l))
+    {
+      int32_t imgid = GPOINTER_TO_INT(l->data);
+      if(b->ops.target) imgid = b->ops.target(imgid, b->user_data);
+      done++;
+      if(imgid > 0) items[count++].imgid = imgid;
+    }
+
+    const uint64_t locks = _history_batch_lock(items, count, b->ops.source);
+
+    // the images left out by prepare() are dropped from the chunk
+    const int targets = count;
+    count = 0;
+    for(int k = 0; k < targets; k++)
+    {
+      _history_batch_item_t *item = &items[count];
+      item->imgid = items[k].imgid;
+      item->hist = NULL;
+      if(b->undo)
+      {
+        item->hist = dt_history_snapshot_item_init();
+        item->hist->imgid = item->imgid;
+        dt_history_snapshot_undo_create(item->imgid, &item->hist->before, &item->hist->before_history_end);
+      }
+
+      if(b->ops.prepare)
+      {
+        dt_dev_init(&item->dev, FALSE);
+        item->dev.iop = dt_iop_load_modules_ext(&item->dev, TRUE);
+        item->dev.image_storage.id = item->imgid;
+
+        if(!b->ops.prepare(&item->dev, item->imgid, b->user_data))
+        {
+          dt_dev_cleanup(&item->dev);
+          if(item->hist) dt_history_snapshot_undo_lt_history_data_free(item->hist);
+          continue;
+        }
+      }
+      count++;
+    }
+
+    dt_database_start_transaction(darktable.db);
+    for(int k = 0; k < count; k++)
+    {
+      _history_batch_item_t *item = &items[k];
+      if(b->ops.write)
+        b->ops.write(b->ops.prepare ? &item->dev : NULL, item->imgid, b->user_data);
+      else
+        dt_dev_write_history_ext(&item->dev, item->imgid);
+
+      /* attach changed tag reflecting actual change */
+      dt_tag_attach(tagid, item->imgid, FALSE, FALSE);
+      _history_batch_touch_image(item->imgid);
+    }
+    dt_database_release_transaction(darktable.db);
+
+    _history_batch_unlock(locks);
+
+    for(int k = 0; k < count; k++)
+    {
+      _history_batch_item_t *item = &items[k];
+      if(item->hist)
+      {
+        dt_history_snapshot_undo_create(item->imgid, &item->hist->after, &item->hist->after_history_end);
+        dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)item->hist,
+                       dt_history_snapshot_undo_pop, dt_history_snapshot_undo_lt_history_data_free);
+      }
+      if(b->ops.prepare) dt_dev_cleanup(&item->dev);
+
+      dt_mipmap_cache_remove(darktable.mipmap_cache, item->imgid);
+
+      /* update the aspect ratio. recompute only if really needed for performance reasons */
+      if(darktable.collection->params.sort == DT_COLLECTION_SORT_ASPECT_RATIO)
+        dt_image_set_aspect_ratio(item->imgid, FALSE);
+
+      if(dt_dev_is_current_image(darktable.develop, item->imgid)) current = TRUE;
+      changed = g_list_prepend(changed, GINT_TO_POINTER(item->imgid));
+
+      // signal that the mipmap need to be updated
+      DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, item->imgid);
+    }
+
+    if(job) dt_control_job_set_progress(job, (double)done / total);
+  }
+
+  if(b->undo) dt_undo_end_group(darktable.undo);
+
+  free(items);
+
+  changed = g_list_reverse(changed);
+
+  dt_print(DT_DEBUG_PERF, "[history] batch done on %d of %u images\n", g_list_length(changed), total);
+
+  // the sidecars at once, now that all the histories are in the database
+  dt_image_synch_xmps(changed);
+
+  /* if current image in develop reload history */
+  if(current) g_main_context_invoke(NULL, _history_batch_reload_current, NULL);
+
+  if(b->ops.done) b->ops.done(changed, b->user_data);
+
+  return changed;
+}
+
+static int32_t _history_batch_job_run(dt_job_t *job)
+{
+  _history_batch_t *b = dt_control_job_get_params(job);
+  GList *changed = _history_batch_run(b, job);
+  // the thumbnails of the changed images, the callers don't wait for the job
+  dt_collection_update_query(darktable.collection, DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF, changed);
+  return 0;
+}
+
+int dt_history_batch_apply(const GList *list, const dt_history_batch_ops_t *ops, gpointer user_data,
+                           const gboolean undo, const char *message, const gboolean background)
+{
+  _history_batch_t *b = calloc(1, sizeof(_history_batch_t));
+  if(!b)
+  {
+    if(ops->free) ops->free(user_data);
+    return 0;
+  }
+  b->imgs = g_list_copy((GList *)list);
+  b->ops = *ops;
+  b->user_data = user_data;
+  b->undo = undo;
+
+  if(background)
+  {
+    dt_job_t *job = dt_control_job_create(&_history_batch_job_run, "%s", message);
+    if(job)
+    {
+      dt_control_job_add_progress(job, _(message), TRUE);
+      dt_control_job_set_params(job, b, _history_batch_free);
+      dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_FG, job);
+      return -1;
+    }
+  }
+
+  GList *changed = _history_batch_run(b, NULL);
+  const int count = g_list_length(changed);
+  g_list_free(changed);
+  _history_batch_free(b);
+  return count;
+}
+
+// state of a paste onto a list of images, the source history is read once
+typedef struct _history_paste_t
+{
+  int32_t imgid;
+  gboolean merge;
+  gboolean copy_full;
+  GList *ops;
+  GList *iop_list;  // order of the source if copied
+  dt_develop_t src; // only for a merge or a paste of selected items
+  GList *mod_list;
+  int *multi_priority; // of the modules of mod_list as read, changed by each paste
+} _history_paste_t;
+
+static void _history_paste_free(gpointer user_data)
+{
+  _history_paste_t *p = (_history_paste_t *)user_data;
+  if(p->merge || p->ops)
+  {
+    dt_dev_cleanup(&p->src);
+    g_list_free(p->mod_list);
+  }
+  free(p->multi_priority);
+  g_list_free_full(p->iop_list, g_free);
+  g_list_free(p->ops);
+  free(p);
+}
+
+static int32_t _history_paste_target(const int32_t imgid, gpointer user_data)
+{
+  const _history_paste_t *p = (_history_paste_t *)user_data;
+  return imgid == p->imgid ? -1 : imgid;
+}
+
+static gboolean _history_paste_prepare(dt_develop_t *dev, const int32_t imgid, gpointer user_data)
+{
+  _history_paste_t *p = (_history_paste_t *)user_data;
+
+  if(p->iop_list) dt_ioppr_write_iop_order_list(p->iop_list, imgid);
+
+  if(!p->merge) _history_clear_on_image(imgid);
+
+  // the iop order of the image renumbers the instances of the source modules, start from the source again
+  int k = 0;
+  for(GList *l = p->mod_list; l; l = g_list_next(l))
+    ((dt_iop_module_t *)l->data)->multi_priority = p->multi_priority[k++];
+
+  _history_paste_merge(dev, imgid, &p->src, p->mod_list);
+  return TRUE;
+}
+
+static void _history_paste_write(dt_develop_t *dev, const int32_t imgid, gpointer user_data)
+{
+  const _history_paste_t *p = (_history_paste_t *)user_data;
+
+  // the user wants an exact duplicate of the history, the module order comes with the rows
+  if(!p->merge && !p->ops)
+  {
+    _history_clear_on_image(imgid);
+    _history_copy_rows(p->imgid, imgid, p->copy_full);
+  }
+  else
+    dt_dev_write_history_ext(dev, imgid);
+}
+
+static void _history_paste_done(const GList *imgs, gpointer user_data)
+{
+  const guint count = g_list_length((GList *)imgs);
+  if(count > 1)
+    dt_control_log(ngettext("history pasted onto %d image", "history pasted onto %d images", count), count);
+}
+
+// paste the copied history, in the background outside of the darkroom. returns TRUE if done at once.
+static gboolean _history_paste_on_list(const GList *list, const gboolean undo)
+{
+  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
+  const gboolean darkroom = cv->view(cv) == DT_VIEW_DARKROOM;
+
+  // be sure the current history is written before pasting some other history data
+  if(darkroom) dt_dev_write_history(darktable.develop);
+
+  const dt_history_copy_item_t *cp = &darktable.view_manager->copy_paste;
+  _history_paste_t *p = calloc(1, sizeof(_history_paste_t));
+  if(!p) return FALSE;
+  p->imgid = cp->copied_imageid;
+  p->merge = dt_conf_get_int("plugins/lighttable/copy_history/pastemode") == 0;
+  p->copy_full = cp->full_copy;
+  p->ops = g_list_copy(cp->selops);
+  if(cp->copy_iop_order) p->iop_list = dt_ioppr_get_iop_order_list(p->imgid, FALSE);
+  if(p->merge || p->ops)
+  {
+    _history_paste_source_init(&p->src, &p->mod_list, p->imgid, p->ops, p->copy_full);
+    p->multi_priority = calloc(g_list_length(p->mod_list) + 1, sizeof(int));
+    int k = 0;
+    for(const GList *l = p->mod_list; l; l = g_list_next(l))
+      p->multi_priority[k++] = ((dt_iop_module_t *)l->data)->multi_priority;
+  }
+
+  // nothing to build for a plain copy of the rows
+  const dt_history_batch_ops_t ops = { .source = p->imgid,
+                                       .target = _history_paste_target,
+                                       .prepare = p->merge || p->ops ? _history_paste_prepare : NULL,
+                                       .write = _history_paste_write,
+                                       .done = _history_paste_done,
+                                       .free = _history_paste_free };
+
+  // a single image is quick, and the darkroom has to be in sync with its history
+  const gboolean background = !darkroom && list->next;
+  return dt_history_batch_apply(list, &ops, p, undo, N_("paste history"), background) >= 0;
+}
+
 char *dt_history_item_as_string(const char *name, gboolean enabled)
 {
   return g_strconcat(enabled ? "●" : "○", "  ", name, NULL);
@@ -1652,21 +2030,7 @@ gboolean dt_history_paste_on_list(const GList *list, gboolean undo)
   if(!list) // do we have any images to receive the pasted history?
     return FALSE;
 
-  const int mode = dt_conf_get_int("plugins/lighttable/copy_history/pastemode");
-  gboolean merge = FALSE;
-  if(mode == 0) merge = TRUE;
-
-  if(undo) dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-  for(GList *l = (GList *)list; l; l = g_list_next(l))
-  {
-    const int dest = GPOINTER_TO_INT(l->data);
-    dt_history_copy_and_paste_on_image(darktable.view_manager->copy_paste.copied_imageid,
-                                       dest, merge,
-                                       darktable.view_manager->copy_paste.selops,
-                                       darktable.view_manager->copy_paste.copy_iop_order,
-                                       darktable.view_manager->copy_paste.full_copy);
-  }
-  if(undo) dt_undo_end_group(darktable.undo);
+  const gboolean done = _history_paste_on_list(list, undo);
 
   // In darkroom and if there is a copy of the iop-order we need to rebuild the pipe
   // to take into account the possible new order of modules.
@@ -1679,7 +2043,7 @@ gboolean dt_history_paste_on_list(const GList *list, gboolean undo)
     dt_dev_pixelpipe_rebuild(darktable.develop);
   }
 
-  return TRUE;
+  return done;
 }
 
 gboolean dt_history_paste_parts_on_list(const GList *list, gboolean undo)
@@ -1688,10 +2052,6 @@ gboolean dt_history_paste_parts_on_list(const GList *list, gboolean undo)
   if(!list) // do we have any images to receive the pasted history?
     return FALSE;
 
-  const int mode = dt_conf_get_int("plugins/lighttable/copy_history/pastemode");
-  gboolean merge = FALSE;
-  if(mode == 0) merge = TRUE;
-
   // at the time the dialog is started, some signals are sent and this in turn call
   // back dt_view_get_images_to_act_on() which free list and create a new one.
 
@@ -1707,17 +2067,7 @@ gboolean dt_history_paste_parts_on_list(const GList *list, gboolean undo)
     return FALSE;
   }
 
-  if(undo) dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-  for (const GList *l = l_copy; l; l = g_list_next(l))
-  {
-    const int dest = GPOINTER_TO_INT(l->data);
-    dt_history_copy_and_paste_on_image(darktable.view_manager->copy_paste.copied_imageid,
-                                       dest, merge,
-                                       darktable.view_manager->copy_paste.selops,
-                                       darktable.view_manager->copy_paste.copy_iop_order,
-                                       darktable.view_manager->copy_paste.full_copy);
-  }
-  if(undo) dt_undo_end_group(darktable.undo);
+  const gboolean done = _history_paste_on_list(l_copy, undo);
 
   g_list_free(l_copy);
 
@@ -1732,7 +2082,7 @@ gboolean dt_history_paste_parts_on_list(const GList *list, gboolean undo)
     dt_dev_pixelpipe_rebuild(darktable.develop);
   }
 
-  return TRUE;
+  return done;
 }
 
 gboolean dt_history_delete_on_list(const GList *list, gboolean undo)
@@ -67,6 +67,30 @@ int dt_history_merge_module_into_history(struct dt_develop_t *dev_dest, struct d
 /** copy history from imgid and pasts on dest_imgid, merge or overwrite... */
 int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboolean merge, GList *ops, gboolean copy_iop_order, const gboolean copy_full);
 
+/** the steps of a change of the history of many images, see dt_history_batch_apply() */
+typedef struct dt_history_batch_ops_t
+{
+  // image the new histories are made from, locked with the changed images. 0 if none.
+  int32_t source;
+  // image to change for imgid, a duplicate for instance, -1 to skip it. optional.
+  int32_t (*target)(const int32_t imgid, gpointer user_data);
+  // build the new history of imgid in dev, its modules are loaded. returns FALSE to skip the image. optional,
+  // no dev is given to write without it.
+  gboolean (*prepare)(struct dt_develop_t *dev, const int32_t imgid, gpointer user_data);
+  // write the new history, within the transaction. optional, defaults to dt_dev_write_history_ext().
+  void (*write)(struct dt_develop_t *dev, const int32_t imgid, gpointer user_data);
+  // called with the changed images at the end, in the thread of the batch. optional.
+  void (*done)(const GList *imgs, gpointer user_data);
+  // frees user_data. optional.
+  void (*free)(gpointer user_data);
+} dt_history_batch_ops_t;
+
+/** change the history of the images of list: the histories are written by chunks in one transaction and the
+    sidecars once at the end. in background the changes are done by a cancellable job which also reloads the
+    collection, -1 is returned. otherwise returns the number of changed images. user_data is owned by the batch. */
+int dt_history_batch_apply(const GList *list, const dt_history_batch_ops_t *ops, gpointer user_data,
+                           const gboolean undo, const char *message, const gboolean background);
+
 /** delete all history for the given image */
 void dt_history_delete_on_image(int32_t imgid);
 
@@ -76,6 +100,8 @@ void dt_history_delete_on_image_ext(int32_t imgid, gboolean undo);
 /** copy history from imgid and pasts on selected images, merge or overwrite... */
 gboolean dt_history_copy(int imgid);
 gboolean dt_history_copy_parts(int imgid);
+/** the paste onto several images outside of the darkroom is done by a background job which reloads the
+    collection itself, FALSE is returned then as when nothing was pasted */
 gboolean dt_history_paste_on_list(const GList *list, gboolean undo);
 gboolean dt_history_paste_parts_on_list(const GList *list, gboolean undo);
 
@@ -23,6 +23,10 @@
 #include "common/darktable.h"
 #include "common/http_server.h"
 
+#ifndef _WIN32
+#include <gio/gunixsocketaddress.h>
+#endif
+
 #ifndef SOUP_CHECK_VERSION
 // SOUP_CHECK_VERSION was introduced only in 2.42
 #define SOUP_CHECK_VERSION(x, y, z) false
@@ -188,6 +192,7 @@ dt_http_server_t *dt_http_server_create(const int *ports, const int n_ports, con
 
   dt_http_server_t *server = (dt_http_server_t *)malloc(sizeof(dt_http_server_t));
   server->server = httpserver;
+  server->service = NULL;
 
   _connection_t *params = (_connection_t *)malloc(sizeof(_connection_t));
   params->id = id;
@@ -211,8 +216,205 @@ dt_http_server_t *dt_http_server_create(const int *ports, const int n_ports, con
   return server;
 }
 
+typedef struct _service_t
+{
+  dt_http_server_handler handler;
+  gpointer user_data;
+  GThreadPool *workers;
+  GMainContext *context;
+  gint pending; // requests whose reply has not been sent yet
+} _service_t;
+
+typedef struct _service_request_t
+{
+  _service_t *service;
+  SoupServer *server;
+  SoupMessage *msg;
+  GHashTable *query;
+  guint status;
+  GBytes *reply;
+  gchar *content_type;
+} _service_request_t;
+
+static void _service_free(gpointer data)
+{
+  _service_t *service = (_service_t *)data;
+  g_main_context_unref(service->context);
+  free(service);
+}
+
+// back in the thread of the server, send the reply
+static gboolean _service_reply(gpointer data)
+{
+  _service_request_t *request = (_service_request_t *)data;
+
+  soup_message_set_status(request->msg, request->status);
+  if(request->reply)
+  {
+    gsize size = 0;
+    gconstpointer body = g_bytes_get_data(request->reply, &size);
+    soup_message_set_response(request->msg,
+                              request->content_type ? request->content_type : "application/octet-stream",
+                              SOUP_MEMORY_COPY, body, size);
+  }
+  soup_server_unpause_message(request->server, request->msg);
+  g_atomic_int_add(&request->service->pending, -1);
+
+  g_object_unref(request->msg);
+  g_object_unref(request->server);
+  if(request->query) g_hash_table_destroy(request->query);
+  if(request->reply) g_bytes_unref(request->reply);
+  g_free(request->content_type);
+  free(request);
+  return G_SOURCE_REMOVE;
+}
+
+static void _service_worker(gpointer data, gpointer user_data)
+{
+  _service_request_t *request = (_service_request_t *)data;
+  _service_t *service = (_service_t *)user_data;
+
+  request->status = service->handler(request->query, &request->reply, &request->content_type,
+                                     service->user_data);
+  g_main_context_invoke(service->context, _service_reply, request);
+}
+
+static void _copy_query(GHashTable *query, GHashTable *copy)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, query);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+    g_hash_table_insert(copy, g_strdup(key), g_strdup(value));
+}
+
+// in the thread of the server, the message is put on hold until a worker has handled it
+static void _service_request(SoupServer *server, SoupMessage *msg, const char *path, GHashTable *query,
+                             SoupClientContext *client, gpointer user_data)
+{
+  _service_t *service = (_service_t *)user_data;
+
+  if(msg->method != SOUP_METHOD_GET && msg->method != SOUP_METHOD_POST)
+  {
+    soup_message_set_status(msg, SOUP_STATUS_NOT_IMPLEMENTED);
+    return;
+  }
+
+  // the server is being shut down
+  if(!service->workers)
+  {
+    soup_message_set_status(msg, SOUP_STATUS_SERVICE_UNAVAILABLE);
+    return;
+  }
+
+  _service_request_t *request = (_service_request_t *)calloc(1, sizeof(_service_request_t));
+  request->service = service;
+  request->server = g_object_ref(server);
+  request->msg = g_object_ref(msg);
+
+  // the query lives as long as the handler, the fields of a posted form are added to it
+  if(query || msg->method == SOUP_METHOD_POST)
+  {
+    request->query = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    if(query) _copy_query(query, request->query);
+    if(msg->method == SOUP_METHOD_POST && msg->request_body->length > 0)
+    {
+      SoupBuffer *body = soup_message_body_flatten(msg->request_body);
+      GHashTable *form = soup_form_decode(body->data);
+      _copy_query(form, request->query);
+      g_hash_table_destroy(form);
+      soup_buffer_free(body);
+    }
+  }
+
+  soup_server_pause_message(server, msg);
+  g_atomic_int_inc(&service->pending);
+  g_thread_pool_push(service->workers, request, NULL);
+}
+
+dt_http_server_t *dt_http_server_create_service(const int port, const char *socket, const char *id,
+                                                const int threads, const dt_http_server_handler handler,
+                                                gpointer user_data)
+{
+#ifdef OLD_API
+  fprintf(stderr, "error: long running http servers need libsoup 2.48 or newer\n");
+  return NULL;
+#else
+  SoupServer *httpserver = soup_server_new(SOUP_SERVER_SERVER_HEADER, "darktable internal server", NULL);
+  if(httpserver == NULL)
+  {
+    fprintf(stderr, "error: couldn't create libsoup httpserver\n");
+    return NULL;
+  }
+
+  GError *error = NULL;
+  gboolean listening = FALSE;
+  char *url = NULL;
+
+  if(socket)
+  {
+#ifndef _WIN32
+    GSocketAddress *address = g_unix_socket_address_new(socket);
+    listening = soup_server_listen(httpserver, address, 0, &error);
+    g_object_unref(address);
+    url = g_strdup_printf("unix:%s:/%s", socket, id);
+#endif
+  }
+  else
+  {
+    // only on the loopback interface
+    listening = soup_server_listen_local(httpserver, port, 0, &error);
+    url = g_strdup_printf("http://localhost:%d/%s", port, id);
+  }
+
+  if(!listening)
+  {
+    fprintf(stderr, "error: can't listen on %s: %s\n", url ? url : socket,
+            error ? error->message : "unix sockets are not supported");
+    g_clear_error(&error);
+    g_free(url);
+    g_object_unref(httpserver);
+    return NULL;
+  }
+
+  _service_t *service = (_service_t *)malloc(sizeof(_service_t));
+  service->handler = handler;
+  service->user_data = user_data;
+  service->context = g_main_context_ref_thread_default();
+  service->pending = 0;
+  service->workers = g_thread_pool_new(_service_worker, service, MAX(threads, 1), FALSE, NULL);
+
+  dt_http_server_t *server = (dt_http_server_t *)malloc(sizeof(dt_http_server_t));
+  server->server = httpserver;
+  server->url = url;
+  server->service = service;
+
+  char *path = g_strdup_printf("/%s", id);
+  soup_server_add_handler(httpserver, path, _service_request, service, _service_free);
+  g_free(path);
+
+  dt_print(DT_DEBUG_CONTROL, "[http server] service listening on %s\n", server->url);
+
+  return server;
+#endif
+}
+
 void dt_http_server_kill(dt_http_server_t *server)
 {
+  // let the requests being handled finish, their replies hold a reference on the server
+  if(server->service)
+  {
+    _service_t *service = (_service_t *)server->service;
+    g_thread_pool_free(service->workers, FALSE, TRUE);
+    service->workers = NULL;
+
+    // the main loop has been left: send the replies the workers queued in the main context and give the
+    // connections a chance to write them before they are closed
+    while(g_atomic_int_get(&service->pending) > 0) g_main_context_iteration(service->context, TRUE);
+    while(g_main_context_iteration(service->context, FALSE))
+      ;
+    server->service = NULL;
+  }
   if(server->server)
   {
     soup_server_disconnect(server->server);
@@ -22,10 +22,17 @@
 
 typedef gboolean (*dt_http_server_callback)(GHashTable *query, gpointer user_data);
 
+/** handler of the requests of a service. called from a worker thread with a copy of the query (may be NULL),
+ *  it sets the reply and its content type and returns the http status code.
+ */
+typedef guint (*dt_http_server_handler)(GHashTable *query, GBytes **reply, gchar **content_type,
+                                        gpointer user_data);
+
 typedef struct dt_http_server_t
 {
   SoupServer *server;
   char *url;
+  gpointer service; // only for services
 } dt_http_server_t;
 
 /** create a new http server, listening on one of the ports and using id as its path.
@@ -35,6 +42,14 @@ typedef struct dt_http_server_t
 dt_http_server_t *dt_http_server_create(const int *ports, const int n_ports, const char *id,
                                         const dt_http_server_callback callback, gpointer user_data);
 
+/** create a long running server answering the requests on path /id, listening on the loopback interface at
+ *  port or on the unix socket if socket is not NULL. up to threads requests are handled concurrently, the
+ *  main context of the calling thread must be running.
+ */
+dt_http_server_t *dt_http_server_create_service(const int port, const char *socket, const char *id,
+                                                const int threads, const dt_http_server_handler handler,
+                                                gpointer user_data);
+
 /** call this to kill a server manually. don't call this if the request was received.
  *  this also frees server.
  */
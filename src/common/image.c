@@ -717,27 +717,25 @@ gboolean dt_image_get_final_size(const int32_t imgid, int *width, int *height)
   }
 
   // and now we can do the pipe stuff to get final image size
-  dt_develop_t dev;
-  dt_dev_init(&dev, 0);
-  dt_dev_load_image(&dev, imgid);
+  dt_develop_t *const dev = dt_dev_pool_acquire(imgid);
 
   dt_dev_pixelpipe_t pipe;
-  int wd = dev.image_storage.width, ht = dev.image_storage.height;
+  int wd = dev->image_storage.width, ht = dev->image_storage.height;
   int res = dt_dev_pixelpipe_init_dummy(&pipe, wd, ht);
   if(res)
   {
     // set mem pointer to 0, won't be used.
-    dt_dev_pixelpipe_set_input(&pipe, &dev, NULL, wd, ht, 1.0f);
-    dt_dev_pixelpipe_create_nodes(&pipe, &dev);
-    dt_dev_pixelpipe_synch_all(&pipe, &dev);
-    dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
+    dt_dev_pixelpipe_set_input(&pipe, dev, NULL, wd, ht, 1.0f);
+    dt_dev_pixelpipe_create_nodes(&pipe, dev);
+    dt_dev_pixelpipe_synch_all(&pipe, dev);
+    dt_dev_pixelpipe_get_dimensions(&pipe, dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
                                     &pipe.processed_height);
     wd = pipe.processed_width;
     ht = pipe.processed_height;
     res = TRUE;
     dt_dev_pixelpipe_cleanup(&pipe);
   }
-  dt_dev_cleanup(&dev);
+  dt_dev_pool_release(dev);
 
   imgtmp = dt_image_cache_get(darktable.image_cache, imgid, 'w');
   imgtmp->final_width = *width = wd;
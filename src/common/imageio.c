@@ -66,6 +66,7 @@
 #endif
 
 #include <assert.h>
+#include <fcntl.h>
 #include <glib/gstdio.h>
 #include <inttypes.h>
 #include <math.h>
@@ -73,6 +74,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 #ifdef USE_LUA
 #include "lua/image.h"
@@ -262,6 +266,23 @@ gboolean dt_imageio_has_mono_preview(const char *filename)
   return mono;
 }
 
+void dt_imageio_prefetch(const int32_t imgid)
+{
+#if defined(POSIX_FADV_WILLNEED)
+  char filename[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+  dt_image_full_path(imgid, filename, sizeof(filename), &from_cache);
+  if(!*filename) return;
+
+  // the kernel starts reading and returns at once, the pages are in memory when the loader reads the file
+  const int fd = g_open(filename, O_RDONLY, 0);
+  if(fd < 0) return;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  close(fd);
+  dt_print(DT_DEBUG_IMAGEIO, "[dt_imageio_prefetch] `%s'\n", filename);
+#endif
+}
+
 void dt_imageio_flip_buffers(char *out, const char *in, const size_t bpp, const int wd, const int ht,
                              const int fwd, const int fht, const int stride,
                              const dt_image_orientation_t orientation)
@@ -682,9 +703,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
                                  dt_imageio_module_data_t *storage_params, int num, int total,
                                  dt_export_metadata_t *metadata)
 {
-  dt_develop_t dev;
-  dt_dev_init(&dev, 0);
-  dt_dev_load_image(&dev, imgid);
+  dt_develop_t *const dev = dt_dev_pool_acquire(imgid);
 
   const gboolean buf_is_downscaled = (thumbnail_export && dt_conf_get_bool("ui/performance"));
   dt_mipmap_buffer_t buf;
@@ -693,7 +712,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   else
     dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
 
-  const dt_image_t *img = &dev.image_storage;
+  const dt_image_t *img = &dev->image_storage;
 
   if(!buf.buf || !buf.width || !buf.height)
   {
@@ -735,25 +754,25 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
     GList *modules_used = NULL;
 
-    dt_dev_pop_history_items_ext(&dev, appending ? dev.history_end : 0);
-    dt_ioppr_update_for_style_items(&dev, style_items, appending);
+    dt_dev_pop_history_items_ext(dev, appending ? dev->history_end : 0);
+    dt_ioppr_update_for_style_items(dev, style_items, appending);
 
     for(GList *st_items = style_items; st_items; st_items = g_list_next(st_items))
     {
       dt_style_item_t *st_item = (dt_style_item_t *)st_items->data;
-      dt_styles_apply_style_item(&dev, st_item, &modules_used, appending);
+      dt_styles_apply_style_item(dev, st_item, &modules_used, appending);
     }
 
     g_list_free(modules_used);
     g_list_free_full(style_items, dt_style_item_free);
   }
 
-  dt_ioppr_resync_modules_order(&dev);
+  dt_ioppr_resync_modules_order(dev);
 
   dt_dev_pixelpipe_set_icc(&pipe, icc_type, icc_filename, icc_intent);
-  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
-  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
-  dt_dev_pixelpipe_synch_all(&pipe, &dev);
+  dt_dev_pixelpipe_set_input(&pipe, dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_create_nodes(&pipe, dev);
+  dt_dev_pixelpipe_synch_all(&pipe, dev);
   if(darktable.unmuted & DT_DEBUG_IMAGEIO)
   {
     fprintf(stderr,"[dt_imageio_export_with_flags] ");
@@ -782,7 +801,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
     if(!strncmp(filter, "post:", 5)) dt_dev_pixelpipe_disable_before(&pipe, filter + 5);
   }
 
-  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
+  dt_dev_pixelpipe_get_dimensions(&pipe, dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
                                   &pipe.processed_height);
 
   dt_show_times(&start, "[export] creating pixelpipe");
@@ -796,7 +815,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   else if(icc_type == DT_COLORSPACE_NONE)
   {
     dt_iop_module_t *colorout = NULL;
-    for(GList *modules = dev.iop; modules; modules = g_list_next(modules))
+    for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
     {
       colorout = (dt_iop_module_t *)modules->data;
       if(colorout->get_p && strcmp(colorout->op, "colorout") == 0)
@@ -873,7 +892,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   gboolean corrected = FALSE;
   float origin[] = { 0.0f, 0.0f };
 
-  if(dt_dev_distort_backtransform_plus(&dev, &pipe, 0.f, DT_DEV_TRANSFORM_DIR_ALL, origin, 1))
+  if(dt_dev_distort_backtransform_plus(dev, &pipe, 0.f, DT_DEV_TRANSFORM_DIR_ALL, origin, 1))
   {
     if((width == 0) && exact_size)
       width = pipe.processed_width;
@@ -944,7 +963,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
      * if high quality processing was requested, downsampling will be done
      * at the very end of the pipe (just before border and watermark)
      */
-    dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+    dt_dev_pixelpipe_process_no_gamma(&pipe, dev, 0, 0, processed_width, processed_height, scale);
   }
   else
   {
@@ -970,9 +989,9 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
     // do the processing (8-bit with special treatment, to make sure we can use openmp further down):
     if(bpp == 8)
-      dt_dev_pixelpipe_process(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+      dt_dev_pixelpipe_process(&pipe, dev, 0, 0, processed_width, processed_height, scale);
     else
-      dt_dev_pixelpipe_process_no_gamma(&pipe, &dev, 0, 0, processed_width, processed_height, scale);
+      dt_dev_pixelpipe_process_no_gamma(&pipe, dev, 0, 0, processed_width, processed_height, scale);
 
     if(finalscale) finalscale->enabled = 1;
   }
@@ -1087,7 +1106,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
     goto error;
 
   dt_dev_pixelpipe_cleanup(&pipe);
-  dt_dev_cleanup(&dev);
+  dt_dev_pool_release(dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
 
   /* now write xmp into that container, if possible */
@@ -1131,7 +1150,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 error:
   dt_dev_pixelpipe_cleanup(&pipe);
 error_early:
-  dt_dev_cleanup(&dev);
+  dt_dev_pool_release(dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
   return 1;
 }
@@ -62,6 +62,8 @@ gboolean dt_imageio_has_mono_preview(const char *filename);
 void dt_imageio_set_hdr_tag(dt_image_t *img);
 // Update the tag for b&w workflow
 void dt_imageio_update_monochrome_workflow_tag(int32_t id, int mask);
+// ask the system to read the file of the image in the background, for the next images of a batch
+void dt_imageio_prefetch(const int32_t imgid);
 // opens the file using pfm, hdr, exr.
 dt_imageio_retval_t dt_imageio_open_hdr(dt_image_t *img, const char *filename, dt_mipmap_buffer_t *buf);
 // opens file using imagemagick
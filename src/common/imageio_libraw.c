@@ -306,20 +306,11 @@ dt_imageio_retval_t dt_imageio_open_libraw(dt_image_t *img, const char *filename
     err = DT_IMAGEIO_CACHE_FULL;
     goto error;
   }
-  // Use faster memcpy if buffer sizes are equal
-  const size_t bufSize_mipmap = (size_t)img->width * img->height * sizeof(uint16_t);
-  const size_t bufSize_libraw = (size_t)raw->rawdata.sizes.raw_pitch * raw->rawdata.sizes.raw_height;
-  if(bufSize_mipmap == bufSize_libraw)
-  {
-    memcpy(buf, raw->rawdata.raw_image, bufSize_mipmap);
-  }
-  else
-  {
-    dt_imageio_flip_buffers((char *)buf, (char *)raw->rawdata.raw_image, sizeof(uint16_t),
-                            raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
-                            raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
-                            raw->rawdata.sizes.raw_pitch, ORIENTATION_NONE);
-  }
+  // LibRaw owns the buffer it unpacks into, the rows are copied in parallel (as rawspeed)
+  dt_imageio_flip_buffers((char *)buf, (char *)raw->rawdata.raw_image, sizeof(uint16_t),
+                          raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
+                          raw->rawdata.sizes.raw_width, raw->rawdata.sizes.raw_height,
+                          raw->rawdata.sizes.raw_pitch, ORIENTATION_NONE);
 
   // Checks not really required for CR3 support, but it's taken from the old dt libraw integration.
   if(FILTERS_ARE_4BAYER(img->buf_dsc.filters))
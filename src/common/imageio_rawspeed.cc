@@ -137,8 +137,6 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
 {
   if(_ignore_image(filename)) return DT_IMAGEIO_FILE_CORRUPTED;
 
-  if(!img->exif_inited) (void)dt_exif_read(img, filename);
-
   char filen[PATH_MAX] = { 0 };
   snprintf(filen, sizeof(filen), "%s", filename);
   FileReader f(filen);
@@ -150,9 +148,12 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
   {
     dt_rawspeed_load_meta();
 
-    dt_pthread_mutex_lock(&darktable.readFile_mutex);
+    // read the file once into the padded buffer rawspeed needs, the same bytes are parsed by exiv2. nothing
+    // is locked, the loaders running in parallel read their files concurrently.
     m = f.readFile();
-    dt_pthread_mutex_unlock(&darktable.readFile_mutex);
+
+    if(!img->exif_inited)
+      (void)dt_exif_read_from_data(img, filename, m->getData(0, m->getSize()), m->getSize());
 
     RawParser t(*m.get());
     d = t.getDecoder(meta);
@@ -381,24 +382,14 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
     if(!buf) return DT_IMAGEIO_CACHE_FULL;
 
     /*
-     * since we do not want to crop black borders at this stage,
-     * and we do not want to rotate image, we can just use memcpy,
-     * as it is faster than dt_imageio_flip_buffers, but only if
-     * buffer sizes are equal,
-     * (from Klaus: r->pitch may differ from DT pitch (line to line spacing))
-     * else fallback to generic dt_imageio_flip_buffers()
+     * the black borders are not cropped at this stage, the crop is only kept in img->crop_*, and the image is
+     * not rotated: the uncropped data is copied as is, with the rows copied in parallel as r->pitch may differ
+     * from the dt pitch (line to line spacing). the threads also share the first touch of the pages of the
+     * fresh buffer, which is most of the cost for the large sensors.
+     * rawspeed owns the buffer it decodes into, so this copy is the only one left.
      */
-    const size_t bufSize_mipmap = (size_t)img->width * img->height * r->getBpp();
-    const size_t bufSize_rawspeed = (size_t)r->pitch * dimUncropped.y;
-    if(bufSize_mipmap == bufSize_rawspeed)
-    {
-      memcpy(buf, r->getDataUncropped(0, 0), bufSize_mipmap);
-    }
-    else
-    {
-      dt_imageio_flip_buffers((char *)buf, (char *)r->getDataUncropped(0, 0), r->getBpp(), dimUncropped.x,
-                              dimUncropped.y, dimUncropped.x, dimUncropped.y, r->pitch, ORIENTATION_NONE);
-    }
+    dt_imageio_flip_buffers((char *)buf, (char *)r->getDataUncropped(0, 0), r->getBpp(), dimUncropped.x,
+                            dimUncropped.y, dimUncropped.x, dimUncropped.y, r->pitch, ORIENTATION_NONE);
 
     //  Check if the camera is missing samples
     const Camera *cam = meta->getCamera(r->metadata.make.c_str(),
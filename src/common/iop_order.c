@@ -541,6 +541,84 @@ gboolean dt_ioppr_is_iop_before(GList *iop_order_list, const char *base_operatio
   return op_order < base_order;
 }
 
+struct dt_iop_order_index_t
+{
+  GList **links;       // the links of the list, in order
+  gint64 *keys;        // operation and instance of each link
+  GHashTable *entries; // operation and instance -> position + 1 of the first match
+  GHashTable *first;   // operation -> position + 1 of its first instance
+};
+
+static inline gint64 _index_key(const GQuark op, const int instance)
+{
+  return ((gint64)op << 32) | (guint32)instance;
+}
+
+dt_iop_order_index_t *dt_ioppr_index_new(GList *iop_order_list)
+{
+  dt_iop_order_index_t *index = (dt_iop_order_index_t *)malloc(sizeof(dt_iop_order_index_t));
+  const int count = g_list_length(iop_order_list);
+  index->links = (GList **)malloc(sizeof(GList *) * MAX(count, 1));
+  index->keys = (gint64 *)malloc(sizeof(gint64) * MAX(count, 1));
+  index->entries = g_hash_table_new(g_int64_hash, g_int64_equal);
+  index->first = g_hash_table_new(NULL, NULL);
+
+  int pos = 0;
+  for(GList *l = iop_order_list; l; l = g_list_next(l), pos++)
+  {
+    const dt_iop_order_entry_t *const restrict e = (dt_iop_order_entry_t *)l->data;
+    const GQuark op = g_quark_from_string(e->operation);
+
+    index->links[pos] = l;
+    index->keys[pos] = _index_key(op, e->instance);
+
+    // the first match wins, as when walking the list
+    if(!g_hash_table_contains(index->entries, &index->keys[pos]))
+      g_hash_table_insert(index->entries, &index->keys[pos], GINT_TO_POINTER(pos + 1));
+    if(!g_hash_table_contains(index->first, GUINT_TO_POINTER(op)))
+      g_hash_table_insert(index->first, GUINT_TO_POINTER(op), GINT_TO_POINTER(pos + 1));
+  }
+
+  return index;
+}
+
+void dt_ioppr_index_free(dt_iop_order_index_t *index)
+{
+  if(!index) return;
+  g_hash_table_destroy(index->entries);
+  g_hash_table_destroy(index->first);
+  free(index->keys);
+  free(index->links);
+  free(index);
+}
+
+GList *dt_ioppr_index_get_link(const dt_iop_order_index_t *index, const char *op_name, const int multi_priority)
+{
+  // an operation never interned is in no list
+  const GQuark op = g_quark_try_string(op_name);
+  if(!op) return NULL;
+
+  int pos = 0;
+  if(multi_priority == -1)
+    pos = GPOINTER_TO_INT(g_hash_table_lookup(index->first, GUINT_TO_POINTER(op)));
+  else
+  {
+    const gint64 key = _index_key(op, multi_priority);
+    pos = GPOINTER_TO_INT(g_hash_table_lookup(index->entries, &key));
+  }
+
+  return pos ? index->links[pos - 1] : NULL;
+}
+
+int dt_ioppr_index_get_iop_order(const dt_iop_order_index_t *index, const char *op_name, const int multi_priority)
+{
+  const GList *const restrict link = dt_ioppr_index_get_link(index, op_name, multi_priority);
+  if(link) return ((dt_iop_order_entry_t *)link->data)->o.iop_order;
+
+  fprintf(stderr, "cannot get iop-order for %s instance %d\n", op_name, multi_priority);
+  return INT_MAX;
+}
+
 gint dt_sort_iop_list_by_order(gconstpointer a, gconstpointer b)
 {
   const dt_iop_order_entry_t *const restrict am = (const dt_iop_order_entry_t *)a;
@@ -892,19 +970,17 @@ void dt_ioppr_resync_modules_order(dt_develop_t *dev)
 
   // and reset all module iop_order
 
-  GList *modules = dev->iop;
-  while(modules)
+  dt_iop_order_index_t *index = dt_ioppr_index_new(dev->iop_order_list);
+  for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
   {
     dt_iop_module_t *mod = (dt_iop_module_t *)(modules->data);
-    GList *next = g_list_next(modules);
 
     // modules with iop_order set to INT_MAX we keep them as they will be removed (non visible)
     // _lib_modulegroups_update_iop_visibility.
     if(mod->iop_order != INT_MAX)
-      mod->iop_order = dt_ioppr_get_iop_order(dev->iop_order_list, mod->op, mod->multi_priority);
-
-    modules = next;
+      mod->iop_order = dt_ioppr_index_get_iop_order(index, mod->op, mod->multi_priority);
   }
+  dt_ioppr_index_free(index);
 
   dev->iop = g_list_sort(dev->iop, dt_sort_iop_by_order);
 }
@@ -1105,16 +1181,6 @@ static int _count_entries_operation(GList *e_list, const char *operation)
   return count;
 }
 
-static gboolean _operation_already_handled(GList *e_list, const char *operation)
-{
-  for(const GList *l = g_list_previous(e_list); l; l = g_list_previous(l))
-  {
-    const dt_iop_order_entry_t *const restrict ep = (dt_iop_order_entry_t *)l->data;
-    if(!strcmp(ep->operation, operation)) return TRUE;
-  }
-  return FALSE;
-}
-
 // returns the nth module's priority being active or not
 int _get_multi_priority(dt_develop_t *dev, const char *operation, const int n, const gboolean only_disabled)
 {
@@ -1134,11 +1200,35 @@ int _get_multi_priority(dt_develop_t *dev, const char *operation, const int n, c
 
 void dt_ioppr_update_for_entries(dt_develop_t *dev, GList *entry_list, gboolean append)
 {
+  // number of entries for each operation
+  GHashTable *entries_count = g_hash_table_new(NULL, NULL);
+  for(const GList *l = entry_list; l; l = g_list_next(l))
+  {
+    const dt_iop_order_entry_t *const restrict ep = (dt_iop_order_entry_t *)l->data;
+    const GQuark op = g_quark_from_string(ep->operation);
+    const int nb = GPOINTER_TO_INT(g_hash_table_lookup(entries_count, GUINT_TO_POINTER(op)));
+    g_hash_table_insert(entries_count, GUINT_TO_POINTER(op), GINT_TO_POINTER(nb + 1));
+  }
+
+  // last instance of each operation in the target iop-order list. the new instances of an operation are
+  // inserted after its last one and it is then handled, so the other links stay valid.
+  GHashTable *last_link = g_hash_table_new(NULL, NULL);
+  for(GList *l = dev->iop_order_list; l; l = g_list_next(l))
+  {
+    const dt_iop_order_entry_t *const restrict e = (dt_iop_order_entry_t *)l->data;
+    g_hash_table_insert(last_link, GUINT_TO_POINTER(g_quark_from_string(e->operation)), l);
+  }
 
   // for each priority list to be checked
   for(GList *e_list = entry_list; e_list; e_list = g_list_next(e_list))
   {
     const dt_iop_order_entry_t *const restrict ep = (dt_iop_order_entry_t *)e_list->data;
+    const GQuark op = g_quark_from_string(ep->operation);
+
+    // look for this operation into the target iop-order list, only once per operation
+    GList *l = (GList *)g_hash_table_lookup(last_link, GUINT_TO_POINTER(op));
+    if(!l) continue;
+    g_hash_table_remove(last_link, GUINT_TO_POINTER(op));
 
     gboolean force_append = FALSE;
 
@@ -1156,73 +1246,68 @@ void dt_ioppr_update_for_entries(dt_develop_t *dev, GList *entry_list, gboolean
     _count_iop_module(dev->iop, ep->operation,
                       &max_multi_priority, &count, &max_multi_priority_enabled, &count_enabled);
 
-    // look for this operation into the target iop-order list and add there as much operation as needed
+    // add there as much operation as needed
+
+    // how many instances of this module in the entry list, and re-number multi-priority accordingly
+    const int new_active_instances = GPOINTER_TO_INT(g_hash_table_lookup(entries_count, GUINT_TO_POINTER(op)));
+
+    int add_count = 0;
+    int start_multi_priority = 0;
+    int nb_replace = 0;
 
-    for(GList *l = g_list_last(dev->iop_order_list); l; l = g_list_previous(l))
+    if(append || force_append)
     {
-      const dt_iop_order_entry_t *const restrict e = (dt_iop_order_entry_t *)l->data;
-      if(!strcmp(e->operation, ep->operation) && !_operation_already_handled(e_list, ep->operation))
-      {
-        // how many instances of this module in the entry list, and re-number multi-priority accordingly
-        const int new_active_instances = _count_entries_operation(entry_list, ep->operation);
+      nb_replace = count - count_enabled;
+      add_count = MAX(0, new_active_instances - nb_replace);
+      start_multi_priority = max_multi_priority + 1;
+    }
+    else
+    {
+      nb_replace = count;
+      add_count = MAX(0, new_active_instances - count);
+      start_multi_priority = max_multi_priority + 1;
+    }
 
-        int add_count = 0;
-        int start_multi_priority = 0;
-        int nb_replace = 0;
+    // update multi_priority to be unique in iop list
+    int multi_priority = start_multi_priority;
+    int nb = 0;
 
-        if(append || force_append)
+    for(const GList *s = entry_list; s; s = g_list_next(s))
+    {
+      dt_iop_order_entry_t *item = (dt_iop_order_entry_t *)s->data;
+      if(!strcmp(item->operation, ep->operation))
+      {
+        nb++;
+        if(nb <= nb_replace)
         {
-          nb_replace = count - count_enabled;
-          add_count = MAX(0, new_active_instances - nb_replace);
-          start_multi_priority = max_multi_priority + 1;
+          // this one replaces current module, get it's multi-priority
+          item->instance = _get_multi_priority(dev, item->operation, nb, append);
         }
         else
         {
-          nb_replace = count;
-          add_count = MAX(0, new_active_instances - count);
-          start_multi_priority = max_multi_priority + 1;
-        }
-
-        // update multi_priority to be unique in iop list
-        int multi_priority = start_multi_priority;
-        int nb = 0;
-
-        for(const GList *s = entry_list; s; s = g_list_next(s))
-        {
-          dt_iop_order_entry_t *item = (dt_iop_order_entry_t *)s->data;
-          if(!strcmp(item->operation, e->operation))
-          {
-            nb++;
-            if(nb <= nb_replace)
-            {
-              // this one replaces current module, get it's multi-priority
-              item->instance = _get_multi_priority(dev, item->operation, nb, append);
-            }
-            else
-            {
-              // otherwise create a new multi-priority
-              item->instance = multi_priority++;
-            }
-          }
+          // otherwise create a new multi-priority
+          item->instance = multi_priority++;
         }
+      }
+    }
 
-        multi_priority = start_multi_priority;
+    multi_priority = start_multi_priority;
 
-        l = g_list_next(l);
+    l = g_list_next(l);
 
-        for(int k = 0; k<add_count; k++)
-        {
-          dt_iop_order_entry_t *n = (dt_iop_order_entry_t *)malloc(sizeof(dt_iop_order_entry_t));
-          g_strlcpy(n->operation, ep->operation, sizeof(n->operation));
-          n->instance = multi_priority++;
-          n->o.iop_order = 0;
-          dev->iop_order_list = g_list_insert_before(dev->iop_order_list, l, n);
-        }
-        break;
-      }
+    for(int k = 0; k<add_count; k++)
+    {
+      dt_iop_order_entry_t *n = (dt_iop_order_entry_t *)malloc(sizeof(dt_iop_order_entry_t));
+      g_strlcpy(n->operation, ep->operation, sizeof(n->operation));
+      n->instance = multi_priority++;
+      n->o.iop_order = 0;
+      dev->iop_order_list = g_list_insert_before(dev->iop_order_list, l, n);
     }
   }
 
+  g_hash_table_destroy(last_link);
+  g_hash_table_destroy(entries_count);
+
   _ioppr_reset_iop_order(dev->iop_order_list);
 
 //  dt_ioppr_print_iop_order(dev->iop_order_list, "upd sitem");
@@ -1250,6 +1335,7 @@ void dt_ioppr_update_for_style_items(dt_develop_t *dev, GList *st_items, gboolea
 
   // write back the multi-priority
 
+  dt_iop_order_index_t *index = dt_ioppr_index_new(dev->iop_order_list);
   GList *el = e_list;
   for(const GList *si_list = st_items; si_list; si_list = g_list_next(si_list))
   {
@@ -1257,9 +1343,10 @@ void dt_ioppr_update_for_style_items(dt_develop_t *dev, GList *st_items, gboolea
     const dt_iop_order_entry_t *const restrict e = (dt_iop_order_entry_t *)el->data;
 
     si->multi_priority = e->instance;
-    si->iop_order = dt_ioppr_get_iop_order(dev->iop_order_list, si->operation, si->multi_priority);
+    si->iop_order = dt_ioppr_index_get_iop_order(index, si->operation, si->multi_priority);
     el = g_list_next(el);
   }
+  dt_ioppr_index_free(index);
 
   g_list_free(e_list);
 }
@@ -1286,6 +1373,7 @@ void dt_ioppr_update_for_modules(dt_develop_t *dev, GList *modules, gboolean app
 
   // write back the multi-priority
 
+  dt_iop_order_index_t *index = dt_ioppr_index_new(dev->iop_order_list);
   GList *el = e_list;
   for(const GList *m_list = modules; m_list; m_list = g_list_next(m_list))
   {
@@ -1293,10 +1381,11 @@ void dt_ioppr_update_for_modules(dt_develop_t *dev, GList *modules, gboolean app
     dt_iop_order_entry_t *e = (dt_iop_order_entry_t *)el->data;
 
     mod->multi_priority = e->instance;
-    mod->iop_order = dt_ioppr_get_iop_order(dev->iop_order_list, mod->op, mod->multi_priority);
+    mod->iop_order = dt_ioppr_index_get_iop_order(index, mod->op, mod->multi_priority);
 
     el = g_list_next(el);
   }
+  dt_ioppr_index_free(index);
 
   g_list_free_full(e_list, free);
 }
@@ -1428,17 +1517,17 @@ int dt_ioppr_check_so_iop_order(GList *iop_list, GList *iop_order_list)
   int iop_order_missing = 0;
 
   // check if all the modules have their iop_order assigned
+  dt_iop_order_index_t *index = dt_ioppr_index_new(iop_order_list);
   for(const GList *modules = iop_list; modules; modules = g_list_next(modules))
   {
     const dt_iop_module_so_t *const restrict mod = (dt_iop_module_so_t *)(modules->data);
-    const dt_iop_order_entry_t *const restrict entry =
-      dt_ioppr_get_iop_order_entry(iop_order_list, mod->op, 0); // mod->multi_priority);
-    if(entry == NULL)
+    if(dt_ioppr_index_get_link(index, mod->op, 0) == NULL) // mod->multi_priority);
     {
       iop_order_missing = 1;
       fprintf(stderr, "[dt_ioppr_check_so_iop_order] missing iop_order for module %s\n", mod->op);
     }
   }
+  dt_ioppr_index_free(index);
 
   return iop_order_missing;
 }
@@ -1827,8 +1916,36 @@ static void _ioppr_check_rules(GList *iop_list, const int imgid, const char *msg
     }
   }
 
-  // for each module check if it doesn't break a rule
-  for(const GList *modules = iop_list; modules; modules = g_list_next(modules))
+  // first and last position of each operation, a rule can only be broken if the first module of its
+  // op_next is before the last module of its op_prev
+  GHashTable *first = g_hash_table_new(NULL, NULL);
+  GHashTable *last = g_hash_table_new(NULL, NULL);
+  int pos = 1;
+  for(const GList *modules = iop_list; modules; modules = g_list_next(modules), pos++)
+  {
+    const dt_iop_module_t *const restrict mod = (dt_iop_module_t *)modules->data;
+    const gpointer op = GUINT_TO_POINTER(g_quark_from_string(mod->op));
+    if(!g_hash_table_contains(first, op)) g_hash_table_insert(first, op, GINT_TO_POINTER(pos));
+    g_hash_table_insert(last, op, GINT_TO_POINTER(pos));
+  }
+
+  GList *broken_rules = NULL;
+  for(const GList *rules = darktable.iop_order_rules; rules; rules = g_list_next(rules))
+  {
+    const dt_iop_order_rule_t *const restrict rule = (dt_iop_order_rule_t *)rules->data;
+    const GQuark op_next = g_quark_try_string(rule->op_next);
+    const GQuark op_prev = g_quark_try_string(rule->op_prev);
+    const int first_next = GPOINTER_TO_INT(g_hash_table_lookup(first, GUINT_TO_POINTER(op_next)));
+    const int last_prev = GPOINTER_TO_INT(g_hash_table_lookup(last, GUINT_TO_POINTER(op_prev)));
+    if(first_next && last_prev && first_next < last_prev)
+      broken_rules = g_list_prepend(broken_rules, (gpointer)rule);
+  }
+  broken_rules = g_list_reverse(broken_rules);
+  g_hash_table_destroy(first);
+  g_hash_table_destroy(last);
+
+  // for each module check if it doesn't break one of these rules
+  for(const GList *modules = broken_rules ? iop_list : NULL; modules; modules = g_list_next(modules))
   {
     const dt_iop_module_t *const restrict mod = (dt_iop_module_t *)modules->data;
     if(mod->iop_order == INT_MAX)
@@ -1837,7 +1954,7 @@ static void _ioppr_check_rules(GList *iop_list, const int imgid, const char *msg
     }
 
     // we have a module, now check each rule
-    for(const GList *rules = darktable.iop_order_rules; rules; rules = g_list_next(rules))
+    for(const GList *rules = broken_rules; rules; rules = g_list_next(rules))
     {
       const dt_iop_order_rule_t *const restrict rule = (dt_iop_order_rule_t *)rules->data;
 
@@ -1878,6 +1995,7 @@ static void _ioppr_check_rules(GList *iop_list, const int imgid, const char *msg
     }
   }
 
+  g_list_free(broken_rules);
   if(fences) g_list_free(fences);
 }
 
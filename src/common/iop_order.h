@@ -172,7 +172,8 @@ gboolean dt_ioppr_has_iop_order_list(int32_t imgid);
 GList *dt_ioppr_get_iop_order_list(int32_t imgid, gboolean sorted);
 /** return the iop-order list for the given version, this is used to get the built-in lists */
 GList *dt_ioppr_get_iop_order_list_version(dt_iop_order_t version);
-/** returns the dt_iop_order_entry_t of iop_order_list with operation = op_name */
+/** returns the dt_iop_order_entry_t of iop_order_list with operation = op_name. this and the lookups below walk
+    the list, which is cheaper than building an index for a single lookup. loops use dt_ioppr_index_new(). */
 dt_iop_order_entry_t *dt_ioppr_get_iop_order_entry(GList *iop_order_list, const char *op_name, const int multi_priority);
 /** likewise, but returns the link in the list instead of the entry */
 GList *dt_ioppr_get_iop_order_link(GList *iop_order_list, const char *op_name, const int multi_priority);
@@ -184,6 +185,16 @@ int dt_ioppr_get_iop_order(GList *iop_order_list, const char *op_name, const int
 /** returns TRUE if operation/multi-priority is before base_operation (first in pipe) on the iop-list */
 gboolean dt_ioppr_is_iop_before(GList *iop_order_list, const char *base_operation,
                                 const char *operation, const int multi_priority);
+
+/** lookup index of an iop-order list, for the loops doing many lookups on the same list: the operations are
+    interned and each operation/multi-priority is hashed to its position in the list. the index refers to the
+    links of the list, it stays valid when the iop_order are reset but not when entries are added or removed. */
+typedef struct dt_iop_order_index_t dt_iop_order_index_t;
+dt_iop_order_index_t *dt_ioppr_index_new(GList *iop_order_list);
+void dt_ioppr_index_free(dt_iop_order_index_t *index);
+/** as dt_ioppr_get_iop_order_link() and dt_ioppr_get_iop_order() but in constant time */
+GList *dt_ioppr_index_get_link(const dt_iop_order_index_t *index, const char *op_name, const int multi_priority);
+int dt_ioppr_index_get_iop_order(const dt_iop_order_index_t *index, const char *op_name, const int multi_priority);
 /* write iop-order list for the given image */
 gboolean dt_ioppr_write_iop_order_list(GList *iop_order_list, const int32_t imgid);
 gboolean dt_ioppr_write_iop_order(const dt_iop_order_t kind, GList *iop_order_list, const int32_t imgid);
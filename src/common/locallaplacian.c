@@ -33,6 +33,8 @@
 #define max_levels 30
 // the number of segments for the piecewise linear interpolation
 #define num_gamma 6
+// the number of segments for the fast variant, which remaps from the second level on
+#define num_gamma_fast 4
 
 //#define DEBUG_DUMP
 
@@ -560,6 +562,56 @@ void apply_curve(
   pad_by_replication(out, w, h, padding);
 }
 
+static inline void ll_gauss_reduce(
+    const float *const input,
+    float *const coarse,
+    const int wd,
+    const int ht,
+    const int use_sse2)
+{
+#if defined(__SSE2__)
+  if(use_sse2)
+    gauss_reduce_sse2(input, coarse, wd, ht);
+  else
+#endif
+    gauss_reduce(input, coarse, wd, ht);
+}
+
+static inline void ll_apply_curve(
+    float *const out,
+    const float *const in,
+    const uint32_t w,
+    const uint32_t h,
+    const uint32_t padding,
+    const float g,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity,
+    const int use_sse2)
+{
+#if defined(__SSE2__)
+  if(use_sse2)
+    apply_curve_sse2(out, in, w, h, padding, g, sigma, shadows, highlights, clarity);
+  else
+#endif
+    apply_curve(out, in, w, h, padding, g, sigma, shadows, highlights, clarity);
+}
+
+// weight of the gamma sample k in the piecewise linear interpolation at brightness v
+static inline float ll_gamma_weight(
+    const float v,
+    const float *const gamma,
+    const int ng,
+    const int k)
+{
+  int hi = 1;
+  for(;hi<ng-1 && gamma[hi] <= v;hi++);
+  const int lo = hi-1;
+  const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+  return k == lo ? 1.0f - a : (k == hi ? a : 0.0f);
+}
+
 void local_laplacian_internal(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -570,6 +622,7 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     const int use_sse2,         // flag whether to use SSE version
+    const int fast,             // flag whether to use the reduced pyramid variant
     local_laplacian_boundary_t *b)
 {
   if(wd <= 1 || ht <= 1) return;
@@ -580,6 +633,9 @@ void local_laplacian_internal(
   if(b && b->mode == 2) // higher number here makes it less prone to aliasing and slower.
     last_level = num_levels > 4 ? 4 : num_levels-1;
   const int max_supp = 1<<last_level;
+  // the fast variant remaps the pyramids from the second level on, and needs two levels below it
+  const int reduced = fast && last_level >= 2;
+  const int ng = reduced ? num_gamma_fast : num_gamma;
   int w, h;
   float *padded[max_levels] = {0};
   if(b && b->mode == 2)
@@ -597,51 +653,89 @@ void local_laplacian_internal(
     output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
 
   // create gauss pyramid of padded input, write coarse directly to output
-#if defined(__SSE2__)
-  if(use_sse2)
-  {
-    for(int l=1;l<last_level;l++)
-      gauss_reduce_sse2(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce_sse2(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
-  }
-  else
-#endif
-  {
-    for(int l=1;l<last_level;l++)
-      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
-  }
+  for(int l=1;l<last_level;l++)
+    ll_gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1), use_sse2);
+  ll_gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1), use_sse2);
 
   // evenly sample brightness [0,1]:
   float gamma[num_gamma] = {0.0f};
-  for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
+  for(int k=0;k<ng;k++) gamma[k] = (k+.5f)/(float)ng;
   // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
 
-  // allocate memory for intermediate laplacian pyramids
+  // memory for intermediate laplacian pyramids
   float *buf[num_gamma][max_levels] = {{0}};
-  for(int k=0;k<num_gamma;k++) for(int l=0;l<=last_level;l++)
-    buf[k][l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
-
-  // the paper says remapping only level 3 not 0 does the trick, too
-  // (but i really like the additional octave of sharpness we get,
-  // willing to pay the cost).
-  for(int k=0;k<num_gamma;k++)
-  { // process images
-#if defined(__SSE2__)
-    if(use_sse2)
-      apply_curve_sse2(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
-    else // brackets in next line needed for silly gcc warning:
+
+  if(!reduced)
+  {
+    for(int k=0;k<num_gamma;k++) for(int l=0;l<=last_level;l++)
+      buf[k][l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
+
+    // the paper says remapping only level 3 not 0 does the trick, too
+    // (but i really like the additional octave of sharpness we get,
+    // willing to pay the cost).
+    for(int k=0;k<num_gamma;k++)
+    { // process images
+      ll_apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity,
+                     use_sse2);
+
+      // create gaussian pyramids
+      for(int l=1;l<=last_level;l++)
+        ll_gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1), use_sse2);
+    }
+  }
+  else
+  {
+    // the finest octave is not remapped: we keep the details of the input, amplified by the
+    // slope of the curve around the pixel brightness, which is 1+clarity.
+    const float gain = 1.0f + clarity;
+    float *const out0 = output[0];
+    const float *const fine = padded[0];
+    const float *const coarse = padded[1];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(w, h, gain, out0, fine, coarse) \
+    schedule(static) \
+    collapse(2)
 #endif
-    {apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);}
+    for(int j=0;j<h;j++) for(int i=0;i<w;i++)
+      out0[j*w+i] = gain * ll_laplacian(coarse, fine, i, j, w, h);
+    for(int l=1;l<last_level;l++)
+      memset(output[l], 0, sizeof(float) * dl(w,l) * dl(h,l));
 
-    // create gaussian pyramids
+    // only one remapped pyramid is alive at a time, its laplacian coefficients are accumulated
+    // into the output pyramid with the interpolation weight of its gamma sample.
     for(int l=1;l<=last_level;l++)
-#if defined(__SSE2__)
-      if(use_sse2)
-        gauss_reduce_sse2(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
-      else
+      buf[0][l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
+    float **const pyr = buf[0];
+
+    for(int k=0;k<ng;k++)
+    {
+      ll_apply_curve(pyr[1], padded[1], dl(w,1), dl(h,1), max_supp/2, gamma[k], sigma, shadows, highlights,
+                     clarity, use_sse2);
+      for(int l=2;l<=last_level;l++)
+        ll_gauss_reduce(pyr[l-1], pyr[l], dl(w,l-1), dl(h,l-1), use_sse2);
+
+      for(int l=1;l<last_level;l++)
+      {
+        const int pw = dl(w,l), ph = dl(h,l);
+        float *const outl = output[l];
+        const float *const vl = padded[l];
+        const float *const fl = pyr[l];
+        const float *const cl = pyr[l+1];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+        dt_omp_firstprivate(pw, ph, outl, vl, fl, cl, k, ng) \
+        shared(gamma) \
+        schedule(static) \
+        collapse(2)
 #endif
-        gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+        for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
+        {
+          const float wk = ll_gamma_weight(vl[j*pw+i], gamma, ng, k);
+          if(wk > 0.0f) outl[j*pw+i] += wk * ll_laplacian(cl, fl, i, j, pw, ph);
+        }
+      }
+    }
   }
 
   // resample output[last_level] from preview
@@ -703,7 +797,26 @@ void local_laplacian_internal(
   }
 
   // assemble output pyramid coarse to fine
-  for(int l=last_level-1;l >= 0; l--)
+  if(reduced)
+  {
+    // the laplacian coefficients are already in place, add the upsampled coarser level
+    for(int l=last_level-1;l >= 0; l--)
+    {
+      const int pw = dl(w,l), ph = dl(h,l);
+      float *const outl = output[l];
+      const float *const coarse = output[l+1];
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+      dt_omp_firstprivate(pw, ph, outl, coarse) \
+      schedule(static) \
+      collapse(2)
+#endif
+      for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
+        outl[j*pw+i] += ll_expand_gaussian(coarse,
+            CLAMPS(i, 1, ((pw-1)&~1)-1), CLAMPS(j, 1, ((ph-1)&~1)-1), pw, ph);
+    }
+  }
+  else for(int l=last_level-1;l >= 0; l--)
   {
     const int pw = dl(w,l), ph = dl(h,l);
 
@@ -782,6 +895,24 @@ size_t local_laplacian_memory_use(const int width,     // width of input image
   return memory_use;
 }
 
+size_t local_laplacian_fast_memory_use(const int width,     // width of input image
+                                       const int height)    // height of input image
+{
+  const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
+  if(num_levels < 3) return local_laplacian_memory_use(width, height);
+  const int max_supp = 1<<(num_levels-1);
+  const int paddwd = width  + 2*max_supp;
+  const int paddht = height + 2*max_supp;
+
+  // padded input and output pyramids, plus one remapped pyramid from the second level on
+  size_t memory_use = 0;
+
+  for(int l=0;l<num_levels;l++)
+    memory_use += sizeof(float) * (l ? 3 : 2) * dl(paddwd, l) * dl(paddht, l);
+
+  return memory_use;
+}
+
 size_t local_laplacian_singlebuffer_size(const int width,     // width of input image
                                          const int height)    // height of input image
 {
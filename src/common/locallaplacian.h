@@ -55,6 +55,7 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     const int use_sse2,         // switch on sse optimised version, if available
+    const int fast,             // use the reduced pyramid variant: fewer gamma samples, finest level not remapped
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
     local_laplacian_boundary_t *b);
 
@@ -69,12 +70,31 @@ void local_laplacian(
     const float clarity,        // user param: increase clarity/local contrast
     local_laplacian_boundary_t *b) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, 0, b);
+}
+
+// faster variant using about a third of the memory, at the cost of a slight loss of accuracy
+// on the finest details. see src/tests/unittests/common/test_locallaplacian.c for a comparison.
+void local_laplacian_fast(
+    const float *const input,   // input buffer in some Labx or yuvx format
+    float *const out,           // output buffer with colour
+    const int wd,               // width and
+    const int ht,               // height of the input buffer
+    const float sigma,          // user param: separate shadows/mid-tones/highlights
+    const float shadows,        // user param: lift shadows
+    const float highlights,     // user param: compress highlights
+    const float clarity,        // user param: increase clarity/local contrast
+    local_laplacian_boundary_t *b) // can be 0
+{
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, 1, b);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
                                   const int height);    // height of input image
 
+size_t local_laplacian_fast_memory_use(const int width,      // width of input image
+                                       const int height);    // height of input image
+
 
 size_t local_laplacian_singlebuffer_size(const int width,       // width of input image
                                          const int height);     // height of input image
@@ -92,6 +112,20 @@ void local_laplacian_sse2(
     const float clarity,        // user param: increase clarity/local contrast
     local_laplacian_boundary_t *b) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, 0, b);
+}
+
+void local_laplacian_fast_sse2(
+    const float *const input,   // input buffer in some Labx or yuvx format
+    float *const out,           // output buffer with colour
+    const int wd,               // width and
+    const int ht,               // height of the input buffer
+    const float sigma,          // user param: separate shadows/mid-tones/highlights
+    const float shadows,        // user param: lift shadows
+    const float highlights,     // user param: compress highlights
+    const float clarity,        // user param: increase clarity/local contrast
+    local_laplacian_boundary_t *b) // can be 0
+{
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, 1, b);
 }
 #endif
@@ -0,0 +1,369 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/prefetch.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+#include "control/conf.h"
+#include "control/control.h"
+#include "control/jobs.h"
+
+// a failed rendering is tried again that many times before giving up until the next invalidation
+#define PREFETCH_MAX_TRIES 3
+
+typedef struct dt_prefetch_t
+{
+  dt_pthread_mutex_t lock;
+
+  dt_prefetch_render_t render;
+  dt_prefetch_evict_t evict;
+  void *user_data;
+
+  // parameters of the renderings, copied to the render callback
+  void *params;
+  size_t params_size;
+
+  // what is shown and where we are going
+  int32_t first, last, min, max;
+  int direction;
+
+  // window and budget
+  int ahead, behind;
+  size_t budget;
+
+  GHashTable *done;   // rank -> size of the rendering in bytes
+  GHashTable *busy;   // ranks being rendered
+  GHashTable *failed; // rank -> number of failed renderings
+  size_t used;
+  int epoch;          // incremented when all renderings are invalidated
+
+  gboolean running[2]; // the job for the shown images / the others is queued or running
+  gboolean shutdown;
+  int refs;            // the owner and the queued jobs, the last one frees the prefetcher
+} dt_prefetch_t;
+
+static gboolean _in_window(const dt_prefetch_t *p, const int32_t rank)
+{
+  if(rank < p->min || rank > p->max) return FALSE;
+  const int32_t from = p->first - (p->direction >= 0 ? p->behind : p->ahead);
+  const int32_t to = p->last + (p->direction >= 0 ? p->ahead : p->behind);
+  return rank >= from && rank <= to;
+}
+
+static gboolean _todo(const dt_prefetch_t *p, const int32_t rank)
+{
+  return !g_hash_table_contains(p->done, GINT_TO_POINTER(rank))
+         && !g_hash_table_contains(p->busy, GINT_TO_POINTER(rank))
+         && GPOINTER_TO_INT(g_hash_table_lookup(p->failed, GINT_TO_POINTER(rank))) < PREFETCH_MAX_TRIES;
+}
+
+// next rank to render, the shown ones if shown is set, ahead then behind otherwise, -1 if none.
+// to be called with the lock.
+static int32_t _next_rank(const dt_prefetch_t *p, const gboolean shown)
+{
+  if(shown)
+  {
+    for(int32_t rank = p->first; rank <= p->last; rank++)
+      if(rank >= p->min && rank <= p->max && _todo(p, rank)) return rank;
+    return -1;
+  }
+
+  const guint n = g_hash_table_size(p->done);
+  const size_t estimate = n ? p->used / n : 0;
+
+  const int step = p->direction >= 0 ? 1 : -1;
+  const int32_t ahead_from = p->direction >= 0 ? p->last : p->first;
+  const int32_t behind_from = p->direction >= 0 ? p->first : p->last;
+
+  for(int pass = 0; pass < 2; pass++)
+  {
+    const int count = pass ? p->behind : p->ahead;
+    const int32_t from = pass ? behind_from : ahead_from;
+    const int dir = pass ? -step : step;
+    for(int k = 1; k <= count; k++)
+    {
+      const int32_t rank = from + dir * k;
+      if(rank < p->min || rank > p->max) break;
+      if(!_todo(p, rank)) continue;
+      // out of budget, the closest ones are already there
+      if(p->used + estimate > p->budget) return -1;
+      return rank;
+    }
+  }
+  return -1;
+}
+
+// evict the ranks out of the window, returns the list of evicted ranks for the callback.
+// to be called with the lock.
+static GList *_evict_outside(dt_prefetch_t *p, const gboolean all)
+{
+  GList *evicted = NULL;
+  GHashTableIter it;
+  gpointer key, value;
+  g_hash_table_iter_init(&it, p->done);
+  while(g_hash_table_iter_next(&it, &key, &value))
+  {
+    const int32_t rank = GPOINTER_TO_INT(key);
+    if(all || !_in_window(p, rank))
+    {
+      p->used -= GPOINTER_TO_SIZE(value);
+      evicted = g_list_prepend(evicted, GINT_TO_POINTER(rank));
+      g_hash_table_iter_remove(&it);
+    }
+  }
+
+  // the failures are forgotten when leaving the window, a later visit tries again
+  g_hash_table_iter_init(&it, p->failed);
+  while(g_hash_table_iter_next(&it, &key, &value))
+    if(all || !_in_window(p, GPOINTER_TO_INT(key))) g_hash_table_iter_remove(&it);
+
+  return evicted;
+}
+
+static void _call_evict(dt_prefetch_t *p, GList *evicted)
+{
+  if(p->evict)
+    for(GList *l = evicted; l; l = g_list_next(l)) p->evict(GPOINTER_TO_INT(l->data), p->user_data);
+  g_list_free(evicted);
+}
+
+static void _start(dt_prefetch_t *p, const gboolean shown);
+
+// render one image and queue the job again, so that the background queue is never held by the prefetcher
+static int32_t _prefetch_job_run(dt_prefetch_t *p, const gboolean shown)
+{
+  dt_pthread_mutex_lock(&p->lock);
+  const int32_t rank = p->shutdown ? -1 : _next_rank(p, shown);
+  if(rank < 0)
+  {
+    p->running[shown] = FALSE;
+    dt_pthread_mutex_unlock(&p->lock);
+    return 0;
+  }
+  const int epoch = p->epoch;
+  g_hash_table_add(p->busy, GINT_TO_POINTER(rank));
+  void *params = p->params_size ? g_malloc(p->params_size) : NULL;
+  if(params) memcpy(params, p->params, p->params_size);
+  dt_pthread_mutex_unlock(&p->lock);
+
+  const int64_t size = p->render(rank, params, p->user_data);
+  g_free(params);
+
+  // the rank stays busy until the callbacks are done, dt_prefetch_free() waits for it
+  dt_pthread_mutex_lock(&p->lock);
+  GList *evicted = NULL;
+  if(size < 0)
+  {
+    if(epoch == p->epoch && _in_window(p, rank))
+    {
+      const int tries = GPOINTER_TO_INT(g_hash_table_lookup(p->failed, GINT_TO_POINTER(rank)));
+      g_hash_table_insert(p->failed, GINT_TO_POINTER(rank), GINT_TO_POINTER(tries + 1));
+    }
+  }
+  else if(epoch != p->epoch || !_in_window(p, rank))
+  {
+    // the user jumped away while we were rendering
+    evicted = g_list_prepend(evicted, GINT_TO_POINTER(rank));
+  }
+  else
+  {
+    g_hash_table_insert(p->done, GINT_TO_POINTER(rank), GSIZE_TO_POINTER((size_t)size));
+    g_hash_table_remove(p->failed, GINT_TO_POINTER(rank));
+    p->used += size;
+  }
+  dt_pthread_mutex_unlock(&p->lock);
+
+  _call_evict(p, evicted);
+
+  dt_pthread_mutex_lock(&p->lock);
+  g_hash_table_remove(p->busy, GINT_TO_POINTER(rank));
+  // the shown images may have changed while we were rendering
+  const gboolean start_shown = !shown && !p->running[TRUE] && !p->shutdown && _next_rank(p, TRUE) >= 0;
+  if(start_shown) p->running[TRUE] = TRUE;
+  // no follow-up once the owner is gone
+  const gboolean again = !p->shutdown;
+  if(!again) p->running[shown] = FALSE;
+  dt_pthread_mutex_unlock(&p->lock);
+
+  if(start_shown) _start(p, TRUE);
+  if(again) _start(p, shown);
+  return 0;
+}
+
+static int32_t _prefetch_job_run_shown(dt_job_t *job)
+{
+  return _prefetch_job_run(dt_control_job_get_params(job), TRUE);
+}
+
+static int32_t _prefetch_job_run_around(dt_job_t *job)
+{
+  return _prefetch_job_run(dt_control_job_get_params(job), FALSE);
+}
+
+// mark the jobs as running, returns for each job if it has to be started. to be called with the lock.
+static void _need_start(dt_prefetch_t *p, gboolean start[2])
+{
+  for(int shown = 0; shown < 2; shown++)
+  {
+    start[shown] = !p->running[shown] && !p->shutdown;
+    if(start[shown]) p->running[shown] = TRUE;
+  }
+}
+
+static void _unref(void *data)
+{
+  dt_prefetch_t *p = (dt_prefetch_t *)data;
+  dt_pthread_mutex_lock(&p->lock);
+  const gboolean last = --p->refs == 0;
+  dt_pthread_mutex_unlock(&p->lock);
+  if(!last) return;
+
+  g_hash_table_destroy(p->done);
+  g_hash_table_destroy(p->busy);
+  g_hash_table_destroy(p->failed);
+  g_free(p->params);
+  dt_pthread_mutex_destroy(&p->lock);
+  free(p);
+}
+
+// to be called without the lock with running set. nothing is queued once the control is stopped, the job
+// would run synchronously in the caller.
+static void _start(dt_prefetch_t *p, const gboolean shown)
+{
+  dt_job_t *job = dt_control_running()
+                      ? dt_control_job_create(shown ? &_prefetch_job_run_shown : &_prefetch_job_run_around,
+                                              "prefetch images")
+                      : NULL;
+  if(job)
+  {
+    // a queued job keeps the prefetcher alive, it's released when the job is disposed, run or not
+    dt_pthread_mutex_lock(&p->lock);
+    p->refs++;
+    dt_pthread_mutex_unlock(&p->lock);
+    dt_control_job_set_params(job, p, _unref);
+    if(!dt_control_add_job(darktable.control, shown ? DT_JOB_QUEUE_USER_FG : DT_JOB_QUEUE_USER_BG, job))
+      return;
+  }
+
+  dt_pthread_mutex_lock(&p->lock);
+  p->running[shown] = FALSE;
+  dt_pthread_mutex_unlock(&p->lock);
+}
+
+dt_prefetch_t *dt_prefetch_new(dt_prefetch_render_t render, dt_prefetch_evict_t evict, void *user_data,
+                               const void *params, size_t params_size)
+{
+  dt_prefetch_t *p = (dt_prefetch_t *)calloc(1, sizeof(dt_prefetch_t));
+  dt_pthread_mutex_init(&p->lock, NULL);
+  p->render = render;
+  p->evict = evict;
+  p->user_data = user_data;
+  p->params_size = params ? params_size : 0;
+  p->params = p->params_size ? g_malloc(p->params_size) : NULL;
+  if(p->params) memcpy(p->params, params, p->params_size);
+  p->done = g_hash_table_new(NULL, NULL);
+  p->busy = g_hash_table_new(NULL, NULL);
+  p->failed = g_hash_table_new(NULL, NULL);
+  p->ahead = MAX(dt_conf_get_int("ui/prefetch/ahead"), 0);
+  p->behind = MAX(dt_conf_get_int("ui/prefetch/behind"), 0);
+  p->budget = (size_t)MAX(dt_conf_get_int("ui/prefetch/memory"), 0) << 20;
+  p->first = p->last = -1;
+  p->min = 0;
+  p->max = -1;
+  p->direction = 1;
+  p->refs = 1;
+  return p;
+}
+
+void dt_prefetch_free(dt_prefetch_t *p)
+{
+  if(!p) return;
+
+  // the queued jobs do nothing from now on, they only release the prefetcher when they are disposed
+  dt_pthread_mutex_lock(&p->lock);
+  p->shutdown = TRUE;
+  dt_pthread_mutex_unlock(&p->lock);
+
+  // the renderings in progress can't be interrupted, wait for them as they use the callbacks
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&p->lock);
+    const gboolean rendering = g_hash_table_size(p->busy) > 0;
+    GList *evicted = rendering ? NULL : _evict_outside(p, TRUE);
+    dt_pthread_mutex_unlock(&p->lock);
+    if(!rendering)
+    {
+      _call_evict(p, evicted);
+      break;
+    }
+    g_usleep(10000);
+  }
+
+  _unref(p);
+}
+
+void dt_prefetch_set_position(dt_prefetch_t *p, int32_t first, int32_t last, int32_t min, int32_t max)
+{
+  dt_pthread_mutex_lock(&p->lock);
+
+  if(first > p->first)
+    p->direction = 1;
+  else if(first < p->first)
+    p->direction = -1;
+
+  p->first = first;
+  p->last = MAX(first, last);
+  p->min = min;
+  p->max = max;
+
+  GList *evicted = _evict_outside(p, FALSE);
+  gboolean start[2];
+  _need_start(p, start);
+  dt_pthread_mutex_unlock(&p->lock);
+
+  _call_evict(p, evicted);
+  if(start[TRUE]) _start(p, TRUE);
+  if(start[FALSE]) _start(p, FALSE);
+}
+
+void dt_prefetch_invalidate(dt_prefetch_t *p, const void *params)
+{
+  dt_pthread_mutex_lock(&p->lock);
+  p->epoch++;
+  if(params && p->params_size) memcpy(p->params, params, p->params_size);
+  GList *evicted = _evict_outside(p, TRUE);
+  gboolean start[2];
+  _need_start(p, start);
+  dt_pthread_mutex_unlock(&p->lock);
+
+  _call_evict(p, evicted);
+  if(start[TRUE]) _start(p, TRUE);
+  if(start[FALSE]) _start(p, FALSE);
+}
+
+gboolean dt_prefetch_is_ready(dt_prefetch_t *p, int32_t rank)
+{
+  dt_pthread_mutex_lock(&p->lock);
+  const gboolean ready = g_hash_table_contains(p->done, GINT_TO_POINTER(rank));
+  dt_pthread_mutex_unlock(&p->lock);
+  return ready;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,67 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <inttypes.h>
+
+/*
+  Prefetch of the images around the ones currently shown by a view (slideshow, culling).
+
+  The view tells where it is in its list of images, the prefetcher renders in a background job a window of
+  images ahead in the direction of travel and a smaller one behind, the closest first, within a memory
+  budget. What a rendering is and where it is stored is up to the view through the render callback. When
+  the view moves, the images leaving the window are handed back to the evict callback and the queued
+  renderings are replanned, so a jump never waits for stale renderings. The shown images are rendered by a
+  job of the foreground queue, the others one per job in the background queue so that they never hold it.
+
+  The parameters of the renderings (sizes, ...) are given to the prefetcher which hands a copy of them to the
+  render callback, changing them invalidates all renderings. A failed rendering is tried again a few times.
+
+  The window and budget are set by ui/prefetch/ahead, ui/prefetch/behind and ui/prefetch/memory (MB).
+*/
+
+struct dt_prefetch_t;
+
+/** render the image at rank with the given copy of the parameters, returns the memory used by the result in
+    bytes, or a negative value on failure. called from a background job, without any lock held. */
+typedef int64_t (*dt_prefetch_render_t)(int32_t rank, const void *params, void *user_data);
+/** the image at rank left the window, its rendering can be freed. may be NULL. */
+typedef void (*dt_prefetch_evict_t)(int32_t rank, void *user_data);
+
+/** params (params_size bytes, may be NULL/0) are copied */
+struct dt_prefetch_t *dt_prefetch_new(dt_prefetch_render_t render, dt_prefetch_evict_t evict, void *user_data,
+                                      const void *params, size_t params_size);
+/** wait for the renderings in progress, evict everything and free the prefetcher. the queued jobs are left to
+    the control, which disposes of them. to be called while the control is running (e.g. when leaving the
+    view), jobs queued when the workers are stopped would never run. */
+void dt_prefetch_free(struct dt_prefetch_t *prefetch);
+
+/** the view shows ranks first..last out of min..max. must not be called with a lock the callbacks take. */
+void dt_prefetch_set_position(struct dt_prefetch_t *prefetch, int32_t first, int32_t last, int32_t min,
+                              int32_t max);
+/** forget all renderings (e.g. the display size changed), they are evicted and rendered again with params
+    if not NULL, the current parameters otherwise */
+void dt_prefetch_invalidate(struct dt_prefetch_t *prefetch, const void *params);
+/** is the image at rank rendered ? */
+gboolean dt_prefetch_is_ready(struct dt_prefetch_t *prefetch, int32_t rank);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -592,71 +592,251 @@ gboolean dt_styles_create_from_image(const char *name, const char *description,
   return FALSE;
 }
 
-void dt_styles_apply_to_list(const char *name, const GList *list, gboolean duplicate)
+// the items of the style, in the order they are applied
+static GList *_styles_get_items_to_apply(const int id)
 {
-  gboolean selected = FALSE;
+  sqlite3_stmt *stmt;
 
-  /* write current history changes so nothing gets lost,
-     do that only in the darkroom as there is nothing to be saved
-     when in the lighttable (and it would write over current history stack) */
-  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
-  if(cv->view(cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT num, module, operation, op_params, enabled,"
+                              "  blendop_params, blendop_version, multi_priority, multi_name"
+                              " FROM data.style_items WHERE styleid=?1 "
+                              " ORDER BY operation, multi_priority",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+  GList *si_list = NULL;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_style_item_t *style_item = (dt_style_item_t *)malloc(sizeof(dt_style_item_t));
+
+    style_item->num = sqlite3_column_int(stmt, 0);
+    style_item->selimg_num = 0;
+    style_item->enabled = sqlite3_column_int(stmt, 4);
+    style_item->multi_priority = sqlite3_column_int(stmt, 7);
+    style_item->name = NULL;
+    style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
+    style_item->multi_name = g_strdup((char *)sqlite3_column_text(stmt, 8));
+    style_item->module_version = sqlite3_column_int(stmt, 1);
+    style_item->blendop_version = sqlite3_column_int(stmt, 6);
+    style_item->params_size = sqlite3_column_bytes(stmt, 3);
+    style_item->params = (void *)malloc(style_item->params_size);
+    memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3), style_item->params_size);
+    style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
+    style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
+    memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5), style_item->blendop_params_size);
+    style_item->iop_order = 0;
+
+    si_list = g_list_prepend(si_list, style_item);
+  }
+  sqlite3_finalize(stmt);
+  si_list = g_list_reverse(si_list);  // list was built in reverse order, so un-reverse it
+
+  return si_list;
+}
 
-  const int mode = dt_conf_get_int("plugins/lighttable/style/applymode");
-  const gboolean is_overwrite = (mode == DT_STYLE_HISTORY_OVERWRITE);
+// the module order of the style with the multi-instances of the image
+static void _styles_write_iop_order(GList *style_iop_list, const int32_t imgid)
+{
+  GList *iop_list = dt_ioppr_iop_order_copy_deep(style_iop_list);
+  // the style has an iop-order, we need to merge the multi-instance from target image
+  // get target image iop-order list:
+  GList *img_iop_order_list = dt_ioppr_get_iop_order_list(imgid, FALSE);
+  // get multi-instance modules if any:
+  GList *mi = dt_ioppr_extract_multi_instances_list(img_iop_order_list);
+  // if some where found merge them with the style list
+  if(mi) iop_list = dt_ioppr_merge_multi_instance_iop_order_list(iop_list, mi);
+  // finally we have the final list for the image
+  dt_ioppr_write_iop_order_list(iop_list, imgid);
+  g_list_free_full(iop_list, g_free);
+  g_list_free_full(img_iop_order_list, g_free);
+}
 
-  /* for each selected image apply style */
-  dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
+// a style to apply onto a list of images, read once
+typedef struct _styles_batch_style_t
+{
+  gchar *name;
+  GList *items;
+  int *multi_priority; // of the items as read, changed by each image
+  GList *iop_list;
+} _styles_batch_style_t;
 
-  dt_undo_lt_history_t *hist = NULL;
+typedef struct _styles_batch_t
+{
+  GList *styles; // _styles_batch_style_t
+  gboolean duplicate;
+  gboolean overwrite;
+} _styles_batch_t;
 
-  for(const GList *l = list; l; l = g_list_next(l))
+static void _styles_batch_free(gpointer user_data)
+{
+  _styles_batch_t *b = (_styles_batch_t *)user_data;
+  for(GList *l = b->styles; l; l = g_list_next(l))
   {
-    const int32_t imgid = GPOINTER_TO_INT(l->data);
-    if(is_overwrite)
-    {
-      hist = dt_history_snapshot_item_init();
-      hist->imgid = imgid;
-      dt_history_snapshot_undo_create(hist->imgid, &hist->before, &hist->before_history_end);
+    _styles_batch_style_t *style = (_styles_batch_style_t *)l->data;
+    g_free(style->name);
+    g_list_free_full(style->items, dt_style_item_free);
+    free(style->multi_priority);
+    g_list_free_full(style->iop_list, g_free);
+    free(style);
+  }
+  g_list_free(b->styles);
+  free(b);
+}
 
-      dt_undo_disable_next(darktable.undo);
-      if(!duplicate) dt_history_delete_on_image_ext(imgid, FALSE);
-    }
+static int32_t _styles_batch_target(const int32_t imgid, gpointer user_data)
+{
+  const _styles_batch_t *b = (_styles_batch_t *)user_data;
+  if(!b->duplicate) return imgid;
+
+  /* make a duplicate before applying style */
+  const int32_t newimgid = dt_image_duplicate(imgid);
+  if(newimgid != -1)
+  {
+    if(b->overwrite)
+      dt_history_delete_on_image_ext(newimgid, FALSE);
+    else
+      dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL, TRUE, TRUE);
+  }
+  return newimgid;
+}
 
-    dt_styles_apply_to_image(name, duplicate, is_overwrite, imgid);
+static gboolean _styles_batch_prepare(dt_develop_t *dev, const int32_t imgid, gpointer user_data)
+{
+  const _styles_batch_t *b = (_styles_batch_t *)user_data;
 
-    if(is_overwrite)
-    {
-      dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
-      dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
-                     dt_history_snapshot_undo_pop, dt_history_snapshot_undo_lt_history_data_free);
-    }
+  if(b->overwrite && !b->duplicate) dt_history_delete_on_image_ext(imgid, FALSE);
 
-    selected = TRUE;
+  for(const GList *l = b->styles; l; l = g_list_next(l))
+  {
+    const _styles_batch_style_t *style = (_styles_batch_style_t *)l->data;
+    if(style->iop_list) _styles_write_iop_order(style->iop_list, imgid);
   }
 
-  dt_undo_end_group(darktable.undo);
+  dt_dev_read_history_ext(dev, imgid, TRUE);
 
-  DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_TAG_CHANGED);
+  dt_ioppr_check_iop_order(dev, imgid, "_styles_batch_prepare ");
 
-  if(!selected)
+  dt_dev_pop_history_items_ext(dev, dev->history_end);
+
+  for(const GList *l = b->styles; l; l = g_list_next(l))
   {
-    dt_control_log(_("no image selected!"));
+    const _styles_batch_style_t *style = (_styles_batch_style_t *)l->data;
+    GList *modules_used = NULL;
+
+    // the iop order of the image renumbers the instances of the items, start from the style again
+    int k = 0;
+    for(GList *si = style->items; si; si = g_list_next(si))
+      ((dt_style_item_t *)si->data)->multi_priority = style->multi_priority[k++];
+
+    dt_ioppr_update_for_style_items(dev, style->items, FALSE);
+
+    for(GList *si = style->items; si; si = g_list_next(si))
+      dt_styles_apply_style_item(dev, (dt_style_item_t *)si->data, &modules_used, FALSE);
+
+    g_list_free(modules_used);
   }
-  else
+
+  dt_ioppr_check_iop_order(dev, imgid, "_styles_batch_prepare 1");
+
+  return TRUE;
+}
+
+static void _styles_batch_write(dt_develop_t *dev, const int32_t imgid, gpointer user_data)
+{
+  const _styles_batch_t *b = (_styles_batch_t *)user_data;
+
+  // write history and forms to db
+  dt_dev_write_history_ext(dev, imgid);
+
+  /* add tag */
+  for(const GList *l = b->styles; l; l = g_list_next(l))
   {
-    dt_control_log(_("style %s successfully applied!"), name);
+    const _styles_batch_style_t *style = (_styles_batch_style_t *)l->data;
+    guint tagid = 0;
+    gchar ntag[512] = { 0 };
+    g_snprintf(ntag, sizeof(ntag), "darktable|style|%s", style->name);
+    if(dt_tag_new(ntag, &tagid)) dt_tag_attach(tagid, imgid, FALSE, FALSE);
   }
 }
 
-void dt_multiple_styles_apply_to_list(GList *styles, const GList *list, gboolean duplicate)
+static void _styles_batch_done(const GList *imgs, gpointer user_data)
+{
+  const _styles_batch_t *b = (_styles_batch_t *)user_data;
+
+  DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_TAG_CHANGED);
+
+  if(!imgs)
+    dt_control_log(_("no image selected!"));
+  else if(b->styles->next)
+    dt_control_log(ngettext("style successfully applied!", "styles successfully applied!",
+                            g_list_length(b->styles)));
+  else
+    dt_control_log(_("style %s successfully applied!"), ((_styles_batch_style_t *)b->styles->data)->name);
+}
+
+// apply the styles onto the images of list, in the background outside of the darkroom
+static void _styles_apply_to_list(const GList *styles, const GList *list, const gboolean duplicate)
 {
   /* write current history changes so nothing gets lost,
      do that only in the darkroom as there is nothing to be saved
      when in the lighttable (and it would write over current history stack) */
   const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
-  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+  const gboolean darkroom = cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM;
+  if(darkroom) dt_dev_write_history(darktable.develop);
+
+  _styles_batch_t *b = calloc(1, sizeof(_styles_batch_t));
+  if(!b) return;
+  b->duplicate = duplicate;
+  b->overwrite = dt_conf_get_int("plugins/lighttable/style/applymode") == DT_STYLE_HISTORY_OVERWRITE;
+
+  for(const GList *l = styles; l; l = g_list_next(l))
+  {
+    const char *name = (const char *)l->data;
+    const int id = dt_styles_get_id_by_name(name);
+    if(!id) continue;
+
+    _styles_batch_style_t *style = calloc(1, sizeof(_styles_batch_style_t));
+    style->name = g_strdup(name);
+    style->items = _styles_get_items_to_apply(id);
+    style->multi_priority = calloc(g_list_length(style->items) + 1, sizeof(int));
+    int k = 0;
+    for(const GList *si = style->items; si; si = g_list_next(si))
+      style->multi_priority[k++] = ((dt_style_item_t *)si->data)->multi_priority;
+    style->iop_list = dt_styles_module_order_list(name);
+    b->styles = g_list_prepend(b->styles, style);
+  }
+  b->styles = g_list_reverse(b->styles);
+
+  if(!b->styles)
+  {
+    _styles_batch_free(b);
+    return;
+  }
 
+  const dt_history_batch_ops_t ops = { .target = _styles_batch_target,
+                                       .prepare = _styles_batch_prepare,
+                                       .write = _styles_batch_write,
+                                       .done = _styles_batch_done,
+                                       .free = _styles_batch_free };
+
+  dt_history_batch_apply(list, &ops, b, TRUE, N_("apply styles"), !darkroom && list && list->next);
+}
+
+void dt_styles_apply_to_list(const char *name, const GList *list, gboolean duplicate)
+{
+  if(!list)
+  {
+    dt_control_log(_("no image selected!"));
+    return;
+  }
+
+  GList *styles = g_list_prepend(NULL, (gpointer)name);
+  _styles_apply_to_list(styles, list, duplicate);
+  g_list_free(styles);
+}
+
+void dt_multiple_styles_apply_to_list(GList *styles, const GList *list, gboolean duplicate)
+{
   if(!styles && !list)
   {
     dt_control_log(_("no images nor styles selected!"));
@@ -673,28 +853,7 @@ void dt_multiple_styles_apply_to_list(GList *styles, const GList *list, gboolean
     return;
   }
 
-  const int mode = dt_conf_get_int("plugins/lighttable/style/applymode");
-  const gboolean is_overwrite = (mode == DT_STYLE_HISTORY_OVERWRITE);
-
-  /* for each selected image apply style */
-  dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-  for(const GList *l = list; l; l = g_list_next(l))
-  {
-    const int32_t imgid = GPOINTER_TO_INT(l->data);
-    if(is_overwrite && !duplicate)
-      dt_history_delete_on_image_ext(imgid, FALSE);
-
-    for (GList *style = styles; style; style = g_list_next(style))
-    {
-      dt_styles_apply_to_image((char*)style->data, duplicate, is_overwrite, imgid);
-    }
-  }
-  dt_undo_end_group(darktable.undo);
-
-  DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_TAG_CHANGED);
-
-  const guint styles_cnt = g_list_length(styles);
-  dt_control_log(ngettext("style successfully applied!", "styles successfully applied!", styles_cnt));
+  _styles_apply_to_list(styles, list, duplicate);
 }
 
 void dt_styles_create_from_list(const GList *list)
@@ -814,7 +973,6 @@ void dt_styles_apply_style_item(dt_develop_t *dev, dt_style_item_t *style_item,
 void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const gboolean overwrite, const int32_t imgid)
 {
   int id = 0;
-  sqlite3_stmt *stmt;
 
   if((id = dt_styles_get_id_by_name(name)) != 0)
   {
@@ -850,17 +1008,8 @@ void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const
     GList *iop_list = dt_styles_module_order_list(name);
     if(iop_list)
     {
-      // the style has an iop-order, we need to merge the multi-instance from target image
-      // get target image iop-order list:
-      GList *img_iop_order_list = dt_ioppr_get_iop_order_list(newimgid, FALSE);
-      // get multi-instance modules if any:
-      GList *mi = dt_ioppr_extract_multi_instances_list(img_iop_order_list);
-      // if some where found merge them with the style list
-      if(mi) iop_list = dt_ioppr_merge_multi_instance_iop_order_list(iop_list, mi);
-      // finally we have the final list for the image
-      dt_ioppr_write_iop_order_list(iop_list, newimgid);
+      _styles_write_iop_order(iop_list, newimgid);
       g_list_free_full(iop_list, g_free);
-      g_list_free_full(img_iop_order_list, g_free);
     }
 
     dt_dev_read_history_ext(dev_dest, newimgid, TRUE);
@@ -875,39 +1024,7 @@ void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const
       fprintf(stderr,"\n^^^^^ Apply style on image %i, history size %i",imgid,dev_dest->history_end);
 
     // go through all entries in style
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT num, module, operation, op_params, enabled,"
-                                "  blendop_params, blendop_version, multi_priority, multi_name"
-                                " FROM data.style_items WHERE styleid=?1 "
-                                " ORDER BY operation, multi_priority",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
-    GList *si_list = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      dt_style_item_t *style_item = (dt_style_item_t *)malloc(sizeof(dt_style_item_t));
-
-      style_item->num = sqlite3_column_int(stmt, 0);
-      style_item->selimg_num = 0;
-      style_item->enabled = sqlite3_column_int(stmt, 4);
-      style_item->multi_priority = sqlite3_column_int(stmt, 7);
-      style_item->name = NULL;
-      style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
-      style_item->multi_name = g_strdup((char *)sqlite3_column_text(stmt, 8));
-      style_item->module_version = sqlite3_column_int(stmt, 1);
-      style_item->blendop_version = sqlite3_column_int(stmt, 6);
-      style_item->params_size = sqlite3_column_bytes(stmt, 3);
-      style_item->params = (void *)malloc(style_item->params_size);
-      memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3), style_item->params_size);
-      style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
-      style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
-      memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5), style_item->blendop_params_size);
-      style_item->iop_order = 0;
-
-      si_list = g_list_prepend(si_list, style_item);
-    }
-    sqlite3_finalize(stmt);
-    si_list = g_list_reverse(si_list);  // list was built in reverse order, so un-reverse it
+    GList *si_list = _styles_get_items_to_apply(id);
 
     dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
 
@@ -1265,27 +1265,13 @@ uint32_t dt_tag_get_with_usage(GList **result)
 {
   sqlite3_stmt *stmt;
 
-  /* Select tags that are similar to the keyword and are actually used to tag images*/
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO memory.taglist (id, count)"
-                              "  SELECT tagid, COUNT(*)"
-                              "  FROM main.tagged_images"
-                              "  GROUP BY tagid",
-                              -1, &stmt, NULL);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
-
   const uint32_t nb_selected = dt_selected_images_count();
 
-  /* Now put all the bits together */
+  /* the usage counters are maintained by the database, see memory.tag_usage */
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT T.name, T.id, MT.count, CT.imgnb, T.flags, T.synonyms"
+                              "SELECT T.name, T.id, U.count, U.selected, T.flags, T.synonyms"
                               "  FROM data.tags T "
-                              "  LEFT JOIN memory.taglist MT ON MT.id = T.id "
-                              "  LEFT JOIN (SELECT tagid, COUNT(DISTINCT imgid) AS imgnb"
-                              "             FROM main.tagged_images "
-                              "             WHERE imgid IN (SELECT imgid FROM main.selected_images) GROUP BY tagid) AS CT "
-                              "    ON CT.tagid = T.id"
+                              "  LEFT JOIN memory.tag_usage U ON U.tagid = T.id "
                               "  WHERE T.id NOT IN memory.darktable_tags "
                               "  ORDER BY T.name ",
                               -1, &stmt, NULL);
@@ -1306,12 +1292,12 @@ uint32_t dt_tag_get_with_usage(GList **result)
                 (imgnb == 0) ? DT_TS_NO_IMAGE : DT_TS_SOME_IMAGES;
     t->flags = sqlite3_column_int(stmt, 4);
     t->synonym = g_strdup((char *)sqlite3_column_text(stmt, 5));
-    *result = g_list_append(*result, t);
+    *result = g_list_prepend(*result, t);
     count++;
   }
 
   sqlite3_finalize(stmt);
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM memory.taglist", NULL, NULL, NULL);
+  *result = g_list_reverse(*result); // list was built in reverse order, so un-reverse it
 
   return count;
 }
@@ -1383,12 +1383,24 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
     metadata.list = g_list_remove(metadata.list, metadata.list->data);
   }
 
+  // the files of the next images are read while the current one is exported
+  const int prefetch = dt_conf_get_int("plugins/imageio/prefetch");
+  GList *ahead = prefetch > 0 ? t : NULL;
+  for(int k = 0; k < prefetch && ahead; k++, ahead = g_list_next(ahead))
+    dt_imageio_prefetch(GPOINTER_TO_INT(ahead->data));
+
   while(t && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
   {
     const int imgid = GPOINTER_TO_INT(t->data);
     t = g_list_next(t);
     const guint num = total - g_list_length(t);
 
+    if(ahead)
+    {
+      dt_imageio_prefetch(GPOINTER_TO_INT(ahead->data));
+      ahead = g_list_next(ahead);
+    }
+
     // progress message
     char message[512] = { 0 };
     snprintf(message, sizeof(message), _("exporting %d / %d to %s"), num, total, mstorage->name(mstorage));
@@ -40,6 +40,7 @@
 #include "develop/imageop.h"
 #include "develop/lightroom.h"
 #include "develop/masks.h"
+#include "develop/recipe.h"
 #include "gui/gtk.h"
 #include "gui/presets.h"
 
@@ -703,7 +704,7 @@ float dt_dev_get_zoom_scale(dt_develop_t *dev, dt_dev_zoom_t zoom, int closeup_f
   return zoom_scale;
 }
 
-void dt_dev_load_image(dt_develop_t *dev, const uint32_t imgid)
+static void _dev_load_image(dt_develop_t *dev, const uint32_t imgid, const gboolean keep_modules)
 {
   dt_lock_image(imgid);
 
@@ -720,7 +721,7 @@ void dt_dev_load_image(dt_develop_t *dev, const uint32_t imgid)
 
   // we need a global lock as the dev->iop set must not be changed until read history is terminated
   dt_pthread_mutex_lock(&darktable.dev_threadsafe);
-  dev->iop = dt_iop_load_modules(dev);
+  if(!keep_modules || !dev->iop) dev->iop = dt_iop_load_modules(dev);
 
   dt_dev_read_history(dev);
   dt_pthread_mutex_unlock(&darktable.dev_threadsafe);
@@ -733,6 +734,132 @@ void dt_dev_load_image(dt_develop_t *dev, const uint32_t imgid)
   dt_unlock_image(imgid);
 }
 
+void dt_dev_load_image(dt_develop_t *dev, const uint32_t imgid)
+{
+  _dev_load_image(dev, imgid, FALSE);
+}
+
+typedef struct _dev_pool_entry_t
+{
+  dt_develop_t dev; // first, the entry is given out as the develop
+  guint modules;    // number of module instances of a clean context
+} _dev_pool_entry_t;
+
+static GMutex _dev_pool_lock;
+static GList *_dev_pool = NULL; // idle contexts
+
+// back to the modules of a fresh context: drop the history, the masks and the instances added for the
+// previous image. returns FALSE if the context can't be reused.
+static gboolean _dev_pool_reset(_dev_pool_entry_t *entry)
+{
+  dt_develop_t *dev = &entry->dev;
+
+  while(dev->history)
+  {
+    dt_dev_free_history_item(((dt_dev_history_item_t *)dev->history->data));
+    dev->history = g_list_delete_link(dev->history, dev->history);
+  }
+  dev->history_end = 0;
+
+  // back to the defaults, this also unlinks the raster masks while all their sources are still there
+  for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    memcpy(module->params, module->default_params, module->params_size);
+    dt_iop_commit_blend_params(module, module->default_blendop_params);
+    module->enabled = module->default_enabled;
+  }
+
+  GList *modules = dev->iop;
+  while(modules)
+  {
+    GList *next = g_list_next(modules);
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    if(module->multi_priority != 0)
+    {
+      dt_iop_cleanup_module(module);
+      free(module);
+      dev->iop = g_list_delete_link(dev->iop, modules);
+    }
+    else
+      module->multi_name[0] = '\0';
+    modules = next;
+  }
+
+  g_list_free_full(dev->forms, (void (*)(void *))dt_masks_free_form);
+  dev->forms = NULL;
+  g_list_free_full(dev->allforms, (void (*)(void *))dt_masks_free_form);
+  dev->allforms = NULL;
+  dev->form_visible = NULL;
+
+  g_list_free_full(dev->iop_order_list, free);
+  dev->iop_order_list = NULL;
+  dev->iop_order_version = 0;
+
+  dev->proxy.chroma_adaptation = NULL;
+  dev->proxy.wb_coeffs[0] = 0.f;
+
+  return g_list_length(dev->iop) == entry->modules;
+}
+
+static void _dev_pool_free(_dev_pool_entry_t *entry)
+{
+  dt_dev_cleanup(&entry->dev);
+  free(entry);
+}
+
+dt_develop_t *dt_dev_pool_acquire(const uint32_t imgid)
+{
+  g_mutex_lock(&_dev_pool_lock);
+  _dev_pool_entry_t *entry = _dev_pool ? (_dev_pool_entry_t *)_dev_pool->data : NULL;
+  if(entry) _dev_pool = g_list_delete_link(_dev_pool, _dev_pool);
+  g_mutex_unlock(&_dev_pool_lock);
+
+  if(!entry)
+  {
+    entry = (_dev_pool_entry_t *)calloc(1, sizeof(_dev_pool_entry_t));
+    dt_dev_init(&entry->dev, 0);
+    _dev_load_image(&entry->dev, imgid, FALSE);
+    entry->modules = 0;
+    for(GList *modules = entry->dev.iop; modules; modules = g_list_next(modules))
+      if(((dt_iop_module_t *)modules->data)->multi_priority == 0) entry->modules++;
+  }
+  else
+  {
+    dt_print(DT_DEBUG_DEV, "[dev_pool] reusing a develop context for image %u\n", imgid);
+    _dev_load_image(&entry->dev, imgid, TRUE);
+  }
+
+  return &entry->dev;
+}
+
+void dt_dev_pool_release(dt_develop_t *dev)
+{
+  if(!dev) return;
+  _dev_pool_entry_t *entry = (_dev_pool_entry_t *)dev;
+
+  if(!_dev_pool_reset(entry))
+  {
+    _dev_pool_free(entry);
+    return;
+  }
+
+  g_mutex_lock(&_dev_pool_lock);
+  const gboolean keep = g_list_length(_dev_pool) < MAX(dt_conf_get_int("develop_pool_size"), 0);
+  if(keep) _dev_pool = g_list_prepend(_dev_pool, entry);
+  g_mutex_unlock(&_dev_pool_lock);
+
+  if(!keep) _dev_pool_free(entry);
+}
+
+void dt_dev_pool_cleanup()
+{
+  g_mutex_lock(&_dev_pool_lock);
+  g_list_free_full(_dev_pool, (GDestroyNotify)_dev_pool_free);
+  _dev_pool = NULL;
+  g_mutex_unlock(&_dev_pool_lock);
+}
+
 void dt_dev_configure(dt_develop_t *dev, int wd, int ht)
 {
   // fixed border on every side
@@ -1165,6 +1292,7 @@ void dt_dev_pop_history_items_ext(dt_develop_t *dev, int32_t cnt)
   dev->history_end = cnt;
 
   // reset gui params for all modules
+  dt_iop_order_index_t *order_index = dt_ioppr_index_new(dev->iop_order_list);
   for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
   {
     dt_iop_module_t *module = (dt_iop_module_t *)(modules->data);
@@ -1173,12 +1301,13 @@ void dt_dev_pop_history_items_ext(dt_develop_t *dev, int32_t cnt)
     module->enabled = module->default_enabled;
 
     if(module->multi_priority == 0)
-      module->iop_order = dt_ioppr_get_iop_order(dev->iop_order_list, module->op, module->multi_priority);
+      module->iop_order = dt_ioppr_index_get_iop_order(order_index, module->op, module->multi_priority);
     else
     {
       module->iop_order = INT_MAX;
     }
   }
+  dt_ioppr_index_free(order_index);
 
   // go through history and set gui params
   GList *forms = NULL;
@@ -1765,6 +1894,22 @@ char * _print_validity(gboolean state)
     return "WRONG";
 }
 
+static void _dev_read_history_synch(dt_develop_t *dev, const gboolean no_image)
+{
+  // FIXME : this probably needs to capture dev thread lock
+  if(dev->gui_attached && !no_image)
+  {
+    dev->pipe->changed |= DT_DEV_PIPE_SYNCH;
+    dev->preview_pipe->changed |= DT_DEV_PIPE_SYNCH; // again, fixed topology for now.
+    dev->preview2_pipe->changed |= DT_DEV_PIPE_SYNCH; // again, fixed topology for now.
+    dt_dev_invalidate_all(dev);
+
+    /* signal history changed */
+    dt_dev_undo_end_record(dev);
+  }
+  dt_dev_masks_list_change(dev);
+}
+
 void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_image)
 {
   if(imgid <= 0) return;
@@ -1774,6 +1919,34 @@ void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_ima
 
   dt_dev_undo_start_record(dev);
 
+  // the history is unchanged since it was last read, no need to parse, merge and write it again
+  dt_dev_recipe_t *recipe = dt_dev_recipe_read(dev, imgid);
+  if(recipe && !no_image)
+  {
+    // unless the settings changed the defaults or the auto-presets to merge
+    _dt_dev_load_pipeline_defaults(dev);
+    if(!dt_dev_recipe_has_defaults(dev, imgid, recipe))
+    {
+      dt_print(DT_DEBUG_PARAMS, "[history] recipe of image %d misses some defaults\n", imgid);
+      dt_dev_recipe_free(recipe);
+      recipe = NULL;
+    }
+  }
+  if(recipe)
+  {
+    dt_dev_recipe_apply(dev, recipe);
+
+    dt_print(DT_DEBUG_PARAMS, "[history] history of image %d read from its recipe\n", imgid);
+
+    dt_ioppr_check_iop_order(dev, imgid, "dt_dev_read_history_ext recipe");
+
+    _dev_read_history_synch(dev, no_image);
+
+    // the recipe matched the current hash of the history, which is then up to date
+    dt_unlock_image(imgid);
+    return;
+  }
+
   int auto_apply_modules = 0;
   gboolean first_run = FALSE;
   gboolean legacy_params = FALSE;
@@ -1837,6 +2010,9 @@ void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_ima
 
   dev->history_end = 0;
 
+  // the order list isn't changed while the rows are read, new instances are only added to dev->iop
+  dt_iop_order_index_t *order_index = dt_ioppr_index_new(dev->iop_order_list);
+
   // Strip rows from DB lookup. One row == One module in history
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -1866,7 +2042,7 @@ void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_ima
       continue;
     }
 
-    const int iop_order = dt_ioppr_get_iop_order(dev->iop_order_list, module_name, multi_priority);
+    const int iop_order = dt_ioppr_index_get_iop_order(order_index, module_name, multi_priority);
 
     dt_dev_history_item_t *hist = (dt_dev_history_item_t *)calloc(1, sizeof(dt_dev_history_item_t));
     hist->module = NULL;
@@ -2026,6 +2202,7 @@ void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_ima
     dev->history_end++;
   }
   sqlite3_finalize(stmt);
+  dt_ioppr_index_free(order_index);
 
   dt_ioppr_resync_modules_order(dev);
 
@@ -2043,18 +2220,7 @@ void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_ima
 
   dt_masks_read_masks_history(dev, imgid);
 
-  // FIXME : this probably needs to capture dev thread lock
-  if(dev->gui_attached && !no_image)
-  {
-    dev->pipe->changed |= DT_DEV_PIPE_SYNCH;
-    dev->preview_pipe->changed |= DT_DEV_PIPE_SYNCH; // again, fixed topology for now.
-    dev->preview2_pipe->changed |= DT_DEV_PIPE_SYNCH; // again, fixed topology for now.
-    dt_dev_invalidate_all(dev);
-
-    /* signal history changed */
-    dt_dev_undo_end_record(dev);
-  }
-  dt_dev_masks_list_change(dev);
+  _dev_read_history_synch(dev, no_image);
 
   // make sure module_dev is in sync with history
   _dev_write_history(dev, imgid);
@@ -2090,6 +2256,9 @@ void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_ima
     dt_history_hash_write_from_history(imgid, flags);
   }
 
+  // the defaults and the auto-presets are only merged when reading with the image
+  if(!no_image) dt_dev_recipe_write(dev, imgid);
+
   dt_unlock_image(imgid);
 }
 
@@ -355,6 +355,14 @@ void dt_dev_process_preview(dt_develop_t *dev);
 void dt_dev_process_preview2(dt_develop_t *dev);
 
 void dt_dev_load_image(dt_develop_t *dev, const uint32_t imgid);
+/** a develop context without gui with imgid loaded, as dt_dev_init() + dt_dev_load_image() would give. the
+    contexts are kept in a pool once released: their modules are instantiated once and only reset between
+    the images. */
+dt_develop_t *dt_dev_pool_acquire(const uint32_t imgid);
+/** give a context from dt_dev_pool_acquire() back, it must not be used anymore */
+void dt_dev_pool_release(dt_develop_t *dev);
+/** free the idle contexts, no context may be in use */
+void dt_dev_pool_cleanup();
 void dt_dev_reload_image(dt_develop_t *dev, const uint32_t imgid);
 /** checks if provided imgid is the image currently in develop */
 int dt_dev_is_current_image(dt_develop_t *dev, uint32_t imgid);
@@ -108,7 +108,10 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_ALLOW_FAST_PIPE = 1 << 12,   // Module can work with a fast pipe
   IOP_FLAGS_UNSAFE_COPY = 1 << 13,       // Unsafe to copy as part of history
   IOP_FLAGS_GUIDES_SPECIAL_DRAW = 1 << 14, // handle the grid drawing directly
-  IOP_FLAGS_GUIDES_WIDGET = 1 << 15        // require the guides widget
+  IOP_FLAGS_GUIDES_WIDGET = 1 << 15,       // require the guides widget
+  IOP_FLAGS_TILING_CONCURRENT = 1 << 16    // CPU tiles may be processed concurrently (reentrant process(),
+                                           // processed_maximum left untouched, no parallel regions
+                                           // beyond the loops of process())
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -327,6 +327,15 @@ int dt_masks_group_render(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
                           float **buffer, int *roi, float scale);
 int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                               const dt_iop_roi_t *roi, float *buffer);
+/** same as dt_masks_get_mask_roi() but goes through the raster cache of the shapes, buffer must be zeroed */
+int dt_masks_get_mask_roi_cached(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                                 dt_masks_form_t *const form, const dt_iop_roi_t *roi, float *buffer);
+/** same as dt_masks_get_mask() but goes through the raster cache of the shapes */
+int dt_masks_get_mask_cached(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                             dt_masks_form_t *const form, float **buffer, int *width, int *height, int *posx,
+                             int *posy);
+/** free the raster cache of the shapes */
+void dt_masks_raster_cache_cleanup();
 
 // returns current masks version
 int dt_masks_version(void);
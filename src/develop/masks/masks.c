@@ -2386,6 +2386,274 @@ void dt_masks_calculate_source_pos_value(dt_masks_form_gui_t *gui, const int mas
   *py = y;
 }
 
+/*
+  Raster cache of the shapes.
+
+  Rendering a shape for a roi, and a brush with a long stroke in particular, is expensive while
+  most of the time nothing changed since the previous pipe run. The rasterized shapes are thus
+  kept, cropped to their non-zero area, and keyed on the shape, the distortions up to the module
+  and the roi. As each shape of a group is cached separately, editing one shape only renders
+  that one again. The whole masks the retouch and spot removal modules get for each of their
+  shapes are kept the same way, under an empty roi.
+*/
+
+#define DT_MASKS_RASTER_CACHE_SIZE ((size_t)128 << 20)
+
+typedef struct dt_masks_raster_t
+{
+  int formid;
+  uint64_t form_hash;     // hash of the shape itself
+  uint64_t context_hash;  // hash of the pipe input, the distortions up to the module and the roi
+  int ok;                 // value returned by get_mask_roi()
+  cairo_rectangle_int_t area; // non-zero part of the mask, in roi coordinates
+  float *mask;
+} dt_masks_raster_t;
+
+static GMutex _raster_cache_lock;
+static GList *_raster_cache = NULL; // most recently used first
+static size_t _raster_cache_size = 0;
+
+static size_t _raster_size(const dt_masks_raster_t *r)
+{
+  return sizeof(float) * r->area.width * r->area.height;
+}
+
+static void _raster_free(dt_masks_raster_t *r)
+{
+  dt_free_align(r->mask);
+  free(r);
+}
+
+static uint64_t _form_hash(const dt_masks_form_t *form)
+{
+  uint64_t hash = 5381;
+  const unsigned char *data = (const unsigned char *)&form->type;
+  for(size_t i = 0; i < sizeof(form->type); i++) hash = ((hash << 5) + hash) ^ data[i];
+  data = (const unsigned char *)form->source;
+  for(size_t i = 0; i < sizeof(form->source); i++) hash = ((hash << 5) + hash) ^ data[i];
+  hash = ((hash << 5) + hash) ^ form->version;
+
+  for(const GList *l = form->points; l; l = g_list_next(l))
+  {
+    data = (const unsigned char *)l->data;
+    for(int i = 0; i < form->functions->point_struct_size; i++) hash = ((hash << 5) + hash) ^ data[i];
+  }
+  return hash;
+}
+
+static uint64_t _raster_context_hash(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                                     const dt_iop_roi_t *roi)
+{
+  uint64_t hash = dt_dev_hash_distort_plus(module->dev, piece->pipe, module->iop_order,
+                                           DT_DEV_TRANSFORM_DIR_BACK_INCL);
+  // history is being changed, do not cache
+  if(hash == 0) return 0;
+
+  // copied forms keep their id and points across images, and some distortions (flip) depend on the image
+  // itself rather than on the params the hash above covers
+  const dt_image_t *const image = &piece->pipe->image;
+  const int v[] = { image->id, image->orientation, image->width, image->height,
+                    piece->pipe->iwidth, piece->pipe->iheight, roi->x, roi->y, roi->width, roi->height };
+  for(int k = 0; k < 10; k++) hash = ((hash << 5) + hash) ^ v[k];
+  const float s[] = { piece->pipe->iscale, roi->scale };
+  const unsigned char *data = (const unsigned char *)s;
+  for(size_t i = 0; i < sizeof(s); i++) hash = ((hash << 5) + hash) ^ data[i];
+  return hash;
+}
+
+static void _raster_insert(dt_masks_raster_t *r)
+{
+  g_mutex_lock(&_raster_cache_lock);
+  GList *l = _raster_cache;
+  while(l)
+  {
+    GList *next = g_list_next(l);
+    dt_masks_raster_t *o = (dt_masks_raster_t *)l->data;
+    // drop the previous versions of this shape, as well as what another thread may have
+    // inserted in the meantime
+    if(o->formid == r->formid && o->context_hash == r->context_hash)
+    {
+      _raster_cache_size -= _raster_size(o);
+      _raster_free(o);
+      _raster_cache = g_list_delete_link(_raster_cache, l);
+    }
+    l = next;
+  }
+
+  _raster_cache = g_list_prepend(_raster_cache, r);
+  _raster_cache_size += _raster_size(r);
+
+  while(_raster_cache_size > DT_MASKS_RASTER_CACHE_SIZE)
+  {
+    GList *last = g_list_last(_raster_cache);
+    dt_masks_raster_t *o = (dt_masks_raster_t *)last->data;
+    _raster_cache_size -= _raster_size(o);
+    _raster_free(o);
+    _raster_cache = g_list_delete_link(_raster_cache, last);
+  }
+  g_mutex_unlock(&_raster_cache_lock);
+}
+
+int dt_masks_get_mask_roi_cached(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                                 dt_masks_form_t *const form, const dt_iop_roi_t *roi, float *buffer)
+{
+  if(!form->functions) return 0;
+
+  // groups are combined from their cached shapes
+  if(form->type & DT_MASKS_GROUP) return dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+
+  const uint64_t context_hash = _raster_context_hash(module, piece, roi);
+  if(context_hash == 0) return dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+
+  const uint64_t form_hash = _form_hash(form);
+  const size_t width = roi->width;
+
+  g_mutex_lock(&_raster_cache_lock);
+  for(GList *l = _raster_cache; l; l = g_list_next(l))
+  {
+    dt_masks_raster_t *r = (dt_masks_raster_t *)l->data;
+    if(r->formid == form->formid && r->form_hash == form_hash && r->context_hash == context_hash)
+    {
+      _raster_cache = g_list_remove_link(_raster_cache, l);
+      _raster_cache = g_list_concat(l, _raster_cache);
+
+      // the buffer is zeroed by the caller, only copy the non-zero part
+      for(int y = 0; y < r->area.height; y++)
+        memcpy(buffer + (size_t)(y + r->area.y) * width + r->area.x, r->mask + (size_t)y * r->area.width,
+               sizeof(float) * r->area.width);
+      const int ok = r->ok;
+      g_mutex_unlock(&_raster_cache_lock);
+
+      dt_print(DT_DEBUG_MASKS, "[masks %s] raster cache hit\n", form->name);
+      return ok;
+    }
+  }
+  g_mutex_unlock(&_raster_cache_lock);
+
+  const int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+
+  // find the non-zero part of the mask
+  int x0 = roi->width, x1 = -1, y0 = roi->height, y1 = -1;
+  for(int y = 0; y < roi->height; y++)
+  {
+    const float *const row = buffer + y * width;
+    int first = -1, last = -1;
+    for(int x = 0; x < roi->width; x++)
+      if(row[x] != 0.0f)
+      {
+        if(first < 0) first = x;
+        last = x;
+      }
+    if(first < 0) continue;
+    x0 = MIN(x0, first);
+    x1 = MAX(x1, last);
+    y0 = MIN(y0, y);
+    y1 = y;
+  }
+
+  dt_masks_raster_t *r = (dt_masks_raster_t *)calloc(1, sizeof(dt_masks_raster_t));
+  r->formid = form->formid;
+  r->form_hash = form_hash;
+  r->context_hash = context_hash;
+  r->ok = ok;
+  if(x1 >= 0)
+    r->area = (cairo_rectangle_int_t){ x0, y0, x1 - x0 + 1, y1 - y0 + 1 };
+
+  // do not let a single large shape (a gradient at full resolution) flush the cache
+  if(_raster_size(r) > DT_MASKS_RASTER_CACHE_SIZE / 4)
+  {
+    free(r);
+    return ok;
+  }
+
+  if(r->area.width > 0)
+  {
+    r->mask = dt_alloc_align_float((size_t)r->area.width * r->area.height);
+    if(!r->mask)
+    {
+      free(r);
+      return ok;
+    }
+    for(int y = 0; y < r->area.height; y++)
+      memcpy(r->mask + (size_t)y * r->area.width, buffer + (size_t)(y + r->area.y) * width + r->area.x,
+             sizeof(float) * r->area.width);
+  }
+
+  _raster_insert(r);
+  return ok;
+}
+
+int dt_masks_get_mask_cached(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                             dt_masks_form_t *const form, float **buffer, int *width, int *height, int *posx,
+                             int *posy)
+{
+  if(!form->functions) return 0;
+  if(form->type & DT_MASKS_GROUP) return dt_masks_get_mask(module, piece, form, buffer, width, height, posx, posy);
+
+  // the whole mask doesn't depend on a roi, the empty one keeps these apart from the roi entries
+  const dt_iop_roi_t whole = { 0 };
+  const uint64_t context_hash = _raster_context_hash(module, piece, &whole);
+  if(context_hash == 0) return dt_masks_get_mask(module, piece, form, buffer, width, height, posx, posy);
+
+  const uint64_t form_hash = _form_hash(form);
+
+  g_mutex_lock(&_raster_cache_lock);
+  for(GList *l = _raster_cache; l; l = g_list_next(l))
+  {
+    dt_masks_raster_t *r = (dt_masks_raster_t *)l->data;
+    if(r->formid == form->formid && r->form_hash == form_hash && r->context_hash == context_hash)
+    {
+      _raster_cache = g_list_remove_link(_raster_cache, l);
+      _raster_cache = g_list_concat(l, _raster_cache);
+
+      // the callers own and free the mask
+      *buffer = dt_alloc_align_float((size_t)r->area.width * r->area.height);
+      if(*buffer)
+        memcpy(*buffer, r->mask, _raster_size(r));
+      *width = r->area.width;
+      *height = r->area.height;
+      *posx = r->area.x;
+      *posy = r->area.y;
+      const int ok = *buffer ? r->ok : 0;
+      g_mutex_unlock(&_raster_cache_lock);
+
+      dt_print(DT_DEBUG_MASKS, "[masks %s] raster cache hit\n", form->name);
+      return ok;
+    }
+  }
+  g_mutex_unlock(&_raster_cache_lock);
+
+  const int ok = dt_masks_get_mask(module, piece, form, buffer, width, height, posx, posy);
+  if(!*buffer || *width <= 0 || *height <= 0) return ok;
+
+  dt_masks_raster_t *r = (dt_masks_raster_t *)calloc(1, sizeof(dt_masks_raster_t));
+  r->formid = form->formid;
+  r->form_hash = form_hash;
+  r->context_hash = context_hash;
+  r->ok = ok;
+  r->area = (cairo_rectangle_int_t){ *posx, *posy, *width, *height };
+
+  if(_raster_size(r) > DT_MASKS_RASTER_CACHE_SIZE / 4
+     || !(r->mask = dt_alloc_align_float((size_t)*width * *height)))
+  {
+    free(r);
+    return ok;
+  }
+  memcpy(r->mask, *buffer, _raster_size(r));
+
+  _raster_insert(r);
+  return ok;
+}
+
+void dt_masks_raster_cache_cleanup()
+{
+  g_mutex_lock(&_raster_cache_lock);
+  g_list_free_full(_raster_cache, (GDestroyNotify)_raster_free);
+  _raster_cache = NULL;
+  _raster_cache_size = 0;
+  g_mutex_unlock(&_raster_cache_lock);
+}
+
 #include "detail.c"
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -426,13 +426,30 @@ void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
 
   dt_print(DT_DEBUG_PARAMS, "[pixelpipe] synch all modules with history for pipe %i\n", pipe->type);
 
-  // go through all history items and adjust params
+  // only the last item of each module instance up to history_end sets its state, the ones before are
+  // superseded and committing them would be wasted (some modules build luts or profiles in commit_params)
+  GHashTable *last = g_hash_table_new(NULL, NULL);
+  int items = 0;
+  for(GList *history = dev->history; items < dev->history_end && history; history = g_list_next(history), items++)
+    g_hash_table_insert(last, ((dt_dev_history_item_t *)history->data)->module, history);
+
+  // go through the effective history items, in history order, and adjust params
+  int commits = 0;
   GList *history = dev->history;
   for(int k = 0; k < dev->history_end && history; k++)
   {
-    dt_dev_pixelpipe_synch(pipe, dev, history);
+    const dt_dev_history_item_t *hist = (dt_dev_history_item_t *)history->data;
+    if(g_hash_table_lookup(last, hist->module) == history)
+    {
+      dt_dev_pixelpipe_synch(pipe, dev, history);
+      commits++;
+    }
     history = g_list_next(history);
   }
+  g_hash_table_destroy(last);
+
+  dt_print(DT_DEBUG_PERF, "[pixelpipe] synch all for pipe %i: %d history items, %d commits saved\n", pipe->type,
+           items, items - commits);
   dt_pthread_mutex_unlock(&pipe->busy_mutex);
 }
 
@@ -0,0 +1,415 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2022 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "develop/recipe.h"
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
+#include "common/image_cache.h"
+#include "common/iop_order.h"
+#include "develop/blend.h"
+#include "develop/imageop.h"
+#include "develop/masks.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// layout of the blob, to be bumped whenever it changes
+#define DT_DEV_RECIPE_VERSION 1
+
+typedef struct _recipe_item_t
+{
+  dt_iop_module_t *base; // instance of the module in dev, to load new instances from
+  char op[20];
+  int multi_priority;
+  char multi_name[128];
+  int enabled;
+  int num;
+  void *params;
+  dt_develop_blend_params_t blend_params;
+  GList *forms;
+} _recipe_item_t;
+
+struct dt_dev_recipe_t
+{
+  GList *iop_order_list;
+  int history_end;
+  GList *items;
+};
+
+typedef struct _recipe_reader_t
+{
+  const guint8 *pos;
+  const guint8 *end;
+  gboolean fail;
+} _recipe_reader_t;
+
+static void _put_int(GByteArray *b, const int32_t value)
+{
+  g_byte_array_append(b, (const guint8 *)&value, sizeof(value));
+}
+
+static void _put_data(GByteArray *b, const void *data, const int32_t size)
+{
+  _put_int(b, size);
+  if(size > 0) g_byte_array_append(b, (const guint8 *)data, size);
+}
+
+static void _put_string(GByteArray *b, const char *s)
+{
+  _put_data(b, s, strlen(s));
+}
+
+static int32_t _get_int(_recipe_reader_t *r)
+{
+  int32_t value = 0;
+  if(r->fail || r->end - r->pos < (ptrdiff_t)sizeof(value))
+  {
+    r->fail = TRUE;
+    return 0;
+  }
+  memcpy(&value, r->pos, sizeof(value));
+  r->pos += sizeof(value);
+  return value;
+}
+
+static const void *_get_data(_recipe_reader_t *r, int32_t *size)
+{
+  *size = _get_int(r);
+  if(r->fail || *size < 0 || r->end - r->pos < *size)
+  {
+    r->fail = TRUE;
+    *size = 0;
+    return NULL;
+  }
+  const void *data = r->pos;
+  r->pos += *size;
+  return data;
+}
+
+static void _get_string(_recipe_reader_t *r, char *s, const size_t max)
+{
+  int32_t len = 0;
+  const void *data = _get_data(r, &len);
+  if(r->fail || len >= max)
+  {
+    r->fail = TRUE;
+    return;
+  }
+  memcpy(s, data, len);
+  s[len] = '\0';
+}
+
+static void _recipe_item_free(gpointer data)
+{
+  _recipe_item_t *item = (_recipe_item_t *)data;
+  free(item->params);
+  g_list_free_full(item->forms, (GDestroyNotify)dt_masks_free_form);
+  free(item);
+}
+
+static void _recipe_free(dt_dev_recipe_t *recipe)
+{
+  g_list_free_full(recipe->iop_order_list, free);
+  g_list_free_full(recipe->items, _recipe_item_free);
+  free(recipe);
+}
+
+static void _recipe_read_forms(_recipe_reader_t *r, _recipe_item_t *item)
+{
+  const int nb_forms = _get_int(r);
+  for(int f = 0; f < nb_forms && !r->fail; f++)
+  {
+    const dt_masks_type_t type = _get_int(r);
+    if(r->fail) return;
+
+    dt_masks_form_t *form = dt_masks_create(type);
+    item->forms = g_list_prepend(item->forms, form);
+    form->formid = _get_int(r);
+    form->version = _get_int(r);
+    _get_string(r, form->name, sizeof(form->name));
+    int32_t source_size = 0;
+    const void *source = _get_data(r, &source_size);
+    const int32_t point_size = _get_int(r);
+    int32_t points_size = 0;
+    const guint8 *points = _get_data(r, &points_size);
+    if(r->fail) return;
+
+    const int32_t form_point_size = form->functions ? form->functions->point_struct_size : 0;
+    if(source_size != sizeof(form->source) || point_size != form_point_size
+       || (point_size && points_size % point_size))
+    {
+      r->fail = TRUE;
+      return;
+    }
+    memcpy(form->source, source, sizeof(form->source));
+
+    for(int32_t p = 0; point_size && p < points_size; p += point_size)
+    {
+      void *point = malloc(point_size);
+      memcpy(point, points + p, point_size);
+      form->points = g_list_prepend(form->points, point);
+    }
+    form->points = g_list_reverse(form->points);
+  }
+  item->forms = g_list_reverse(item->forms);
+}
+
+static dt_dev_recipe_t *_recipe_parse(const dt_develop_t *dev, _recipe_reader_t *r)
+{
+  // the params of the blending and of the masks are stored as they are now
+  if(_get_int(r) != dt_develop_blend_version() || _get_int(r) != dt_masks_version()) return NULL;
+
+  dt_dev_recipe_t *recipe = (dt_dev_recipe_t *)calloc(1, sizeof(dt_dev_recipe_t));
+  recipe->history_end = _get_int(r);
+
+  int32_t order_size = 0;
+  const char *order = _get_data(r, &order_size);
+  if(order_size > 0) recipe->iop_order_list = dt_ioppr_deserialize_iop_order_list(order, order_size);
+  if(!recipe->iop_order_list) r->fail = TRUE;
+
+  const int count = _get_int(r);
+  for(int i = 0; i < count && !r->fail; i++)
+  {
+    _recipe_item_t *item = (_recipe_item_t *)calloc(1, sizeof(_recipe_item_t));
+    recipe->items = g_list_prepend(recipe->items, item);
+
+    _get_string(r, item->op, sizeof(item->op));
+    const int version = _get_int(r);
+    item->multi_priority = _get_int(r);
+    _get_string(r, item->multi_name, sizeof(item->multi_name));
+    item->enabled = _get_int(r);
+    item->num = _get_int(r);
+    int32_t params_size = 0;
+    const void *params = _get_data(r, &params_size);
+    int32_t blend_size = 0;
+    const void *blend_params = _get_data(r, &blend_size);
+    if(r->fail) break;
+
+    // the recipe must have been made for the modules as they are now
+    item->base = dt_iop_get_module_by_op_priority(dev->iop, item->op, -1);
+    if(!item->base || item->base->version() != version || item->base->params_size != params_size
+       || blend_size != sizeof(dt_develop_blend_params_t))
+    {
+      r->fail = TRUE;
+      break;
+    }
+    item->params = malloc(params_size);
+    memcpy(item->params, params, params_size);
+    memcpy(&item->blend_params, blend_params, sizeof(dt_develop_blend_params_t));
+
+    _recipe_read_forms(r, item);
+  }
+  recipe->items = g_list_reverse(recipe->items);
+
+  if(r->fail || r->pos != r->end)
+  {
+    _recipe_free(recipe);
+    return NULL;
+  }
+  return recipe;
+}
+
+dt_dev_recipe_t *dt_dev_recipe_read(const dt_develop_t *dev, const int32_t imgid)
+{
+  dt_dev_recipe_t *recipe = NULL;
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT r.recipe"
+                              " FROM main.history_recipe AS r, main.history_hash AS h"
+                              " WHERE r.imgid = ?1 AND h.imgid = r.imgid"
+                              "   AND r.version = ?2 AND r.hash = h.current_hash",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, DT_DEV_RECIPE_VERSION);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const guint8 *blob = (const guint8 *)sqlite3_column_blob(stmt, 0);
+    _recipe_reader_t r = { .pos = blob, .end = blob + sqlite3_column_bytes(stmt, 0), .fail = blob == NULL };
+    recipe = _recipe_parse(dev, &r);
+    if(!recipe) dt_print(DT_DEBUG_PARAMS, "[history] recipe of image %d is outdated\n", imgid);
+  }
+  sqlite3_finalize(stmt);
+
+  return recipe;
+}
+
+gboolean dt_dev_recipe_has_defaults(const dt_develop_t *dev, const int32_t imgid, const dt_dev_recipe_t *recipe)
+{
+  // the auto-presets are applied once, when the flag is cleared they are applied again
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+  if(!image) return FALSE;
+  const gboolean applied = image->flags & DT_IMAGE_AUTO_PRESETS_APPLIED;
+  dt_image_cache_read_release(darktable.image_cache, image);
+  if(!applied) return FALSE;
+
+  // as _dev_add_default_modules(), any module enabled by default and missing from the history is added
+  for(const GList *modules = dev->iop; modules; modules = g_list_next(modules))
+  {
+    const dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    if(!module->default_enabled || (module->flags() & IOP_FLAGS_NO_HISTORY_STACK)) continue;
+
+    gboolean found = FALSE;
+    for(const GList *l = recipe->items; l && !found; l = g_list_next(l))
+      found = !strcmp(((_recipe_item_t *)l->data)->op, module->op);
+    if(!found) return FALSE;
+  }
+  return TRUE;
+}
+
+void dt_dev_recipe_free(dt_dev_recipe_t *recipe)
+{
+  _recipe_free(recipe);
+}
+
+void dt_dev_recipe_apply(dt_develop_t *dev, dt_dev_recipe_t *recipe)
+{
+  // as dt_ioppr_set_default_iop_order() does with the order of the database
+  if(dev->iop_order_list) g_list_free_full(dev->iop_order_list, free);
+  dev->iop_order_list = recipe->iop_order_list;
+  recipe->iop_order_list = NULL;
+  dt_ioppr_resync_modules_order(dev);
+
+  // and the history as dt_dev_read_history_ext() reads it from the rows
+  GList *forms_last = NULL;
+  dev->history_end = 0;
+  dt_iop_order_index_t *order_index = dt_ioppr_index_new(dev->iop_order_list);
+  for(GList *l = recipe->items; l; l = g_list_next(l))
+  {
+    _recipe_item_t *item = (_recipe_item_t *)l->data;
+    const int iop_order = dt_ioppr_index_get_iop_order(order_index, item->op, item->multi_priority);
+
+    dt_iop_module_t *module = dt_iop_get_module_by_op_priority(dev->iop, item->op, item->multi_priority);
+    if(!module)
+    {
+      module = (dt_iop_module_t *)calloc(1, sizeof(dt_iop_module_t));
+      if(dt_iop_load_module(module, item->base->so, dev))
+      {
+        free(module);
+        continue;
+      }
+      dt_iop_update_multi_priority(module, item->multi_priority);
+      module->iop_order = iop_order;
+      module->instance = item->base->instance;
+      dev->iop = g_list_append(dev->iop, module);
+    }
+    g_strlcpy(module->multi_name, item->multi_name, sizeof(module->multi_name));
+
+    dt_dev_history_item_t *hist = (dt_dev_history_item_t *)calloc(1, sizeof(dt_dev_history_item_t));
+    hist->module = module;
+    hist->enabled = item->enabled;
+    hist->num = item->num;
+    hist->iop_order = iop_order;
+    hist->multi_priority = item->multi_priority;
+    g_strlcpy(hist->op_name, module->op, sizeof(hist->op_name));
+    g_strlcpy(hist->multi_name, item->multi_name, sizeof(hist->multi_name));
+    hist->params = item->params;
+    item->params = NULL;
+    hist->blend_params = malloc(sizeof(dt_develop_blend_params_t));
+    memcpy(hist->blend_params, &item->blend_params, sizeof(dt_develop_blend_params_t));
+    hist->forms = item->forms;
+    item->forms = NULL;
+
+    // update module iop_order only on active history entries
+    if(recipe->history_end > dev->history_end)
+    {
+      module->iop_order = iop_order;
+      if(hist->forms) forms_last = hist->forms;
+    }
+
+    dev->history = g_list_append(dev->history, hist);
+    dev->history_end++;
+  }
+  dt_ioppr_index_free(order_index);
+
+  dt_ioppr_resync_modules_order(dev);
+
+  dev->history_end = recipe->history_end;
+
+  // the current forms snapshot
+  dt_masks_replace_current_forms(dev, forms_last);
+
+  _recipe_free(recipe);
+}
+
+void dt_dev_recipe_write(const dt_develop_t *dev, const int32_t imgid)
+{
+  if(!dev->iop_order_list) return;
+
+  GByteArray *b = g_byte_array_new();
+
+  _put_int(b, dt_develop_blend_version());
+  _put_int(b, dt_masks_version());
+  _put_int(b, dev->history_end);
+
+  size_t order_size = 0;
+  void *order = dt_ioppr_serialize_iop_order_list(dev->iop_order_list, &order_size);
+  _put_data(b, order, order_size);
+  free(order);
+
+  _put_int(b, g_list_length(dev->history));
+  for(const GList *h = dev->history; h; h = g_list_next(h))
+  {
+    const dt_dev_history_item_t *hist = (dt_dev_history_item_t *)h->data;
+    _put_string(b, hist->op_name);
+    _put_int(b, hist->module->version());
+    _put_int(b, hist->multi_priority);
+    _put_string(b, hist->multi_name);
+    _put_int(b, hist->enabled);
+    _put_int(b, hist->num);
+    _put_data(b, hist->params, hist->module->params_size);
+    _put_data(b, hist->blend_params, sizeof(dt_develop_blend_params_t));
+
+    _put_int(b, g_list_length(hist->forms));
+    for(const GList *f = hist->forms; f; f = g_list_next(f))
+    {
+      const dt_masks_form_t *form = (dt_masks_form_t *)f->data;
+      const int32_t point_size = form->functions ? form->functions->point_struct_size : 0;
+      _put_int(b, form->type);
+      _put_int(b, form->formid);
+      _put_int(b, form->version);
+      _put_string(b, form->name);
+      _put_data(b, form->source, sizeof(form->source));
+      _put_int(b, point_size);
+      _put_int(b, point_size ? point_size * g_list_length(form->points) : 0);
+      for(const GList *p = form->points; point_size && p; p = g_list_next(p))
+        g_byte_array_append(b, (const guint8 *)p->data, point_size);
+    }
+  }
+
+  // only for the hash of the history just written, no recipe for an image without one
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO main.history_recipe (imgid, version, hash, recipe)"
+                              " SELECT imgid, ?2, current_hash, ?3"
+                              " FROM main.history_hash"
+                              " WHERE imgid = ?1 AND current_hash IS NOT NULL",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, DT_DEV_RECIPE_VERSION);
+  DT_DEBUG_SQLITE3_BIND_BLOB(stmt, 3, b->data, b->len, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+
+  g_byte_array_free(b, TRUE);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,57 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2022 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "develop/develop.h"
+
+/*
+  Pipeline recipe of an image.
+
+  The history as read by dt_dev_read_history_ext() (module order, history items with their current params
+  and the masks of each item) is kept as one blob in main.history_recipe, so that the next reads of the
+  history of the image are a single query instead of the defaults and presets merge, the per row parsing
+  and the writing back of the history.
+
+  A recipe is only valid for the current history hash of the image and triggers drop it whenever the
+  history, the masks, the module order or the history end of the image change. Any version mismatch of a
+  module, of the blending or of the masks makes the reading fall back to the database rows.
+*/
+
+typedef struct dt_dev_recipe_t dt_dev_recipe_t;
+
+/** the recipe of imgid if it's valid and matches the modules of dev, NULL otherwise */
+dt_dev_recipe_t *dt_dev_recipe_read(const dt_develop_t *dev, const int32_t imgid);
+
+/** whether reading the history of imgid from the rows would give recipe again: the auto-presets are applied and
+    all the modules enabled by default, which depend on the settings, are in recipe. the defaults of the
+    modules of dev must be loaded for the image. */
+gboolean dt_dev_recipe_has_defaults(const dt_develop_t *dev, const int32_t imgid, const dt_dev_recipe_t *recipe);
+
+/** free a recipe which isn't applied */
+void dt_dev_recipe_free(dt_dev_recipe_t *recipe);
+
+/** set the module order, the history and the masks of dev from recipe, and free it */
+void dt_dev_recipe_apply(dt_develop_t *dev, dt_dev_recipe_t *recipe);
+
+/** store the history of dev as the recipe of imgid, for its current history hash */
+void dt_dev_recipe_write(const dt_develop_t *dev, const int32_t imgid);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -598,22 +598,339 @@ static int _fit_output_to_input_roi(struct dt_iop_module_t *self, struct dt_dev_
 }
 
 
+/* one tile of the cpu tiling: the input and output regions handed to process(), and the "good" part of
+   the output that is copied back to the output buffer */
+typedef struct _tile_t
+{
+  dt_iop_roi_t iroi;
+  dt_iop_roi_t oroi;
+  dt_iop_roi_t oroi_good;
+} _tile_t;
+
+/* a tile plan of _default_process_tiling_roi(). fitting the input and output regions of each tile is
+   expensive (see _fit_output_to_input_roi()) and gives the same result as long as the module parameters,
+   the regions of interest and the tile dimensions (i.e. the memory budget) do not change. the most
+   recent plans are thus kept and reused by the next pipe runs. */
+typedef struct _tile_plan_t
+{
+  const struct dt_iop_module_t *module;
+  char op[20];
+  uint64_t hash;
+  int buf_in_width, buf_in_height;
+  dt_iop_roi_t roi_in, roi_out;
+  int width, height, overlap_in, xyalign;
+
+  int tiles_x, tiles_y;
+  _tile_t *tiles;
+} _tile_plan_t;
+
+#define TILE_PLAN_CACHE_ENTRIES 16
+
+static GMutex _tile_plan_lock;
+static GList *_tile_plans = NULL; // most recently used first
+
+static void _tile_plan_free(_tile_plan_t *plan)
+{
+  free(plan->tiles);
+  free(plan);
+}
+
+static gboolean _tile_plan_matches(const _tile_plan_t *a, const _tile_plan_t *b)
+{
+  return a->module == b->module && !strcmp(a->op, b->op) && a->hash == b->hash
+         && a->buf_in_width == b->buf_in_width && a->buf_in_height == b->buf_in_height
+         && !memcmp(&a->roi_in, &b->roi_in, sizeof(dt_iop_roi_t))
+         && !memcmp(&a->roi_out, &b->roi_out, sizeof(dt_iop_roi_t))
+         && a->width == b->width && a->height == b->height
+         && a->overlap_in == b->overlap_in && a->xyalign == b->xyalign;
+}
+
+/* copy the tiles of a cached plan matching key into key->tiles */
+static gboolean _tile_plan_lookup(_tile_plan_t *key)
+{
+  gboolean found = FALSE;
+  g_mutex_lock(&_tile_plan_lock);
+  for(GList *l = _tile_plans; l; l = g_list_next(l))
+  {
+    _tile_plan_t *plan = (_tile_plan_t *)l->data;
+    if(!_tile_plan_matches(plan, key)) continue;
+
+    _tile_plans = g_list_remove_link(_tile_plans, l);
+    _tile_plans = g_list_concat(l, _tile_plans);
+
+    const size_t size = sizeof(_tile_t) * plan->tiles_x * plan->tiles_y;
+    key->tiles = malloc(size);
+    memcpy(key->tiles, plan->tiles, size);
+    found = TRUE;
+    break;
+  }
+  g_mutex_unlock(&_tile_plan_lock);
+  return found;
+}
+
+static void _tile_plan_insert(const _tile_plan_t *key)
+{
+  _tile_plan_t *plan = malloc(sizeof(_tile_plan_t));
+  *plan = *key;
+  const size_t size = sizeof(_tile_t) * plan->tiles_x * plan->tiles_y;
+  plan->tiles = malloc(size);
+  memcpy(plan->tiles, key->tiles, size);
+
+  g_mutex_lock(&_tile_plan_lock);
+  _tile_plans = g_list_prepend(_tile_plans, plan);
+  if(g_list_length(_tile_plans) > TILE_PLAN_CACHE_ENTRIES)
+  {
+    GList *last = g_list_last(_tile_plans);
+    _tile_plan_free((_tile_plan_t *)last->data);
+    _tile_plans = g_list_delete_link(_tile_plans, last);
+  }
+  g_mutex_unlock(&_tile_plan_lock);
+}
+
+void dt_tiling_cleanup()
+{
+  g_mutex_lock(&_tile_plan_lock);
+  g_list_free_full(_tile_plans, (GDestroyNotify)_tile_plan_free);
+  _tile_plans = NULL;
+  g_mutex_unlock(&_tile_plan_lock);
+}
+
+/* number of tiles to process concurrently and threads per tile. modules flagged with
+   IOP_FLAGS_TILING_CONCURRENT get the threads split among several tiles when the tiles would be too small to
+   keep all threads busy, i.e. less than TILING_MIN_ROWS rows per thread for the parallel loops of process().
+   the global OpenMP settings are left alone: if the runtime doesn't allow nested parallelism the loops of
+   process() run single threaded in their worker, otherwise each tile gets TILING_MIN_THREADS threads. */
+#define TILING_MIN_ROWS 32
+#define TILING_MIN_THREADS 4
+
+/* memory for the buffers of one tile when `workers` tiles are processed at the same time: the input and output
+   images are there once, each tile has its own overhead and share of the rest. */
+static float _tile_singlebuffer(const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                                const int in_bpp, const int out_bpp, const dt_develop_tiling_t *const tiling,
+                                const int workers)
+{
+  const float available = fmax(dt_get_available_mem() - ((float)roi_out->width * roi_out->height * out_bpp)
+                               - ((float)roi_in->width * roi_in->height * in_bpp)
+                               - workers * (float)tiling->overhead, 0) / workers;
+
+  /* we ignore the above value if singlebuffer_limit (is defined and) is higher than available/tiling.factor.
+     this will mainly allow tiling for modules with high and "unpredictable" memory demand which is
+     reflected in high values of tiling.factor (take bilateral noise reduction as an example). */
+  return fmax(available / fmax(tiling->factor, 1.0f), dt_get_singlebuffer_mem() / workers);
+}
+
+static int _concurrent_tiles(struct dt_iop_module_t *self, const dt_iop_roi_t *const roi_in,
+                             const dt_iop_roi_t *const roi_out, const int in_bpp, const int out_bpp,
+                             const int max_bpp, const dt_develop_tiling_t *const tiling, int *inner_threads)
+{
+  *inner_threads = 1;
+#ifdef _OPENMP
+  if(!(self->flags() & IOP_FLAGS_TILING_CONCURRENT)) return 1;
+
+  const int threads = omp_get_max_threads();
+  if(threads < 2) return 1;
+
+  /* rows of the tiles a single worker would get, see the sizing of the tiles by the callers */
+  const int width = _max(_max(roi_in->width, roi_out->width), 1);
+  const float row_size = (float)width * max_bpp * fmax(tiling->maxbuf, 1.0f);
+  const int height = _max(roi_in->height, roi_out->height);
+  const float rows = fminf(_tile_singlebuffer(roi_in, roi_out, in_bpp, out_bpp, tiling, 1) / row_size, height);
+  if(rows >= (float)TILING_MIN_ROWS * threads) return 1;
+
+  const int inner = omp_get_max_active_levels() > 1 ? _min(TILING_MIN_THREADS, threads) : 1;
+  int workers = _max(threads / inner, 1);
+
+  /* the workers share the memory, their tiles are that much smaller. no more of them than can get tiles
+     of TILING_MIN_ROWS rows per thread. */
+  while(workers > 1
+        && fminf(_tile_singlebuffer(roi_in, roi_out, in_bpp, out_bpp, tiling, workers) / row_size, height)
+               < (float)TILING_MIN_ROWS * inner)
+    workers--;
+  if(workers < 2) return 1;
+
+  *inner_threads = inner;
+  return workers;
+#else
+  return 1;
+#endif
+}
+
+/* process the tiles of a plan with up to `workers` tiles at a time. returns FALSE if buffers could not be
+   allocated. */
+static gboolean _process_tiles(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                               const void *const ivoid, void *const ovoid,
+                               const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                               const int in_bpp, const int out_bpp, const _tile_t *const tiles,
+                               const int ntiles, int workers, const int inner_threads, const char *const caller)
+{
+  const size_t ipitch = (size_t)roi_in->width * in_bpp;
+  const size_t opitch = (size_t)roi_out->width * out_bpp;
+
+  /* all tiles of a worker share the same buffers */
+  size_t isize = 0, osize = 0;
+  for(int t = 0; t < ntiles; t++)
+  {
+    isize = MAX(isize, (size_t)tiles[t].iroi.width * tiles[t].iroi.height * in_bpp);
+    osize = MAX(osize, (size_t)tiles[t].oroi.width * tiles[t].oroi.height * out_bpp);
+  }
+
+  workers = _max(_min(workers, ntiles), 1);
+  void **buffers = calloc(2 * workers, sizeof(void *));
+  for(int w = 0; w < workers; w++)
+  {
+    buffers[2 * w] = dt_alloc_align(64, isize);
+    buffers[2 * w + 1] = dt_alloc_align(64, osize);
+    if(buffers[2 * w] == NULL || buffers[2 * w + 1] == NULL)
+    {
+      dt_free_align(buffers[2 * w]);
+      dt_free_align(buffers[2 * w + 1]);
+      buffers[2 * w] = buffers[2 * w + 1] = NULL;
+      /* run with the workers we could get buffers for */
+      workers = w;
+      break;
+    }
+  }
+  if(workers == 0)
+  {
+    dt_print(DT_DEBUG_TILING, "[%s] could not alloc tile buffers for module '%s'\n", caller, self->op);
+    free(buffers);
+    return FALSE;
+  }
+
+  /* store processed_maximum to be re-used and aggregated */
+  dt_aligned_pixel_t processed_maximum_saved;
+  dt_aligned_pixel_t processed_maximum_new = { 1.0f };
+  for_four_channels(k) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
+
+  piece->pipe->tiling = 1;
+
+  if(workers == 1)
+  {
+    void *input = buffers[0];
+    void *output = buffers[1];
+
+    for(int t = 0; t < ntiles; t++)
+    {
+      const _tile_t *const tile = tiles + t;
+      const size_t ioffs = ((size_t)tile->iroi.y - roi_in->y) * ipitch + ((size_t)tile->iroi.x - roi_in->x) * in_bpp;
+      const size_t ooffs = ((size_t)tile->oroi_good.y - roi_out->y) * opitch
+                           + ((size_t)tile->oroi_good.x - roi_out->x) * out_bpp;
+      const size_t iwidth = tile->iroi.width;
+      const size_t owidth = tile->oroi.width;
+
+      dt_print(DT_DEBUG_TILING, "[%s] process tile %d of %d size %dx%d at origin [%d,%d]\n",
+               caller, t + 1, ntiles, tile->iroi.width, tile->iroi.height, tile->iroi.x, tile->iroi.y);
+
+      /* prepare input tile buffer */
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+      dt_omp_firstprivate(in_bpp, ipitch, ivoid, ioffs, input, iwidth, tile) \
+      schedule(static)
+#endif
+      for(size_t j = 0; j < tile->iroi.height; j++)
+        memcpy((char *)input + j * iwidth * in_bpp, (char *)ivoid + ioffs + j * ipitch, iwidth * in_bpp);
+
+      /* take original processed_maximum as starting point */
+      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
+
+      /* call process() of module */
+      self->process(self, piece, input, output, &tile->iroi, &tile->oroi);
+
+      /* aggregate resulting processed_maximum */
+      /* TODO: check if there really can be differences between tiles and take
+               appropriate action (calculate minimum, maximum, average, ...?) */
+      for(int k = 0; k < 4; k++)
+      {
+        if(t > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
+          dt_print(DT_DEBUG_TILING, "[%s] processed_maximum[%d] differs between tiles in module '%s'\n",
+                   caller, k, self->op);
+        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
+      }
+
+      /* copy "good" part of tile to output buffer */
+      const size_t origin_x = tile->oroi_good.x - tile->oroi.x;
+      const size_t origin_y = tile->oroi_good.y - tile->oroi.y;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+      dt_omp_firstprivate(opitch, origin_x, origin_y, out_bpp, ovoid, ooffs, output, owidth, tile) \
+      schedule(static)
+#endif
+      for(size_t j = 0; j < tile->oroi_good.height; j++)
+        memcpy((char *)ovoid + ooffs + j * opitch,
+               (char *)output + ((j + origin_y) * owidth + origin_x) * out_bpp,
+               (size_t)tile->oroi_good.width * out_bpp);
+    }
+  }
+#ifdef _OPENMP
+  else
+  {
+    /* concurrent tiles: the modules flagged for that do not change processed_maximum, see
+       IOP_FLAGS_TILING_CONCURRENT. the thread split is given to both levels, omp_set_num_threads() in the
+       worker only changes the number of threads of the regions it opens. */
+    dt_print(DT_DEBUG_TILING, "[%s] process %d tiles, %d at a time with %d threads each\n",
+             caller, ntiles, workers, inner_threads);
+
+#pragma omp parallel num_threads(workers) default(none) \
+    dt_omp_firstprivate(self, piece, ivoid, ovoid, roi_in, roi_out, in_bpp, out_bpp, ipitch, opitch, \
+                        tiles, ntiles, buffers, inner_threads)
+    {
+      omp_set_num_threads(inner_threads);
+
+      void *input = buffers[2 * omp_get_thread_num()];
+      void *output = buffers[2 * omp_get_thread_num() + 1];
+
+#pragma omp for schedule(dynamic)
+      for(int t = 0; t < ntiles; t++)
+      {
+        const _tile_t *const tile = tiles + t;
+        const size_t ioffs = ((size_t)tile->iroi.y - roi_in->y) * ipitch + ((size_t)tile->iroi.x - roi_in->x) * in_bpp;
+        const size_t ooffs = ((size_t)tile->oroi_good.y - roi_out->y) * opitch
+                             + ((size_t)tile->oroi_good.x - roi_out->x) * out_bpp;
+        const size_t iwidth = tile->iroi.width;
+        const size_t owidth = tile->oroi.width;
+
+        for(size_t j = 0; j < tile->iroi.height; j++)
+          memcpy((char *)input + j * iwidth * in_bpp, (char *)ivoid + ioffs + j * ipitch, iwidth * in_bpp);
+
+        self->process(self, piece, input, output, &tile->iroi, &tile->oroi);
+
+        /* the good parts of the tiles do not overlap */
+        const size_t origin_x = tile->oroi_good.x - tile->oroi.x;
+        const size_t origin_y = tile->oroi_good.y - tile->oroi.y;
+        for(size_t j = 0; j < tile->oroi_good.height; j++)
+          memcpy((char *)ovoid + ooffs + j * opitch,
+                 (char *)output + ((j + origin_y) * owidth + origin_x) * out_bpp,
+                 (size_t)tile->oroi_good.width * out_bpp);
+      }
+    }
+
+    for_four_channels(k) processed_maximum_new[k] = processed_maximum_saved[k];
+  }
+#endif
+
+  /* copy back final processed_maximum */
+  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+
+  piece->pipe->tiling = 0;
+
+  for(int w = 0; w < 2 * workers; w++) dt_free_align(buffers[w]);
+  free(buffers);
+  return TRUE;
+}
+
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
 static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                                         const void *const ivoid, void *const ovoid,
                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                                         const int in_bpp)
 {
-  void *input = NULL;
-  void *output = NULL;
+  _tile_t *tiles = NULL;
   dt_print(DT_DEBUG_TILING, "[default_process_tiling_ptp] **** tiling module '%s' for image with size %dx%d --> %dx%d\n",
            self->op, roi_in->width, roi_in->height, roi_out->width, roi_out->height);
   dt_iop_buffer_dsc_t dsc;
   self->output_format(self, piece->pipe, piece, &dsc);
   const int out_bpp = dt_iop_buffer_dsc_to_bpp(&dsc);
 
-  const int ipitch = roi_in->width * in_bpp;
-  const int opitch = roi_out->width * out_bpp;
   const int max_bpp = _max(in_bpp, out_bpp);
 
   /* get tiling requirements of module */
@@ -630,21 +947,16 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
     goto fallback;
   }
 
-  /* calculate optimal size of tiles */
-  float available = dt_get_available_mem();
-  assert(available >= 500.0f * 1024.0f * 1024.0f);
-  /* correct for size of ivoid and ovoid which are needed on top of tiling */
-  available = fmax(available - ((float)roi_out->width * roi_out->height * out_bpp)
-                   - ((float)roi_in->width * roi_in->height * in_bpp) - tiling.overhead,
-                   0);
+  /* tiles processed at the same time share the memory */
+  int inner_threads;
+  const int workers
+      = _concurrent_tiles(self, roi_in, roi_out, in_bpp, out_bpp, max_bpp, &tiling, &inner_threads);
 
-  /* we ignore the above value if singlebuffer_limit (is defined and) is higher than available/tiling.factor.
-     this will mainly allow tiling for modules with high and "unpredictable" memory demand which is
-     reflected in high values of tiling.factor (take bilateral noise reduction as an example). */
-  float singlebuffer = dt_get_singlebuffer_mem();
-  const float factor = fmax(tiling.factor, 1.0f);
+  /* calculate optimal size of tiles */
+  assert(dt_get_available_mem() >= 500.0f * 1024.0f * 1024.0f);
+  /* correct for size of ivoid and ovoid which are needed on top of tiling, each worker gets its share */
+  const float singlebuffer = _tile_singlebuffer(roi_in, roi_out, in_bpp, out_bpp, &tiling, workers);
   const float maxbuf = fmax(tiling.maxbuf, 1.0f);
-  singlebuffer = fmax(available / factor, singlebuffer);
 
   int width = roi_in->width;
   int height = roi_in->height;
@@ -718,117 +1030,55 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   dt_print(DT_DEBUG_TILING, "[default_process_tiling_ptp] (%dx%d) tiles with max dimensions %dx%d and overlap %d\n",
            tiles_x, tiles_y, width, height, overlap);
 
-  /* reserve input and output buffers for tiles */
-  input = dt_alloc_align(64, (size_t)width * height * in_bpp);
-  if(input == NULL)
+  /* lay out the tiles */
+  tiles = malloc(sizeof(_tile_t) * tiles_x * tiles_y);
+  int ntiles = 0;
+  for(int tx = 0; tx < tiles_x; tx++)
   {
-    dt_print(DT_DEBUG_TILING, "[default_process_tiling_ptp] could not alloc input buffer for module '%s'\n",
-             self->op);
-    goto error;
-  }
-  output = dt_alloc_align(64, (size_t)width * height * out_bpp);
-  if(output == NULL)
-  {
-    dt_print(DT_DEBUG_TILING, "[default_process_tiling_ptp] could not alloc output buffer for module '%s'\n",
-             self->op);
-    goto error;
-  }
-
-  /* store processed_maximum to be re-used and aggregated */
-  dt_aligned_pixel_t processed_maximum_saved;
-  dt_aligned_pixel_t processed_maximum_new = { 1.0f };
-  for_four_channels(k) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
-
-  /* iterate over tiles */
-  for(size_t tx = 0; tx < tiles_x; tx++)
-  {
-    const size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
-    for(size_t ty = 0; ty < tiles_y; ty++)
+    const int wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
+    for(int ty = 0; ty < tiles_y; ty++)
     {
-      piece->pipe->tiling = 1;
-
-      const size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
+      const int ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
 
       /* no need to process end-tiles that are smaller than the total overlap area */
       if((wd <= 2 * overlap && tx > 0) || (ht <= 2 * overlap && ty > 0)) continue;
 
-      /* origin and region of effective part of tile, which we want to store later */
-      size_t origin[] = { 0, 0, 0 };
-      size_t region[] = { wd, ht, 1 };
-
-      /* roi_in and roi_out for process_cl on subbuffer */
-      dt_iop_roi_t iroi = { roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
-      dt_iop_roi_t oroi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
-
-      /* offsets of tile into ivoid and ovoid */
-      const size_t ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
-      size_t ooffs = (ty * tile_ht) * opitch + (tx * tile_wd) * out_bpp;
-
-      dt_print(DT_DEBUG_TILING, "[default_process_tiling_ptp] tile (%zu,%zu) with %zux%zu at origin [%zu,%zu]\n",
-               tx, ty, wd, ht, tx * tile_wd, ty * tile_ht);
-
-/* prepare input tile buffer */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(ht, in_bpp, ipitch, ivoid, wd) \
-      dt_omp_sharedconst(ioffs) \
-      shared(input, width) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < ht; j++)
-        memcpy((char *)input + j * wd * in_bpp, (char *)ivoid + ioffs + j * ipitch, (size_t)wd * in_bpp);
-
-      /* take original processed_maximum as starting point */
-      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
-
-      /* call process() of module */
-      self->process(self, piece, input, output, &iroi, &oroi);
-
-      /* aggregate resulting processed_maximum */
-      /* TODO: check if there really can be differences between tiles and take
-               appropriate action (calculate minimum, maximum, average, ...?) */
-      for(int k = 0; k < 4; k++)
-      {
-        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
-          dt_print(DT_DEBUG_TILING, "[default_process_tiling_ptp] processed_maximum[%d] differs between tiles in module '%s'\n",
-                   k, self->op);
-        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
-      }
+      _tile_t *tile = tiles + ntiles++;
+      tile->iroi = (dt_iop_roi_t){ roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
+      tile->oroi = (dt_iop_roi_t){ roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
 
-      /* correct origin and region of tile for overlap.
-         make sure that we only copy back the "good" part. */
+      /* make sure that we only copy back the "good" part: the overlap to the previous tiles is skipped */
+      tile->oroi_good = tile->oroi;
       if(tx > 0)
       {
-        origin[0] += overlap;
-        region[0] -= overlap;
-        ooffs += (size_t)overlap * out_bpp;
+        tile->oroi_good.x += overlap;
+        tile->oroi_good.width -= overlap;
       }
       if(ty > 0)
       {
-        origin[1] += overlap;
-        region[1] -= overlap;
-        ooffs += (size_t)overlap * opitch;
+        tile->oroi_good.y += overlap;
+        tile->oroi_good.height -= overlap;
       }
-
-/* copy "good" part of tile to output buffer */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(opitch, out_bpp, ovoid, wd) \
-      shared(ooffs, output, width, origin, region) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < region[1]; j++)
-        memcpy((char *)ovoid + ooffs + j * opitch,
-               (char *)output + ((j + origin[1]) * wd + origin[0]) * out_bpp, (size_t)region[0] * out_bpp);
     }
   }
 
-  /* copy back final processed_maximum */
-  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+  /* with concurrent tiles the good parts must not overlap: the right and bottom overlap areas of a tile
+     are overwritten by the next tiles when processed in order. */
+  if(workers > 1)
+    for(int t = 0; t < ntiles; t++)
+    {
+      _tile_t *tile = tiles + t;
+      if(tile->oroi.x + tile->oroi.width < roi_out->x + roi_out->width)
+        tile->oroi_good.width = _min(tile->oroi_good.width, tile->oroi.width - overlap - (tile->oroi_good.x - tile->oroi.x));
+      if(tile->oroi.y + tile->oroi.height < roi_out->y + roi_out->height)
+        tile->oroi_good.height = _min(tile->oroi_good.height, tile->oroi.height - overlap - (tile->oroi_good.y - tile->oroi.y));
+    }
 
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
-  piece->pipe->tiling = 0;
+  if(!_process_tiles(self, piece, ivoid, ovoid, roi_in, roi_out, in_bpp, out_bpp, tiles, ntiles, workers,
+                     inner_threads, "default_process_tiling_ptp"))
+    goto error;
+
+  free(tiles);
   return;
 
 error:
@@ -836,8 +1086,7 @@ error:
 // fall through
 
 fallback:
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  free(tiles);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_TILING, "[default_process_tiling_ptp] fall back to standard processing for module '%s'\n",
            self->op);
@@ -854,8 +1103,7 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                                         const int in_bpp)
 {
-  void *input = NULL;
-  void *output = NULL;
+  _tile_plan_t plan = { 0 };
 
   dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] **** tiling module '%s' for image input size %dx%d --> %dx%d\n",
            self->op, roi_in->width, roi_in->height, roi_out->width, roi_out->height);
@@ -866,8 +1114,6 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
   self->output_format(self, piece->pipe, piece, &dsc);
   const int out_bpp = dt_iop_buffer_dsc_to_bpp(&dsc);
 
-  const int ipitch = roi_in->width * in_bpp;
-  const int opitch = roi_out->width * out_bpp;
   const int max_bpp = _max(in_bpp, out_bpp);
 
   float fullscale = fmax(roi_in->scale / roi_out->scale, sqrtf(((float)roi_in->width * roi_in->height)
@@ -892,21 +1138,16 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
     goto fallback;
   }
 
-  /* calculate optimal size of tiles */
-  float available = dt_get_available_mem();
-  assert(available >= 500.0f * 1024.0f * 1024.0f);
-  /* correct for size of ivoid and ovoid which are needed on top of tiling */
-  available = fmax(available - ((float)roi_out->width * roi_out->height * out_bpp)
-                   - ((float)roi_in->width * roi_in->height * in_bpp) - tiling.overhead,
-                   0);
+  /* tiles processed at the same time share the memory */
+  int inner_threads;
+  const int workers
+      = _concurrent_tiles(self, roi_in, roi_out, in_bpp, out_bpp, max_bpp, &tiling, &inner_threads);
 
-  /* we ignore the above value if singlebuffer_limit (is defined and) is higher than available/tiling.factor.
-     this will mainly allow tiling for modules with high and "unpredictable" memory demand which is
-     reflected in high values of tiling.factor (take bilateral noise reduction as an example). */
-  float singlebuffer = dt_get_singlebuffer_mem();
-  const float factor = fmax(tiling.factor, 1.0f);
+  /* calculate optimal size of tiles */
+  assert(dt_get_available_mem() >= 500.0f * 1024.0f * 1024.0f);
+  /* correct for size of ivoid and ovoid which are needed on top of tiling, each worker gets its share */
+  const float singlebuffer = _tile_singlebuffer(roi_in, roi_out, in_bpp, out_bpp, &tiling, workers);
   const float maxbuf = fmax(tiling.maxbuf, 1.0f);
-  singlebuffer = fmax(available / factor, singlebuffer);
 
   int width = _max(roi_in->width, roi_out->width);
   int height = _max(roi_in->height, roi_out->height);
@@ -997,172 +1238,127 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
   dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] (%dx%d) tiles with max dimensions %dx%d, good %dx%d, overlap %d->%d\n",
            tiles_x, tiles_y, width, height, tile_wd, tile_ht, overlap_in, overlap_out);
 
-  /* store processed_maximum to be re-used and aggregated */
-  dt_aligned_pixel_t processed_maximum_saved;
-  dt_aligned_pixel_t processed_maximum_new = { 1.0f };
-  for_four_channels(k) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
-
-  /* iterate over tiles */
-  for(size_t tx = 0; tx < tiles_x; tx++)
-    for(size_t ty = 0; ty < tiles_y; ty++)
-    {
-      piece->pipe->tiling = 1;
-
-      /* the output dimensions of the good part of this specific tile */
-      const size_t wd = (tx + 1) * tile_wd > roi_out->width ? (size_t)roi_out->width - tx * tile_wd : tile_wd;
-      const size_t ht = (ty + 1) * tile_ht > roi_out->height ? (size_t)roi_out->height - ty * tile_ht : tile_ht;
-
-      /* roi_in and roi_out of good part: oroi_good easy to calculate based on number and dimension of tile.
-         iroi_good is calculated by modify_roi_in() of respective module */
-      dt_iop_roi_t iroi_good = { roi_in->x  + tx * tile_wd, roi_in->y  + ty * tile_ht, wd, ht, roi_in->scale };
-      dt_iop_roi_t oroi_good = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
-
-      self->modify_roi_in(self, piece, &oroi_good, &iroi_good);
-
-      /* clamp iroi_good to not exceed roi_in */
-      iroi_good.x = _max(iroi_good.x, roi_in->x);
-      iroi_good.y = _max(iroi_good.y, roi_in->y);
-      iroi_good.width = _min(iroi_good.width, roi_in->width + roi_in->x - iroi_good.x);
-      iroi_good.height = _min(iroi_good.height, roi_in->height + roi_in->y - iroi_good.y);
-
-      _print_roi(&iroi_good, "tile iroi_good");
-      _print_roi(&oroi_good, "tile oroi_good");
-
-      /* now we need to calculate full region of this tile: increase input roi to take care of overlap
-         requirements
-         and alignment and add additional delta to correct for possible rounding errors in modify_roi_in()
-         -> generates first estimate of iroi_full */
-      const int x_in = iroi_good.x;
-      const int y_in = iroi_good.y;
-      const int width_in = iroi_good.width;
-      const int height_in = iroi_good.height;
-      const int new_x_in = _max(_align_close(x_in - overlap_in - delta, xyalign), roi_in->x);
-      const int new_y_in = _max(_align_close(y_in - overlap_in - delta, xyalign), roi_in->y);
-      const int new_width_in = _min(_align_up(width_in + overlap_in + delta + (x_in - new_x_in), xyalign),
-                                    roi_in->width + roi_in->x - new_x_in);
-      const int new_height_in = _min(_align_up(height_in + overlap_in + delta + (y_in - new_y_in), xyalign),
-                                     roi_in->height + roi_in->y - new_y_in);
-
-      /* iroi_full based on calculated numbers and dimensions. oroi_full just set as a starting point for the
-       * following iterative search */
-      dt_iop_roi_t iroi_full = { new_x_in, new_y_in, new_width_in, new_height_in, iroi_good.scale };
-      dt_iop_roi_t oroi_full = oroi_good; // a good starting point for optimization
-
-      _print_roi(&iroi_full, "tile iroi_full before optimization");
-      _print_roi(&oroi_full, "tile oroi_full before optimization");
+  /* the regions of the tiles only depend on these, reuse them if we already fitted them */
+  plan.module = self;
+  g_strlcpy(plan.op, self->op, sizeof(plan.op));
+  plan.hash = piece->hash;
+  plan.buf_in_width = piece->buf_in.width;
+  plan.buf_in_height = piece->buf_in.height;
+  plan.roi_in = *roi_in;
+  plan.roi_out = *roi_out;
+  plan.width = width;
+  plan.height = height;
+  plan.overlap_in = overlap_in;
+  plan.xyalign = xyalign;
+  plan.tiles_x = tiles_x;
+  plan.tiles_y = tiles_y;
+
+  if(_tile_plan_lookup(&plan))
+  {
+    dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] reuse tile plan for module '%s'\n", self->op);
+  }
+  else
+  {
+    plan.tiles = malloc(sizeof(_tile_t) * tiles_x * tiles_y);
 
-      /* try to find a matching oroi_full */
-      if(!_fit_output_to_input_roi(self, piece, &iroi_full, &oroi_full, delta, 10))
+    /* iterate over tiles */
+    for(size_t tx = 0; tx < tiles_x; tx++)
+      for(size_t ty = 0; ty < tiles_y; ty++)
       {
-        dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] can not handle requested roi's. tiling for "
-                               "module '%s' not possible.\n",
-                 self->op);
-        goto error;
-      }
-
-      _print_roi(&iroi_full, "tile iroi_full after optimization");
-      _print_roi(&oroi_full, "tile oroi_full after optimization");
-
-      /* make sure that oroi_full at least covers the range of oroi_good.
-         this step is needed due to the possibility of rounding errors */
-      oroi_full.x = _min(oroi_full.x, oroi_good.x);
-      oroi_full.y = _min(oroi_full.y, oroi_good.y);
-      oroi_full.width = _max(oroi_full.width, oroi_good.x + oroi_good.width - oroi_full.x);
-      oroi_full.height = _max(oroi_full.height, oroi_good.y + oroi_good.height - oroi_full.y);
-
-      /* clamp oroi_full to not exceed roi_out */
-      oroi_full.x = _max(oroi_full.x, roi_out->x);
-      oroi_full.y = _max(oroi_full.y, roi_out->y);
-      oroi_full.width = _min(oroi_full.width, roi_out->width + roi_out->x - oroi_full.x);
-      oroi_full.height = _min(oroi_full.height, roi_out->height + roi_out->y - oroi_full.y);
-
-      /* calculate final iroi_full */
-      self->modify_roi_in(self, piece, &oroi_full, &iroi_full);
-
-      /* clamp iroi_full to not exceed roi_in */
-      iroi_full.x = _max(iroi_full.x, roi_in->x);
-      iroi_full.y = _max(iroi_full.y, roi_in->y);
-      iroi_full.width = _min(iroi_full.width, roi_in->width + roi_in->x - iroi_full.x);
-      iroi_full.height = _min(iroi_full.height, roi_in->height + roi_in->y - iroi_full.y);
-
-      _print_roi(&iroi_full, "tile iroi_full final");
-      _print_roi(&oroi_full, "tile oroi_full final");
-
-      /* offsets of tile into ivoid and ovoid */
-      const size_t ioffs = ((size_t)iroi_full.y - roi_in->y)  * ipitch + ((size_t)iroi_full.x - roi_in->x) * in_bpp;
-            size_t ooffs = ((size_t)oroi_good.y - roi_out->y) * opitch + ((size_t)oroi_good.x - roi_out->x) * out_bpp;
-
-      dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] process tile (%zu,%zu) size %dx%d at origin [%d,%d]\n",
-               tx, ty, iroi_full.width, iroi_full.height, iroi_full.x, iroi_full.y);
-
-      /* prepare input tile buffer */
-      input = dt_alloc_align(64, (size_t)iroi_full.width * iroi_full.height * in_bpp);
-      if(input == NULL)
-      {
-        dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] could not alloc input buffer for module '%s'\n",
-                 self->op);
-        goto error;
-      }
-      output = dt_alloc_align(64, (size_t)oroi_full.width * oroi_full.height * out_bpp);
-      if(output == NULL)
-      {
-        dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] could not alloc output buffer for module '%s'\n",
-                 self->op);
-        goto error;
-      }
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(in_bpp, ipitch, ivoid) \
-      dt_omp_sharedconst(ioffs) shared(input, iroi_full) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < iroi_full.height; j++)
-        memcpy((char *)input + j * iroi_full.width * in_bpp, (char *)ivoid + ioffs + j * ipitch,
-               (size_t)iroi_full.width * in_bpp);
-
-      /* take original processed_maximum as starting point */
-      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
-
-      /* call process() of module */
-      self->process(self, piece, input, output, &iroi_full, &oroi_full);
+        /* the output dimensions of the good part of this specific tile */
+        const size_t wd = (tx + 1) * tile_wd > roi_out->width ? (size_t)roi_out->width - tx * tile_wd : tile_wd;
+        const size_t ht = (ty + 1) * tile_ht > roi_out->height ? (size_t)roi_out->height - ty * tile_ht : tile_ht;
+
+        /* roi_in and roi_out of good part: oroi_good easy to calculate based on number and dimension of tile.
+           iroi_good is calculated by modify_roi_in() of respective module */
+        dt_iop_roi_t iroi_good = { roi_in->x  + tx * tile_wd, roi_in->y  + ty * tile_ht, wd, ht, roi_in->scale };
+        dt_iop_roi_t oroi_good = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
+
+        self->modify_roi_in(self, piece, &oroi_good, &iroi_good);
+
+        /* clamp iroi_good to not exceed roi_in */
+        iroi_good.x = _max(iroi_good.x, roi_in->x);
+        iroi_good.y = _max(iroi_good.y, roi_in->y);
+        iroi_good.width = _min(iroi_good.width, roi_in->width + roi_in->x - iroi_good.x);
+        iroi_good.height = _min(iroi_good.height, roi_in->height + roi_in->y - iroi_good.y);
+
+        _print_roi(&iroi_good, "tile iroi_good");
+        _print_roi(&oroi_good, "tile oroi_good");
+
+        /* now we need to calculate full region of this tile: increase input roi to take care of overlap
+           requirements
+           and alignment and add additional delta to correct for possible rounding errors in modify_roi_in()
+           -> generates first estimate of iroi_full */
+        const int x_in = iroi_good.x;
+        const int y_in = iroi_good.y;
+        const int width_in = iroi_good.width;
+        const int height_in = iroi_good.height;
+        const int new_x_in = _max(_align_close(x_in - overlap_in - delta, xyalign), roi_in->x);
+        const int new_y_in = _max(_align_close(y_in - overlap_in - delta, xyalign), roi_in->y);
+        const int new_width_in = _min(_align_up(width_in + overlap_in + delta + (x_in - new_x_in), xyalign),
+                                      roi_in->width + roi_in->x - new_x_in);
+        const int new_height_in = _min(_align_up(height_in + overlap_in + delta + (y_in - new_y_in), xyalign),
+                                       roi_in->height + roi_in->y - new_y_in);
+
+        /* iroi_full based on calculated numbers and dimensions. oroi_full just set as a starting point for the
+         * following iterative search */
+        dt_iop_roi_t iroi_full = { new_x_in, new_y_in, new_width_in, new_height_in, iroi_good.scale };
+        dt_iop_roi_t oroi_full = oroi_good; // a good starting point for optimization
+
+        _print_roi(&iroi_full, "tile iroi_full before optimization");
+        _print_roi(&oroi_full, "tile oroi_full before optimization");
+
+        /* try to find a matching oroi_full */
+        if(!_fit_output_to_input_roi(self, piece, &iroi_full, &oroi_full, delta, 10))
+        {
+          dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] can not handle requested roi's. tiling for "
+                                 "module '%s' not possible.\n",
+                   self->op);
+          goto error;
+        }
 
-      /* aggregate resulting processed_maximum */
-      /* TODO: check if there really can be differences between tiles and take
-               appropriate action (calculate minimum, maximum, average, ...?) */
-      for(int k = 0; k < 4; k++)
-      {
-        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
-          dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] processed_maximum[%d] differs between tiles in module '%s'\n",
-              k, self->op);
-        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
+        _print_roi(&iroi_full, "tile iroi_full after optimization");
+        _print_roi(&oroi_full, "tile oroi_full after optimization");
+
+        /* make sure that oroi_full at least covers the range of oroi_good.
+           this step is needed due to the possibility of rounding errors */
+        oroi_full.x = _min(oroi_full.x, oroi_good.x);
+        oroi_full.y = _min(oroi_full.y, oroi_good.y);
+        oroi_full.width = _max(oroi_full.width, oroi_good.x + oroi_good.width - oroi_full.x);
+        oroi_full.height = _max(oroi_full.height, oroi_good.y + oroi_good.height - oroi_full.y);
+
+        /* clamp oroi_full to not exceed roi_out */
+        oroi_full.x = _max(oroi_full.x, roi_out->x);
+        oroi_full.y = _max(oroi_full.y, roi_out->y);
+        oroi_full.width = _min(oroi_full.width, roi_out->width + roi_out->x - oroi_full.x);
+        oroi_full.height = _min(oroi_full.height, roi_out->height + roi_out->y - oroi_full.y);
+
+        /* calculate final iroi_full */
+        self->modify_roi_in(self, piece, &oroi_full, &iroi_full);
+
+        /* clamp iroi_full to not exceed roi_in */
+        iroi_full.x = _max(iroi_full.x, roi_in->x);
+        iroi_full.y = _max(iroi_full.y, roi_in->y);
+        iroi_full.width = _min(iroi_full.width, roi_in->width + roi_in->x - iroi_full.x);
+        iroi_full.height = _min(iroi_full.height, roi_in->height + roi_in->y - iroi_full.y);
+
+        _print_roi(&iroi_full, "tile iroi_full final");
+        _print_roi(&oroi_full, "tile oroi_full final");
+
+        _tile_t *tile = plan.tiles + tx * tiles_y + ty;
+        tile->iroi = iroi_full;
+        tile->oroi = oroi_full;
+        tile->oroi_good = oroi_good;
       }
 
-      /* copy "good" part of tile to output buffer */
-      const int origin_x = oroi_good.x - oroi_full.x;
-      const int origin_y = oroi_good.y - oroi_full.y;
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(opitch, origin_x, origin_y, out_bpp, ovoid) \
-      shared(ooffs, output, oroi_good, oroi_full) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < oroi_good.height; j++)
-        memcpy((char *)ovoid + ooffs + j * opitch,
-               (char *)output + ((j + origin_y) * oroi_full.width + origin_x) * out_bpp,
-               (size_t)oroi_good.width * out_bpp);
-
-      dt_free_align(input);
-      dt_free_align(output);
-      input = output = NULL;
-    }
+    _tile_plan_insert(&plan);
+  }
 
-  /* copy back final processed_maximum */
-  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+  if(!_process_tiles(self, piece, ivoid, ovoid, roi_in, roi_out, in_bpp, out_bpp, plan.tiles,
+                     tiles_x * tiles_y, workers, inner_threads, "default_process_tiling_roi"))
+    goto error;
 
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
-  piece->pipe->tiling = 0;
+  free(plan.tiles);
   return;
 
 error:
@@ -1170,8 +1366,7 @@ error:
 // fall through
 
 fallback:
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  free(plan.tiles);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_TILING, "[default_process_tiling_roi] fall back to standard processing for module '%s'\n",
            self->op);
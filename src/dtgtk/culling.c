@@ -19,6 +19,8 @@
 #include "dtgtk/culling.h"
 #include "common/collection.h"
 #include "common/debug.h"
+#include "common/mipmap_cache.h"
+#include "common/prefetch.h"
 #include "common/selection.h"
 #include "control/control.h"
 #include "gui/gtk.h"
@@ -791,6 +793,20 @@ static void _dt_filmstrip_change(gpointer instance, int imgid, gpointer user_dat
   _thumbs_refocus(table);
 }
 
+// the ranks of the prefetcher are not the same images anymore (new query, sort order, imported images, ...).
+// the renderings are forgotten and the window emptied, the next redraw sets it again.
+static void _dt_collection_changed_callback(gpointer instance, dt_collection_change_t query_change,
+                                            dt_collection_properties_t changed_property, gpointer imgs,
+                                            const int next, gpointer user_data)
+{
+  if(!user_data) return;
+  dt_culling_t *table = (dt_culling_t *)user_data;
+  if(!table->prefetch) return;
+
+  dt_prefetch_invalidate(table->prefetch, NULL);
+  dt_prefetch_set_position(table->prefetch, -1, -1, 0, -1);
+}
+
 // get the class name associated with the overlays mode
 static gchar *_thumbs_get_overlays_class(dt_thumbnail_overlay_t over)
 {
@@ -879,12 +895,28 @@ dt_culling_t *dt_culling_new(dt_culling_mode_t mode)
                             G_CALLBACK(_dt_filmstrip_change), table);
   DT_DEBUG_CONTROL_SIGNAL_CONNECT(darktable.signals, DT_SIGNAL_SELECTION_CHANGED,
                             G_CALLBACK(_dt_selection_changed_callback), table);
+  DT_DEBUG_CONTROL_SIGNAL_CONNECT(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
+                            G_CALLBACK(_dt_collection_changed_callback), table);
 
   g_object_ref(table->widget);
 
   return table;
 }
 
+void dt_culling_stop_prefetch(dt_culling_t *table)
+{
+  if(!table) return;
+  dt_prefetch_free(table->prefetch);
+  table->prefetch = NULL;
+}
+
+void dt_culling_cleanup(dt_culling_t *table)
+{
+  if(!table) return;
+  DT_DEBUG_CONTROL_SIGNAL_DISCONNECT(darktable.signals, G_CALLBACK(_dt_collection_changed_callback), table);
+  dt_culling_stop_prefetch(table);
+}
+
 // initialize offset, ... values
 // to be used when reentering culling
 void dt_culling_init(dt_culling_t *table, int fallback_offset)
@@ -1039,6 +1071,50 @@ void dt_culling_init(dt_culling_t *table, int fallback_offset)
   table->offset_imgid = first_id;
 }
 
+// parameters of the renderings of the prefetcher
+typedef struct _prefetch_params_t
+{
+  dt_mipmap_size_t mip;
+  gboolean selection;
+} _prefetch_params_t;
+
+// render callback of the prefetcher, rank is the position inside the navigated images
+static int64_t _prefetch_render(int32_t rank, const void *params, void *user_data)
+{
+  const _prefetch_params_t *prm = (const _prefetch_params_t *)params;
+
+  sqlite3_stmt *stmt;
+  if(prm->selection)
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT m.imgid "
+                                "FROM memory.collected_images AS m, main.selected_images AS s "
+                                "WHERE m.imgid = s.imgid "
+                                "ORDER BY m.rowid "
+                                "LIMIT 1 OFFSET ?1",
+                                -1, &stmt, NULL);
+  }
+  else
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT m.imgid "
+                                "FROM memory.collected_images AS m "
+                                "ORDER BY m.rowid "
+                                "LIMIT 1 OFFSET ?1",
+                                -1, &stmt, NULL);
+  }
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rank);
+  const int id = (sqlite3_step(stmt) == SQLITE_ROW) ? sqlite3_column_int(stmt, 0) : -1;
+  sqlite3_finalize(stmt);
+  if(id <= 0) return -1;
+
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, id, prm->mip, DT_MIPMAP_BLOCKING, 'r');
+  const int64_t size = buf.buf ? (int64_t)buf.width * buf.height * 4 : -1;
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  return size;
+}
+
 static void _thumbs_prefetch(dt_culling_t *table)
 {
   if(!table->list) return;
@@ -1052,72 +1128,54 @@ static void _thumbs_prefetch(dt_culling_t *table)
     maxw = MAX(maxw, th->width);
     maxh = MAX(maxh, th->height);
   }
-  dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, maxw, maxh);
+  const dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, maxw, maxh);
 
-  // prefetch next image
-  gchar *query;
+  // position of the first shown image and number of navigated images
+  int first = 0;
+  int count = 0;
   sqlite3_stmt *stmt;
-  dt_thumbnail_t *last = (dt_thumbnail_t *)g_list_last(table->list)->data;
   if(table->navigate_inside_selection)
   {
-    query = g_strdup_printf(
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m, main.selected_images AS s "
-                          "WHERE m.imgid = s.imgid"
-                          " AND m.rowid > (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid "
-                          "LIMIT 1",
-                          last->imgid);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT COUNT(*), COALESCE(SUM(m.rowid < ?1), 0) "
+                                "FROM memory.collected_images AS m, main.selected_images AS s "
+                                "WHERE m.imgid = s.imgid",
+                                -1, &stmt, NULL);
   }
   else
   {
-    query = g_strdup_printf(
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m "
-                          "WHERE m.rowid > (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid "
-                          "LIMIT 1",
-                          last->imgid);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT COUNT(*), COALESCE(SUM(m.rowid < ?1), 0) "
+                                "FROM memory.collected_images AS m",
+                                -1, &stmt, NULL);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, table->offset);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    count = sqlite3_column_int(stmt, 0);
+    first = sqlite3_column_int(stmt, 1);
   }
   sqlite3_finalize(stmt);
-  g_free(query);
+  if(count == 0) return;
 
-  // prefetch previous image
-  dt_thumbnail_t *prev = (dt_thumbnail_t *)(table->list)->data;
-  if(table->navigate_inside_selection)
+  // the renderings get their own copy of the parameters, these ones are only used by the gui thread
+  const _prefetch_params_t prm = { .mip = mip, .selection = table->navigate_inside_selection };
+  if(!table->prefetch)
   {
-    query = g_strdup_printf(
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m, main.selected_images AS s "
-                          "WHERE m.imgid = s.imgid"
-                          " AND m.rowid < (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid DESC "
-                          "LIMIT 1",
-                          prev->imgid);
+    table->prefetch_mip = mip;
+    table->prefetch_selection = table->navigate_inside_selection;
+    table->prefetch = dt_prefetch_new(_prefetch_render, NULL, table, &prm, sizeof(prm));
   }
-  else
+  else if(table->prefetch_mip != mip || table->prefetch_selection != table->navigate_inside_selection)
   {
-    query = g_strdup_printf(
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m "
-                          "WHERE m.rowid < (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid DESC "
-                          "LIMIT 1",
-                          prev->imgid);
+    // the ranks or the sizes are not the same anymore
+    table->prefetch_mip = mip;
+    table->prefetch_selection = table->navigate_inside_selection;
+    dt_prefetch_invalidate(table->prefetch, &prm);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
-  }
-  sqlite3_finalize(stmt);
+
+  // the shown images are rendered by the thumbnails, the prefetcher goes ahead in the direction of travel
+  dt_prefetch_set_position(table->prefetch, first, first + g_list_length(table->list) - 1, 0, count - 1);
 }
 
 static gboolean _thumbs_recreate_list_at(dt_culling_t *table, const int offset)
@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 /** a class to manage a collection of zoomable thumbnails for culling or full preview.  */
+#include "common/mipmap_cache.h"
 #include "dtgtk/thumbnail.h"
 #include <gtk/gtk.h>
 
@@ -74,9 +75,17 @@ typedef struct dt_culling_t
   dt_thumbnail_overlay_t overlays; // overlays type
   int overlays_block_timeout;      // overlay block visibility duration
   gboolean show_tooltips;          // are tooltips visible ?
+
+  struct dt_prefetch_t *prefetch; // renders the images around the shown ones in background
+  dt_mipmap_size_t prefetch_mip;  // mip level of the shown images
+  gboolean prefetch_selection;    // the ranks of the prefetcher are inside the selection
 } dt_culling_t;
 
 dt_culling_t *dt_culling_new(dt_culling_mode_t mode);
+// free what is owned by the culling, not the widget
+void dt_culling_cleanup(dt_culling_t *table);
+// stop rendering the images around, to be done while the control is running. restarted by the next redraw.
+void dt_culling_stop_prefetch(dt_culling_t *table);
 // reload all thumbs from scratch.
 void dt_culling_full_redraw(dt_culling_t *table, gboolean force);
 // initialise culling offset/navigation mode, etc before entering.
@@ -72,6 +72,12 @@
 #define LSD_DENSITY_TH 0.7                  // LSD: minimal density of region points in rectangle
 #define LSD_N_BINS 1024                     // LSD: number of bins in pseudo-ordering of gradient modulus
 #define LSD_GAMMA 0.45                      // gamma correction to apply on raw images prior to line detection
+#define PYRAMID_MIN_SIZE 400                // coarse-to-fine: minimum size of the buffer to detect lines on its half size level (the preview fits in 720x450)
+#define REFINE_RADIUS 2                     // coarse-to-fine: how far in pixels the edges are searched around a coarse line
+#define REFINE_STEP 4.0f                    // coarse-to-fine: distance in pixels of the edge samples along a coarse line
+#define REFINE_MAX_SAMPLES 64               // coarse-to-fine: maximum number of edge samples per line
+#define REFINE_CONTRAST 2.0f                // coarse-to-fine: minimum grey step of an edge sample (in 1/256 units)
+#define LINES_CACHE_SIZE 16                 // number of images whose detected lines are kept
 #define RANSAC_RUNS 400                     // how many iterations to run in ransac
 #define RANSAC_EPSILON 2                    // starting value for ransac epsilon (in -log10 units)
 #define RANSAC_EPSILON_STEP 1               // step size of epsilon optimization (log10 units)
@@ -511,8 +517,33 @@ typedef struct dt_iop_ashift_global_data_t
   int kernel_ashift_bicubic;
   int kernel_ashift_lanczos2;
   int kernel_ashift_lanczos3;
+  dt_pthread_mutex_t lines_lock;
+  GHashTable *lines_cache; // imgid -> dt_iop_ashift_lines_cache_t
+  uint64_t lines_use;
 } dt_iop_ashift_global_data_t;
 
+// the lines detected on the preview buffer of an image, before any outlier removal
+typedef struct dt_iop_ashift_lines_cache_t
+{
+  // what the lines were detected on
+  uint64_t hash;
+  int width;
+  int height;
+  int x_off;
+  int y_off;
+  float scale;
+  dt_iop_ashift_enhance_t enhance;
+  gboolean coarse;
+  // the detected lines
+  dt_iop_ashift_line_t *lines;
+  int lines_count;
+  int vertical_count;
+  int horizontal_count;
+  float vertical_weight;
+  float horizontal_weight;
+  uint64_t used; // last use, the oldest entries are dropped first
+} dt_iop_ashift_lines_cache_t;
+
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
                   void *new_params, const int new_version)
 {
@@ -1219,128 +1250,60 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
 #endif
 }
 
-// simple conversion of rgb image into greyscale variant suitable for line segment detection
-// the lsd routines expect input as *double, roughly in the range [0.0; 256.0]
-static void rgb2grey256(const float *const in, double *const out, const int width, const int height)
+// simple conversion of rgb image into greyscale variant suitable for line segment detection,
+// roughly in the range [0.0; 256.0] as expected by the lsd routines
+static void rgb2grey256(const float *const in, float *const out, const int width, const int height)
 {
   const size_t npixels = (size_t)width * height;
 
 #ifdef _OPENMP
-#pragma omp parallel for default(none) \
+#pragma omp parallel for simd default(none) \
   dt_omp_firstprivate(npixels) \
   dt_omp_sharedconst(in, out) \
   schedule(static)
 #endif
-  for(int index = 0; index < npixels; index++)
+  for(size_t index = 0; index < npixels; index++)
   {
-    out[index] = (0.3f * in[4*index+0] + 0.59f * in[4*index+1] + 0.11f * in[4*index+2]) * 256.0;
+    out[index] = (0.3f * in[4*index+0] + 0.59f * in[4*index+1] + 0.11f * in[4*index+2]) * 256.0f;
   }
 }
 
-// sobel edge enhancement in one direction
-static void edge_enhance_1d(const double *in, double *out, const int width, const int height,
-                            dt_iop_ashift_enhance_t dir)
+// sobel edge enhancement: gradient magnitude of both directions (in and out must be different buffers)
+static void edge_enhance(const float *const in, float *const out, const int width, const int height)
 {
-  // Sobel kernels for both directions
-  const double hkernel[3][3] = { { 1.0, 0.0, -1.0 }, { 2.0, 0.0, -2.0 }, { 1.0, 0.0, -1.0 } };
-  const double vkernel[3][3] = { { 1.0, 2.0, 1.0 }, { 0.0, 0.0, 0.0 }, { -1.0, -2.0, -1.0 } };
-  const int kwidth = 3;
-  const int khwidth = kwidth / 2;
-
-  // select kernel
-  const double *kernel = (dir == ASHIFT_ENHANCE_HORIZONTAL) ? (const double *)hkernel : (const double *)vkernel;
+  if(width < 3 || height < 3)
+  {
+    dt_iop_image_copy_by_size(out, in, width, height, 1);
+    return;
+  }
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(height, width, khwidth, kwidth) \
-  shared(in, out, kernel) \
+  dt_omp_firstprivate(height, width) \
+  dt_omp_sharedconst(in, out) \
   schedule(static)
 #endif
-  // loop over image pixels and perform sobel convolution
-  for(int j = khwidth; j < height - khwidth; j++)
+  for(int j = 1; j < height - 1; j++)
   {
-    const double *inp = in + (size_t)j * width + khwidth;
-    double *outp = out + (size_t)j * width + khwidth;
-    for(int i = khwidth; i < width - khwidth; i++, inp++, outp++)
-    {
-      double sum = 0.0f;
-      for(int jj = 0; jj < kwidth; jj++)
-      {
-        const int k = jj * kwidth;
-        const int l = (jj - khwidth) * width;
-        for(int ii = 0; ii < kwidth; ii++)
-        {
-          sum += inp[l + ii - khwidth] * kernel[k + ii];
-        }
-      }
-      *outp = sum;
-    }
-  }
-
+    const float *const up = in + (size_t)(j - 1) * width;
+    const float *const mid = in + (size_t)j * width;
+    const float *const down = in + (size_t)(j + 1) * width;
+    float *const outp = out + (size_t)j * width;
 #ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(height, width, khwidth) \
-  shared(out) \
-  schedule(static)
+#pragma omp simd
 #endif
-  // border fill in output buffer, so we don't get pseudo lines at image frame
-  for(int j = 0; j < height; j++)
-    for(int i = 0; i < width; i++)
+    for(int i = 1; i < width - 1; i++)
     {
-      double val = out[j * width + i];
-
-      if(j < khwidth)
-        val = out[(khwidth - j) * width + i];
-      else if(j >= height - khwidth)
-        val = out[(j - khwidth) * width + i];
-      else if(i < khwidth)
-        val = out[j * width + (khwidth - i)];
-      else if(i >= width - khwidth)
-        val = out[j * width + (i - khwidth)];
-
-      out[j * width + i] = val;
-
-      // jump over center of image
-      if(i == khwidth && j >= khwidth && j < height - khwidth) i = width - khwidth;
+      const float gx = (up[i-1] + 2.0f * mid[i-1] + down[i-1]) - (up[i+1] + 2.0f * mid[i+1] + down[i+1]);
+      const float gy = (up[i-1] + 2.0f * up[i] + up[i+1]) - (down[i-1] + 2.0f * down[i] + down[i+1]);
+      outp[i] = sqrtf(gx * gx + gy * gy);
     }
-}
-
-// edge enhancement in both directions
-static int edge_enhance(const double *in, double *out, const int width, const int height)
-{
-  double *Gx = NULL;
-  double *Gy = NULL;
-
-  Gx = malloc(sizeof(double) * width * height);
-  if(Gx == NULL) goto error;
-
-  Gy = malloc(sizeof(double) * width * height);
-  if(Gy == NULL) goto error;
-
-  // perform edge enhancement in both directions
-  edge_enhance_1d(in, Gx, width, height, ASHIFT_ENHANCE_HORIZONTAL);
-  edge_enhance_1d(in, Gy, width, height, ASHIFT_ENHANCE_VERTICAL);
-
-// calculate absolute values
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(height, width) \
-  shared(Gx, Gy, out) \
-  schedule(static)
-#endif
-  for(size_t k = 0; k < (size_t)width * height; k++)
-  {
-    out[k] = sqrt(Gx[k] * Gx[k] + Gy[k] * Gy[k]);
+    // border fill in output buffer, so we don't get pseudo lines at image frame
+    outp[0] = outp[1];
+    outp[width - 1] = outp[width - 2];
   }
-
-  free(Gx);
-  free(Gy);
-  return TRUE;
-
-error:
-  if(Gx) free(Gx);
-  if(Gy) free(Gy);
-  return FALSE;
+  memcpy(out, out + width, sizeof(float) * width);
+  memcpy(out + (size_t)(height - 1) * width, out + (size_t)(height - 2) * width, sizeof(float) * width);
 }
 
 // XYZ -> sRGB matrix
@@ -1432,12 +1395,163 @@ static void gamma_correct(const float *const in, float *const out, const int wid
   }
 }
 
+// convert the greyscale image to the format expected by the lsd routines
+static void grey_to_lsd(const float *const in, double *const out, const int width, const int height)
+{
+  const size_t npixels = (size_t)width * height;
+
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(npixels) \
+  dt_omp_sharedconst(in, out) \
+  schedule(static)
+#endif
+  for(size_t index = 0; index < npixels; index++)
+    out[index] = in[index];
+}
+
+// half size level of the greyscale image (2x2 box average) in the format expected by the lsd routines
+static void grey_downsample_to_lsd(const float *const in, double *const out, const int width, const int height)
+{
+  const int hwidth = width / 2;
+  const int hheight = height / 2;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(width, hwidth, hheight) \
+  dt_omp_sharedconst(in, out) \
+  schedule(static)
+#endif
+  for(int j = 0; j < hheight; j++)
+  {
+    const float *const row0 = in + (size_t)2 * j * width;
+    const float *const row1 = row0 + width;
+    double *const outp = out + (size_t)j * hwidth;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int i = 0; i < hwidth; i++)
+      outp[i] = 0.25f * (row0[2*i] + row0[2*i+1] + row1[2*i] + row1[2*i+1]);
+  }
+}
+
+// bilinear lookup in the greyscale image, coordinates with origin at the corner of the first pixel as
+// returned by the lsd routines
+static inline float grey_sample(const float *const in, const int width, const int height, const float x,
+                                const float y)
+{
+  const float xx = CLAMP(x - 0.5f, 0.0f, width - 1.001f);
+  const float yy = CLAMP(y - 0.5f, 0.0f, height - 1.001f);
+  const int xi = (int)xx;
+  const int yi = (int)yy;
+  const float fx = xx - xi;
+  const float fy = yy - yi;
+  const float *const p = in + (size_t)yi * width + xi;
+  return (1.0f - fy) * ((1.0f - fx) * p[0] + fx * p[1]) + fy * ((1.0f - fx) * p[width] + fx * p[width + 1]);
+}
+
+// refine a line found on the half size level at full resolution: the edge is searched along the normal of
+// the line at regular samples, only within REFINE_RADIUS pixels, and the line is fitted through the found
+// edge points. the line (x1, y1, x2, y2 as returned by the lsd routines) is kept as is if the edge is not
+// found often enough. grey must not be edge enhanced, the edge is where the grey values step.
+static void refine_line(const float *const grey, const int width, const int height, double *const line)
+{
+  // grey values along the normal in half pixel steps, the edge is searched at the inner ones
+  const int taps = 2 * REFINE_RADIUS;
+  float profile[4 * REFINE_RADIUS + 3];
+  float step[4 * REFINE_RADIUS + 1];
+
+  const float x1 = line[0];
+  const float y1 = line[1];
+  const float dx = line[2] - x1;
+  const float dy = line[3] - y1;
+  const float length = sqrtf(dx * dx + dy * dy);
+  if(length < 2.0f * REFINE_RADIUS) return;
+
+  const float ux = dx / length;
+  const float uy = dy / length;
+  const float nx = -uy;
+  const float ny = ux;
+
+  const int samples = MIN(MAX((int)(length / REFINE_STEP), 2), REFINE_MAX_SAMPLES);
+  int found = 0;
+  double sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+
+  for(int s = 0; s < samples; s++)
+  {
+    const float t = (s + 0.5f) * length / samples;
+    const float cx = x1 + t * ux;
+    const float cy = y1 + t * uy;
+
+    for(int k = 0; k < 2 * taps + 3; k++)
+    {
+      const float o = 0.5f * (k - taps - 1);
+      profile[k] = grey_sample(grey, width, height, cx + o * nx, cy + o * ny);
+    }
+    // grey step over one pixel centered at each inner position
+    int best = 0;
+    for(int k = 0; k < 2 * taps + 1; k++)
+    {
+      step[k] = fabsf(profile[k + 2] - profile[k]);
+      if(step[k] > step[best]) best = k;
+    }
+    // no edge, or the edge is further away than the search radius
+    if(step[best] < REFINE_CONTRAST || best == 0 || best == 2 * taps) continue;
+
+    const float denom = step[best - 1] - 2.0f * step[best] + step[best + 1];
+    const float delta = denom < 0.0f ? 0.5f * (step[best - 1] - step[best + 1]) / denom : 0.0f;
+    const float o = 0.5f * (best - taps + delta);
+    const double px = cx + o * nx;
+    const double py = cy + o * ny;
+
+    sx += px;
+    sy += py;
+    sxx += px * px;
+    syy += py * py;
+    sxy += px * py;
+    found++;
+  }
+
+  if(found < MAX(3, samples / 2)) return;
+
+  // total least squares fit through the edge points
+  const double mx = sx / found;
+  const double my = sy / found;
+  const double cxx = sxx / found - mx * mx;
+  const double cyy = syy / found - my * my;
+  const double cxy = sxy / found - mx * my;
+  const double theta = 0.5 * atan2(2.0 * cxy, cxx - cyy);
+  double vx = cos(theta);
+  double vy = sin(theta);
+
+  // the refined line must stay near the coarse one
+  if(fabs(vx * ux + vy * uy) < cos(M_PI / 180.0 * 5.0)) return;
+  if(fabs((mx - x1) * nx + (my - y1) * ny) > REFINE_RADIUS) return;
+  if(vx * ux + vy * uy < 0.0)
+  {
+    vx = -vx;
+    vy = -vy;
+  }
+
+  // end points are the projections of the coarse ones on the refined line
+  const double t1 = (x1 - mx) * vx + (y1 - my) * vy;
+  const double t2 = (line[2] - mx) * vx + (line[3] - my) * vy;
+  line[0] = mx + t1 * vx;
+  line[1] = my + t1 * vy;
+  line[2] = mx + t2 * vx;
+  line[3] = my + t2 * vy;
+}
+
 // do actual line_detection based on LSD algorithm and return results according
-// to this module's conventions
+// to this module's conventions. in coarse-to-fine mode, the lines of large buffers are detected on their half
+// size level and refined at full resolution.
 static int line_detect(float *in, const int width, const int height, const int x_off, const int y_off,
                        const float scale, dt_iop_ashift_line_t **alines, int *lcount, int *vcount, int *hcount,
-                       float *vweight, float *hweight, dt_iop_ashift_enhance_t enhance, const int is_raw)
+                       float *vweight, float *hweight, dt_iop_ashift_enhance_t enhance, const int is_raw,
+                       const gboolean coarse)
 {
+  float *grey = NULL;
+  float *edges = NULL;
   double *greyscale = NULL;
   double *lsd_lines = NULL;
   dt_iop_ashift_line_t *ashift_lines = NULL;
@@ -1459,29 +1573,62 @@ static int line_detect(float *in, const int width, const int height, const int x
     (void)detail_enhance(in, in, width, height);
   }
 
+  // the lines are detected on the half size level of large buffers
+  const gboolean pyramid = coarse && MIN(width, height) >= PYRAMID_MIN_SIZE;
+  const int lsd_width = pyramid ? width / 2 : width;
+  const int lsd_height = pyramid ? height / 2 : height;
+
   // allocate intermediate buffers
-  greyscale = malloc(sizeof(double) * width * height);
+  grey = dt_alloc_align_float((size_t)width * height);
+  if(grey == NULL) goto error;
+  greyscale = malloc(sizeof(double) * lsd_width * lsd_height);
   if(greyscale == NULL) goto error;
 
   // convert to greyscale image
-  rgb2grey256(in, greyscale, width, height);
+  rgb2grey256(in, grey, width, height);
 
-  // if requested perform an additional edge enhancement step
+  // if requested perform an additional edge enhancement step. the lines are refined on the plain greyscale
+  // image, the edge magnitudes peak at the edges instead of stepping there.
   if(enhance & ASHIFT_ENHANCE_EDGES)
   {
-    (void)edge_enhance(greyscale, greyscale, width, height);
+    edges = dt_alloc_align_float((size_t)width * height);
+    if(edges) edge_enhance(grey, edges, width, height);
   }
 
+  if(pyramid)
+    grey_downsample_to_lsd(edges ? edges : grey, greyscale, width, height);
+  else
+    grey_to_lsd(edges ? edges : grey, greyscale, width, height);
+  dt_free_align(edges);
+  edges = NULL;
+
   // call the line segment detector LSD;
   // LSD stores the number of found lines in lines_count.
   // it returns structural details as vector 'double lines[7 * lines_count]'
   int lines_count;
 
-  lsd_lines = LineSegmentDetection(&lines_count, greyscale, width, height,
+  lsd_lines = LineSegmentDetection(&lines_count, greyscale, lsd_width, lsd_height,
                                    LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
                                    LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
                                    LSD_N_BINS, NULL, NULL, NULL);
 
+  // back to full resolution, only the surroundings of the found lines are looked at
+  if(pyramid && lsd_lines)
+  {
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(width, height, lines_count) \
+  dt_omp_sharedconst(grey, lsd_lines) \
+  schedule(dynamic)
+#endif
+    for(int n = 0; n < lines_count; n++)
+    {
+      double *const line = lsd_lines + n * 7;
+      for(int k = 0; k < 5; k++) line[k] *= 2.0;
+      refine_line(grey, width, height, line);
+    }
+  }
+
   // we count the lines that we really want to use
   int lct = 0;
   if(lines_count > 0)
@@ -1599,40 +1746,123 @@ static int line_detect(float *in, const int width, const int height, const int x
   // free intermediate buffers
   free(lsd_lines);
   free(greyscale);
+  dt_free_align(grey);
   return lct > 0 ? TRUE : FALSE;
 
 error:
   free(lsd_lines);
   free(greyscale);
+  dt_free_align(grey);
   return FALSE;
 }
 
-// get image from buffer, analyze for structure and save results
+static void _lines_cache_free(gpointer data)
+{
+  dt_iop_ashift_lines_cache_t *c = (dt_iop_ashift_lines_cache_t *)data;
+  free(c->lines);
+  free(c);
+}
+
+static gboolean _lines_cache_matches(const dt_iop_ashift_lines_cache_t *const a,
+                                     const dt_iop_ashift_lines_cache_t *const b)
+{
+  return a->hash == b->hash && a->width == b->width && a->height == b->height && a->x_off == b->x_off
+         && a->y_off == b->y_off && a->scale == b->scale && a->enhance == b->enhance && a->coarse == b->coarse;
+}
+
+// copy the cached lines of imgid into entry if they were detected on the same buffer with the same settings
+static gboolean _lines_cache_get(dt_iop_ashift_global_data_t *gd, const int32_t imgid,
+                                 dt_iop_ashift_lines_cache_t *const entry)
+{
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&gd->lines_lock);
+  dt_iop_ashift_lines_cache_t *c
+      = (dt_iop_ashift_lines_cache_t *)g_hash_table_lookup(gd->lines_cache, GINT_TO_POINTER(imgid));
+  if(c && _lines_cache_matches(c, entry))
+  {
+    entry->lines = (dt_iop_ashift_line_t *)malloc(sizeof(dt_iop_ashift_line_t) * c->lines_count);
+    if(entry->lines)
+    {
+      memcpy(entry->lines, c->lines, sizeof(dt_iop_ashift_line_t) * c->lines_count);
+      entry->lines_count = c->lines_count;
+      entry->vertical_count = c->vertical_count;
+      entry->horizontal_count = c->horizontal_count;
+      entry->vertical_weight = c->vertical_weight;
+      entry->horizontal_weight = c->horizontal_weight;
+      c->used = ++gd->lines_use;
+      found = TRUE;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->lines_lock);
+  return found;
+}
+
+// keep a copy of the lines of entry as the ones of imgid, the least recently used images are dropped first
+static void _lines_cache_put(dt_iop_ashift_global_data_t *gd, const int32_t imgid,
+                             const dt_iop_ashift_lines_cache_t *const entry)
+{
+  dt_iop_ashift_lines_cache_t *c = (dt_iop_ashift_lines_cache_t *)malloc(sizeof(dt_iop_ashift_lines_cache_t));
+  if(c == NULL) return;
+  *c = *entry;
+  c->lines = (dt_iop_ashift_line_t *)malloc(sizeof(dt_iop_ashift_line_t) * entry->lines_count);
+  if(c->lines == NULL)
+  {
+    free(c);
+    return;
+  }
+  memcpy(c->lines, entry->lines, sizeof(dt_iop_ashift_line_t) * entry->lines_count);
+
+  dt_pthread_mutex_lock(&gd->lines_lock);
+  c->used = ++gd->lines_use;
+  g_hash_table_insert(gd->lines_cache, GINT_TO_POINTER(imgid), c);
+  while(g_hash_table_size(gd->lines_cache) > LINES_CACHE_SIZE)
+  {
+    gpointer oldest = NULL;
+    uint64_t used = UINT64_MAX;
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, gd->lines_cache);
+    while(g_hash_table_iter_next(&iter, &key, &value))
+    {
+      if(((dt_iop_ashift_lines_cache_t *)value)->used < used)
+      {
+        used = ((dt_iop_ashift_lines_cache_t *)value)->used;
+        oldest = key;
+      }
+    }
+    g_hash_table_remove(gd->lines_cache, oldest);
+  }
+  dt_pthread_mutex_unlock(&gd->lines_lock);
+}
+
+// get image from buffer, analyze for structure and save results. the lines detected on a buffer are kept per
+// image, a new request on the same buffer with the same settings reuses them.
 static int _get_structure(dt_iop_module_t *module, dt_iop_ashift_enhance_t enhance)
 {
   dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
+  dt_iop_ashift_global_data_t *gd = (dt_iop_ashift_global_data_t *)module->global_data;
+  const int32_t imgid = module->dev->image_storage.id;
 
   float *buffer = NULL;
-  int width = 0;
-  int height = 0;
-  int x_off = 0;
-  int y_off = 0;
-  float scale = 0.0f;
+  dt_iop_ashift_lines_cache_t entry = { 0 };
+  entry.enhance = enhance;
+  entry.coarse = dt_conf_get_bool("plugins/darkroom/ashift/coarse_to_fine");
 
   dt_iop_gui_enter_critical_section(module);
   // read buffer data if they are available
   if(g->buf != NULL)
   {
-    width = g->buf_width;
-    height = g->buf_height;
-    x_off = g->buf_x_off;
-    y_off = g->buf_y_off;
-    scale = g->buf_scale;
+    entry.hash = g->buf_hash;
+    entry.width = g->buf_width;
+    entry.height = g->buf_height;
+    entry.x_off = g->buf_x_off;
+    entry.y_off = g->buf_y_off;
+    entry.scale = g->buf_scale;
 
     // create a temporary buffer to hold image data
-    buffer = malloc(sizeof(float) * 4 * (size_t)width * height);
+    buffer = malloc(sizeof(float) * 4 * (size_t)entry.width * entry.height);
     if(buffer != NULL)
-      dt_iop_image_copy_by_size(buffer, g->buf, width, height, 4);
+      dt_iop_image_copy_by_size(buffer, g->buf, entry.width, entry.height, 4);
   }
   dt_iop_gui_leave_critical_section(module);
 
@@ -1645,31 +1875,29 @@ static int _get_structure(dt_iop_module_t *module, dt_iop_ashift_enhance_t enhan
   free(g->lines);
   g->lines = NULL;
 
-  dt_iop_ashift_line_t *lines;
-  int lines_count;
-  int vertical_count;
-  int horizontal_count;
-  float vertical_weight;
-  float horizontal_weight;
-
   // get new structural data
-  if(!line_detect(buffer, width, height, x_off, y_off, scale, &lines, &lines_count,
-                  &vertical_count, &horizontal_count, &vertical_weight, &horizontal_weight,
-                  enhance, dt_image_is_raw(&module->dev->image_storage)))
-    goto error;
+  if(!_lines_cache_get(gd, imgid, &entry))
+  {
+    if(!line_detect(buffer, entry.width, entry.height, entry.x_off, entry.y_off, entry.scale, &entry.lines,
+                    &entry.lines_count, &entry.vertical_count, &entry.horizontal_count, &entry.vertical_weight,
+                    &entry.horizontal_weight, enhance, dt_image_is_raw(&module->dev->image_storage),
+                    entry.coarse))
+      goto error;
+    _lines_cache_put(gd, imgid, &entry);
+  }
 
   // save new structural data
-  g->lines_in_width = width;
-  g->lines_in_height = height;
-  g->lines_x_off = x_off;
-  g->lines_y_off = y_off;
-  g->lines_count = lines_count;
-  g->vertical_count = vertical_count;
-  g->horizontal_count = horizontal_count;
-  g->vertical_weight = vertical_weight;
-  g->horizontal_weight = horizontal_weight;
+  g->lines_in_width = entry.width;
+  g->lines_in_height = entry.height;
+  g->lines_x_off = entry.x_off;
+  g->lines_y_off = entry.y_off;
+  g->lines_count = entry.lines_count;
+  g->vertical_count = entry.vertical_count;
+  g->horizontal_count = entry.horizontal_count;
+  g->vertical_weight = entry.vertical_weight;
+  g->horizontal_weight = entry.horizontal_weight;
   g->lines_version++;
-  g->lines = lines;
+  g->lines = entry.lines;
 
   free(buffer);
   return TRUE;
@@ -5495,6 +5723,9 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_ashift_bicubic = dt_opencl_create_kernel(program, "ashift_bicubic");
   gd->kernel_ashift_lanczos2 = dt_opencl_create_kernel(program, "ashift_lanczos2");
   gd->kernel_ashift_lanczos3 = dt_opencl_create_kernel(program, "ashift_lanczos3");
+  dt_pthread_mutex_init(&gd->lines_lock, NULL);
+  gd->lines_cache = g_hash_table_new_full(NULL, NULL, NULL, _lines_cache_free);
+  gd->lines_use = 0;
 }
 
 void cleanup_global(dt_iop_module_so_t *module)
@@ -5504,6 +5735,8 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_ashift_bicubic);
   dt_opencl_free_kernel(gd->kernel_ashift_lanczos2);
   dt_opencl_free_kernel(gd->kernel_ashift_lanczos3);
+  g_hash_table_destroy(gd->lines_cache);
+  dt_pthread_mutex_destroy(&gd->lines_lock);
   free(module->data);
   module->data = NULL;
 }
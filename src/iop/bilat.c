@@ -44,6 +44,7 @@ typedef enum dt_iop_bilat_mode_t
 {
   s_mode_bilateral = 0,       // $DESCRIPTION: "bilateral grid"
   s_mode_local_laplacian = 1, // $DESCRIPTION: "local laplacian filter"
+  s_mode_local_laplacian_fast = 2, // $DESCRIPTION: "local laplacian filter (fast)"
 }
 dt_iop_bilat_mode_t;
 
@@ -205,7 +206,7 @@ error:
     dt_print(DT_DEBUG_OPENCL, "[opencl_bilateral] couldn't enqueue kernel! %d\n", err);
     return FALSE;
   }
-  else // mode == s_mode_local_laplacian
+  else // mode == s_mode_local_laplacian, the fast variant has no gpu path (see commit_params)
   {
     dt_local_laplacian_cl_t *b = dt_local_laplacian_init_cl(piece->pipe->devid, roi_in->width, roi_in->height,
         d->midtone, d->sigma_s, d->sigma_r, d->detail);
@@ -250,7 +251,7 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     tiling->xalign = 1;
     tiling->yalign = 1;
   }
-  else  // mode == s_mode_local_laplacian
+  else  // mode == s_mode_local_laplacian(_fast)
   {
     const int width = roi_in->width;
     const int height = roi_in->height;
@@ -259,7 +260,11 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     const size_t basebuffer = sizeof(float) * channels * width * height;
     const int rad = MIN(roi_in->width, ceilf(256 * roi_in->scale / piece->iscale));
 
-    tiling->factor = 2.0f + (float)local_laplacian_memory_use(width, height) / basebuffer;
+    const size_t memory_use = d->mode == s_mode_local_laplacian_fast
+                                ? local_laplacian_fast_memory_use(width, height)
+                                : local_laplacian_memory_use(width, height);
+
+    tiling->factor = 2.0f + (float)memory_use / basebuffer;
     tiling->maxbuf
         = fmax(1.0f, (float)local_laplacian_singlebuffer_size(width, height) / basebuffer);
     tiling->overhead = 0;
@@ -279,8 +284,10 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 #ifdef HAVE_OPENCL
   if(d->mode == s_mode_bilateral)
     piece->process_cl_ready = (piece->process_cl_ready && !(darktable.opencl->avoid_atomics));
+  else if(d->mode == s_mode_local_laplacian_fast)
+    piece->process_cl_ready = 0; // the fast local laplacian only has a cpu path
 #endif
-  if(d->mode == s_mode_local_laplacian)
+  if(d->mode != s_mode_bilateral)
     piece->process_tiling_ready = 0; // can't deal with tiles, sorry.
 }
 
@@ -320,6 +327,10 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
     dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
     dt_bilateral_free(b);
   }
+  else if(d->mode == s_mode_local_laplacian_fast)
+  {
+    local_laplacian_fast_sse2(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+  }
   else // s_mode_local_laplacian
   {
     local_laplacian_sse2(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
@@ -350,6 +361,10 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
     dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
     dt_bilateral_free(b);
   }
+  else if(d->mode == s_mode_local_laplacian_fast)
+  {
+    local_laplacian_fast(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+  }
   else // s_mode_local_laplacian
   {
     local_laplacian(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
@@ -364,7 +379,7 @@ void gui_changed(dt_iop_module_t *self, GtkWidget *w, void *previous)
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)self->params;
   if(w == g->highlights || w == g->shadows || w == g->midtone)
   {
-    dt_bauhaus_combobox_set(g->mode, s_mode_local_laplacian);
+    if(p->mode == s_mode_bilateral) dt_bauhaus_combobox_set(g->mode, s_mode_local_laplacian);
   }
   else if(w == g->range || w == g->spatial)
   {
@@ -372,7 +387,7 @@ void gui_changed(dt_iop_module_t *self, GtkWidget *w, void *previous)
   }
   else if(w == g->mode)
   {
-    if(p->mode == s_mode_local_laplacian)
+    if(p->mode != s_mode_bilateral)
     {
       p->sigma_r = dt_bauhaus_slider_get(g->highlights);
       p->sigma_s = dt_bauhaus_slider_get(g->shadows);
@@ -386,11 +401,11 @@ void gui_changed(dt_iop_module_t *self, GtkWidget *w, void *previous)
 
   if(!w || w == g->mode)
   {
-    gtk_widget_set_visible(g->highlights, p->mode == s_mode_local_laplacian);
-    gtk_widget_set_visible(g->shadows, p->mode == s_mode_local_laplacian);
-    gtk_widget_set_visible(g->midtone, p->mode == s_mode_local_laplacian);
-    gtk_widget_set_visible(g->range, p->mode != s_mode_local_laplacian);
-    gtk_widget_set_visible(g->spatial, p->mode != s_mode_local_laplacian);
+    gtk_widget_set_visible(g->highlights, p->mode != s_mode_bilateral);
+    gtk_widget_set_visible(g->shadows, p->mode != s_mode_bilateral);
+    gtk_widget_set_visible(g->midtone, p->mode != s_mode_bilateral);
+    gtk_widget_set_visible(g->range, p->mode == s_mode_bilateral);
+    gtk_widget_set_visible(g->spatial, p->mode == s_mode_bilateral);
   }
 }
 
@@ -399,7 +414,7 @@ void gui_update(dt_iop_module_t *self)
   dt_iop_bilat_gui_data_t *g = (dt_iop_bilat_gui_data_t *)self->gui_data;
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)self->params;
 
-  if(p->mode == s_mode_local_laplacian)
+  if(p->mode != s_mode_bilateral)
   {
     dt_bauhaus_slider_set(g->highlights, p->sigma_r);
     dt_bauhaus_slider_set(g->shadows, p->sigma_s);
@@ -425,7 +440,9 @@ void gui_init(dt_iop_module_t *self)
   dt_iop_bilat_gui_data_t *g = IOP_GUI_ALLOC(bilat);
 
   g->mode = dt_bauhaus_combobox_from_params(self, N_("mode"));
-  gtk_widget_set_tooltip_text(g->mode, _("the filter used for local contrast enhancement. bilateral is faster but can lead to artifacts around edges for extreme settings."));
+  gtk_widget_set_tooltip_text(g->mode, _("the filter used for local contrast enhancement. bilateral is faster but can lead to artifacts around edges for extreme settings.\n"
+                                           "the fast local laplacian filter needs less time and memory, at the cost of slightly softer fine details.\n"
+                                           "it only runs on the CPU, with OpenCL the local laplacian filter can be faster."));
 
   g->detail = dt_bauhaus_slider_from_params(self, N_("detail"));
   dt_bauhaus_slider_set_offset(g->detail, 100);
@@ -744,6 +744,31 @@ typedef union floatint_t
   uint32_t i;
 } floatint_t;
 
+// When the full-image scratch buffers of the wavelets path don't fit in memory, the image is processed in
+// horizontal strips. Each strip is padded by the support of the whole decomposition chain (2 * mult rows per
+// scale), so its inner rows get exactly the same wavelet coefficients as when decomposing the full image.
+// The BayesShrink thresholds need the variance of each detail scale over the whole image: a first pass over
+// the strips only accumulates it, a second pass decomposes again, shrinks, synthesizes and backtransforms.
+// The scratch memory drops from three full images to four strips, at the cost of decomposing twice.
+#define DENOISE_STRIP_MIN_ROWS 128
+#define DENOISE_STRIP_BUFFERS 4
+
+static inline int wavelets_support(const int max_scale)
+{
+  return 2 * ((1 << max_scale) - 1);
+}
+
+static inline int wavelets_strip_rows(const int max_scale)
+{
+  // keep the padding at most half of the strip
+  return MAX(DENOISE_STRIP_MIN_ROWS, 4 * wavelets_support(max_scale));
+}
+
+static inline size_t wavelets_strip_size(const int width, const int height, const int max_scale)
+{
+  return (size_t)width * MIN(height, wavelets_strip_rows(max_scale) + 2 * wavelets_support(max_scale));
+}
+
 void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                      const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
                      struct dt_develop_tiling_t *tiling)
@@ -793,6 +818,15 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     tiling->maxbuf = 1.0f;
     tiling->maxbuf_cl = 1.0f;
     tiling->overhead = 0;
+
+    if(dt_conf_get_bool("plugins/darkroom/denoiseprofile/wavelets_strips"))
+    {
+      // process_wavelets() falls back to strips when the full-size buffers don't fit:
+      // in + out + a few strips of scratch memory
+      tiling->factor = 2.0f;
+      tiling->overhead = DENOISE_STRIP_BUFFERS * 4 * sizeof(float)
+                         * wavelets_strip_size(roi_in->width, roi_in->height, max_scale);
+    }
     tiling->overlap = max_filter_radius;
     tiling->xalign = 1;
     tiling->yalign = 1;
@@ -1261,6 +1295,70 @@ static void variance_stabilizing_xform(dt_aligned_pixel_t thrs, const int scale,
     thrs[c] = adjt[c] * sb2 / std_x[c];
 }
 
+// Apply the variance stabilizing transform selected by the parameters.
+static inline void wavelets_precondition(const dt_iop_denoiseprofile_data_t *const d, const float *const in,
+                                         float *const buf, const int width, const int height,
+                                         const dt_aligned_pixel_t aa, const dt_aligned_pixel_t bb,
+                                         const dt_aligned_pixel_t p, const float compensate_p,
+                                         const dt_aligned_pixel_t wb, const dt_colormatrix_t toY0U0V0)
+{
+  if(!d->use_new_vst)
+  {
+    precondition(in, buf, width, height, aa, bb);
+  }
+  else if(d->wavelet_color_mode == MODE_RGB)
+  {
+    precondition_v2(in, buf, width, height, d->a[1] * compensate_p, p, d->b[1], wb);
+  }
+  else
+  {
+    precondition_Y0U0V0(in, buf, width, height, d->a[1] * compensate_p, p, d->b[1], toY0U0V0);
+  }
+}
+
+// Invert the variance stabilizing transform applied by wavelets_precondition().
+static inline void wavelets_backtransform(const dt_iop_denoiseprofile_data_t *const d, float *const buf,
+                                          const int width, const int height, const dt_aligned_pixel_t aa,
+                                          const dt_aligned_pixel_t bb, const dt_aligned_pixel_t p,
+                                          const float compensate_p, const float in_scale,
+                                          const dt_aligned_pixel_t wb, const dt_colormatrix_t toRGB)
+{
+  if(!d->use_new_vst)
+  {
+    backtransform(buf, width, height, aa, bb);
+  }
+  else if(d->wavelet_color_mode == MODE_RGB)
+  {
+    backtransform_v2(buf, width, height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(in_scale), wb);
+  }
+  else
+  {
+    backtransform_Y0U0V0(buf, width, height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(in_scale),
+                         wb, toRGB);
+  }
+}
+
+static inline void sum_squared_details(const float *const restrict detail, const size_t npixels,
+                                       double sum_y2[3])
+{
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f;
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(detail, npixels) \
+  reduction(+: s0, s1, s2) \
+  schedule(simd:static)
+#endif
+  for(size_t k = 0; k < npixels; k++)
+  {
+    s0 += detail[4 * k] * detail[4 * k];
+    s1 += detail[4 * k + 1] * detail[4 * k + 1];
+    s2 += detail[4 * k + 2] * detail[4 * k + 2];
+  }
+  sum_y2[0] += s0;
+  sum_y2[1] += s1;
+  sum_y2[2] += s2;
+}
+
 static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
                              const void *const ivoid, void *const ovoid, const dt_iop_roi_t *const roi_in,
                              const dt_iop_roi_t *const roi_out, const eaw_dn_decompose_t decompose,
@@ -1304,16 +1402,6 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
     return;
   }
 
-  float *buf = NULL;
-  float *restrict precond = NULL;
-  float *restrict tmp = NULL;
-
-  if (!dt_iop_alloc_image_buffers(self, roi_in, roi_out, 4, &precond, 4, &tmp, 4, &buf, 0))
-  {
-    dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out, TRUE);
-    return;
-  }
-
   dt_aligned_pixel_t wb;  // the "unused" fourth element enables vectorization
   const dt_aligned_pixel_t wb_weights = { 2.0f, 1.0f, 2.0f, 0.0f };
   compute_wb_factors(wb,d,piece,wb_weights);
@@ -1351,70 +1439,179 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
   const dt_aligned_pixel_t aa = { d->a[1] * wb[0], d->a[1] * wb[1], d->a[1] * wb[2], 0.0f };
   const dt_aligned_pixel_t bb = { d->b[1] * wb[0], d->b[1] * wb[1], d->b[1] * wb[2], 0.0f };
 
-  if(!d->use_new_vst)
-  {
-    precondition(in, precond, width, height, aa, bb);
-  }
-  else if(d->wavelet_color_mode == MODE_RGB)
-  {
-    precondition_v2(in, precond, width, height, d->a[1] * compensate_p, p, d->b[1], wb);
-  }
-  else
+  // the legacy full-image path needs in + out + 3 scratch buffers, see tiling_callback()
+  const gboolean strips = dt_conf_get_bool("plugins/darkroom/denoiseprofile/wavelets_strips")
+                          && !dt_tiling_piece_fits_host_memory(width, height, 4 * sizeof(float), 5.0f, 0);
+
+  const gboolean info = (darktable.unmuted & DT_DEBUG_PERF)
+                        && (piece->pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_EXPORT));
+  dt_times_t start_time = { 0 }, end_time = { 0 };
+  if(info) dt_get_times(&start_time);
+
+  if(!strips)
   {
-    precondition_Y0U0V0(in, precond, width, height, d->a[1] * compensate_p, p, d->b[1], toY0U0V0);
-  }
+    float *buf = NULL;
+    float *restrict precond = NULL;
+    float *restrict tmp = NULL;
+
+    if (!dt_iop_alloc_image_buffers(self, roi_in, roi_out, 4, &precond, 4, &tmp, 4, &buf, 0))
+    {
+      dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out, TRUE);
+      return;
+    }
 
-  debug_dump_PFM(piece,"/tmp/transformed.pfm",precond,width,height,0);
+    wavelets_precondition(d, in, precond, width, height, aa, bb, p, compensate_p, wb, toY0U0V0);
 
-  float *restrict buf1 = precond;
-  float *restrict buf2 = tmp;
+    debug_dump_PFM(piece,"/tmp/transformed.pfm",precond,width,height,0);
 
-  // clear the output buffer, which will be accumulating all of the detail scales
-  memset(out, 0, sizeof(float) * 4 * npixels);
+    float *restrict buf1 = precond;
+    float *restrict buf2 = tmp;
 
-  for(int scale = 0; scale < max_scale; scale++)
-  {
-    const float sigma = 1.0f;
-    const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
-    const float sigma_band = powf(varf, scale) * sigma;
-    dt_aligned_pixel_t sum_y2;
-    decompose(buf2, buf1, buf, sum_y2, scale, 1.0f / (sigma_band * sigma_band), width, height);
-    debug_dump_PFM(piece,"/tmp/coarse_%d.pfm",buf2,width,height,scale);
-    debug_dump_PFM(piece,"/tmp/detail_%d.pfm",buf,width,height,scale);
+    // clear the output buffer, which will be accumulating all of the detail scales
+    memset(out, 0, sizeof(float) * 4 * npixels);
 
-    const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
-    dt_aligned_pixel_t thrs;
-    variance_stabilizing_xform(thrs, scale, max_scale, npixels, sum_y2, d);
-    synthesize(out, out, buf, thrs, boost, width, height);
+    for(int scale = 0; scale < max_scale; scale++)
+    {
+      const float sigma = 1.0f;
+      const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
+      const float sigma_band = powf(varf, scale) * sigma;
+      dt_aligned_pixel_t sum_y2;
+      decompose(buf2, buf1, buf, sum_y2, scale, 1.0f / (sigma_band * sigma_band), width, height);
+      debug_dump_PFM(piece,"/tmp/coarse_%d.pfm",buf2,width,height,scale);
+      debug_dump_PFM(piece,"/tmp/detail_%d.pfm",buf,width,height,scale);
 
-    float *buf3 = buf2;
-    buf2 = buf1;
-    buf1 = buf3;
-  }
+      const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
+      dt_aligned_pixel_t thrs;
+      variance_stabilizing_xform(thrs, scale, max_scale, npixels, sum_y2, d);
+      synthesize(out, out, buf, thrs, boost, width, height);
+
+      float *buf3 = buf2;
+      buf2 = buf1;
+      buf1 = buf3;
+    }
 
-  // add in the final residue
+    // add in the final residue
 #ifdef _OPENMP
 #pragma omp simd aligned(buf1, out : 64)
 #endif
-  for (size_t k = 0; k < 4U * npixels; k++)
-    out[k] += buf1[k];
+    for (size_t k = 0; k < 4U * npixels; k++)
+      out[k] += buf1[k];
 
-  if(!d->use_new_vst)
-  {
-    backtransform(out, width, height, aa, bb);
-  }
-  else if(d->wavelet_color_mode == MODE_RGB)
-  {
-    backtransform_v2(out, width, height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(in_scale), wb);
+    wavelets_backtransform(d, out, width, height, aa, bb, p, compensate_p, in_scale, wb, toRGB);
+
+    dt_free_align(buf);
+    dt_free_align(tmp);
+    dt_free_align(precond);
   }
   else
   {
-    backtransform_Y0U0V0(out, width, height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(in_scale), wb, toRGB);
+    const int halo = wavelets_support(max_scale);
+    const int strip_rows = wavelets_strip_rows(max_scale);
+    const size_t strip_size = wavelets_strip_size(width, height, max_scale);
+
+    float *const restrict precond = dt_alloc_align_float(4 * strip_size);
+    float *const restrict tmp = dt_alloc_align_float(4 * strip_size);
+    float *const restrict buf = dt_alloc_align_float(4 * strip_size);
+    float *const restrict accum = dt_alloc_align_float(4 * strip_size);
+
+    if(!precond || !tmp || !buf || !accum)
+    {
+      if(precond) dt_free_align(precond);
+      if(tmp) dt_free_align(tmp);
+      if(buf) dt_free_align(buf);
+      if(accum) dt_free_align(accum);
+      dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out, TRUE);
+      return;
+    }
+
+    // pass 0 accumulates the energy of each detail scale over the inner rows of all strips,
+    // pass 1 denoises the strips with the resulting thresholds
+    double sum_y2[MAX_MAX_SCALE][3] = { { 0.0 } };
+    dt_aligned_pixel_t thrs[MAX_MAX_SCALE];
+
+    for(int pass = 0; pass < 2; pass++)
+    {
+      if(pass == 1)
+      {
+        for(int scale = 0; scale < max_scale; scale++)
+        {
+          const dt_aligned_pixel_t energy = { sum_y2[scale][0], sum_y2[scale][1], sum_y2[scale][2], 0.0f };
+          variance_stabilizing_xform(thrs[scale], scale, max_scale, npixels, energy, d);
+        }
+      }
+
+      for(int row_start = 0; row_start < height; row_start += strip_rows)
+      {
+        const int row_end = MIN(row_start + strip_rows, height);
+        const int top = MAX(row_start - halo, 0);
+        const int bottom = MIN(row_end + halo, height);
+        const int rows = bottom - top;
+        // offset and number of the rows of the strip that are exact and written to the output
+        const size_t inner = (size_t)4 * (row_start - top) * width;
+        const size_t inner_pixels = (size_t)(row_end - row_start) * width;
+
+        wavelets_precondition(d, in + (size_t)4 * top * width, precond, width, rows, aa, bb, p, compensate_p, wb,
+                              toY0U0V0);
+
+        float *restrict buf1 = precond;
+        float *restrict buf2 = tmp;
+
+        if(pass == 1) memset(accum, 0, sizeof(float) * 4 * width * rows);
+
+        for(int scale = 0; scale < max_scale; scale++)
+        {
+          const float sigma = 1.0f;
+          const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
+          const float sigma_band = powf(varf, scale) * sigma;
+          // the energy returned here includes the padding rows, we only count the inner ones below
+          dt_aligned_pixel_t strip_sum_y2;
+          decompose(buf2, buf1, buf, strip_sum_y2, scale, 1.0f / (sigma_band * sigma_band), width, rows);
+
+          if(pass == 0)
+          {
+            sum_squared_details(buf + inner, inner_pixels, sum_y2[scale]);
+          }
+          else
+          {
+            const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
+            synthesize(accum, accum, buf, thrs[scale], boost, width, rows);
+          }
+
+          float *buf3 = buf2;
+          buf2 = buf1;
+          buf1 = buf3;
+        }
+
+        if(pass == 0) continue;
+
+        // add in the final residue
+#ifdef _OPENMP
+#pragma omp simd aligned(buf1, accum : 64)
+#endif
+        for (size_t k = 0; k < (size_t)4 * width * rows; k++)
+          accum[k] += buf1[k];
+
+        wavelets_backtransform(d, accum, width, rows, aa, bb, p, compensate_p, in_scale, wb, toRGB);
+
+        memcpy(out + (size_t)4 * row_start * width, accum + inner, sizeof(float) * 4 * inner_pixels);
+      }
+    }
+
+    dt_free_align(accum);
+    dt_free_align(buf);
+    dt_free_align(tmp);
+    dt_free_align(precond);
   }
 
-  dt_free_align(buf);
-  dt_free_align(tmp);
-  dt_free_align(precond);
+  if(info)
+  {
+    const float mpixels = npixels / 1.0e6;
+    dt_get_times(&end_time);
+    const float tclock = end_time.clock - start_time.clock;
+    const float uclock = end_time.user - start_time.user;
+    fprintf(stderr, " [denoiseprofile] process wavelets CPU `%s' did %.2fmpix, %d scales, %.4f secs (%.4f CPU), %.2f mpix/s\n",
+            strips ? "strips" : "full image", mpixels, max_scale, tclock, uclock, mpixels / tclock);
+  }
 
   if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(ivoid, ovoid, width, height);
 
@@ -28,6 +28,7 @@
 #include "common/imagebuf.h"
 #include "common/iop_profile.h"
 #include "common/opencl.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "develop/develop.h"
 #include "develop/imageop_gui.h"
@@ -517,6 +518,39 @@ static inline unsigned int num_steps_to_reach_equivalent_sigma(const float sigma
   return s + 1;
 }
 
+// CPU temporal blocking : instead of sweeping the whole image once per scale and per iteration,
+// we solve several iterations over a tile while it stays in cache. One iteration reads pixels up to
+// 2 * mult away in each B-spline decomposition and up to mult away in each PDE step, so after n
+// iterations, the inner tile is exact as long as it is padded by n times that support on each side.
+// Tiles are processed in parallel, one per thread.
+#define DIFFUSE_TILE_SIZE 256
+
+static inline int diffusion_support(const int scales)
+{
+  // sum over scales of 2 * mult (decomposition) + mult (PDE)
+  return 3 * ((1 << scales) - 1);
+}
+
+static inline int diffusion_iterations_per_tile(const int scales)
+{
+  // pad the tile by at most half its size on each side, so the halo overhead stays below 4×.
+  // 0 means the support is too large to get any benefit and we should process the full image.
+  return DIFFUSE_TILE_SIZE / (2 * diffusion_support(scales));
+}
+
+// whether process() runs the tile-local path on a roi of width x height, and the size of its tiles. It is used
+// when the stencil support is small enough for the halo to pay off and the per-thread tiles don't need more
+// memory than the full-image buffers.
+static inline gboolean diffusion_cpu_tiled(const size_t width, const size_t height, const int scales,
+                                           int *block, size_t *tile_width, size_t *tile_height)
+{
+  *block = diffusion_iterations_per_tile(scales);
+  *tile_width = MIN(width, DIFFUSE_TILE_SIZE + 2 * (size_t)*block * diffusion_support(scales));
+  *tile_height = MIN(height, DIFFUSE_TILE_SIZE + 2 * (size_t)*block * diffusion_support(scales));
+  return dt_conf_get_bool("plugins/darkroom/diffuse/cpu_tiled") && *block > 0
+         && dt_get_num_threads() * *tile_width * *tile_height <= width * height;
+}
+
 void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                      const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
                      struct dt_develop_tiling_t *tiling)
@@ -529,13 +563,34 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
   const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
   const int max_filter_radius = (1 << scales);
 
-  // in + out + 2 * tmp + 2 * LF + s details + grey mask
-  tiling->factor = 6.25f + scales;
+  int block;
+  size_t tile_width, tile_height;
+  const gboolean tiled
+      = diffusion_cpu_tiled(roi_out->width, roi_out->height, scales, &block, &tile_width, &tile_height);
+
+  if(tiled)
+  {
+    // in + out + 2 * tmp + grey mask, the wavelets buffers only exist per thread over padded tiles:
+    // 2 tiles + 2 * LF + s details + grey mask + the rows of the decomposition.
+    // should the tiling make process() fall back to the full image path on smaller rois, this overhead
+    // still covers its extra buffers since the threads' tiles are larger than the roi then.
+    const size_t threads = dt_get_num_threads();
+    const size_t tile_size = tile_width * tile_height;
+    tiling->factor = 4.25f;
+    const size_t overhead = threads * (sizeof(float) * 4 * (4 + scales) * tile_size + tile_size
+                                       + sizeof(float) * 4 * tile_width * threads);
+    tiling->overhead = MIN(overhead, G_MAXUINT);
+  }
+  else
+  {
+    // in + out + 2 * tmp + 2 * LF + s details + grey mask
+    tiling->factor = 6.25f + scales;
+    tiling->overhead = 0;
+  }
   tiling->factor_cl = 6.25f + scales;
 
   tiling->maxbuf = 1.0f;
   tiling->maxbuf_cl = 1.0f;
-  tiling->overhead = 0;
   tiling->overlap = max_filter_radius;
   tiling->xalign = 1;
   tiling->yalign = 1;
@@ -915,7 +970,9 @@ static inline gint wavelets_process(const float *const restrict in, float *const
                                     const int has_mask,
                                     float *const restrict HF[MAX_NUM_SCALES],
                                     float *const restrict LF_odd,
-                                    float *const restrict LF_even)
+                                    float *const restrict LF_even,
+                                    float *const restrict tempbuf,
+                                    const size_t padded_size)
 {
   gint success = TRUE;
 
@@ -938,9 +995,7 @@ static inline gint wavelets_process(const float *const restrict in, float *const
   // there is a paper from a guy we know that explains it : https://jo.dreggn.org/home/2010_atrous.pdf
   // the wavelets decomposition here is the same as the equalizer/atrous module,
   float *restrict residual; // will store the temp buffer containing the last step of blur
-  // allocate a one-row temporary buffer for the decomposition
-  size_t padded_size;
-  float *const DT_ALIGNED_ARRAY tempbuf = dt_alloc_perthread_float(4 * width, &padded_size); //TODO: alloc in caller
+  // tempbuf is a per-thread one-row temporary buffer for the decomposition, allocated by the caller
   for(int s = 0; s < scales; ++s)
   {
     /* fprintf(stdout, "Wavelet decompose : scale %i\n", s); */
@@ -978,7 +1033,6 @@ static inline gint wavelets_process(const float *const restrict in, float *const
     dump_PFM(name, buffer_out, width, height);
 #endif
   }
-  dt_free_align(tempbuf);
 
   // will store the temp buffer NOT containing the last step of blur
   float *restrict temp = (residual == LF_even) ? LF_odd : LF_even;
@@ -1087,6 +1141,114 @@ static inline void inpaint_mask(float *const restrict inpainted, const float *co
   }
 }
 
+static gboolean process_tiled(const float *const restrict in, float *const restrict out,
+                              float *const restrict temp, const uint8_t *const restrict mask,
+                              const size_t width, const size_t height, const dt_iop_diffuse_data_t *const data,
+                              const float final_radius, const float zoom, const int scales, const int has_mask,
+                              const int iterations, const int block)
+{
+  const int support = diffusion_support(scales);
+  const size_t max_halo = (size_t)block * support;
+  const size_t tile_width = MIN(width, DIFFUSE_TILE_SIZE + 2 * max_halo);
+  const size_t tile_height = MIN(height, DIFFUSE_TILE_SIZE + 2 * max_halo);
+  const size_t tile_size = tile_width * tile_height;
+  const size_t num_horizontal = (width + DIFFUSE_TILE_SIZE - 1) / DIFFUSE_TILE_SIZE;
+  const size_t num_vertical = (height + DIFFUSE_TILE_SIZE - 1) / DIFFUSE_TILE_SIZE;
+  const int num_blocks = (iterations + block - 1) / block;
+
+  gboolean out_of_memory = FALSE;
+  const float *restrict src = in;
+
+  for(int b = 0; b < num_blocks; b++)
+  {
+    // ping-pong between temp and out so that the last block writes into out
+    float *const restrict dst = ((num_blocks - 1 - b) % 2 == 0) ? out : temp;
+    const int block_iterations = MIN(block, iterations - b * block);
+    const size_t halo = (size_t)block_iterations * support;
+
+#ifdef _OPENMP
+#pragma omp parallel default(none) \
+    dt_omp_firstprivate(src, dst, mask, width, height, data, final_radius, zoom, scales, has_mask, \
+                        block_iterations, halo, tile_width, tile_height, tile_size, num_horizontal, num_vertical) \
+    shared(out_of_memory)
+#endif
+    {
+      // thread-private tile buffers. The OpenMP loops in wavelets_process run nested, hence single-threaded.
+      float *restrict tile_a = dt_alloc_align_float(tile_size * 4);
+      float *restrict tile_b = dt_alloc_align_float(tile_size * 4);
+      float *const restrict LF_odd = dt_alloc_align_float(tile_size * 4);
+      float *const restrict LF_even = dt_alloc_align_float(tile_size * 4);
+      uint8_t *const restrict tile_mask = dt_alloc_align(64, sizeof(uint8_t) * tile_size);
+      size_t padded_size;
+      float *const restrict tempbuf = dt_alloc_perthread_float(4 * tile_width, &padded_size);
+      float *restrict HF[MAX_NUM_SCALES] = { NULL };
+      gboolean local_oom = (!tile_a || !tile_b || !LF_odd || !LF_even || !tile_mask || !tempbuf);
+      for(int s = 0; s < scales; s++)
+      {
+        HF[s] = dt_alloc_align_float(tile_size * 4);
+        if(!HF[s]) local_oom = TRUE;
+      }
+      if(local_oom) out_of_memory = TRUE;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic) collapse(2)
+#endif
+      for(size_t tile_vertical = 0; tile_vertical < num_vertical; tile_vertical++)
+        for(size_t tile_horizontal = 0; tile_horizontal < num_horizontal; tile_horizontal++)
+        {
+          if(local_oom) continue;
+
+          // inner region written to dst
+          const size_t row_start = tile_vertical * DIFFUSE_TILE_SIZE;
+          const size_t row_end = MIN(row_start + DIFFUSE_TILE_SIZE, height);
+          const size_t col_start = tile_horizontal * DIFFUSE_TILE_SIZE;
+          const size_t col_end = MIN(col_start + DIFFUSE_TILE_SIZE, width);
+
+          // padded region read from src. Where it touches the image borders, the clamping done by
+          // the filters on the tile is the same as on the full image.
+          const size_t top = (row_start > halo) ? row_start - halo : 0;
+          const size_t bottom = MIN(row_end + halo, height);
+          const size_t left = (col_start > halo) ? col_start - halo : 0;
+          const size_t right = MIN(col_end + halo, width);
+          const size_t w = right - left;
+          const size_t h = bottom - top;
+
+          for(size_t i = 0; i < h; i++)
+          {
+            memcpy(tile_a + 4 * i * w, src + 4 * ((top + i) * width + left), sizeof(float) * 4 * w);
+            if(has_mask) memcpy(tile_mask + i * w, mask + (top + i) * width + left, sizeof(uint8_t) * w);
+          }
+
+          for(int it = 0; it < block_iterations; it++)
+          {
+            wavelets_process(tile_a, tile_b, tile_mask, w, h, data, final_radius, zoom, scales, has_mask, HF,
+                             LF_odd, LF_even, tempbuf, padded_size);
+            float *const restrict swap = tile_a;
+            tile_a = tile_b;
+            tile_b = swap;
+          }
+
+          for(size_t i = row_start; i < row_end; i++)
+            memcpy(dst + 4 * (i * width + col_start), tile_a + 4 * ((i - top) * w + (col_start - left)),
+                   sizeof(float) * 4 * (col_end - col_start));
+        }
+
+      if(tile_a) dt_free_align(tile_a);
+      if(tile_b) dt_free_align(tile_b);
+      if(LF_odd) dt_free_align(LF_odd);
+      if(LF_even) dt_free_align(LF_even);
+      if(tile_mask) dt_free_align(tile_mask);
+      if(tempbuf) dt_free_align(tempbuf);
+      for(int s = 0; s < scales; s++) if(HF[s]) dt_free_align(HF[s]);
+    }
+
+    if(out_of_memory) return FALSE;
+    src = dst;
+  }
+
+  return TRUE;
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const restrict ivoid,
              void *const restrict ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -1098,6 +1260,23 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   float *restrict in = DT_IS_ALIGNED((float *const restrict)ivoid);
   float *const restrict out = DT_IS_ALIGNED((float *const restrict)ovoid);
 
+  const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
+  const float final_radius = (data->radius + data->radius_center) * 2.f / scale;
+
+  const int iterations = MAX(ceilf((float)data->iterations), 1);
+  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
+  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+
+  // use the tile-local path when the stencil support is small enough, see diffusion_cpu_tiled()
+  int block;
+  size_t tile_width, tile_height;
+  const gboolean tiled = diffusion_cpu_tiled(width, height, scales, &block, &tile_width, &tile_height);
+
+  const gboolean info = (darktable.unmuted & DT_DEBUG_PERF)
+                         && (piece->pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_EXPORT));
+  dt_times_t start_time = { 0 }, end_time = { 0 };
+  if(info) dt_get_times(&start_time);
+
   float *const restrict temp1 = dt_alloc_align_float((size_t)roi_out->width * roi_out->height * 4);
   float *const restrict temp2 = dt_alloc_align_float((size_t)roi_out->width * roi_out->height * 4);
 
@@ -1106,31 +1285,37 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 
   uint8_t *const restrict mask = dt_alloc_align(64, sizeof(uint8_t) * roi_out->width * roi_out->height);
 
-  const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
-  const float final_radius = (data->radius + data->radius_center) * 2.f / scale;
-
-  const int iterations = MAX(ceilf((float)data->iterations), 1);
-  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
-  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
-
   gboolean out_of_memory = FALSE;
 
-  // wavelets scales buffers
-  float *restrict HF[MAX_NUM_SCALES];
-  for(int s = 0; s < scales; s++)
+  // wavelets scales buffers, only needed over the full image in non-tiled mode
+  float *restrict HF[MAX_NUM_SCALES] = { NULL };
+  float *restrict LF_odd = NULL;
+  float *restrict LF_even = NULL;
+  float *restrict tempbuf = NULL;
+  size_t padded_size = 0;
+
+  if(!tiled)
   {
-    HF[s] = dt_alloc_align_float(width * height * 4);
-    if(!HF[s]) out_of_memory = TRUE;
-  }
+    for(int s = 0; s < scales; s++)
+    {
+      HF[s] = dt_alloc_align_float(width * height * 4);
+      if(!HF[s]) out_of_memory = TRUE;
+    }
 
-  // temp buffer for blurs. We will need to cycle between them for memory efficiency
-  float *const restrict LF_odd = dt_alloc_align_float(width * height * 4);
-  float *const restrict LF_even = dt_alloc_align_float(width * height * 4);
+    // temp buffer for blurs. We will need to cycle between them for memory efficiency
+    LF_odd = dt_alloc_align_float(width * height * 4);
+    LF_even = dt_alloc_align_float(width * height * 4);
+
+    // one-row temporary buffer per thread for the decomposition
+    tempbuf = dt_alloc_perthread_float(4 * width, &padded_size);
+
+    if(!LF_odd || !LF_even || !tempbuf) out_of_memory = TRUE;
+  }
 
   // PAUSE !
   // check that all buffers exist before processing,
   // because we use a lot of memory here.
-  if(!temp1 || !temp2 || !LF_odd || !LF_even || out_of_memory)
+  if(!temp1 || !temp2 || !mask || out_of_memory)
   {
     dt_control_log(_("diffuse/sharpen failed to allocate memory, check your RAM settings"));
     goto error;
@@ -1149,30 +1334,52 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
     in = temp1;
   }
 
-  for(int it = 0; it < iterations; it++)
+  if(tiled)
   {
-    if(it == 0)
+    if(!process_tiled(in, out, temp2, mask, width, height, data, final_radius, scale, scales, has_mask,
+                      iterations, block))
     {
-      temp_in = in;
-      temp_out = temp2;
-    }
-    else if(it % 2 == 0)
-    {
-      temp_in = temp1;
-      temp_out = temp2;
+      dt_control_log(_("diffuse/sharpen failed to allocate memory, check your RAM settings"));
+      goto error;
     }
-    else
+  }
+  else
+  {
+    for(int it = 0; it < iterations; it++)
     {
-      temp_in = temp2;
-      temp_out = temp1;
-    }
+      if(it == 0)
+      {
+        temp_in = in;
+        temp_out = temp2;
+      }
+      else if(it % 2 == 0)
+      {
+        temp_in = temp1;
+        temp_out = temp2;
+      }
+      else
+      {
+        temp_in = temp2;
+        temp_out = temp1;
+      }
+
+      if(it == (int)iterations - 1)
+        temp_out = out;
 
-    if(it == (int)iterations - 1)
-      temp_out = out;
+      wavelets_process(temp_in, temp_out, mask,
+                       roi_out->width, roi_out->height,
+                       data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even, tempbuf, padded_size);
+    }
+  }
 
-    wavelets_process(temp_in, temp_out, mask,
-                     roi_out->width, roi_out->height,
-                     data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
+  if(info)
+  {
+    const float mpixels = (width * height) / 1.0e6;
+    dt_get_times(&end_time);
+    const float tclock = end_time.clock - start_time.clock;
+    const float uclock = end_time.user - start_time.user;
+    fprintf(stderr, " [diffuse] process CPU `%s' did %.2fmpix, %d iterations, %d scales, %.4f secs (%.4f CPU), %.2f mpix/s\n",
+            tiled ? "tiled" : "full image", mpixels, iterations, scales, tclock, uclock, mpixels / tclock);
   }
 
 error:
@@ -1181,6 +1388,7 @@ error:
   if(temp2) dt_free_align(temp2);
   if(LF_even) dt_free_align(LF_even);
   if(LF_odd) dt_free_align(LF_odd);
+  if(tempbuf) dt_free_align(tempbuf);
   for(int s = 0; s < scales; s++) if(HF[s]) dt_free_align(HF[s]);
 }
 
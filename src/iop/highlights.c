@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "bauhaus/bauhaus.h"
+#include "common/dwt.h"
 #include "common/opencl.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -37,6 +38,11 @@
 #include <gtk/gtk.h>
 #include <inttypes.h>
 
+// radius in pixels of the full image up to which the wavelets mode looks for the color of the clipped areas
+#define WAVELETS_RADIUS 512
+#define WAVELETS_MAX_SCALES 8
+// minimal share of unclipped pixels around a clipped one to take the color from a scale
+#define WAVELETS_MIN_WEIGHT 0.2f
 
 DT_MODULE_INTROSPECTION(2, dt_iop_highlights_params_t)
 
@@ -45,6 +51,7 @@ typedef enum dt_iop_highlights_mode_t
   DT_IOP_HIGHLIGHTS_CLIP = 0,    // $DESCRIPTION: "clip highlights"
   DT_IOP_HIGHLIGHTS_LCH = 1,     // $DESCRIPTION: "reconstruct in LCh"
   DT_IOP_HIGHLIGHTS_INPAINT = 2, // $DESCRIPTION: "reconstruct color"
+  DT_IOP_HIGHLIGHTS_WAVELETS = 3, // $DESCRIPTION: "reconstruct with wavelets"
 } dt_iop_highlights_mode_t;
 
 typedef struct dt_iop_highlights_params_t
@@ -232,6 +239,21 @@ error:
 }
 #endif
 
+// number of wavelet scales covering WAVELETS_RADIUS at the scale of the roi
+static int _wavelets_scales(const dt_dev_pixelpipe_iop_t *const piece, const dt_iop_roi_t *const roi)
+{
+  const float radius = WAVELETS_RADIUS * roi->scale / piece->iscale;
+  int scales = 1;
+  while(scales < WAVELETS_MAX_SCALES && 2 * ((1 << scales) - 1) < radius) scales++;
+  return scales;
+}
+
+// distance up to which the a-trous decomposition on scales reads its input
+static int _wavelets_reach(const int scales)
+{
+  return 2 * ((1 << scales) - 1);
+}
+
 void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
               const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
               struct dt_develop_tiling_t *tiling)
@@ -243,6 +265,17 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
   tiling->maxbuf = 1.0f;
   tiling->overhead = 0;
 
+  if(filters && d->mode == DT_IOP_HIGHLIGHTS_WAVELETS)
+  {
+    // in + out + 4 channel rgb, coarse and color buffers + the two buffers of the decomposition
+    tiling->factor = 2.0f + 5 * 4;
+    tiling->maxbuf = 1.0f;
+    tiling->xalign = (filters == 9u) ? 6 : 2;
+    tiling->yalign = (filters == 9u) ? 6 : 2;
+    tiling->overlap = _wavelets_reach(_wavelets_scales(piece, roi_in));
+    return;
+  }
+
   if(filters == 9u)
   {
     // xtrans
@@ -802,6 +835,190 @@ static void process_clip(dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
   }
 }
 
+typedef struct _wavelets_t
+{
+  float *coarse; // low pass of the weighted rgb image at the current scale
+  float *color;  // rgb share of the clipped pixels, alpha set once known
+} _wavelets_t;
+
+// called for the image, each detail scale and the residual. the coarse image is followed down the scales and
+// each clipped pixel takes its color from the finest scale where enough unclipped pixels are around it.
+static void _wavelets_layer(float *layer, dwt_params_t *const p, const int scale)
+{
+  _wavelets_t *const wt = (_wavelets_t *)p->user_data;
+  float *const restrict coarse = wt->coarse;
+  float *const restrict color = wt->color;
+  const size_t npixels = (size_t)p->width * p->height;
+
+  if(scale == 0)
+  {
+    memcpy(coarse, layer, sizeof(float) * 4 * npixels);
+    return;
+  }
+
+  // the residual is the coarse image of the last scale, use whatever is left there
+  const gboolean residual = scale > p->scales;
+  const float min_weight = residual ? 1e-6f : WAVELETS_MIN_WEIGHT;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(coarse, color, layer, min_weight, npixels, residual) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < npixels; k++)
+  {
+    if(!residual)
+    {
+      for_four_channels(c, aligned(coarse, layer : 16)) coarse[4 * k + c] -= layer[4 * k + c];
+    }
+
+    if(color[4 * k + 3] != 0.0f || coarse[4 * k + 3] < min_weight) continue;
+
+    // the weights cancel out in the shares
+    const float sum = coarse[4 * k] + coarse[4 * k + 1] + coarse[4 * k + 2];
+    if(sum <= 0.0f) continue;
+    for(int c = 0; c < 3; c++) color[4 * k + c] = coarse[4 * k + c] / sum;
+    color[4 * k + 3] = 1.0f;
+  }
+}
+
+// average of the samples of each color on the 3x3 neighbourhood of a site, returns whether any of them is clipped
+static inline int _wavelets_site_rgb(const float *const in, const int j, const int i, const int width,
+                                     const int height, const dt_iop_roi_t *const roi, const uint32_t filters,
+                                     const uint8_t (*const xtrans)[6], const float *const clips,
+                                     float *const rgb, int *const count, const gboolean limit)
+{
+  int clipped = 0;
+  for(int c = 0; c < 3; c++)
+  {
+    rgb[c] = 0.0f;
+    count[c] = 0;
+  }
+  for(int jj = -1; jj <= 1; jj++)
+  {
+    for(int ii = -1; ii <= 1; ii++)
+    {
+      const int y = CLAMP(j + jj, 0, height - 1);
+      const int x = CLAMP(i + ii, 0, width - 1);
+      const int c = fcol(y + roi->y, x + roi->x, filters, xtrans);
+      const float val = in[(size_t)y * width + x];
+      clipped = clipped || (val >= clips[c]);
+      // the clipped samples are only lower bounds
+      rgb[c] += limit ? fminf(val, clips[c]) : val;
+      count[c]++;
+    }
+  }
+  for(int c = 0; c < 3; c++)
+    if(count[c]) rgb[c] /= count[c];
+  return clipped;
+}
+
+/* the color of the clipped areas is propagated from the unclipped pixels around them on a-trous wavelet
+ * scales (normalized convolution of the unclipped pixels), their brightness is then the highest one
+ * consistent with the unclipped channels and the clipping thresholds. every step is a parallel loop over
+ * the pixels and the reach of the decomposition is covered by the tiling overlap. */
+static void process_wavelets(dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
+                             const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                             const float clip, const float *const clips)
+{
+  const uint32_t filters = piece->pipe->dsc.filters;
+  const uint8_t(*const xtrans)[6] = (const uint8_t(*const)[6])piece->pipe->dsc.xtrans;
+  const float *const in = (const float *const)ivoid;
+  float *const out = (float *const)ovoid;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const size_t npixels = (size_t)width * height;
+  const float clip_max = fmaxf(fmaxf(clips[0], clips[1]), clips[2]);
+
+  float *const rgb = dt_alloc_align_float(4 * npixels);
+  float *const coarse = dt_alloc_align_float(4 * npixels);
+  float *const color = dt_alloc_align_float(4 * npixels);
+  if(!rgb || !coarse || !color)
+  {
+    // out of memory, clip instead
+    process_clip(piece, ivoid, ovoid, roi_in, roi_out, clip);
+    goto cleanup;
+  }
+
+  // rgb of every site, only the ones without any clipped sample around carry weight
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(clips, color, filters, height, in, rgb, roi_in, width, xtrans) \
+  schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    for(int i = 0; i < width; i++)
+    {
+      const size_t k = (size_t)j * width + i;
+      float site[3];
+      int count[3];
+      const int clipped = _wavelets_site_rgb(in, j, i, width, height, roi_in, filters, xtrans, clips, site,
+                                             count, FALSE);
+      const float weight = (clipped || !count[0] || !count[1] || !count[2]) ? 0.0f : 1.0f;
+      for(int c = 0; c < 3; c++)
+      {
+        rgb[4 * k + c] = weight * site[c];
+        color[4 * k + c] = 0.0f;
+      }
+      rgb[4 * k + 3] = weight;
+      color[4 * k + 3] = clipped ? 0.0f : 1.0f;
+    }
+  }
+
+  _wavelets_t wt = { .coarse = coarse, .color = color };
+  const int scales = _wavelets_scales(piece, roi_in);
+  dwt_params_t *dwt_p = dt_dwt_init(rgb, width, height, 4, scales, scales + 1, 0, &wt, 1.0f, 0);
+  if(dwt_p == NULL)
+  {
+    process_clip(piece, ivoid, ovoid, roi_in, roi_out, clip);
+    goto cleanup;
+  }
+  dwt_decompose(dwt_p, _wavelets_layer);
+  dt_dwt_free(dwt_p);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(clip, clip_max, clips, color, filters, height, in, out, roi_in, roi_out, width, xtrans) \
+  schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    for(int i = 0; i < width; i++)
+    {
+      const size_t k = (size_t)j * width + i;
+      const int f = fcol(j + roi_out->y, i + roi_out->x, filters, xtrans);
+      if(in[k] < clips[f])
+      {
+        out[k] = in[k];
+        continue;
+      }
+
+      const float *const share = color + 4 * k;
+      if(share[3] == 0.0f)
+      {
+        // nothing unclipped in reach
+        out[k] = fminf(in[k], clip);
+        continue;
+      }
+
+      float site[3];
+      int count[3];
+      _wavelets_site_rgb(in, j, i, width, height, roi_in, filters, xtrans, clips, site, count, TRUE);
+      float level = 0.0f;
+      for(int c = 0; c < 3; c++)
+        if(count[c] && share[c] > 0.0f) level = fmaxf(level, site[c] / share[c]);
+
+      out[k] = CLAMP(level * share[f], clips[f], clip_max);
+    }
+  }
+
+cleanup:
+  dt_free_align(color);
+  dt_free_align(coarse);
+  dt_free_align(rgb);
+}
+
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -891,6 +1108,14 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
       else
         process_lch_bayer(self, piece, ivoid, ovoid, roi_in, roi_out, clip);
       break;
+    case DT_IOP_HIGHLIGHTS_WAVELETS:
+    {
+      const float clips[4] = { 0.987 * data->clip * piece->pipe->dsc.processed_maximum[0],
+                               0.987 * data->clip * piece->pipe->dsc.processed_maximum[1],
+                               0.987 * data->clip * piece->pipe->dsc.processed_maximum[2], clip };
+      process_wavelets(piece, ivoid, ovoid, roi_in, roi_out, clip, clips);
+      break;
+    }
     default:
     case DT_IOP_HIGHLIGHTS_CLIP:
       process_clip(piece, ivoid, ovoid, roi_in, roi_out, clip);
@@ -914,8 +1139,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 
   piece->process_cl_ready = 1;
 
-  // no OpenCL for DT_IOP_HIGHLIGHTS_INPAINT yet.
-  if(d->mode == DT_IOP_HIGHLIGHTS_INPAINT) piece->process_cl_ready = 0;
+  // no OpenCL for DT_IOP_HIGHLIGHTS_INPAINT and DT_IOP_HIGHLIGHTS_WAVELETS yet.
+  if(d->mode == DT_IOP_HIGHLIGHTS_INPAINT || d->mode == DT_IOP_HIGHLIGHTS_WAVELETS) piece->process_cl_ready = 0;
 }
 
 void init_global(dt_iop_module_so_t *module)
@@ -52,6 +52,14 @@ const int   LOOKUP_OVERSAMPLE = 10;
 const int   INTERPOLATION_POINTS = 100; // when interpolating bezier
 const float STAMP_RELOCATION = 0.1;     // how many radii to move stamp forward when following a path
 
+// cached distortion maps: at most this many, for at most this many bytes or a share of the memory darktable
+// may use for the pipes, and maps bigger than the largest size are built for the requested region only and not
+// cached
+#define MAP_CACHE_ENTRIES 8
+#define MAP_CACHE_MAX_SIZE ((size_t)512 << 20)
+#define MAP_CACHE_MEM_SHARE 8
+#define MAP_CACHE_MAX_MAP_SIZE ((size_t)128 << 20)
+
 #define CONF_RADIUS "plugins/darkroom/liquify/radius"
 #define CONF_ANGLE "plugins/darkroom/liquify/angle"
 #define CONF_STRENGTH "plugins/darkroom/liquify/strength"
@@ -256,9 +264,27 @@ typedef struct
   dt_liquify_path_data_t nodes[MAX_NODES];
 } dt_iop_liquify_params_t;
 
+// A distortion map of all the warps of an instance, shared by all pipes through the global data.
+typedef struct dt_liquify_map_t
+{
+  uint64_t hash;                // hash of the paths distorted into the piece at scale 1.0
+  float scale;                  // scale the map was built at
+  gboolean inverted;            // inverted map, used by distort_transform()
+  gboolean resampled;           // approximated from a finer map, only good enough for the preview
+  gboolean partial;             // built for the warps touching roi only
+  cairo_rectangle_int_t roi;    // region where a partial map is exact
+  cairo_rectangle_int_t extent; // extent of the warps of the map at this scale
+  float complex *map;
+  int users;                    // number of callers currently reading the map
+  gboolean evicted;             // not in the cache anymore, freed when the last user releases it
+} dt_liquify_map_t;
+
 typedef struct
 {
   int warp_kernel;
+  dt_pthread_mutex_t map_cache_lock;
+  GList *map_cache;             // dt_liquify_map_t, most recently used first
+  size_t map_cache_size;        // total size of the cached maps in bytes
 } dt_iop_liquify_global_data_t;
 
 typedef struct
@@ -1040,62 +1066,65 @@ static void apply_global_distortion_map(struct dt_iop_module_t *module,
   const struct dt_interpolation * const interpolation =
     dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
+  // the map may be larger than roi_out, only walk the part inside
+  const int x_start = MAX(extent->x, roi_out->x);
+  const int x_end = MIN(extent->x + extent->width, roi_out->x + roi_out->width);
+  const int y_start = MAX(extent->y, roi_out->y);
+  const int y_end = MIN(extent->y + extent->height, roi_out->y + roi_out->height);
+
   #ifdef _OPENMP
   #pragma omp parallel for schedule (static) default (shared)
   #endif
 
-  for(int y = extent->y; y < extent->y + extent->height; y++)
+  for(int y = y_start; y < y_end; y++)
   {
-    // point inside roi_out ?
-    if(y >= roi_out->y && y < roi_out->y + roi_out->height)
+    const float complex *row = map + (size_t)(y - extent->y) * extent->width + x_start - extent->x;
+    float* out_sample = out + ((size_t)(y - roi_out->y) * roi_out->width +
+                             x_start - roi_out->x) * ch;
+    for(int x = x_start; x < x_end; x++)
     {
-      const float complex *row = map + (y - extent->y) * extent->width;
-      float* out_sample = out + ((y - roi_out->y) * roi_out->width +
-                               extent->x - roi_out->x) * ch;
-      for(int x = extent->x; x < extent->x + extent->width; x++)
+      // point actually warped ?
+      if(*row != 0)
       {
-        if(
-          // point inside roi_out ?
-          (x >= roi_out->x && x < roi_out->x + roi_out->width) &&
-          // point actually warped ?
-          (*row != 0))
-        {
-          if(ch == 1)
-            *out_sample = dt_interpolation_compute_sample(interpolation,
-                                                          in,
-                                                          x + crealf(*row) - roi_in->x,
-                                                          y + cimagf(*row) - roi_in->y,
-                                                          roi_in->width,
-                                                          roi_in->height,
-                                                          ch,
-                                                          ch_width);
-          else
-            dt_interpolation_compute_pixel4c(
-              interpolation,
-              in,
-              out_sample,
-              x + crealf(*row) - roi_in->x,
-              y + cimagf(*row) - roi_in->y,
-              roi_in->width,
-              roi_in->height,
-              ch_width);
+        if(ch == 1)
+          *out_sample = dt_interpolation_compute_sample(interpolation,
+                                                        in,
+                                                        x + crealf(*row) - roi_in->x,
+                                                        y + cimagf(*row) - roi_in->y,
+                                                        roi_in->width,
+                                                        roi_in->height,
+                                                        ch,
+                                                        ch_width);
+        else
+          dt_interpolation_compute_pixel4c(
+            interpolation,
+            in,
+            out_sample,
+            x + crealf(*row) - roi_in->x,
+            y + cimagf(*row) - roi_in->y,
+            roi_in->width,
+            roi_in->height,
+            ch_width);
 
-        }
-        ++row;
-        out_sample += ch;
       }
+      ++row;
+      out_sample += ch;
     }
   }
 }
 
-// calculate the map extent.
+// calculate the map extent, of all paths if roi_out is NULL.
 
 static GSList *_get_map_extent(const dt_iop_roi_t *roi_out,
                                const GList *interpolated,
                                cairo_rectangle_int_t *map_extent)
 {
-  const cairo_rectangle_int_t roi_out_rect = { roi_out->x, roi_out->y, roi_out->width, roi_out->height };
-  cairo_region_t *roi_out_region = cairo_region_create_rectangle(&roi_out_rect);
+  cairo_region_t *roi_out_region = NULL;
+  if(roi_out)
+  {
+    const cairo_rectangle_int_t roi_out_rect = { roi_out->x, roi_out->y, roi_out->width, roi_out->height };
+    roi_out_region = cairo_region_create_rectangle(&roi_out_rect);
+  }
   cairo_region_t *map_region = cairo_region_create();
   GSList *in_roi = NULL;
 
@@ -1105,7 +1134,7 @@ static GSList *_get_map_extent(const dt_iop_roi_t *roi_out,
     cairo_rectangle_int_t r;
     compute_round_stamp_extent(&r, warp);
     // add extent if not entirely outside the roi
-    if(cairo_region_contains_rectangle(roi_out_region, &r) != CAIRO_REGION_OVERLAP_OUT)
+    if(!roi_out_region || cairo_region_contains_rectangle(roi_out_region, &r) != CAIRO_REGION_OVERLAP_OUT)
     {
       cairo_region_union_rectangle(map_region, &r);
       in_roi = g_slist_prepend(in_roi, i->data);
@@ -1115,14 +1144,71 @@ static GSList *_get_map_extent(const dt_iop_roi_t *roi_out,
   // return the paths and the extent of all paths
   cairo_region_get_extents(map_region, map_extent);
   cairo_region_destroy(map_region);
-  cairo_region_destroy(roi_out_region);
+  if(roi_out_region) cairo_region_destroy(roi_out_region);
 
   return g_slist_reverse(in_roi);
 }
 
+static float complex *invert_global_distortion_map(const float complex *const map,
+                                                   const cairo_rectangle_int_t *map_extent)
+{
+  const size_t mapsize = (size_t)map_extent->width * map_extent->height;
+  float complex * const imap = dt_alloc_align(64, sizeof(float complex) * mapsize);
+  memset(imap, 0, sizeof(float complex) * mapsize);
+
+  // copy map into imap(inverted map).
+  // imap [ n + dx(map[n]) , n + dy(map[n]) ] = -map[n]
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule (static) default (shared)
+  #endif
+
+  for(int y = 0; y <  map_extent->height; y++)
+  {
+    const float complex *const row = map + y * map_extent->width;
+    for(int x = 0; x < map_extent->width; x++)
+    {
+      const float complex d = row[x];
+      // compute new position (nx,ny) given the displacement d
+      const int nx = x + (int)crealf(d);
+      const int ny = y + (int)cimagf(d);
+
+      // if the point falls into the extent, set it
+      if(nx>0 && nx<map_extent->width && ny>0 && ny<map_extent->height)
+        imap[nx + ny * map_extent->width] = -d;
+    }
+  }
+
+  // now just do a pass to avoid gap with a displacement of zero, note that we do not need high
+  // precision here as the inverted distortion mask is only used to compute a final displacement
+  // of points.
+
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule (static) default (shared)
+  #endif
+
+  for(int y = 0; y <  map_extent->height; y++)
+  {
+    float complex *const row = imap + y * map_extent->width;
+    float complex last[2] = { 0, 0 };
+    for(int x = 0; x < map_extent->width / 2 + 1; x++)
+    {
+      float complex *cl = row + x;
+      float complex *cr = row + map_extent->width - x;
+      if(x!=0)
+      {
+        if(*cl == 0) *cl = last[0];
+        if(*cr == 0) *cr = last[1];
+      }
+      last[0] = *cl; last[1] = *cr;
+    }
+  }
+
+  return imap;
+}
+
 static float complex *create_global_distortion_map(const cairo_rectangle_int_t *map_extent,
-                                                   const GSList *interpolated,
-                                                   gboolean inverted)
+                                                   const GSList *interpolated)
 {
   const int mapsize = map_extent->width * map_extent->height;
   if (mapsize == 0)
@@ -1147,86 +1233,348 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
     free((void *) stamp);
   }
 
-  if(inverted)
+  return map;
+}
+
+/*
+  Distortion map cache.
+
+  Building the map is by far the most expensive part of this module, yet the map only depends
+  on the warps once distorted into the piece and on the scale. The maps are thus kept in the
+  global data, keyed on a hash of the paths distorted to full resolution and on the scale
+  relative to the full resolution image. This way a map is reused when only downstream
+  modules change, by all the tiles of an export, by distort_transform() and
+  distort_backtransform() and, after resampling, by the preview pipe.
+
+  The cached maps always cover the extent of all the warps, callers only read the part they need.
+*/
+
+static uint64_t _paths_hash(const dt_iop_liquify_params_t *p)
+{
+  uint64_t hash = 5381;
+#define HASH_INT(v) hash = ((hash << 5) + hash) ^ (uint64_t)(v)
+  // the paths are at full resolution here, a 1/8 pixel quantization allows the maps of the
+  // preview and the full pipe to match in spite of rounding differences.
+#define HASH_POINT(v) { HASH_INT(lroundf(crealf(v) * 8.0f)); HASH_INT(lroundf(cimagf(v) * 8.0f)); }
+
+  for(int k = 0; k < MAX_NODES; k++)
   {
-    float complex * const imap = dt_alloc_align(64, sizeof(float complex) * mapsize);
-    memset(imap, 0, sizeof(float complex) * mapsize);
+    const dt_liquify_path_data_t *data = &p->nodes[k];
+    if(data->header.type == DT_LIQUIFY_PATH_INVALIDATED)
+      break;
+
+    HASH_INT(data->header.type);
+    HASH_INT(data->warp.type);
+    HASH_INT(lroundf(data->warp.control1 * 65536.0f));
+    HASH_INT(lroundf(data->warp.control2 * 65536.0f));
+    HASH_POINT(data->warp.point);
+    HASH_POINT(data->warp.strength);
+    HASH_POINT(data->warp.radius);
+    if(data->header.type == DT_LIQUIFY_PATH_CURVE_TO_V1)
+    {
+      HASH_POINT(data->node.ctrl1);
+      HASH_POINT(data->node.ctrl2);
+    }
+  }
+
+#undef HASH_POINT
+#undef HASH_INT
+  return hash;
+}
+
+static void _scale_paths(dt_iop_liquify_params_t *p, const float scale)
+{
+  for(int k = 0; k < MAX_NODES; k++)
+  {
+    dt_liquify_path_data_t *data = &p->nodes[k];
+    if(data->header.type == DT_LIQUIFY_PATH_INVALIDATED)
+      break;
 
-    // copy map into imap(inverted map).
-    // imap [ n + dx(map[n]) , n + dy(map[n]) ] = -map[n]
+    data->warp.point *= scale;
+    data->warp.strength *= scale;
+    data->warp.radius *= scale;
+    data->node.ctrl1 *= scale;
+    data->node.ctrl2 *= scale;
+  }
+}
 
-    #ifdef _OPENMP
-    #pragma omp parallel for schedule (static) default (shared)
-    #endif
+static size_t _map_bytes(const dt_liquify_map_t *m)
+{
+  return m->map ? sizeof(float complex) * m->extent.width * m->extent.height : 0;
+}
 
-    for(int y = 0; y <  map_extent->height; y++)
+static void _map_free(dt_liquify_map_t *m)
+{
+  dt_free_align((void *)m->map);
+  free(m);
+}
+
+// to be called with map_cache_lock held
+
+static gboolean _rect_contains(const cairo_rectangle_int_t *outer, const cairo_rectangle_int_t *inner)
+{
+  return inner->x >= outer->x && inner->y >= outer->y && inner->x + inner->width <= outer->x + outer->width
+         && inner->y + inner->height <= outer->y + outer->height;
+}
+
+// a map of these paths exact at least inside roi, any if roi is NULL
+static dt_liquify_map_t *_map_cache_find(dt_iop_liquify_global_data_t *gd, const uint64_t hash,
+                                         const float scale, const gboolean inverted,
+                                         const gboolean allow_resampled, const cairo_rectangle_int_t *roi)
+{
+  for(GList *l = gd->map_cache; l; l = g_list_next(l))
+  {
+    dt_liquify_map_t *m = (dt_liquify_map_t *)l->data;
+    if(m->hash == hash && m->scale == scale && m->inverted == inverted
+       && (allow_resampled || !m->resampled) && (!m->partial || (roi && _rect_contains(&m->roi, roi))))
     {
-      const float complex *const row = map + y * map_extent->width;
-      for(int x = 0; x < map_extent->width; x++)
-      {
-        const float complex d = row[x];
-        // compute new position (nx,ny) given the displacement d
-        const int nx = x + (int)crealf(d);
-        const int ny = y + (int)cimagf(d);
-
-        // if the point falls into the extent, set it
-        if(nx>0 && nx<map_extent->width && ny>0 && ny<map_extent->height)
-          imap[nx + ny * map_extent->width] = -d;
-      }
+      // most recently used first
+      gd->map_cache = g_list_remove_link(gd->map_cache, l);
+      gd->map_cache = g_list_concat(l, gd->map_cache);
+      m->users++;
+      return m;
     }
+  }
+  return NULL;
+}
+
+// the finest cached non inverted map of these paths, if finer than scale. to be called with
+// map_cache_lock held.
+
+static dt_liquify_map_t *_map_cache_find_finer(dt_iop_liquify_global_data_t *gd, const uint64_t hash,
+                                               const float scale)
+{
+  dt_liquify_map_t *best = NULL;
+  for(GList *l = gd->map_cache; l; l = g_list_next(l))
+  {
+    dt_liquify_map_t *m = (dt_liquify_map_t *)l->data;
+    if(m->hash == hash && !m->inverted && !m->resampled && !m->partial && m->scale > scale
+       && (!best || m->scale > best->scale))
+      best = m;
+  }
+  if(best) best->users++;
+  return best;
+}
+
+static void _map_release(dt_iop_liquify_global_data_t *gd, dt_liquify_map_t *m)
+{
+  dt_pthread_mutex_lock(&gd->map_cache_lock);
+  m->users--;
+  const gboolean release = m->evicted && m->users == 0;
+  dt_pthread_mutex_unlock(&gd->map_cache_lock);
+
+  if(release) _map_free(m);
+}
+
+// insert a freshly built map with one user. If another thread inserted the same map in the
+// meantime that one is returned and ours is freed.
+
+static dt_liquify_map_t *_map_cache_insert(dt_iop_liquify_global_data_t *gd, dt_liquify_map_t *m)
+{
+  dt_pthread_mutex_lock(&gd->map_cache_lock);
+
+  dt_liquify_map_t *other
+      = _map_cache_find(gd, m->hash, m->scale, m->inverted, m->resampled, m->partial ? &m->roi : NULL);
+  if(other)
+  {
+    dt_pthread_mutex_unlock(&gd->map_cache_lock);
+    _map_free(m);
+    return other;
+  }
+
+  m->users = 1;
+  gd->map_cache = g_list_prepend(gd->map_cache, m);
+  gd->map_cache_size += _map_bytes(m);
+
+  // evict the least recently used maps, the ones still in use are freed on release. the maps are not counted
+  // by the tiling, keep them to a share of the memory it plans with.
+  const size_t max_size = MIN(MAP_CACHE_MAX_SIZE, dt_get_available_mem() / MAP_CACHE_MEM_SHARE);
+  while(gd->map_cache->next
+        && (g_list_length(gd->map_cache) > MAP_CACHE_ENTRIES || gd->map_cache_size > max_size))
+  {
+    GList *last = g_list_last(gd->map_cache);
+    dt_liquify_map_t *old = (dt_liquify_map_t *)last->data;
+    gd->map_cache = g_list_delete_link(gd->map_cache, last);
+    gd->map_cache_size -= _map_bytes(old);
+    old->evicted = TRUE;
+    if(old->users == 0) _map_free(old);
+  }
+
+  dt_pthread_mutex_unlock(&gd->map_cache_lock);
+  return m;
+}
+
+static void _map_cache_clear(dt_iop_liquify_global_data_t *gd)
+{
+  dt_pthread_mutex_lock(&gd->map_cache_lock);
+  for(GList *l = gd->map_cache; l; l = g_list_next(l))
+  {
+    dt_liquify_map_t *m = (dt_liquify_map_t *)l->data;
+    m->evicted = TRUE;
+    if(m->users == 0) _map_free(m);
+  }
+  g_list_free(gd->map_cache);
+  gd->map_cache = NULL;
+  gd->map_cache_size = 0;
+  dt_pthread_mutex_unlock(&gd->map_cache_lock);
+}
+
+// bilinear resampling of a map to a coarser scale, displacements are scaled as well.
 
-    dt_free_align((void *) map);
+static void _resample_map(const dt_liquify_map_t *src, dt_liquify_map_t *dst)
+{
+  const float f = dst->scale / src->scale;
 
-    // now just do a pass to avoid gap with a displacement of zero, note that we do not need high
-    // precision here as the inverted distortion mask is only used to compute a final displacement
-    // of points.
+  dst->extent.x = floorf(src->extent.x * f);
+  dst->extent.y = floorf(src->extent.y * f);
+  dst->extent.width = (int)ceilf((src->extent.x + src->extent.width) * f) - dst->extent.x;
+  dst->extent.height = (int)ceilf((src->extent.y + src->extent.height) * f) - dst->extent.y;
+  dst->map = NULL;
 
-    #ifdef _OPENMP
-    #pragma omp parallel for schedule (static) default (shared)
-    #endif
+  const size_t mapsize = (size_t)dst->extent.width * dst->extent.height;
+  if(src->map == NULL || mapsize == 0) return;
 
-    for(int y = 0; y <  map_extent->height; y++)
+  float complex *const map = dt_alloc_align(64, sizeof(float complex) * mapsize);
+  const float complex *const smap = src->map;
+  const cairo_rectangle_int_t se = src->extent;
+  const cairo_rectangle_int_t de = dst->extent;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(map, smap, se, de, f) \
+  schedule(static)
+#endif
+  for(int y = 0; y < de.height; y++)
+  {
+    const float sy = (y + de.y) / f - se.y;
+    const int y0 = floorf(sy);
+    const float fy = sy - y0;
+    for(int x = 0; x < de.width; x++)
     {
-      float complex *const row = imap + y * map_extent->width;
-      float complex last[2] = { 0, 0 };
-      for(int x = 0; x < map_extent->width / 2 + 1; x++)
+      const float sx = (x + de.x) / f - se.x;
+      const int x0 = floorf(sx);
+      const float fx = sx - x0;
+
+      float complex v = 0.0f;
+      for(int j = 0; j < 2; j++)
       {
-        float complex *cl = row + x;
-        float complex *cr = row + map_extent->width - x;
-        if(x!=0)
+        const int yy = y0 + j;
+        if(yy < 0 || yy >= se.height) continue;
+        const float wy = j ? fy : 1.0f - fy;
+        for(int i = 0; i < 2; i++)
         {
-          if(*cl == 0) *cl = last[0];
-          if(*cr == 0) *cr = last[1];
+          const int xx = x0 + i;
+          if(xx < 0 || xx >= se.width) continue;
+          const float wx = i ? fx : 1.0f - fx;
+          v += wx * wy * smap[(size_t)yy * se.width + xx];
         }
-        last[0] = *cl; last[1] = *cr;
       }
+      map[(size_t)y * de.width + x] = v * f;
     }
-
-    map = imap;
   }
-  return map;
+
+  dst->map = map;
 }
 
-static float complex *build_global_distortion_map(struct dt_iop_module_t *module,
-                                                   const dt_dev_pixelpipe_iop_t *piece,
-                                                   const dt_iop_roi_t *roi_in,
-                                                   const dt_iop_roi_t *roi_out,
-                                                   cairo_rectangle_int_t *map_extent)
+/*
+  Get the distortion map of the piece at the given scale, with the part inside roi at least.
+  The map must be released with _map_release(). On a miss the map is built for the warps touching roi
+  only, an interactive edit zoomed in would otherwise build far more than it shows. The export pipe, whose
+  tiles all need the map, and the callers whose roi covers all the warps anyway get the map of all the warps.
+  Maps too large to be cached are built for roi and freed on release.
+*/
+
+static dt_liquify_map_t *_get_distortion_map(struct dt_iop_module_t *module,
+                                             const dt_dev_pixelpipe_iop_t *piece,
+                                             const float scale,
+                                             const gboolean inverted,
+                                             const gboolean from_distort_transform,
+                                             const dt_iop_roi_t *roi)
 {
-  // copy params
+  dt_iop_liquify_global_data_t *gd = (dt_iop_liquify_global_data_t *)module->global_data;
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+
+  // the paths distorted into the piece at full resolution, this is the key of the map
   dt_iop_liquify_params_t copy_params;
   memcpy(&copy_params, (dt_iop_liquify_params_t *)piece->data, sizeof(dt_iop_liquify_params_t));
+  distort_paths_raw_to_piece(module, pipe, pipe->iscale, &copy_params, from_distort_transform);
 
-  distort_paths_raw_to_piece(module, piece->pipe, roi_in->scale, &copy_params, FALSE);
+  const uint64_t hash = _paths_hash(&copy_params);
+  const float map_scale = scale / pipe->iscale;
+
+  // the preview does not need an exact map, a finer one computed by the full pipe will do
+  const gboolean preview = (pipe->type & DT_DEV_PIXELPIPE_PREVIEW) == DT_DEV_PIXELPIPE_PREVIEW;
+
+  dt_pthread_mutex_lock(&gd->map_cache_lock);
+  const cairo_rectangle_int_t roi_rect = { roi->x, roi->y, roi->width, roi->height };
+  dt_liquify_map_t *m = _map_cache_find(gd, hash, map_scale, inverted, preview, &roi_rect);
+  dt_liquify_map_t *finer = (!m && !inverted && preview) ? _map_cache_find_finer(gd, hash, map_scale) : NULL;
+  dt_pthread_mutex_unlock(&gd->map_cache_lock);
 
+  if(m) return m;
+
+  m = (dt_liquify_map_t *)calloc(1, sizeof(dt_liquify_map_t));
+  m->hash = hash;
+  m->scale = map_scale;
+  m->inverted = inverted;
+
+  if(finer)
+  {
+    m->resampled = TRUE;
+    _resample_map(finer, m);
+    _map_release(gd, finer);
+    return _map_cache_insert(gd, m);
+  }
+
+  if(inverted)
+  {
+    // derived from the non inverted map
+    dt_liquify_map_t *direct = _get_distortion_map(module, piece, scale, FALSE, from_distort_transform, roi);
+    m->extent = direct->extent;
+    m->map = direct->map ? invert_global_distortion_map(direct->map, &direct->extent) : NULL;
+    m->resampled = direct->resampled;
+    // the inversion of a partial map is not exact up to its roi, it is kept for this caller only
+    const gboolean partial = direct->partial;
+    m->partial = partial;
+    m->roi = direct->roi;
+    _map_release(gd, direct);
+    if(!partial) return _map_cache_insert(gd, m);
+    m->users = 1;
+    m->evicted = TRUE;
+    return m;
+  }
+
+  _scale_paths(&copy_params, map_scale);
   GList *interpolated = interpolate_paths(&copy_params);
-  GSList *interpolated_in_roi = _get_map_extent(roi_out, interpolated, map_extent);
 
-  float complex *map = create_global_distortion_map(map_extent, interpolated_in_roi, FALSE);
+  // extent of all the warps
+  GSList *all = _get_map_extent(NULL, interpolated, &m->extent);
+  const size_t max_map_size = MIN(MAP_CACHE_MAX_MAP_SIZE, dt_get_singlebuffer_mem());
+  const gboolean whole = ((pipe->type & DT_DEV_PIXELPIPE_EXPORT) == DT_DEV_PIXELPIPE_EXPORT)
+                         || _rect_contains(&roi_rect, &m->extent);
+
+  if(whole && sizeof(float complex) * m->extent.width * m->extent.height <= max_map_size)
+  {
+    m->map = create_global_distortion_map(&m->extent, all);
+    g_slist_free(all);
+    g_list_free_full(interpolated, free);
+    return _map_cache_insert(gd, m);
+  }
 
+  // the part needed by roi only
+  g_slist_free(all);
+  GSList *interpolated_in_roi = _get_map_extent(roi, interpolated, &m->extent);
+  m->map = create_global_distortion_map(&m->extent, interpolated_in_roi);
   g_slist_free(interpolated_in_roi);
   g_list_free_full(interpolated, free);
-  return map;
+
+  m->partial = TRUE;
+  m->roi = roi_rect;
+  if(_map_bytes(m) <= max_map_size) return _map_cache_insert(gd, m);
+
+  m->users = 1;
+  m->evicted = TRUE;
+  return m;
 }
 
 // 1st pass: how large would the output be, given this input roi?
@@ -1327,27 +1675,21 @@ static int _distort_xtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *pi
 
   if(extent.width > 0 && extent.height > 0)
   {
-    // copy params
-    dt_iop_liquify_params_t copy_params;
-    memcpy(&copy_params, (dt_iop_liquify_params_t *)piece->data, sizeof(dt_iop_liquify_params_t));
-
-    distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params, TRUE);
-
-    // create the distortion map for this extent
+    // get the distortion map, at least for the warps in (possibly partly) this extent. it is
+    // shared with the pipe processing so that transforming points does not rebuild it.
 
-    GList *interpolated = interpolate_paths(&copy_params);
+    dt_iop_liquify_global_data_t *gd = (dt_iop_liquify_global_data_t *)self->global_data;
+    const dt_iop_roi_t roi_in = { .x = extent.x, .y = extent.y, .width = extent.width, .height = extent.height };
+    dt_liquify_map_t *m = _get_distortion_map(self, piece, scale, inverted, TRUE, &roi_in);
 
-    // we need to adjust the extent to be the union enclosing all the points (currently in extent) and
-    // the warps that are in (possibly partly) in this same region.
-
-    dt_iop_roi_t roi_in = { .x = extent.x, .y = extent.y, .width = extent.width, .height = extent.height };
-    GSList *interpolated_in_roi = _get_map_extent(&roi_in, interpolated, &extent);
-
-    float complex *map = create_global_distortion_map(&extent, interpolated_in_roi, inverted);
-    g_slist_free(interpolated_in_roi);
-    g_list_free_full(interpolated, free);
+    if(m->map == NULL)
+    {
+      _map_release(gd, m);
+      return 0;
+    }
 
-    if(map == NULL) return 0;
+    const float complex *const map = m->map;
+    extent = m->extent;
 
     const int map_size =  extent.width * extent.height;
     const int x_last = extent.x + extent.width;
@@ -1375,7 +1717,7 @@ static int _distort_xtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *pi
       }
     }
 
-    dt_free_align((void *) map);
+    _map_release(gd, m);
   }
 
   return 1;
@@ -1425,25 +1767,22 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
     memcpy(destrow, srcrow, sizeof(float) * roi_out->width);
   }
 
-  // 2. build the distortion map
+  // 2. get the distortion map
 
-  cairo_rectangle_int_t map_extent;
-  float complex *map = build_global_distortion_map(self, piece, roi_in, roi_out, &map_extent);
-  if(map == NULL)
-    return;
+  dt_iop_liquify_global_data_t *gd = (dt_iop_liquify_global_data_t *)self->global_data;
+  dt_liquify_map_t *m = _get_distortion_map(self, piece, roi_in->scale, FALSE, FALSE, roi_out);
 
   // 3. apply the map
 
-  if(map_extent.width != 0 && map_extent.height != 0)
+  if(m->map && m->extent.width != 0 && m->extent.height != 0)
   {
     int ch = piece->colors;
     piece->colors = 1;
-    apply_global_distortion_map(self, piece, in, out, roi_in, roi_out, map, &map_extent);
+    apply_global_distortion_map(self, piece, in, out, roi_in, roi_out, m->map, &m->extent);
     piece->colors = ch;
   }
 
-  dt_free_align((void *) map);
-
+  _map_release(gd, m);
 }
 
 void process(struct dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, const void *const in,
@@ -1471,19 +1810,17 @@ void process(struct dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, cons
     memcpy(destrow, srcrow, sizeof(float) * ch * width);
   }
 
-  // 2. build the distortion map
+  // 2. get the distortion map
 
-  cairo_rectangle_int_t map_extent;
-  float complex *map = build_global_distortion_map(module, piece, roi_in, roi_out, &map_extent);
-  if(map == NULL)
-    return;
+  dt_iop_liquify_global_data_t *gd = (dt_iop_liquify_global_data_t *)module->global_data;
+  dt_liquify_map_t *m = _get_distortion_map(module, piece, roi_in->scale, FALSE, FALSE, roi_out);
 
   // 3. apply the map
 
-  if(map_extent.width != 0 && map_extent.height != 0)
-    apply_global_distortion_map(module, piece, in, out, roi_in, roi_out, map, &map_extent);
+  if(m->map && m->extent.width != 0 && m->extent.height != 0)
+    apply_global_distortion_map(module, piece, in, out, roi_in, roi_out, m->map, &m->extent);
 
-  dt_free_align((void *)map);
+  _map_release(gd, m);
 }
 
 #ifdef HAVE_OPENCL
@@ -1614,6 +1951,27 @@ error:
   return err;
 }
 
+// copy the part of the map inside roi_out
+
+static float complex *_crop_map(const dt_liquify_map_t *m, const dt_iop_roi_t *roi_out,
+                                cairo_rectangle_int_t *extent)
+{
+  const cairo_rectangle_int_t roi_out_rect = { roi_out->x, roi_out->y, roi_out->width, roi_out->height };
+  cairo_region_t *region = cairo_region_create_rectangle(&roi_out_rect);
+  cairo_region_intersect_rectangle(region, &m->extent);
+  cairo_region_get_extents(region, extent);
+  cairo_region_destroy(region);
+
+  if(extent->width == 0 || extent->height == 0) return NULL;
+
+  float complex *map = dt_alloc_align(64, sizeof(float complex) * extent->width * extent->height);
+  for(int y = 0; y < extent->height; y++)
+    memcpy(map + (size_t)y * extent->width,
+           m->map + (size_t)(y + extent->y - m->extent.y) * m->extent.width + extent->x - m->extent.x,
+           sizeof(float complex) * extent->width);
+  return map;
+}
+
 int process_cl(struct dt_iop_module_t *module,
                 dt_dev_pixelpipe_iop_t *piece,
                 const cl_mem_t dev_in,
@@ -1635,9 +1993,12 @@ int process_cl(struct dt_iop_module_t *module,
     if(err != CL_SUCCESS) goto error;
   }
 
-  // 2. build the distortion map
+  // 2. get the distortion map, only the part inside roi_out is uploaded
+  dt_iop_liquify_global_data_t *gd = (dt_iop_liquify_global_data_t *)module->global_data;
+  dt_liquify_map_t *m = _get_distortion_map(module, piece, roi_in->scale, FALSE, FALSE, roi_out);
   cairo_rectangle_int_t map_extent;
-  const float complex *map = build_global_distortion_map(module, piece, roi_in, roi_out, &map_extent);
+  float complex *map = m->map ? _crop_map(m, roi_out, &map_extent) : NULL;
+  _map_release(gd, m);
   if(map == NULL)
     return TRUE;
 
@@ -1663,6 +2024,9 @@ void init_global(dt_iop_module_so_t *module)
   dt_iop_liquify_global_data_t *gd = (dt_iop_liquify_global_data_t *) malloc(sizeof(dt_iop_liquify_global_data_t));
   module->data = gd;
   gd->warp_kernel = dt_opencl_create_kernel(program, "warp_kernel");
+  dt_pthread_mutex_init(&gd->map_cache_lock, NULL);
+  gd->map_cache = NULL;
+  gd->map_cache_size = 0;
 }
 
 void cleanup_global(dt_iop_module_so_t *module)
@@ -1670,6 +2034,8 @@ void cleanup_global(dt_iop_module_so_t *module)
   // called once at shutdown
   dt_iop_liquify_global_data_t *gd = (dt_iop_liquify_global_data_t *) module->data;
   dt_opencl_free_kernel(gd->warp_kernel);
+  _map_cache_clear(gd);
+  dt_pthread_mutex_destroy(&gd->map_cache_lock);
   free(module->data);
   module->data = NULL;
 }
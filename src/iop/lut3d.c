@@ -33,6 +33,7 @@
 #include "gui/accelerators.h"
 #include "iop/iop_api.h"
 
+#include <glib/gstdio.h>
 #include <gtk/gtk.h>
 #include <libgen.h>
 #include <png.h>
@@ -50,6 +51,7 @@ DT_MODULE_INTROSPECTION(3, dt_iop_lut3d_params_t)
 #define DT_IOP_LUT3D_MAX_LUTNAME 128
 #define DT_IOP_LUT3D_CLUT_LEVEL 48
 #define DT_IOP_LUT3D_MAX_KEYPOINTS 2048
+#define DT_IOP_LUT3D_CACHE_IDLE 4 // cluts kept while no pipe uses them
 
 typedef enum dt_iop_lut3d_colorspace_t
 {
@@ -100,9 +102,20 @@ typedef enum dt_lut3d_cols_t
 
 const char invalid_filepath_prefix[] = "INVALID >> ";
 
+// a clut shared by the pipes, read-only once computed
+typedef struct dt_iop_lut3d_clut_t
+{
+  gchar *key;     // lut file, its mtime and size and the lutname, or the compressed lut
+  float *clut;
+  uint16_t level;
+  int refs;       // pipes using it
+  uint64_t used;  // last use, the oldest unused cluts are dropped first
+} dt_iop_lut3d_clut_t;
+
 typedef struct dt_iop_lut3d_data_t
 {
   dt_iop_lut3d_params_t params;
+  dt_iop_lut3d_clut_t *shared;
   float *clut;  // cube lut pointer
   uint16_t level; // cube_size
 } dt_iop_lut3d_data_t;
@@ -113,6 +126,9 @@ typedef struct dt_iop_lut3d_global_data_t
   int kernel_lut3d_trilinear;
   int kernel_lut3d_pyramid;
   int kernel_lut3d_none;
+  dt_pthread_mutex_t clut_lock;
+  GHashTable *cluts; // key -> dt_iop_lut3d_clut_t
+  uint64_t clut_use;
 } dt_iop_lut3d_global_data_t;
 
 #ifdef HAVE_GMIC
@@ -1106,6 +1122,14 @@ void filepath_set_unix_separator(char *filepath)
     if (filepath[i]=='\\') filepath[i] = '/';
 }
 
+static void _clut_free(gpointer data)
+{
+  dt_iop_lut3d_clut_t *c = (dt_iop_lut3d_clut_t *)data;
+  dt_free_align(c->clut);
+  g_free(c->key);
+  free(c);
+}
+
 void init_global(dt_iop_module_so_t *module)
 {
   const int program = 28; // rgbcurve.cl, from programs.conf
@@ -1116,6 +1140,9 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_lut3d_trilinear = dt_opencl_create_kernel(program, "lut3d_trilinear");
   gd->kernel_lut3d_pyramid = dt_opencl_create_kernel(program, "lut3d_pyramid");
   gd->kernel_lut3d_none = dt_opencl_create_kernel(program, "lut3d_none");
+  dt_pthread_mutex_init(&gd->clut_lock, NULL);
+  gd->cluts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _clut_free);
+  gd->clut_use = 0;
 
 #ifdef HAVE_GMIC
   // make sure the cache dir exists
@@ -1133,6 +1160,8 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_lut3d_trilinear);
   dt_opencl_free_kernel(gd->kernel_lut3d_pyramid);
   dt_opencl_free_kernel(gd->kernel_lut3d_none);
+  g_hash_table_destroy(gd->cluts);
+  dt_pthread_mutex_destroy(&gd->clut_lock);
   free(module->data);
   module->data = NULL;
 }
@@ -1175,6 +1204,107 @@ static int calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
   return level;
 }
 
+// the key of the clut of p, NULL if there is no lut to read
+static gchar *_clut_key(const dt_iop_lut3d_params_t *const p)
+{
+  if(!p->filepath[0]) return NULL;
+#ifdef HAVE_GMIC
+  if(p->nb_keypoints)
+  {
+    // the compressed lut is in the params
+    const size_t size = (size_t)MIN(p->nb_keypoints, DT_IOP_LUT3D_MAX_KEYPOINTS) * 2 * 3;
+    gchar *sum = g_compute_checksum_for_data(G_CHECKSUM_MD5, (const guchar *)p->c_clut, size);
+    gchar *key = g_strdup_printf("gmz:%s:%s", sum, p->lutname);
+    g_free(sum);
+    return key;
+  }
+#endif // HAVE_GMIC
+  gchar *key = NULL;
+  gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
+  if(lutfolder[0])
+  {
+    char *fullpath = g_build_filename(lutfolder, p->filepath, NULL);
+    GStatBuf st;
+    if(!g_stat(fullpath, &st))
+      key = g_strdup_printf("%s:%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%s", fullpath,
+                            (gint64)st.st_mtime, (gint64)st.st_size, p->lutname);
+    g_free(fullpath);
+  }
+  g_free(lutfolder);
+  return key;
+}
+
+// called with clut_lock held
+static void _clut_evict(dt_iop_lut3d_global_data_t *gd)
+{
+  while(TRUE)
+  {
+    int idle = 0;
+    dt_iop_lut3d_clut_t *oldest = NULL;
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, gd->cluts);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      dt_iop_lut3d_clut_t *c = (dt_iop_lut3d_clut_t *)value;
+      if(c->refs) continue;
+      idle++;
+      if(!oldest || c->used < oldest->used) oldest = c;
+    }
+    if(idle <= DT_IOP_LUT3D_CACHE_IDLE) return;
+    g_hash_table_remove(gd->cluts, oldest->key);
+  }
+}
+
+// the clut of p, read once for all the pipes (exports, thumbnails, darkroom) as long as the lut is unchanged
+static dt_iop_lut3d_clut_t *_clut_acquire(dt_iop_lut3d_global_data_t *gd, dt_iop_lut3d_params_t *const p)
+{
+  gchar *key = _clut_key(p);
+  if(!key) return NULL;
+
+  // the lock is kept while reading so that concurrent pipes wait for the same lut to be read once
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  dt_iop_lut3d_clut_t *c = (dt_iop_lut3d_clut_t *)g_hash_table_lookup(gd->cluts, key);
+  if(c)
+    g_free(key);
+  else
+  {
+    float *clut = NULL;
+    const uint16_t level = calculate_clut(p, &clut);
+    if(level && clut)
+    {
+      c = (dt_iop_lut3d_clut_t *)calloc(1, sizeof(dt_iop_lut3d_clut_t));
+      c->key = key;
+      c->clut = clut;
+      c->level = level;
+      g_hash_table_insert(gd->cluts, c->key, c);
+    }
+    else
+    {
+      if(clut) dt_free_align(clut);
+      g_free(key);
+    }
+  }
+  if(c)
+  {
+    c->refs++;
+    c->used = ++gd->clut_use;
+    _clut_evict(gd);
+  }
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+
+  return c;
+}
+
+static void _clut_release(dt_iop_lut3d_global_data_t *gd, dt_iop_lut3d_clut_t *c)
+{
+  if(!c) return;
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  c->refs--;
+  _clut_evict(gd);
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+}
+
 #ifdef HAVE_GMIC
 static gboolean list_match_string(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, dt_iop_lut3d_gui_data_t *g)
 {
@@ -1345,16 +1475,14 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 {
   dt_iop_lut3d_params_t *p = (dt_iop_lut3d_params_t *)p1;
   dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;
+  dt_iop_lut3d_global_data_t *gd = (dt_iop_lut3d_global_data_t *)self->global_data;
 
   if (strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
-  { // new clut file
-    if (d->clut)
-    { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
-    }
-    d->level = calculate_clut(p, &d->clut);
+  { // new clut file, release the current clut if any
+    _clut_release(gd, d->shared);
+    d->shared = _clut_acquire(gd, p);
+    d->clut = d->shared ? d->shared->clut : NULL;
+    d->level = d->shared ? d->shared->level : 0;
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1364,6 +1492,7 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
   piece->data = malloc(sizeof(dt_iop_lut3d_data_t));
   dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;
   memcpy(&d->params, self->default_params, sizeof(dt_iop_lut3d_params_t));
+  d->shared = NULL;
   d->clut = NULL;
   d->level = 0;
   d->params.filepath[0] = '\0';
@@ -1372,8 +1501,8 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;;
-  if (d->clut)
-    dt_free_align(d->clut);
+  _clut_release((dt_iop_lut3d_global_data_t *)self->global_data, d->shared);
+  d->shared = NULL;
   d->clut = NULL;
   d->level = 0;
   free(piece->data);
@@ -36,6 +36,7 @@
 #include "dtgtk/drawingarea.h"
 #include "gui/accelerators.h"
 #include "gui/color_picker_proxy.h"
+#include <limits.h>
 #include <stdlib.h>
 
 // this is the version of the modules parameters,
@@ -180,6 +181,7 @@ typedef struct dt_iop_retouch_global_data_t
   int kernel_retouch_copy_alpha;
   int kernel_retouch_copy_buffer_to_buffer;
   int kernel_retouch_copy_buffer_to_image;
+  int kernel_retouch_paste_buffer_to_buffer;
   int kernel_retouch_fill;
   int kernel_retouch_copy_image_to_buffer_masked;
   int kernel_retouch_copy_buffer_to_buffer_masked;
@@ -1912,6 +1914,7 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_retouch_copy_alpha = dt_opencl_create_kernel(program, "retouch_copy_alpha");
   gd->kernel_retouch_copy_buffer_to_buffer = dt_opencl_create_kernel(program, "retouch_copy_buffer_to_buffer");
   gd->kernel_retouch_copy_buffer_to_image = dt_opencl_create_kernel(program, "retouch_copy_buffer_to_image");
+  gd->kernel_retouch_paste_buffer_to_buffer = dt_opencl_create_kernel(program, "retouch_paste_buffer_to_buffer");
   gd->kernel_retouch_fill = dt_opencl_create_kernel(program, "retouch_fill");
   gd->kernel_retouch_copy_image_to_buffer_masked
       = dt_opencl_create_kernel(program, "retouch_copy_image_to_buffer_masked");
@@ -1930,6 +1933,7 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_retouch_copy_alpha);
   dt_opencl_free_kernel(gd->kernel_retouch_copy_buffer_to_buffer);
   dt_opencl_free_kernel(gd->kernel_retouch_copy_buffer_to_image);
+  dt_opencl_free_kernel(gd->kernel_retouch_paste_buffer_to_buffer);
   dt_opencl_free_kernel(gd->kernel_retouch_fill);
   dt_opencl_free_kernel(gd->kernel_retouch_copy_image_to_buffer_masked);
   dt_opencl_free_kernel(gd->kernel_retouch_copy_buffer_to_buffer_masked);
@@ -3312,7 +3316,8 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
         float *mask = NULL;
         dt_iop_roi_t roi_mask = { 0 };
 
-        dt_masks_get_mask(self, piece, form, &mask, &roi_mask.width, &roi_mask.height, &roi_mask.x, &roi_mask.y);
+        dt_masks_get_mask_cached(self, piece, form, &mask, &roi_mask.width, &roi_mask.height, &roi_mask.x,
+                                 &roi_mask.y);
         if(mask == NULL)
         {
           fprintf(stderr, "rt_process_forms: error retrieving mask\n");
@@ -3400,6 +3405,123 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
   }
 }
 
+// the part of roi which the forms read or change, grown by the support of the wavelet scales: outside of it the
+// decomposition gives back the image as is. returns FALSE if no form is in roi.
+static gboolean rt_get_forms_roi(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                                 const dt_iop_roi_t *const roi, const int scales, dt_iop_roi_t *roi_forms)
+{
+  dt_develop_blend_params_t *bp = (dt_develop_blend_params_t *)piece->blendop_data;
+  dt_iop_retouch_params_t *p = (dt_iop_retouch_params_t *)piece->data;
+
+  int roix = INT_MAX, roiy = INT_MAX, roir = INT_MIN, roib = INT_MIN;
+
+  const dt_masks_form_t *grp = dt_masks_get_from_id_ext(piece->pipe->forms, bp->mask_id);
+  if(grp && (grp->type & DT_MASKS_GROUP))
+  {
+    for(const GList *forms = grp->points; forms; forms = g_list_next(forms))
+    {
+      const dt_masks_point_group_t *grpt = (dt_masks_point_group_t *)forms->data;
+      if(grpt == NULL || grpt->formid == 0) continue;
+
+      const int index = rt_get_index_from_formid(p, grpt->formid);
+      if(index == -1) continue;
+
+      dt_masks_form_t *form = dt_masks_get_from_id_ext(piece->pipe->forms, grpt->formid);
+      if(form == NULL || !rt_masks_form_is_in_roi(self, piece, form, roi, roi)) continue;
+
+      int fl, ft, fw, fh;
+      if(!dt_masks_get_area(self, piece, form, &fw, &fh, &fl, &ft)) continue;
+      fw *= roi->scale, fh *= roi->scale, fl *= roi->scale, ft *= roi->scale;
+
+      // the destination
+      roix = MIN(roix, fl);
+      roiy = MIN(roiy, ft);
+      roir = MAX(roir, fl + fw);
+      roib = MAX(roib, ft + fh);
+
+      // and the source of clone and heal
+      const dt_iop_retouch_algo_type_t algo = p->rt_forms[index].algorithm;
+      float dx = 0.f, dy = 0.f;
+      if(algo != DT_IOP_RETOUCH_BLUR && algo != DT_IOP_RETOUCH_FILL
+         && rt_masks_get_delta_to_destination(self, piece, roi, form, &dx, &dy, p->rt_forms[index].distort_mode))
+      {
+        roix = MIN(roix, fl - (int)dx);
+        roiy = MIN(roiy, ft - (int)dy);
+        roir = MAX(roir, fl + fw - (int)dx);
+        roib = MAX(roib, ft + fh - (int)dy);
+      }
+    }
+  }
+
+  if(roir <= roix || roib <= roiy) return FALSE;
+
+  // a detail at the last scale depends on the pixels up to 2^scales - 1 away, plus the rounding of the scaled
+  // masks and the padding of heal
+  const int margin = (1 << scales) + 2;
+  roix = MAX(roix - margin, roi->x);
+  roiy = MAX(roiy - margin, roi->y);
+  roir = MIN(roir + margin, roi->x + roi->width);
+  roib = MIN(roib + margin, roi->y + roi->height);
+  if(roir <= roix || roib <= roiy) return FALSE;
+
+  *roi_forms = *roi;
+  roi_forms->x = roix;
+  roi_forms->y = roiy;
+  roi_forms->width = roir - roix;
+  roi_forms->height = roib - roiy;
+  return TRUE;
+}
+
+// copy in (of roi_in) into out (of roi_out), roi_in must be inside roi_out
+static void rt_paste_in_to_out(const float *const in, const struct dt_iop_roi_t *const roi_in, float *const out,
+                               const struct dt_iop_roi_t *const roi_out)
+{
+  const size_t rowsize = sizeof(float) * 4 * roi_in->width;
+  const int xoffs = roi_in->x - roi_out->x;
+  const int yoffs = roi_in->y - roi_out->y;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, out, roi_in, roi_out, rowsize, xoffs, yoffs) \
+  schedule(static)
+#endif
+  for(int y = 0; y < roi_in->height; y++)
+  {
+    const size_t iindex = (size_t)y * roi_in->width * 4;
+    const size_t oindex = ((size_t)(y + yoffs) * roi_out->width + xoffs) * 4;
+    memcpy(out + oindex, in + iindex, rowsize);
+  }
+}
+
+// decompose only the part roi_forms of in_retouch (of roi_rt) and retouch it, returns FALSE if the scales of
+// the whole image can't be used on that part
+static gboolean rt_decompose_forms_roi(float *const in_retouch, const dt_iop_roi_t *const roi_rt,
+                                       const dt_iop_roi_t *const roi_forms, const dwt_params_t *const dwt_p,
+                                       const int scales, retouch_user_data_t *usr_data)
+{
+  gboolean done = FALSE;
+
+  float *in_forms = dt_alloc_align_float((size_t)4 * roi_forms->width * roi_forms->height);
+  dwt_params_t *dwt_forms = dt_dwt_init(in_forms, roi_forms->width, roi_forms->height, 4, dwt_p->scales,
+                                        dwt_p->return_layer, dwt_p->merge_from_scale, usr_data,
+                                        dwt_p->preview_scale, dwt_p->use_sse);
+  if(in_forms == NULL || dwt_forms == NULL || dwt_get_max_scale(dwt_forms) < scales) goto cleanup;
+
+  rt_copy_in_to_out(in_retouch, roi_rt, in_forms, roi_forms, 4, 0, 0);
+
+  usr_data->roi = *roi_forms;
+  dwt_decompose(dwt_forms, rt_process_forms);
+  usr_data->roi = *roi_rt;
+
+  rt_paste_in_to_out(in_forms, roi_forms, in_retouch, roi_rt);
+  done = TRUE;
+
+cleanup:
+  if(in_forms) dt_free_align(in_forms);
+  if(dwt_forms) dt_dwt_free(dwt_forms);
+  return done;
+}
+
 static void process_internal(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
                              void *const ovoid, const dt_iop_roi_t *const roi_in,
                              const dt_iop_roi_t *const roi_out, const int use_sse)
@@ -3472,8 +3594,22 @@ static void process_internal(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
     if(g) g->first_scale_visible = dt_dwt_first_scale_visible(dwt_p);
   }
 
+  // decompose only the part of the image the forms read or change, the rest is given back as is. the whole
+  // image is needed to show a single scale
+  gboolean decompose = TRUE;
+  if(dwt_p->return_layer == 0)
+  {
+    const int scales = MIN(dwt_p->scales, dwt_get_max_scale(dwt_p));
+    dt_iop_roi_t roi_forms = *roi_rt;
+    if(usr_data.suppress_mask || !rt_get_forms_roi(self, piece, roi_rt, scales, &roi_forms))
+      decompose = FALSE; // nothing to retouch
+    else if((roi_forms.width < roi_rt->width || roi_forms.height < roi_rt->height)
+            && roi_forms.width > (1 << scales) && roi_forms.height > (1 << scales))
+      decompose = !rt_decompose_forms_roi(in_retouch, roi_rt, &roi_forms, dwt_p, scales, &usr_data);
+  }
+
   // decompose it
-  dwt_decompose(dwt_p, rt_process_forms);
+  if(decompose) dwt_decompose(dwt_p, rt_process_forms);
 
   dt_aligned_pixel_t levels = { p->preview_levels[0], p->preview_levels[1], p->preview_levels[2] };
 
@@ -3667,6 +3803,49 @@ cleanup:
   return err;
 }
 
+// copy dev_in (of roi_in) into dev_out (of roi_out), roi_in must be inside roi_out
+static cl_int rt_paste_in_to_out_cl(const int devid, cl_mem dev_in, const struct dt_iop_roi_t *const roi_in,
+                                    cl_mem dev_out, const struct dt_iop_roi_t *const roi_out, const int kernel)
+{
+  cl_int err = CL_SUCCESS;
+
+  const int xoffs = roi_in->x - roi_out->x;
+  const int yoffs = roi_in->y - roi_out->y;
+
+  cl_mem dev_roi_in = NULL;
+  cl_mem dev_roi_out = NULL;
+
+  const size_t sizes[] = { ROUNDUPWD(roi_in->width), ROUNDUPHT(roi_in->height), 1 };
+
+  dev_roi_in = dt_opencl_copy_host_to_device_constant(devid, sizeof(dt_iop_roi_t), (void *)roi_in);
+  dev_roi_out = dt_opencl_copy_host_to_device_constant(devid, sizeof(dt_iop_roi_t), (void *)roi_out);
+  if(dev_roi_in == NULL || dev_roi_out == NULL)
+  {
+    fprintf(stderr, "rt_paste_in_to_out_cl error 1\n");
+    err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    goto cleanup;
+  }
+
+  dt_opencl_set_kernel_arg(devid, kernel, 0, sizeof(cl_mem), (void *)&dev_in);
+  dt_opencl_set_kernel_arg(devid, kernel, 1, sizeof(cl_mem), (void *)&dev_roi_in);
+  dt_opencl_set_kernel_arg(devid, kernel, 2, sizeof(cl_mem), (void *)&dev_out);
+  dt_opencl_set_kernel_arg(devid, kernel, 3, sizeof(cl_mem), (void *)&dev_roi_out);
+  dt_opencl_set_kernel_arg(devid, kernel, 4, sizeof(int), (void *)&xoffs);
+  dt_opencl_set_kernel_arg(devid, kernel, 5, sizeof(int), (void *)&yoffs);
+  err = dt_opencl_enqueue_kernel_2d(devid, kernel, sizes);
+  if(err != CL_SUCCESS)
+  {
+    fprintf(stderr, "rt_paste_in_to_out_cl error 2\n");
+    goto cleanup;
+  }
+
+cleanup:
+  if(dev_roi_in) dt_opencl_release_mem_object(dev_roi_in);
+  if(dev_roi_out) dt_opencl_release_mem_object(dev_roi_out);
+
+  return err;
+}
+
 static cl_int rt_build_scaled_mask_cl(const int devid, float *const mask, dt_iop_roi_t *const roi_mask,
                                       float **mask_scaled, cl_mem *p_dev_mask_scaled,
                                       dt_iop_roi_t *roi_mask_scaled, dt_iop_roi_t *const roi_in, const int dx,
@@ -4112,7 +4291,8 @@ static cl_int rt_process_forms_cl(cl_mem dev_layer, dwt_params_cl_t *const wt_p,
         float *mask = NULL;
         dt_iop_roi_t roi_mask = { 0 };
 
-        dt_masks_get_mask(self, piece, form, &mask, &roi_mask.width, &roi_mask.height, &roi_mask.x, &roi_mask.y);
+        dt_masks_get_mask_cached(self, piece, form, &mask, &roi_mask.width, &roi_mask.height, &roi_mask.x,
+                                 &roi_mask.y);
         if(mask == NULL)
         {
           fprintf(stderr, "rt_process_forms: error retrieving mask\n");
@@ -4218,6 +4398,44 @@ static cl_int rt_process_forms_cl(cl_mem dev_layer, dwt_params_cl_t *const wt_p,
   return err;
 }
 
+// decompose only the part roi_forms of in_retouch (of roi_rt) and retouch it, *done is FALSE if the scales of
+// the whole image can't be used on that part
+static cl_int rt_decompose_forms_roi_cl(const int devid, cl_mem in_retouch, const dt_iop_roi_t *const roi_rt,
+                                        const dt_iop_roi_t *const roi_forms, const dwt_params_cl_t *const dwt_p,
+                                        const int scales, retouch_user_data_t *usr_data,
+                                        dt_iop_retouch_global_data_t *gd, gboolean *done)
+{
+  cl_int err = CL_SUCCESS;
+  *done = FALSE;
+
+  cl_mem in_forms
+      = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * roi_forms->width * roi_forms->height);
+  dwt_params_cl_t *dwt_forms = dt_dwt_init_cl(devid, in_forms, roi_forms->width, roi_forms->height, dwt_p->scales,
+                                              dwt_p->return_layer, dwt_p->merge_from_scale, usr_data,
+                                              dwt_p->preview_scale);
+  if(in_forms == NULL || dwt_forms == NULL || dwt_get_max_scale_cl(dwt_forms) < scales) goto cleanup;
+
+  err = rt_copy_in_to_out_cl(devid, in_retouch, roi_rt, in_forms, roi_forms, 0, 0,
+                             gd->kernel_retouch_copy_buffer_to_buffer);
+  if(err != CL_SUCCESS) goto cleanup;
+
+  usr_data->roi = *roi_forms;
+  err = dwt_decompose_cl(dwt_forms, rt_process_forms_cl);
+  usr_data->roi = *roi_rt;
+  if(err != CL_SUCCESS) goto cleanup;
+
+  err = rt_paste_in_to_out_cl(devid, in_forms, roi_forms, in_retouch, roi_rt,
+                              gd->kernel_retouch_paste_buffer_to_buffer);
+  if(err != CL_SUCCESS) goto cleanup;
+
+  *done = TRUE;
+
+cleanup:
+  if(dwt_forms) dt_dwt_free_cl(dwt_forms);
+  if(in_forms) dt_opencl_release_mem_object(in_forms);
+  return err;
+}
+
 int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem dev_in, cl_mem dev_out,
                const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -4311,9 +4529,31 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
     if(g) g->first_scale_visible = dt_dwt_first_scale_visible_cl(dwt_p);
   }
 
+  // decompose only the part of the image the forms read or change, the rest is given back as is. the whole
+  // image is needed to show a single scale
+  gboolean decompose = TRUE;
+  if(dwt_p->return_layer == 0)
+  {
+    const int scales = MIN(dwt_p->scales, dwt_get_max_scale_cl(dwt_p));
+    dt_iop_roi_t roi_forms = *roi_rt;
+    if(usr_data.suppress_mask || !rt_get_forms_roi(self, piece, roi_rt, scales, &roi_forms))
+      decompose = FALSE; // nothing to retouch
+    else if((roi_forms.width < roi_rt->width || roi_forms.height < roi_rt->height)
+            && roi_forms.width > (1 << scales) && roi_forms.height > (1 << scales))
+    {
+      gboolean done = FALSE;
+      err = rt_decompose_forms_roi_cl(devid, in_retouch, roi_rt, &roi_forms, dwt_p, scales, &usr_data, gd, &done);
+      if(err != CL_SUCCESS) goto cleanup;
+      decompose = !done;
+    }
+  }
+
   // decompose it
-  err = dwt_decompose_cl(dwt_p, rt_process_forms_cl);
-  if(err != CL_SUCCESS) goto cleanup;
+  if(decompose)
+  {
+    err = dwt_decompose_cl(dwt_p, rt_process_forms_cl);
+    if(err != CL_SUCCESS) goto cleanup;
+  }
 
   dt_aligned_pixel_t levels = { p->preview_levels[0], p->preview_levels[1], p->preview_levels[2] };
 
@@ -51,6 +51,8 @@
 
 DT_MODULE_INTROSPECTION(5, dt_iop_watermark_params_t)
 
+#define DT_IOP_WATERMARK_CACHE_SIZE (64 * 1024 * 1024) // bytes of rendered watermarks kept
+
 // gchar *checksum = g_compute_checksum_for_data(G_CHECKSUM_MD5,data,length);
 
 typedef enum dt_iop_watermark_base_scale_t
@@ -105,6 +107,23 @@ typedef struct dt_iop_watermark_data_t
   char font[64];
 } dt_iop_watermark_data_t;
 
+// a watermark svg rendered at a given scale, reused by the pipes rendering the same document
+typedef struct dt_iop_watermark_raster_t
+{
+  gchar *svgdoc; // the document with its variables expanded
+  float scale;
+  RsvgDimensionData dimension;
+  cairo_surface_t *surface;
+  size_t size;
+} dt_iop_watermark_raster_t;
+
+typedef struct dt_iop_watermark_global_data_t
+{
+  dt_pthread_mutex_t lock;
+  GList *rasters; // most recently used first
+  size_t size;
+} dt_iop_watermark_global_data_t;
+
 typedef struct dt_iop_watermark_gui_data_t
 {
   GtkWidget *watermarks;                             // watermark
@@ -443,10 +462,98 @@ static gchar *_watermark_get_svgdoc(dt_iop_module_t *self, dt_iop_watermark_data
   return svgdata;
 }
 
+static void _raster_free(gpointer data)
+{
+  dt_iop_watermark_raster_t *r = (dt_iop_watermark_raster_t *)data;
+  cairo_surface_destroy(r->surface);
+  g_free(r->svgdoc);
+  free(r);
+}
+
+// the dimension of svgdoc, if it has already been rendered
+static gboolean _raster_get_dimension(dt_iop_watermark_global_data_t *gd, const gchar *svgdoc,
+                                      RsvgDimensionData *dimension)
+{
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&gd->lock);
+  for(const GList *l = gd->rasters; l && !found; l = g_list_next(l))
+  {
+    const dt_iop_watermark_raster_t *r = (dt_iop_watermark_raster_t *)l->data;
+    if(!strcmp(r->svgdoc, svgdoc))
+    {
+      *dimension = r->dimension;
+      found = TRUE;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->lock);
+  return found;
+}
+
+// a new reference on svgdoc rendered at scale, NULL if not cached
+static cairo_surface_t *_raster_get(dt_iop_watermark_global_data_t *gd, const gchar *svgdoc, const float scale)
+{
+  cairo_surface_t *surface = NULL;
+  dt_pthread_mutex_lock(&gd->lock);
+  for(GList *l = gd->rasters; l; l = g_list_next(l))
+  {
+    const dt_iop_watermark_raster_t *r = (dt_iop_watermark_raster_t *)l->data;
+    if(r->scale == scale && !strcmp(r->svgdoc, svgdoc))
+    {
+      surface = cairo_surface_reference(r->surface);
+      gd->rasters = g_list_remove_link(gd->rasters, l);
+      gd->rasters = g_list_concat(l, gd->rasters);
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->lock);
+  return surface;
+}
+
+static void _raster_add(dt_iop_watermark_global_data_t *gd, const gchar *svgdoc, const float scale,
+                        const RsvgDimensionData *dimension, cairo_surface_t *surface)
+{
+  dt_iop_watermark_raster_t *r = (dt_iop_watermark_raster_t *)malloc(sizeof(dt_iop_watermark_raster_t));
+  r->svgdoc = g_strdup(svgdoc);
+  r->scale = scale;
+  r->dimension = *dimension;
+  r->surface = cairo_surface_reference(surface);
+  r->size = (size_t)cairo_image_surface_get_stride(surface) * cairo_image_surface_get_height(surface);
+
+  dt_pthread_mutex_lock(&gd->lock);
+  gd->rasters = g_list_prepend(gd->rasters, r);
+  gd->size += r->size;
+  // the surfaces still used by a pipe are only freed with their last reference
+  while(gd->size > DT_IOP_WATERMARK_CACHE_SIZE && gd->rasters->next)
+  {
+    GList *last = g_list_last(gd->rasters);
+    dt_iop_watermark_raster_t *old = (dt_iop_watermark_raster_t *)last->data;
+    gd->size -= old->size;
+    gd->rasters = g_list_delete_link(gd->rasters, last);
+    _raster_free(old);
+  }
+  dt_pthread_mutex_unlock(&gd->lock);
+}
+
+// to be called with darktable.plugin_threadsafe held
+static RsvgHandle *_watermark_svg_new(const gchar *svgdoc)
+{
+  GError *error = NULL;
+  RsvgHandle *svg = rsvg_handle_new_from_data((const guint8 *)svgdoc, strlen(svgdoc), &error);
+  if(!svg || error)
+  {
+    fprintf(stderr, "[watermark] error processing svg file: %s\n", error ? error->message : "unknown");
+    if(error) g_error_free(error);
+    if(svg) g_object_unref(svg);
+    return NULL;
+  }
+  return svg;
+}
+
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
   dt_iop_watermark_data_t *data = (dt_iop_watermark_data_t *)piece->data;
+  dt_iop_watermark_global_data_t *gd = (dt_iop_watermark_global_data_t *)self->global_data;
   float *in = (float *)ivoid;
   float *out = (float *)ovoid;
   const int ch = piece->colors;
@@ -510,6 +617,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   if(stride == -1)
   {
     fprintf(stderr, "[watermark] cairo stride error\n");
+    g_free(svgdoc);
     dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
     return;
   }
@@ -523,34 +631,18 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
     fprintf(stderr, "[watermark] cairo surface error: %s\n",
             cairo_status_to_string(cairo_surface_status(surface)));
     g_free(image);
+    g_free(svgdoc);
     dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
     return;
   }
 
-  // rsvg (or some part of cairo which is used underneath) isn't thread safe, for example when handling fonts
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-
+  // the svg is only parsed and rendered by rsvg when this document hasn't been rendered yet at this scale, the
+  // rendering is kept for the next images. rsvg (or some part of cairo which is used underneath) isn't thread
+  // safe, for example when handling fonts, so this is done with darktable.plugin_threadsafe held.
   RsvgHandle *svg = NULL;
-  if(type == DT_WTM_SVG)
-  {
-    /* create the rsvghandle from parsed svg data */
-    GError *error = NULL;
-    svg = rsvg_handle_new_from_data((const guint8 *)svgdoc, strlen(svgdoc), &error);
-    g_free(svgdoc);
-    if(!svg || error)
-    {
-      cairo_surface_destroy(surface);
-      g_free(image);
-      dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
-      dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
-      fprintf(stderr, "[watermark] error processing svg file: %s\n", error->message);
-      g_error_free(error);
-      return;
-    }
-  }
+  gboolean locked = FALSE;
 
   // we use a second surface
-  guint8 *image_two = NULL;
   cairo_surface_t *surface_two = NULL;
 
   /* get the dimension of svg or png */
@@ -558,7 +650,22 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   switch(type)
   {
     case DT_WTM_SVG:
-      dimension = dt_get_svg_dimension(svg);
+      if(!_raster_get_dimension(gd, svgdoc, &dimension))
+      {
+        dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+        locked = TRUE;
+        svg = _watermark_svg_new(svgdoc);
+        if(!svg)
+        {
+          dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+          cairo_surface_destroy(surface);
+          g_free(image);
+          g_free(svgdoc);
+          dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
+          return;
+        }
+        dimension = dt_get_svg_dimension(svg);
+      }
       break;
     case DT_WTM_PNG:
       // load png into surface 2
@@ -567,16 +674,17 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
       {
         fprintf(stderr, "[watermark] cairo png surface 2 error: %s\n",
                 cairo_status_to_string(cairo_surface_status(surface_two)));
+        cairo_surface_destroy(surface_two);
         cairo_surface_destroy(surface);
         g_free(image);
         dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
-        dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
         return;
       }
       dimension.width = cairo_image_surface_get_width(surface_two);
       dimension.height = cairo_image_surface_get_height(surface_two);
       break;
   }
+  const RsvgDimensionData svg_dimension = dimension;
 
   // if no text is given dimensions are null
   if(!dimension.width) dimension.width = 1;
@@ -670,31 +778,53 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
     svg_offset_x = ceilf(3.0f * scale);
     svg_offset_y = ceilf(3.0f * scale);
 
-    const int watermark_width  = (int)((dimension.width  * scale) + 3* svg_offset_x);
-    const int watermark_height = (int)((dimension.height * scale) + 3* svg_offset_y) ;
-
-    const int stride_two = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, watermark_width);
-    image_two = (guint8 *)g_malloc0_n(watermark_height, stride_two);
-    surface_two = cairo_image_surface_create_for_data(image_two, CAIRO_FORMAT_ARGB32, watermark_width,
-                                                                   watermark_height, stride_two);
-    if((cairo_surface_status(surface_two) != CAIRO_STATUS_SUCCESS) || (image_two == NULL))
+    surface_two = _raster_get(gd, svgdoc, scale);
+    if(!surface_two)
     {
-      fprintf(stderr, "[watermark] cairo surface 2 error: %s\n",
-              cairo_status_to_string(cairo_surface_status(surface_two)));
-      cairo_surface_destroy(surface);
-      g_object_unref(svg);
-      g_free(image);
-      g_free(image_two);
-      dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
-      dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
-      return;
+      const int watermark_width  = (int)((dimension.width  * scale) + 3* svg_offset_x);
+      const int watermark_height = (int)((dimension.height * scale) + 3* svg_offset_y) ;
+
+      surface_two = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, watermark_width, watermark_height);
+      if(!locked)
+      {
+        dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+        locked = TRUE;
+      }
+      if(!svg) svg = _watermark_svg_new(svgdoc);
+      if(cairo_surface_status(surface_two) != CAIRO_STATUS_SUCCESS || !svg)
+      {
+        fprintf(stderr, "[watermark] cairo surface 2 error: %s\n",
+                cairo_status_to_string(cairo_surface_status(surface_two)));
+        dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+        if(svg) g_object_unref(svg);
+        cairo_surface_destroy(surface_two);
+        cairo_surface_destroy(surface);
+        g_free(image);
+        g_free(svgdoc);
+        dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, ch);
+        return;
+      }
+
+      /* create cairo context for the scaled watermark, and set proper scale and translation for it */
+      cairo_t *cr_two = cairo_create(surface_two);
+      cairo_translate(cr_two, svg_offset_x, svg_offset_y);
+      cairo_scale(cr_two, scale, scale);
+      /* render svg into surface*/
+      dt_render_svg(svg, cr_two, dimension.width, dimension.height, 0, 0);
+      cairo_destroy(cr_two);
+      cairo_surface_flush(surface_two);
+
+      _raster_add(gd, svgdoc, scale, &svg_dimension, surface_two);
     }
+
+    // no more non-thread safe rsvg usage
+    if(locked) dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+    if(svg) g_object_unref(svg);
+    g_free(svgdoc);
   }
 
   /* create cairo context and setup transformation/scale */
   cairo_t *cr = cairo_create(surface);
-  /* create cairo context for the scaled watermark */
-  cairo_t *cr_two = cairo_create(surface_two);
 
   // compute bounding box of rotated watermark
   const float bb_width = fabsf(svg_width * cosf(angle)) + fabsf(svg_height * sinf(angle));
@@ -736,31 +866,14 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   cairo_rotate(cr, angle);
   cairo_translate(cr, -cX, -cY);
 
-  // now set proper scale and translationfor the watermark itself
-  cairo_translate(cr_two, svg_offset_x, svg_offset_y);
-
-  switch(type)
-  {
-    case DT_WTM_SVG:
-      cairo_scale(cr_two, scale, scale);
-      /* render svg into surface*/
-      dt_render_svg(svg, cr_two, dimension.width, dimension.height, 0, 0);
-      break;
-    case DT_WTM_PNG:
-      cairo_scale(cr, scale, scale);
-      break;
-  }
-  cairo_surface_flush(surface_two);
+  // the png is scaled while painted
+  if(type == DT_WTM_PNG) cairo_scale(cr, scale, scale);
 
   // paint the watermark
   cairo_set_source_surface(cr, surface_two, -svg_offset_x, -svg_offset_y);
   cairo_paint(cr);
 
-  // no more non-thread safe rsvg usage
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
-
   cairo_destroy(cr);
-  cairo_destroy(cr_two);
 
   /* ensure that all operations on surface finishing up */
   cairo_surface_flush(surface);
@@ -790,12 +903,6 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   cairo_surface_destroy(surface);
   cairo_surface_destroy(surface_two);
   g_free(image);
-  if(type == DT_WTM_SVG)
-  {
-    g_free(image_two);
-    g_object_unref(svg);
-  }
-
 }
 
 static void watermark_callback(GtkWidget *tb, gpointer user_data)
@@ -1005,6 +1112,23 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 // fprintf(stderr, "Commit params: %s...\n",d->filename);
 }
 
+void init_global(dt_iop_module_so_t *module)
+{
+  dt_iop_watermark_global_data_t *gd
+      = (dt_iop_watermark_global_data_t *)calloc(1, sizeof(dt_iop_watermark_global_data_t));
+  dt_pthread_mutex_init(&gd->lock, NULL);
+  module->data = gd;
+}
+
+void cleanup_global(dt_iop_module_so_t *module)
+{
+  dt_iop_watermark_global_data_t *gd = (dt_iop_watermark_global_data_t *)module->data;
+  g_list_free_full(gd->rasters, _raster_free);
+  dt_pthread_mutex_destroy(&gd->lock);
+  free(module->data);
+  module->data = NULL;
+}
+
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   piece->data = malloc(sizeof(dt_iop_watermark_data_t));
@@ -19,6 +19,7 @@
 #include "libs/collect.h"
 #include "bauhaus/bauhaus.h"
 #include "common/collection.h"
+#include "common/collection_index.h"
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/film.h"
@@ -1237,6 +1238,66 @@ void tree_count_show(GtkTreeViewColumn *col, GtkCellRenderer *renderer, GtkTreeM
   g_free(name);
 }
 
+// a name of the tree with its sort key, name is owned by the tuple
+static name_key_tuple_t *_name_key_tuple_new(const int property, char *name, const int count, const int status)
+{
+  gchar *collate_key = NULL;
+
+  if(property == DT_COLLECTION_PROP_FOLDERS)
+  {
+    char *name_folded = g_utf8_casefold(name, -1);
+    char *name_folded_slash = g_strconcat(name_folded, G_DIR_SEPARATOR_S, NULL);
+    collate_key = g_utf8_collate_key_for_filename(name_folded_slash, -1);
+    g_free(name_folded_slash);
+    g_free(name_folded);
+  }
+  else
+    collate_key = tag_collate_key(name);
+
+  name_key_tuple_t *tuple = (name_key_tuple_t *)malloc(sizeof(name_key_tuple_t));
+  tuple->name = name;
+  tuple->collate_key = collate_key;
+  tuple->count = count;
+  tuple->status = property == DT_COLLECTION_PROP_FOLDERS ? status : -1;
+  return tuple;
+}
+
+// the names of the tree from the in-memory index of the collection if it is enabled and can answer
+static gboolean _tree_view_from_index(const int property, const int num, GList **names)
+{
+  GList *values = NULL;
+  if(!dt_collection_index_get_counts(property, num, &values)) return FALSE;
+
+  // whether the folders are reachable
+  GHashTable *status = g_hash_table_new(NULL, NULL);
+  if(property == DT_COLLECTION_PROP_FOLDERS)
+  {
+    sqlite3_stmt *stmt;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT id, status FROM memory.film_folder", -1,
+                                &stmt, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      g_hash_table_insert(status, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)),
+                          GINT_TO_POINTER(sqlite3_column_int(stmt, 1)));
+    sqlite3_finalize(stmt);
+  }
+
+  for(GList *l = values; l; l = g_list_next(l))
+  {
+    const dt_collection_index_value_t *value = l->data;
+    // the sql query only lists the film rolls of memory.film_folder
+    if(property == DT_COLLECTION_PROP_FOLDERS
+       && !g_hash_table_contains(status, GINT_TO_POINTER(value->id)))
+      continue;
+    *names = g_list_prepend(*names, _name_key_tuple_new(property, g_strdup(value->text), value->count,
+                                                       GPOINTER_TO_INT(g_hash_table_lookup(
+                                                           status, GINT_TO_POINTER(value->id)))));
+  }
+
+  g_hash_table_destroy(status);
+  dt_collection_index_free_counts(values);
+  return TRUE;
+}
+
 static const char *UNCATEGORIZED_TAG = N_("uncategorized");
 static void tree_view(dt_lib_collect_rule_t *dr)
 {
@@ -1285,11 +1346,20 @@ static void tree_view(dt_lib_collect_rule_t *dr)
     gtk_tree_store_clear(GTK_TREE_STORE(model));
     gtk_widget_hide(GTK_WIDGET(d->view));
 
+    // we need to sort the names ourselves and not let sqlite handle this
+    // because it knows nothing about path separators.
+    GList *sorted_names = NULL;
+
+    // the in-memory index, if enabled, gives the names without querying the database
+    const gboolean indexed = _tree_view_from_index(property, dr->num, &sorted_names);
+
     /* query construction */
     gchar *where_ext = dt_collection_get_extended_where(darktable.collection, dr->num);
     gchar *query = 0;
-    switch (property)
+    switch (indexed ? DT_COLLECTION_PROP_UNDEF : property)
     {
+      case DT_COLLECTION_PROP_UNDEF: // names from the index
+        break;
       case DT_COLLECTION_PROP_FOLDERS:
         query = g_strdup_printf("SELECT folder, film_rolls_id, COUNT(*) AS count, status"
                                 " FROM main.images AS mi"
@@ -1306,7 +1376,21 @@ static void tree_view(dt_lib_collect_rule_t *dr)
         const gboolean is_insensitive =
           dt_conf_is_equal("plugins/lighttable/tagging/case_sensitivity", "insensitive");
 
-        if(is_insensitive)
+        // without any other rule limiting the images, the counts are the maintained tag usage
+        const gboolean unrestricted = !g_strcmp0(where_ext, "(1=1)");
+
+        if(unrestricted && is_insensitive)
+          query = g_strdup("SELECT lower(name) AS name, 1 AS tagid, SUM(count) AS count"
+                           " FROM memory.tag_usage"
+                           " JOIN data.tags ON id = tagid"
+                           " WHERE count > 0"
+                           " GROUP BY lower(name)");
+        else if(unrestricted)
+          query = g_strdup("SELECT name, tagid, count"
+                           " FROM memory.tag_usage"
+                           " JOIN data.tags ON id = tagid"
+                           " WHERE count > 0");
+        else if(is_insensitive)
           query = g_strdup_printf("SELECT name, 1 AS tagid, SUM(count) AS count"
                                   " FROM (SELECT tagid, COUNT(*) as count"
                                   "   FROM main.images AS mi"
@@ -1390,17 +1474,14 @@ static void tree_view(dt_lib_collect_rule_t *dr)
 
     g_free(where_ext);
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    if(query) DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
 
     char **last_tokens = NULL;
     int last_tokens_length = 0;
     GtkTreeIter last_parent = { 0 };
 
-    // we need to sort the names ourselves and not let sqlite handle this
-    // because it knows nothing about path separators.
-    GList *sorted_names = NULL;
     guint index = 0;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    while(query && sqlite3_step(stmt) == SQLITE_ROW)
     {
       char *name;
       if(is_time_property(property) || property == DT_COLLECTION_PROP_DAY)
@@ -1414,29 +1495,12 @@ static void tree_view(dt_lib_collect_rule_t *dr)
         const char* sqlite_name = (const char *)sqlite3_column_text(stmt, 0);
         name = sqlite_name == NULL ? g_strdup("") : g_strdup(sqlite_name);
       }
-      gchar *collate_key = NULL;
 
       const int count = sqlite3_column_int(stmt, 2);
-
-      if(property == DT_COLLECTION_PROP_FOLDERS)
-      {
-        char *name_folded = g_utf8_casefold(name, -1);
-        char *name_folded_slash = g_strconcat(name_folded, G_DIR_SEPARATOR_S, NULL);
-        collate_key = g_utf8_collate_key_for_filename(name_folded_slash, -1);
-        g_free(name_folded_slash);
-        g_free(name_folded);
-      }
-      else
-        collate_key = tag_collate_key(name);
-
-      name_key_tuple_t *tuple = (name_key_tuple_t *)malloc(sizeof(name_key_tuple_t));
-      tuple->name = name;
-      tuple->collate_key = collate_key;
-      tuple->count = count;
-      tuple->status = property == DT_COLLECTION_PROP_FOLDERS ? sqlite3_column_int(stmt, 3) : -1;
-      sorted_names = g_list_prepend(sorted_names, tuple);
+      const int status = property == DT_COLLECTION_PROP_FOLDERS ? sqlite3_column_int(stmt, 3) : -1;
+      sorted_names = g_list_prepend(sorted_names, _name_key_tuple_new(property, name, count, status));
     }
-    sqlite3_finalize(stmt);
+    if(query) sqlite3_finalize(stmt);
     g_free(query);
     // this order should not be altered. the right feeding of the tree relies on it.
     sorted_names = g_list_sort(sorted_names, sort_folder_tag);
@@ -1649,6 +1713,41 @@ static void tree_view(dt_lib_collect_rule_t *dr)
     gtk_tree_model_foreach(d->treefilter, (GtkTreeModelForeachFunc)tree_expand, dr);
 }
 
+// fill the list from the in-memory index of the collection if it is enabled and can answer
+static gboolean _list_view_from_index(GtkListStore *store, const int property, const int num)
+{
+  GList *values = NULL;
+  if(!dt_collection_index_get_counts(property, num, &values)) return FALSE;
+
+  int index = 0;
+  for(GList *l = values; l; l = g_list_next(l))
+  {
+    const dt_collection_index_value_t *value = l->data;
+
+    // replace invalid utf8 characters if any
+    gchar *text = g_strdup(value->text);
+    gchar *ptr = text;
+    while(!g_utf8_validate(ptr, -1, (const gchar **)&ptr)) ptr[0] = '?';
+
+    gchar *escaped_text = g_markup_escape_text(text, -1);
+
+    GtkTreeIter iter;
+    gtk_list_store_append(store, &iter);
+    gtk_list_store_set(store, &iter, DT_LIB_COLLECT_COL_TEXT, value->text,
+                       DT_LIB_COLLECT_COL_ID, property == DT_COLLECTION_PROP_CAMERA ? index : value->id,
+                       DT_LIB_COLLECT_COL_TOOLTIP, escaped_text, DT_LIB_COLLECT_COL_PATH, value->text,
+                       DT_LIB_COLLECT_COL_VISIBLE, TRUE, DT_LIB_COLLECT_COL_COUNT, value->count,
+                       DT_LIB_COLLECT_COL_UNREACHABLE, 0, -1);
+
+    g_free(text);
+    g_free(escaped_text);
+    index++;
+  }
+
+  dt_collection_index_free_counts(values);
+  return TRUE;
+}
+
 static void list_view(dt_lib_collect_rule_t *dr)
 {
   // update related list
@@ -1671,8 +1770,14 @@ static void list_view(dt_lib_collect_rule_t *dr)
 
     char query[1024] = { 0 };
 
-    switch(property)
+    // the in-memory index, if enabled, fills the list without querying the database
+    const gboolean indexed = _list_view_from_index(GTK_LIST_STORE(model), property, dr->num);
+
+    switch(indexed ? DT_COLLECTION_PROP_UNDEF : property)
     {
+      case DT_COLLECTION_PROP_UNDEF: // filled from the index
+        break;
+
       case DT_COLLECTION_PROP_CAMERA:; // camera
         int index = 0;
         gchar *makermodel_query = g_strdup_printf("SELECT maker, model, COUNT(*) AS count "
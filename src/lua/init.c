@@ -45,6 +45,7 @@
 #include "lua/types.h"
 #include "lua/view.h"
 #include "lua/widget/widget.h"
+#include "lua/worker.h"
 
 static int dt_lua_init_init(lua_State*L)
 {
@@ -255,6 +256,7 @@ void dt_lua_finalize()
   luaA_close(darktable.lua_state.state);
   lua_close(darktable.lua_state.state);
   darktable.lua_state.state = NULL;
+  dt_lua_worker_cleanup();
   // never unlock
 }
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -25,6 +25,7 @@
 #include "lua/glist.h"
 #include "lua/image.h"
 #include "lua/widget/widget.h"
+#include "lua/worker.h"
 #include <common/darktable.h>
 #include <stdio.h>
 
@@ -38,6 +39,7 @@ typedef struct
   char *name;
   GList *supported_formats;
   lua_widget widget;
+  GBytes *parallel_store; // run in a worker state before store, can be NULL
 } lua_storage_gui_t;
 
 static void push_lua_data(lua_State*L, lua_storage_t *d)
@@ -106,6 +108,25 @@ static int store_wrapper(struct dt_imageio_module_storage_t *self, struct dt_ima
   }
 
   lua_storage_t *d = (lua_storage_t *)self_data;
+  lua_storage_gui_t *gui_data = (lua_storage_gui_t *)self->gui_data;
+
+  // the pure part of the storage runs in parallel with the other exports, without the lua lock.
+  // its results are passed to store in the main state.
+  lua_State *W = NULL;
+  int nresults = 0;
+  if(gui_data->parallel_store)
+  {
+    W = dt_lua_worker_acquire();
+    if(dt_lua_worker_push_function(W, gui_data->parallel_store))
+    {
+      lua_pushstring(W, complete_name);
+      lua_pushinteger(W, imgid);
+      lua_pushinteger(W, num);
+      lua_pushinteger(W, total);
+      lua_pushboolean(W, high_quality);
+      if(dt_lua_treated_pcall(W, 5, LUA_MULTRET) == LUA_OK) nresults = lua_gettop(W);
+    }
+  }
 
   dt_lua_lock();
   lua_State *L = darktable.lua_state.state;
@@ -125,6 +146,7 @@ static int store_wrapper(struct dt_imageio_module_storage_t *self, struct dt_ima
   {
     lua_pop(L, 3);
     dt_lua_unlock();
+    dt_lua_worker_release(W);
     g_free(filename);
     return 0;
   }
@@ -138,9 +160,11 @@ static int store_wrapper(struct dt_imageio_module_storage_t *self, struct dt_ima
   lua_pushboolean(L, high_quality);
   push_lua_data(L, d);
   dt_lua_goto_subtable(L, "extra");
-  dt_lua_treated_pcall(L, 8, 0);
+  if(W) nresults = dt_lua_worker_copy_values(W, L, nresults);
+  dt_lua_treated_pcall(L, 8 + nresults, 0);
   lua_pop(L, 2);
   dt_lua_unlock();
+  dt_lua_worker_release(W);
   g_free(filename);
   return false;
 }
@@ -371,7 +395,7 @@ static dt_imageio_module_storage_t ref_storage = {
 
 static int register_storage(lua_State *L)
 {
-  lua_settop(L, 7);
+  lua_settop(L, 8);
   lua_getfield(L, LUA_REGISTRYINDEX, "dt_lua_storages");
   lua_newtable(L);
 
@@ -391,6 +415,13 @@ static int register_storage(lua_State *L)
   data->name = strdup(name);
   data->supported_formats = NULL;
   data->widget = NULL;
+  data->parallel_store = NULL;
+
+  if(!lua_isnoneornil(L, 8))
+  {
+    // raises an error if the function can't run in a worker state
+    data->parallel_store = dt_lua_worker_dump(L, 8);
+  }
 
   if(!lua_isnoneornil(L, 3))
   {
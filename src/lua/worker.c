@@ -0,0 +1,170 @@
+/*
+   This file is part of darktable,
+   Copyright (C) 2021 darktable developers.
+
+   darktable is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   darktable is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/worker.h"
+#include "common/darktable.h"
+#include "lua/call.h"
+
+#include <string.h>
+
+// idle worker states, and the package paths of the main state to set in new ones
+static GMutex _worker_lock;
+static GQueue _worker_idle = G_QUEUE_INIT;
+static gchar *_worker_path = NULL;
+static gchar *_worker_cpath = NULL;
+
+static int _dump_writer(lua_State *L, const void *p, size_t sz, void *ud)
+{
+  g_byte_array_append((GByteArray *)ud, p, sz);
+  return 0;
+}
+
+GBytes *dt_lua_worker_dump(lua_State *L, int index)
+{
+  index = lua_absindex(L, index);
+  luaL_checktype(L, index, LUA_TFUNCTION);
+  if(lua_iscfunction(L, index)) luaL_error(L, "a C function can't be run in a worker state");
+
+  const char *upvalue;
+  for(int n = 1; (upvalue = lua_getupvalue(L, index, n)); n++)
+  {
+    lua_pop(L, 1);
+    if(strcmp(upvalue, "_ENV"))
+      luaL_error(L, "a function run in a worker state can't use the local variable '%s' of its script", upvalue);
+  }
+
+  // new workers search the modules where the main state does
+  lua_getglobal(L, "package");
+  lua_getfield(L, -1, "path");
+  lua_getfield(L, -2, "cpath");
+  g_mutex_lock(&_worker_lock);
+  g_free(_worker_path);
+  g_free(_worker_cpath);
+  _worker_path = g_strdup(lua_tostring(L, -2));
+  _worker_cpath = g_strdup(lua_tostring(L, -1));
+  g_mutex_unlock(&_worker_lock);
+  lua_pop(L, 3);
+
+  GByteArray *code = g_byte_array_new();
+  lua_pushvalue(L, index);
+  lua_dump(L, _dump_writer, code, 0);
+  lua_pop(L, 1);
+  return g_byte_array_free_to_bytes(code);
+}
+
+static lua_State *_worker_new(void)
+{
+  lua_State *W = luaL_newstate();
+  luaL_openlibs(W);
+
+  g_mutex_lock(&_worker_lock);
+  lua_getglobal(W, "package");
+  if(_worker_path)
+  {
+    lua_pushstring(W, _worker_path);
+    lua_setfield(W, -2, "path");
+  }
+  if(_worker_cpath)
+  {
+    lua_pushstring(W, _worker_cpath);
+    lua_setfield(W, -2, "cpath");
+  }
+  g_mutex_unlock(&_worker_lock);
+  lua_pop(W, 1);
+
+  dt_print(DT_DEBUG_LUA, "LUA created a worker state\n");
+  return W;
+}
+
+lua_State *dt_lua_worker_acquire(void)
+{
+  g_mutex_lock(&_worker_lock);
+  lua_State *W = g_queue_pop_head(&_worker_idle);
+  g_mutex_unlock(&_worker_lock);
+  return W ? W : _worker_new();
+}
+
+void dt_lua_worker_release(lua_State *W)
+{
+  if(!W) return;
+  lua_settop(W, 0);
+  g_mutex_lock(&_worker_lock);
+  g_queue_push_head(&_worker_idle, W);
+  g_mutex_unlock(&_worker_lock);
+}
+
+gboolean dt_lua_worker_push_function(lua_State *W, GBytes *code)
+{
+  // the loaded functions are cached in the registry of the worker, keyed by their code
+  if(lua_rawgetp(W, LUA_REGISTRYINDEX, code) == LUA_TFUNCTION) return TRUE;
+  lua_pop(W, 1);
+
+  gsize size = 0;
+  const char *bytes = g_bytes_get_data(code, &size);
+  if(dt_lua_check_print_error(W, luaL_loadbufferx(W, bytes, size, "=worker", "b")) != LUA_OK) return FALSE;
+
+  lua_pushvalue(W, -1);
+  lua_rawsetp(W, LUA_REGISTRYINDEX, code);
+  return TRUE;
+}
+
+int dt_lua_worker_copy_values(lua_State *src, lua_State *dst, int n)
+{
+  if(!lua_checkstack(dst, n)) return 0;
+  const int first = lua_gettop(src) - n + 1;
+  for(int i = first; i < first + n; i++)
+  {
+    switch(lua_type(src, i))
+    {
+      case LUA_TBOOLEAN:
+        lua_pushboolean(dst, lua_toboolean(src, i));
+        break;
+      case LUA_TNUMBER:
+        if(lua_isinteger(src, i))
+          lua_pushinteger(dst, lua_tointeger(src, i));
+        else
+          lua_pushnumber(dst, lua_tonumber(src, i));
+        break;
+      case LUA_TSTRING:
+      {
+        size_t len = 0;
+        const char *s = lua_tolstring(src, i, &len);
+        lua_pushlstring(dst, s, len);
+        break;
+      }
+      default:
+        lua_pushnil(dst);
+        break;
+    }
+  }
+  return n;
+}
+
+void dt_lua_worker_cleanup(void)
+{
+  g_mutex_lock(&_worker_lock);
+  lua_State *W;
+  while((W = g_queue_pop_head(&_worker_idle))) lua_close(W);
+  g_free(_worker_path);
+  g_free(_worker_cpath);
+  _worker_path = _worker_cpath = NULL;
+  g_mutex_unlock(&_worker_lock);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
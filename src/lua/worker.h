@@ -0,0 +1,69 @@
+/*
+   This file is part of darktable,
+   Copyright (C) 2021 darktable developers.
+
+   darktable is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   darktable is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "lua/lua.h"
+
+/*
+   worker states are independent lua states running pure functions outside of the global lua lock,
+   so that several threads can run them at the same time.
+
+   * they only have the standard lua libraries, with the package paths of the main state
+   * the functions are copied from the main state as bytecode and must not have any upvalue but _ENV,
+     i.e. they can use globals and the standard libraries but not locals of the script that defined them
+   * only nil, booleans, numbers and strings can be passed from one state to the other, the results of
+     a worker function are handed back to the main state to act on darktable
+   */
+
+/*
+   (-0,+0)
+   dump the lua function at index to run it in worker states. to be called on the main state with the lua
+   lock held. raises a lua error if the function can't be copied.
+   */
+GBytes *dt_lua_worker_dump(lua_State *L, int index);
+
+/*
+   get an idle worker state with an empty stack, a new one is created if all are busy.
+   can be called from any thread without the lua lock.
+   */
+lua_State *dt_lua_worker_acquire(void);
+
+/* give back a state acquired with dt_lua_worker_acquire, its stack is emptied */
+void dt_lua_worker_release(lua_State *W);
+
+/*
+   (-0,+1)
+   push the function dumped in code on the worker stack, it is loaded once per worker.
+   returns FALSE and pushes nothing if it can't be loaded.
+   */
+gboolean dt_lua_worker_push_function(lua_State *W, GBytes *code);
+
+/*
+   (-0,+n)
+   copy the n values at the top of src on the top of dst. nil, booleans, numbers and strings are copied,
+   any other type is replaced by nil. returns the number of values copied, 0 if dst has no room for them.
+   */
+int dt_lua_worker_copy_values(lua_State *src, lua_State *dst, int n);
+
+/* close all worker states, at shutdown */
+void dt_lua_worker_cleanup(void);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,198 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2022 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests and benchmark comparing the relaxation and the
+ * multigrid solvers of common/heal.c
+ *
+ * Please see ../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/heal.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// margin of the stamp around the healed disc
+#define MARGIN 16
+
+// accepted difference to the exact solution
+#define MAX_ERROR 2e-3f
+
+/*
+ * HELPERS
+ */
+
+typedef struct stamp_t
+{
+  int width, height;
+  float *src;   // pattern
+  float *dest;  // image to heal
+  float *mask;
+} stamp_t;
+
+// disc of the given diameter centered at (cx, cy), the pattern is textured and the image differs from it by a
+// linear gradient, which is the exact healing, plus a spot inside the disc
+static stamp_t *stamp_new(const int width, const int height, const float cx, const float cy,
+                          const float diameter)
+{
+  stamp_t *s = calloc(1, sizeof(stamp_t));
+  s->width = width;
+  s->height = height;
+  s->src = dt_alloc_align_float((size_t)4 * width * height);
+  s->dest = dt_alloc_align_float((size_t)4 * width * height);
+  s->mask = dt_alloc_align_float((size_t)width * height);
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      const size_t k = (size_t)y * width + x;
+      const float dx = x - cx, dy = y - cy;
+      s->mask[k] = dx * dx + dy * dy < 0.25f * diameter * diameter ? 1.0f : 0.0f;
+      for(int c = 0; c < 4; c++)
+      {
+        s->src[4 * k + c] = 0.5f + 0.2f * sinf(x * 0.7f + c) * cosf(y * 0.3f);
+        s->dest[4 * k + c] = s->src[4 * k + c] + 0.3f * x / width + 0.2f * y / height + 0.1f * c
+                             + (s->mask[k] != 0.0f ? 0.5f : 0.0f);
+      }
+    }
+  return s;
+}
+
+static void stamp_free(stamp_t *s)
+{
+  dt_free_align(s->src);
+  dt_free_align(s->dest);
+  dt_free_align(s->mask);
+  free(s);
+}
+
+// largest difference to the exact healing on the healed pixels
+static float stamp_error(const stamp_t *const s)
+{
+  float max = 0.0f;
+  for(int y = 0; y < s->height; y++)
+    for(int x = 0; x < s->width; x++)
+    {
+      const size_t k = (size_t)y * s->width + x;
+      if(s->mask[k] == 0.0f) continue;
+      for(int c = 0; c < 3; c++)
+      {
+        const float exact = s->src[4 * k + c] + 0.3f * x / s->width + 0.2f * y / s->height + 0.1f * c;
+        assert_true(isfinite(s->dest[4 * k + c]));
+        max = fmaxf(max, fabsf(s->dest[4 * k + c] - exact));
+      }
+    }
+  return max;
+}
+
+static double run(stamp_t *const s, const int multigrid)
+{
+  const double start = dt_get_wtime();
+  if(multigrid)
+    _heal_multigrid(s->src, s->dest, s->mask, s->width, 0, 0, s->width, s->height);
+  else
+    _heal_relaxation(s->src, s->dest, s->mask, s->width, s->height);
+  return dt_get_wtime() - start;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_fixed_pixels(void **state)
+{
+  // only the masked pixels change
+  stamp_t *s = stamp_new(160, 140, 80.0f, 70.0f, 120.0f);
+  float *orig = dt_alloc_align_float((size_t)4 * s->width * s->height);
+  memcpy(orig, s->dest, sizeof(float) * 4 * s->width * s->height);
+  dt_heal(s->src, s->dest, s->mask, s->width, s->height, 4);
+  for(size_t k = 0; k < (size_t)s->width * s->height; k++)
+    if(s->mask[k] == 0.0f)
+      for(int c = 0; c < 4; c++) assert_float_equal(s->dest[4 * k + c], orig[4 * k + c], 0.0f);
+  assert_true(stamp_error(s) < MAX_ERROR);
+  dt_free_align(orig);
+  stamp_free(s);
+}
+
+static void test_stamp_borders(void **state)
+{
+  // a mask cut by the borders of the stamp: both solvers must agree. not on the right border of odd widths,
+  // where the relaxation counts the padding pixel as a neighbor
+  const float centers[3][2] = { { 0.0f, 40.0f }, { 50.0f, 0.0f }, { 50.0f, 81.0f } };
+  for(int i = 0; i < 3; i++)
+  {
+    stamp_t *s1 = stamp_new(101, 81, centers[i][0], centers[i][1], 90.0f);
+    stamp_t *s2 = stamp_new(101, 81, centers[i][0], centers[i][1], 90.0f);
+    run(s1, 0);
+    run(s2, 1);
+    float max = 0.0f;
+    for(size_t k = 0; k < (size_t)4 * s1->width * s1->height; k++)
+      max = fmaxf(max, fabsf(s1->dest[k] - s2->dest[k]));
+    assert_true(max < MAX_ERROR);
+    stamp_free(s1);
+    stamp_free(s2);
+  }
+}
+
+static void test_benchmark(void **state)
+{
+  const int sizes[] = { 32, 64, 128, 256, 512 };
+  for(int i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+  {
+    const int size = sizes[i] + 2 * MARGIN;
+    stamp_t *s1 = stamp_new(size, size, 0.5f * size, 0.5f * size, sizes[i]);
+    stamp_t *s2 = stamp_new(size, size, 0.5f * size, 0.5f * size, sizes[i]);
+    const double t_relax = run(s1, 0);
+    const double t_mg = run(s2, 1);
+    const float err_relax = stamp_error(s1);
+    const float err_mg = stamp_error(s2);
+
+    print_message("heal disc %4d: relaxation %.4fs (error %.5f), multigrid %.4fs (error %.5f), x%.1f\n",
+                  sizes[i], t_relax, err_relax, t_mg, err_mg, t_relax / fmax(t_mg, 1e-6));
+
+    assert_true(err_mg < MAX_ERROR);
+    stamp_free(s1);
+    stamp_free(s2);
+  }
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_fixed_pixels),
+    cmocka_unit_test(test_stamp_borders),
+    cmocka_unit_test(test_benchmark),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,171 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2021 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests and benchmark comparing the regular and the fast
+ * (reduced pyramid) variants of common/locallaplacian.c
+ *
+ * Please see ../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/locallaplacian.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define WIDTH 1536
+#define HEIGHT 1024
+
+// local contrast default parameters
+#define SIGMA 0.5f
+#define SHADOWS 0.5f
+#define HIGHLIGHTS 0.5f
+#define CLARITY 0.25f
+
+// accepted difference in L between the two variants
+#define MAX_RMSE 1.5f
+
+/*
+ * HELPERS
+ */
+
+// Lab image with smooth gradients, hard edges and fine texture
+static float *gen_lab(const int wd, const int ht)
+{
+  float *img = dt_alloc_align_float((size_t)4 * wd * ht);
+  for(int j = 0; j < ht; j++)
+    for(int i = 0; i < wd; i++)
+    {
+      float *p = img + (size_t)4 * (j * wd + i);
+      const float smooth = 30.0f * sinf(i / 80.0f) * cosf(j / 120.0f);
+      const float edges = ((i / 128 + j / 128) & 1) ? 10.0f : -10.0f;
+      const float texture = 3.0f * sinf(i * 1.3f) * sinf(j * 1.7f);
+      p[0] = CLAMPS(50.0f + smooth + edges + texture, 0.0f, 100.0f);
+      p[1] = 10.0f * sinf(i / 50.0f);
+      p[2] = -10.0f * cosf(j / 70.0f);
+      p[3] = 0.0f;
+    }
+  return img;
+}
+
+static double run(const float *const in, float *const out, const int fast)
+{
+  const double start = dt_get_wtime();
+  if(fast)
+    local_laplacian_fast(in, out, WIDTH, HEIGHT, SIGMA, SHADOWS, HIGHLIGHTS, CLARITY, 0);
+  else
+    local_laplacian(in, out, WIDTH, HEIGHT, SIGMA, SHADOWS, HIGHLIGHTS, CLARITY, 0);
+  return dt_get_wtime() - start;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_flat_image(void **state)
+{
+  // without any detail, both variants must give back the input
+  const int wd = 256, ht = 192;
+  float *in = dt_alloc_align_float((size_t)4 * wd * ht);
+  float *out = dt_alloc_align_float((size_t)4 * wd * ht);
+  for(int fast = 0; fast < 2; fast++)
+  {
+    for(size_t k = 0; k < (size_t)wd * ht; k++)
+    {
+      in[4 * k + 0] = 40.0f;
+      in[4 * k + 1] = in[4 * k + 2] = in[4 * k + 3] = 0.0f;
+    }
+    local_laplacian_internal(in, out, wd, ht, SIGMA, SHADOWS, HIGHLIGHTS, CLARITY, 0, fast, 0);
+    for(size_t k = 0; k < (size_t)wd * ht; k++)
+      assert_float_equal(out[4 * k], 40.0f, 1e-2f);
+  }
+  dt_free_align(in);
+  dt_free_align(out);
+}
+
+static void test_fast_accuracy(void **state)
+{
+  float *in = gen_lab(WIDTH, HEIGHT);
+  float *ref = dt_alloc_align_float((size_t)4 * WIDTH * HEIGHT);
+  float *out = dt_alloc_align_float((size_t)4 * WIDTH * HEIGHT);
+
+  // warm up, then benchmark both
+  run(in, ref, 0);
+  const double t_ref = run(in, ref, 0);
+  const double t_fast = run(in, out, 1);
+
+  double sum = 0.0;
+  float max = 0.0f;
+  for(size_t k = 0; k < (size_t)WIDTH * HEIGHT; k++)
+  {
+    const float d = fabsf(out[4 * k] - ref[4 * k]);
+    assert_true(isfinite(out[4 * k]));
+    // colour is passed through untouched
+    assert_float_equal(out[4 * k + 1], in[4 * k + 1], 0.0f);
+    assert_float_equal(out[4 * k + 2], in[4 * k + 2], 0.0f);
+    sum += d * d;
+    max = fmaxf(max, d);
+  }
+  const float rmse = sqrtf(sum / ((double)WIDTH * HEIGHT));
+
+  print_message("local laplacian %dx%d: regular %.3fs, fast %.3fs (x%.2f), "
+                "L rmse %.3f, max %.3f, memory %zuMB vs %zuMB\n",
+                WIDTH, HEIGHT, t_ref, t_fast, t_ref / fmax(t_fast, 1e-6), rmse, max,
+                local_laplacian_memory_use(WIDTH, HEIGHT) >> 20,
+                local_laplacian_fast_memory_use(WIDTH, HEIGHT) >> 20);
+
+  assert_true(rmse < MAX_RMSE);
+
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+static void test_fast_memory_use(void **state)
+{
+  // the fast variant keeps a single remapped pyramid
+  assert_true(2 * local_laplacian_fast_memory_use(6000, 4000) < local_laplacian_memory_use(6000, 4000));
+  // too small for the reduced pyramid, falls back to the regular one
+  assert_int_equal(local_laplacian_fast_memory_use(6, 6), local_laplacian_memory_use(6, 6));
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_flat_image),
+    cmocka_unit_test(test_fast_accuracy),
+    cmocka_unit_test(test_fast_memory_use),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
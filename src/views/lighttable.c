@@ -373,6 +373,8 @@ static gboolean is_image_visible_cb(lua_State *L)
 void cleanup(dt_view_t *self)
 {
   dt_library_t *lib = (dt_library_t *)self->data;
+  dt_culling_cleanup(lib->culling);
+  dt_culling_cleanup(lib->preview);
   free(lib->culling);
   free(lib->preview);
   free(self->data);
@@ -574,6 +576,10 @@ void leave(dt_view_t *self)
   gtk_widget_hide(lib->culling->widget);
   gtk_widget_hide(lib->preview->widget);
 
+  // their prefetch jobs can't outlive the control, which is stopped before the cleanup of the views
+  dt_culling_stop_prefetch(lib->culling);
+  dt_culling_stop_prefetch(lib->preview);
+
   // exit preview mode if non-sticky
   if(lib->preview_state && lib->preview_sticky == 0)
   {
@@ -22,6 +22,7 @@
 #include "common/dtpthread.h"
 #include "common/imageio.h"
 #include "common/imageio_module.h"
+#include "common/prefetch.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "dtgtk/thumbtable.h"
@@ -41,21 +42,11 @@ typedef enum dt_slideshow_event_t
   S_REQUEST_STEP_BACK,
 } dt_slideshow_event_t;
 
-typedef enum dt_slideshow_slot_t
-{
-  S_LEFT      = 0,
-  S_CURRENT   = 1,
-  S_RIGHT     = 2,
-  S_SLOT_LAST = 3
-} dt_slideshow_slot_t;
-
 typedef struct _slideshow_buf_t
 {
   uint32_t *buf;
   uint32_t width;
   uint32_t height;
-  int32_t rank;
-  gboolean invalidated;
 } dt_slideshow_buf_t;
 
 typedef struct dt_slideshow_t
@@ -63,15 +54,15 @@ typedef struct dt_slideshow_t
   int32_t col_count;
   uint32_t width, height;
 
-  // buffers
-  dt_slideshow_buf_t buf[S_SLOT_LAST];
-  gboolean init_phase;
+  // rendered images, rank -> dt_slideshow_buf_t, filled by the prefetcher
+  GHashTable *buffers;
+  int32_t rank;
+  struct dt_prefetch_t *prefetch;
 
   // state machine stuff for image transitions:
   dt_pthread_mutex_t lock;
 
   gboolean auto_advance;
-  int exporting;
   int delay;
 
   // some magic to hide the mouse pointer
@@ -87,7 +78,6 @@ typedef struct dt_slideshow_format_t
 
 // fwd declare state machine mechanics:
 static void _step_state(dt_slideshow_t *d, dt_slideshow_event_t event);
-static dt_job_t *process_job_create(dt_slideshow_t *d);
 
 // callbacks for in-memory export
 static int bpp(dt_imageio_module_data_t *data)
@@ -115,48 +105,15 @@ static int write_image(dt_imageio_module_data_t *datai, const char *filename, co
   memcpy(data->buf.buf, in, sizeof(uint32_t) * datai->width * datai->height);
   data->buf.width = datai->width;
   data->buf.height = datai->height;
-  data->buf.invalidated = FALSE;
 
   return 0;
 }
 
-static void shift_left(dt_slideshow_t *d)
-{
-  uint32_t *tmp_buf = d->buf[S_LEFT].buf;
-
-  for(int k=S_LEFT; k<S_RIGHT; k++)
-  {
-    d->buf[k].buf         = d->buf[k+1].buf;
-    d->buf[k].rank        = d->buf[k+1].rank;
-    d->buf[k].width       = d->buf[k+1].width;
-    d->buf[k].height      = d->buf[k+1].height;
-    d->buf[k].invalidated = d->buf[k+1].invalidated;
-  }
-  d->buf[S_RIGHT].invalidated = TRUE;
-  d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 1;
-  d->buf[S_RIGHT].buf = tmp_buf;
-}
-
-static void shift_right(dt_slideshow_t *d)
-{
-  uint32_t *tmp_buf = d->buf[S_RIGHT].buf;
-
-  for(int k=S_RIGHT; k>S_LEFT; k--)
-  {
-    d->buf[k].buf         = d->buf[k-1].buf;
-    d->buf[k].rank        = d->buf[k-1].rank;
-    d->buf[k].width       = d->buf[k-1].width;
-    d->buf[k].height      = d->buf[k-1].height;
-    d->buf[k].invalidated = d->buf[k-1].invalidated;
-  }
-  d->buf[S_LEFT].invalidated = TRUE;
-  d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 1;
-  d->buf[S_LEFT].buf = tmp_buf;
-}
-
-static void requeue_job(dt_slideshow_t *d)
+static void _free_buf(gpointer data)
 {
-  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, process_job_create(d));
+  dt_slideshow_buf_t *buf = (dt_slideshow_buf_t *)data;
+  dt_free_align(buf->buf);
+  free(buf);
 }
 
 static void _set_delay(dt_slideshow_t *d, int value)
@@ -165,8 +122,11 @@ static void _set_delay(dt_slideshow_t *d, int value)
   dt_conf_set_int("slideshow_delay", d->delay);
 }
 
-static int process_image(dt_slideshow_t *d, dt_slideshow_slot_t slot)
+// render callback of the prefetcher, returns the size of the buffer or -1 on error
+static int64_t process_image(int32_t rank, const void *params, void *user_data)
 {
+  dt_slideshow_t *d = (dt_slideshow_t *)user_data;
+
   dt_imageio_module_format_t buf;
   buf.mime = mime;
   buf.levels = levels;
@@ -179,24 +139,19 @@ static int process_image(dt_slideshow_t *d, dt_slideshow_slot_t slot)
   dat.head.width = dat.head.max_width = d->width;
   dat.head.height = dat.head.max_height = d->height;
   dat.head.style[0] = '\0';
-  dat.rank = d->buf[slot].rank;
-  dat.buf.buf = dt_alloc_align(64, sizeof(uint32_t) * d->width * d->height);
+  dat.rank = rank;
 
-  d->exporting++;
-
-  const int32_t rank = dat.rank;
   const gchar *query = dt_collection_get_query(darktable.collection);
 
   if(rank<0 || rank>=d->col_count || !query)
   {
-    d->exporting--;
     dt_pthread_mutex_unlock(&d->lock);
-    goto error;
+    return -1;
   }
 
   dt_pthread_mutex_unlock(&d->lock);
 
-  // get random image id from sql
+  // get image id from sql
   int32_t id = 0;
 
   sqlite3_stmt *stmt;
@@ -206,108 +161,72 @@ static int process_image(dt_slideshow_t *d, dt_slideshow_slot_t slot)
   if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
   sqlite3_finalize(stmt);
 
+  if(!id) return -1;
+
+  dat.buf.buf = dt_alloc_align(64, sizeof(uint32_t) * dat.head.width * dat.head.height);
+  if(!dat.buf.buf) return -1;
+  dat.buf.width = dat.buf.height = 0;
+
   // this is a little slow, might be worth to do an option:
   const gboolean high_quality = !dt_conf_get_bool("ui/performance");
 
-  if(id)
+  // the flags are: ignore exif, display byteorder, high quality, upscale, thumbnail
+  dt_imageio_export_with_flags(id, "unused", &buf, (dt_imageio_module_data_t *)&dat, TRUE, TRUE,
+                               high_quality, TRUE, FALSE, FALSE, NULL, FALSE, FALSE, DT_COLORSPACE_DISPLAY,
+                               NULL, DT_INTENT_LAST, NULL, NULL, 1, 1, NULL);
+
+  if(dat.buf.width == 0 || dat.buf.height == 0)
   {
-    // the flags are: ignore exif, display byteorder, high quality, upscale, thumbnail
-    dt_imageio_export_with_flags(id, "unused", &buf, (dt_imageio_module_data_t *)&dat, TRUE, TRUE,
-                                 high_quality, TRUE, FALSE, FALSE, NULL, FALSE, FALSE, DT_COLORSPACE_DISPLAY,
-                                 NULL, DT_INTENT_LAST, NULL, NULL, 1, 1, NULL);
-
-    // lock to copy back into the slot the rendered buffer, not that this is done only if
-    // the slot rank is still the same as the local buffer rank. This can be false if the
-    // buffers have been shifted to advance to next image.
-    dt_pthread_mutex_lock(&d->lock);
-    if(dat.rank == d->buf[slot].rank)
-    {
-      memcpy(d->buf[slot].buf, dat.buf.buf, sizeof(uint32_t) * dat.buf.width * dat.buf.height);
-      d->buf[slot].width = dat.buf.width;
-      d->buf[slot].height = dat.buf.height;
-      d->buf[slot].invalidated = FALSE;
-    }
-    d->exporting--;
-    dt_pthread_mutex_unlock(&d->lock);
+    dt_free_align(dat.buf.buf);
+    return -1;
   }
 
-  dt_free_align(dat.buf.buf);
-  return 0;
+  dt_slideshow_buf_t *slot = (dt_slideshow_buf_t *)malloc(sizeof(dt_slideshow_buf_t));
+  *slot = dat.buf;
 
- error:
-  dt_free_align(dat.buf.buf);
-  return 1;
+  dt_pthread_mutex_lock(&d->lock);
+  g_hash_table_replace(d->buffers, GINT_TO_POINTER(rank), slot);
+  const gboolean shown = rank == d->rank;
+  dt_pthread_mutex_unlock(&d->lock);
+
+  if(shown) dt_control_queue_redraw_center();
+
+  return (int64_t)sizeof(uint32_t) * dat.head.width * dat.head.height;
 }
 
-static gboolean _is_idle(dt_slideshow_t *d)
+// evict callback of the prefetcher, the image left the window
+static void _evict_image(int32_t rank, void *user_data)
 {
-  return !((d->buf[S_LEFT].invalidated && d->buf[S_LEFT].rank <= d->col_count)
-           || (d->buf[S_CURRENT].invalidated && d->buf[S_CURRENT].rank <= d->col_count)
-           || (d->buf[S_RIGHT].invalidated && d->buf[S_RIGHT].rank <= d->col_count));
+  dt_slideshow_t *d = (dt_slideshow_t *)user_data;
+  dt_pthread_mutex_lock(&d->lock);
+  g_hash_table_remove(d->buffers, GINT_TO_POINTER(rank));
+  dt_pthread_mutex_unlock(&d->lock);
 }
 
 static gboolean auto_advance(gpointer user_data)
 {
   dt_slideshow_t *d = (dt_slideshow_t *)user_data;
   if(!d->auto_advance) return FALSE;
-  if(!_is_idle(d)) return TRUE; // never try to advance if still exporting, but call me back again
+  // never try to advance if the next image is still exporting, but call me back again
+  const int32_t next = d->rank + 1;
+  if(next < d->col_count && !dt_prefetch_is_ready(d->prefetch, next)) return TRUE;
   _step_state(d, S_REQUEST_STEP);
   return FALSE;
 }
 
-static int32_t process_job_run(dt_job_t *job)
-{
-  dt_slideshow_t *d = dt_control_job_get_params(job);
-
-  if(d->buf[S_CURRENT].invalidated && d->buf[S_CURRENT].rank <= d->col_count)
-  {
-    process_image(d, S_CURRENT);
-    dt_control_queue_redraw_center();
-  }
-  else if(d->buf[S_RIGHT].invalidated && d->buf[S_RIGHT].rank <= d->col_count)
-  {
-    process_image(d, S_RIGHT);
-  }
-  else if(d->buf[S_LEFT].invalidated && d->buf[S_LEFT].rank >= 0)
-  {
-    process_image(d, S_LEFT);
-  }
-
-  // any other slot to fill?
-  if(!_is_idle(d))
-    requeue_job(d);
-
-  return 0;
-}
-
-static dt_job_t *process_job_create(dt_slideshow_t *d)
-{
-  dt_job_t *job = dt_control_job_create(&process_job_run, "process slideshow image");
-  if(!job) return NULL;
-  dt_control_job_set_params(job, d, NULL);
-  return job;
-}
-
-static void _refresh_display(dt_slideshow_t *d)
-{
-  if(!d->buf[S_CURRENT].invalidated && d->buf[S_CURRENT].rank >= 0)
-    dt_control_queue_redraw_center();
-}
-
 // state machine stepping
 static void _step_state(dt_slideshow_t *d, dt_slideshow_event_t event)
 {
   dt_pthread_mutex_lock(&d->lock);
 
+  gboolean moved = FALSE;
+
   if(event == S_REQUEST_STEP)
   {
-    if(d->buf[S_CURRENT].rank < d->col_count - 1)
+    if(d->rank < d->col_count - 1)
     {
-      shift_left(d);
-      d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 1;
-      d->buf[S_RIGHT].invalidated = d->buf[S_RIGHT].rank < d->col_count;
-      _refresh_display(d);
-      requeue_job(d);
+      d->rank++;
+      moved = TRUE;
     }
     else
     {
@@ -317,13 +236,10 @@ static void _step_state(dt_slideshow_t *d, dt_slideshow_event_t event)
   }
   else if(event == S_REQUEST_STEP_BACK)
   {
-    if(d->buf[S_CURRENT].rank > 0)
+    if(d->rank > 0)
     {
-      shift_right(d);
-      d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 1;
-      d->buf[S_LEFT].invalidated = d->buf[S_LEFT].rank >= 0;
-      _refresh_display(d);
-      requeue_job(d);
+      d->rank--;
+      moved = TRUE;
     }
     else
     {
@@ -332,8 +248,18 @@ static void _step_state(dt_slideshow_t *d, dt_slideshow_event_t event)
     }
   }
 
+  const int32_t rank = d->rank;
+  const gboolean ready = g_hash_table_contains(d->buffers, GINT_TO_POINTER(rank));
+
   dt_pthread_mutex_unlock(&d->lock);
 
+  // the prefetcher calls back into _evict_image, must be done without the lock
+  if(moved)
+  {
+    dt_prefetch_set_position(d->prefetch, rank, rank, 0, d->col_count - 1);
+    if(ready) dt_control_queue_redraw_center();
+  }
+
   if(d->auto_advance) g_timeout_add_seconds(d->delay, auto_advance, d);
 }
 
@@ -384,7 +310,6 @@ void enter(dt_view_t *self)
 
   dt_control_change_cursor(GDK_BLANK_CURSOR);
   d->mouse_timeout = 0;
-  d->exporting = 0;
 
   dt_ui_panel_show(darktable.gui->ui, DT_UI_PANEL_LEFT, FALSE, TRUE);
   dt_ui_panel_show(darktable.gui->ui, DT_UI_PANEL_RIGHT, FALSE, TRUE);
@@ -409,13 +334,7 @@ void enter(dt_view_t *self)
   d->width = rect.width * darktable.gui->ppd;
   d->height = rect.height * darktable.gui->ppd;
 
-  for(int k=S_LEFT; k<S_SLOT_LAST; k++)
-  {
-    d->buf[k].buf = dt_alloc_align(64, sizeof(uint32_t) * d->width * d->height);
-    d->buf[k].width =  d->width;
-    d->buf[k].height = d->height;
-    d->buf[k].invalidated = TRUE;
-  }
+  d->buffers = g_hash_table_new_full(NULL, NULL, NULL, _free_buf);
 
   // if one selected start with it, otherwise start at the current lighttable offset
   const int imgid = dt_act_on_get_main_image();
@@ -434,9 +353,7 @@ void enter(dt_view_t *self)
     sqlite3_finalize(stmt);
   }
 
-  d->buf[S_CURRENT].rank = selrank == -1 ? dt_thumbtable_get_offset(dt_ui_thumbtable(darktable.gui->ui)) : selrank;
-  d->buf[S_LEFT].rank = d->buf[S_CURRENT].rank - 1;
-  d->buf[S_RIGHT].rank = d->buf[S_CURRENT].rank + 1;
+  d->rank = selrank == -1 ? dt_thumbtable_get_offset(dt_ui_thumbtable(darktable.gui->ui)) : selrank;
 
   d->col_count = dt_collection_get_count(darktable.collection);
 
@@ -447,8 +364,9 @@ void enter(dt_view_t *self)
 
   gtk_widget_grab_focus(dt_ui_center(darktable.gui->ui));
 
-  // start first job
-  dt_control_add_job(darktable.control, DT_JOB_QUEUE_USER_BG, process_job_create(d));
+  // start rendering the current image and the ones around it
+  d->prefetch = dt_prefetch_new(process_image, _evict_image, d, NULL, 0);
+  dt_prefetch_set_position(d->prefetch, d->rank, d->rank, 0, d->col_count - 1);
   dt_control_log(_("waiting to start slideshow"));
 }
 
@@ -461,19 +379,16 @@ void leave(dt_view_t *self)
   dt_control_change_cursor(GDK_LEFT_PTR);
   d->auto_advance = FALSE;
 
-  // exporting could be in action, just wait for the last to finish
+  // exporting could be in action, this waits for the last to finish
   // otherwise we will crash releasing lock and memory.
-  while(d->exporting > 0) sleep(1);
+  dt_prefetch_free(d->prefetch);
+  d->prefetch = NULL;
 
-  dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui), d->buf[S_CURRENT].rank, FALSE);
+  dt_thumbtable_set_offset(dt_ui_thumbtable(darktable.gui->ui), d->rank, FALSE);
 
   dt_pthread_mutex_lock(&d->lock);
-
-  for(int k=S_LEFT; k<S_SLOT_LAST; k++)
-  {
-    dt_free_align(d->buf[k].buf);
-    d->buf[k].buf = NULL;
-  }
+  g_hash_table_destroy(d->buffers);
+  d->buffers = NULL;
   dt_pthread_mutex_unlock(&d->lock);
 }
 
@@ -485,9 +400,9 @@ void expose(dt_view_t *self, cairo_t *cr, int32_t width, int32_t height, int32_t
   dt_pthread_mutex_lock(&d->lock);
   cairo_paint(cr);
 
-  const dt_slideshow_buf_t *slot = &(d->buf[S_CURRENT]);
+  const dt_slideshow_buf_t *slot = d->buffers ? g_hash_table_lookup(d->buffers, GINT_TO_POINTER(d->rank)) : NULL;
 
-  if(slot->buf && slot->rank >= 0 && !slot->invalidated)
+  if(slot)
   {
     // cope with possible resize of the window
     const float tr_width = d->width < slot->width ? 0.f : (d->width - slot->width) * .5f / darktable.gui->ppd;
@@ -109,6 +109,7 @@ tmp_node:add_parameter("number","integer",[[The number of the image out of the e
 tmp_node:add_parameter("total","integer",[[The total number of images in the export series.]])
 tmp_node:add_parameter("high_quality","boolean",[[True if the export is high quality.]])
 tmp_node:add_parameter("extra_data","table",[[An empty Lua table to take extra data. This table is common to the initialize, store and finalize calls in an export series.]])
+tmp_node:add_parameter("...","variable",[[The values returned by parallel_store, if any.]])
 tmp_node = darktable.register_storage:add_parameter("finalize","function",[[This function is called once all images are processed and all store calls are finished.]])
 tmp_node:set_attribute("optional",true)
 tmp_node:add_parameter("storage",types.dt_imageio_module_storage_t,[[The storage object used for the export.]])
@@ -132,6 +133,15 @@ tmp_node:add_return("table or nil",[[The modified table of images to export or n
 [[If nil (or nothing) is returned, the original list of images will be exported]]..para()..
 [[If a table of images is returned, that table will be used instead. The table can be empty. The images parameter can be modified and returned]])
 darktable.register_storage:add_parameter("widget",types.lua_widget,[[A widget to display in the export section of darktable's UI]]):set_attribute("optional",true)
+tmp_node = darktable.register_storage:add_parameter("parallel_store","function",[[A function called once for each exported image before store, in a separate Lua state and without holding the Lua lock, so that it runs in parallel with other exports.]]..para()..
+[[It only has access to the standard Lua libraries, not to the darktable API, and it can't use the local variables of the script that defines it (globals of the separate state are fine). Its results are passed to store, in the main Lua state, after the regular parameters. Only nil, booleans, numbers and strings can be returned.]])
+tmp_node:set_attribute("optional",true)
+tmp_node:add_parameter("filename","string",[[The name of a temporary file where the processed image is stored.]])
+tmp_node:add_parameter("image_id","integer",[[The id of the exported image.]])
+tmp_node:add_parameter("number","integer",[[The number of the image out of the export series.]])
+tmp_node:add_parameter("total","integer",[[The total number of images in the export series.]])
+tmp_node:add_parameter("high_quality","boolean",[[True if the export is high quality.]])
+tmp_node:add_return("variable",[[Values passed to store after the extra_data parameter.]])
 darktable.register_lib:set_text("Register a new lib object. A lib is a graphical element of darktable's user interface")
 darktable.register_lib:add_parameter("plugin_name","string","A unique name for your library")
 darktable.register_lib:add_parameter("name","string","A user-visible name for your library")